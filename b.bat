@@ -9,6 +9,7 @@ pushd bin
 
 set Libs= /LIBPATH:..\lib shell32.lib d3d11.lib d3dcompiler.lib shell32.lib Ole32.lib User32.lib Gdi32.lib Gdiplus.lib freetype.lib libwebp.lib libwebpdecoder.lib windowscodecs.lib dwmapi.lib Advapi32.lib /LIBPATH:..\src res.res
 set CompileFlags=/nologo /utf-8 /I ..\include /I ..\include\ui /I ..\include\webp /I ..\include\easyexif
+set Source=..\src\main.cpp
 set LinkFlags=/OUT:CactusViewer.exe /IGNORE:4099 /debug /subsystem:Windows %Libs%
 
 if %Mode%==release (
@@ -16,11 +17,21 @@ if %Mode%==release (
 ) else if %Mode%==debug (
     set CompileFlags=/EHsc /Zi /Od /D DEBUG_MODE=1 %CompileFlags%
     set LinkFlags=/debug %LinkFlags%
+) else if %Mode%==tests (
+    rem optimized but with asserts, and without the D3D11 debug layer so that it runs anywhere
+    set CompileFlags=/EHsc /Zi /O2 /D DEBUG_MODE=0 %CompileFlags%
+    set Source=..\tests\tests.cpp
+    set LinkFlags=/OUT:tests.exe /IGNORE:4099 /debug /subsystem:Console %Libs%
 ) else (
-    echo Unknown build mode %Mode%, expecting "release" or "debug" or no param.
+    echo Unknown build mode %Mode%, expecting "release", "debug", "tests" or no param.
 	popd
     exit /b 2
 )
 
-cl ..\src\main.cpp %CompileFlags% /link %LinkFlags%
+cl %Source% %CompileFlags% /link %LinkFlags%
+set Result=%errorlevel%
 popd
+if not %Result%==0 exit /b %Result%
+
+rem tests read their reference data relative to the repository root
+if %Mode%==tests bin\tests.exe
@@ -1,25 +1,70 @@
 #pragma once
 #include "ui_core.h"
 
-// helpers /////////////////////////////////////
-char *UI_tprintf(UI_Context *ctx, char* format, ...) {
-	va_list args;
-	va_start(args, format);
-	size_t bytes = vsnprintf(nullptr, 0, format, args) + 1;
-	va_end(args);
+// arenas //////////////////////////////////////
+#define UI_ARENA_COMMIT_BLOCK KB(64)
+
+void UI_arena_init(UI_Arena *arena, u64 reserve_bytes) {
+	arena->base = (u8 *)w_vm_reserve(reserve_bytes);
+	UI_assert(arena->base != nullptr && "Could not reserve address space for a UI arena!");
+	arena->reserved = reserve_bytes;
+	arena->committed = 0;
+	arena->pos = 0;
+}
 
-	if (ctx->string_storage_size + bytes > ctx->string_storage_capacity) {
-		UI_assert(!"Out of string storage memory.");
+// 'size' bytes aligned to 'align', a power of two. The memory isn't zeroed.
+void *UI_arena_push(UI_Arena *arena, u64 size, u64 align = 8) {
+	u64 start = (arena->pos + align - 1) & ~(align - 1);
+	u64 end = start + size;
+	if (end > arena->committed) {
+		u64 commit = (end + UI_ARENA_COMMIT_BLOCK - 1) & ~(u64)(UI_ARENA_COMMIT_BLOCK - 1);
+		commit = min(commit, arena->reserved);
+		UI_assert(end <= commit && "UI arena ran out of reserved memory!");
+		if (!w_vm_commit(arena->base + arena->committed, commit - arena->committed))
+			UI_assert(!"Could not commit memory for a UI arena!");
+		arena->committed = commit;
 	}
-	char *at = ctx->string_storage + ctx->string_storage_size;
-	//char *at = (char*)malloc(bytes);
+	arena->pos = end;
+	return arena->base + start;
+}
+
+void UI_arena_reset(UI_Arena *arena) {
+	arena->pos = 0;
+}
 
+char *UI_arena_vprintf(UI_Arena *arena, const char *format, va_list args) {
+	va_list measure;
+	va_copy(measure, args);
+	int size = vsnprintf(nullptr, 0, format, measure);
+	va_end(measure);
+	if (size < 0) return nullptr;
+	char *result = (char *)UI_arena_push(arena, size + 1, 1);
+	vsnprintf(result, size + 1, format, args);
+	return result;
+}
+
+// The arena of the frame being built. Its contents stay valid until the end of the next frame, like the
+// blocks in the previous frame buffer.
+UI_Arena *UI_get_current_frame_arena(UI_Context *ctx) {
+	return &ctx->frame_arenas[ctx->buffer_index];
+}
+
+// helpers /////////////////////////////////////
+char *UI_tprintf(UI_Context *ctx, const char* format, ...) {
+	va_list args;
 	va_start(args, format);
-	vsnprintf(at, bytes, format, args);
+	char *result = UI_arena_vprintf(UI_get_current_frame_arena(ctx), format, args);
 	va_end(args);
+	return result;
+}
 
-	ctx->string_storage_size += bytes;
-	return at;
+// Copies 'string' into the frame arena as the block's text.
+void UI_block_set_string(UI_Context *ctx, UI_Block *block, const char *string) {
+	int count = (int)strlen(string) + 1;
+	block->string.data = (char *)UI_arena_push(UI_get_current_frame_arena(ctx), count, 1);
+	memcpy(block->string.data, string, count);
+	block->string.count = count;
+	block->string.capacity = 0;
 }
 
 bool UI_handle_signal(bool *signal) {
@@ -38,19 +83,63 @@ StableDynarray<UI_Block>* UI_get_previous_frame_buffer(UI_Context *ctx) {
 #define UI_CURRENT 	0
 #define UI_PREVIOUS 1
 
+u64 UI_hash_bytes(u64 hash, const void *data, size_t size) {
+	const u8 *bytes = (const u8 *)data;
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+	return hash;
+}
+#define UI_hash_value(hash, value) UI_hash_bytes(hash, &(value), sizeof(value))
+
+// Tables are a power of two at least twice the number of entries, probed linearly.
+UI_Hash_Slot *UI_hash_index_lookup(Dynarray<UI_Hash_Slot> *table, u32 hash) {
+	u32 mask = table->count - 1;
+	u32 i = hash;
+	i ^= i >> 16; i *= 0x7feb352d;
+	i ^= i >> 15; i *= 0x846ca68b;
+	i ^= i >> 16;
+	for (i &= mask; table->data[i].index != 0 && table->data[i].hash != hash; i = (i + 1) & mask);
+	return &table->data[i];
+}
+
+void UI_hash_index_reset(Dynarray<UI_Hash_Slot> *table, int entries) {
+	int count = 16;
+	while (count < entries * 2) count *= 2;
+	table->resize(count);
+	memset(table->data, 0, count * sizeof(UI_Hash_Slot));
+}
+
+// Maps the hashes of the frame that just ended to their blocks, keeping the first block when several
+// share a hash like the linear search used to.
+void UI_index_previous_frame(UI_Context *ctx) {
+	auto buffer = UI_get_previous_frame_buffer(ctx);
+	UI_hash_index_reset(&ctx->previous_blocks_index, buffer->count);
+	for (u32 i = 0; i < buffer->count; i++) {
+		UI_Hash_Slot *slot = UI_hash_index_lookup(&ctx->previous_blocks_index, buffer->data[i].hash);
+		if (slot->index != 0) continue;
+		slot->hash = buffer->data[i].hash;
+		slot->index = i + 1;
+	}
+}
+
+UI_Block *UI_find_previous_block(UI_Context *ctx, u32 hash) {
+	if (ctx->previous_blocks_index.count == 0) return nullptr;
+	UI_Hash_Slot *slot = UI_hash_index_lookup(&ctx->previous_blocks_index, hash);
+	return slot->index ? &UI_get_previous_frame_buffer(ctx)->data[slot->index - 1] : nullptr;
+}
+
 UI_Block *UI_find_block(UI_Context *ctx, u32 hash, int frame) {
 	UI_assert(frame == UI_CURRENT || frame == UI_PREVIOUS);
 	UI_Block *result = 0;
-	StableDynarray<UI_Block>* buffer;
-	if 		(frame == UI_PREVIOUS) buffer = UI_get_previous_frame_buffer(ctx);
-	else if (frame == UI_CURRENT)  buffer = UI_get_current_frame_buffer(ctx);
-	if (hash != 0) {
-		for (u32 i = 0; i < buffer->count; ++i) {
-			UI_Block *block = &buffer->data[i];
-			if (block->hash == hash) {
-				result = block;
-				break;
-			}
+	if (hash == 0) return result;
+	if (frame == UI_PREVIOUS) return UI_find_previous_block(ctx, hash);
+	// the current frame's hashes are assigned after the blocks are pushed, so there is no index for it
+	StableDynarray<UI_Block>* buffer = UI_get_current_frame_buffer(ctx);
+	for (u32 i = 0; i < buffer->count; ++i) {
+		UI_Block *block = &buffer->data[i];
+		if (block->hash == hash) {
+			result = block;
+			break;
 		}
 	}
 	return result;
@@ -60,9 +149,9 @@ UI_Block *UI_find_block(UI_Context *ctx, u32 hash, int frame) {
 
 
 inline UI_Block *UI_find_block(UI_Context *ctx, u32 hash, bool previous = true) {
-	auto buffer = UI_get_previous_frame_buffer(ctx);
-	if (!previous)
-		buffer = UI_get_current_frame_buffer(ctx);
+	if (previous)
+		return UI_find_previous_block(ctx, hash);
+	auto buffer = UI_get_current_frame_buffer(ctx);
 	for (u32 i = 0; i < buffer->count; i++) {
 		if (buffer->data[i].hash == hash) {
 			return &buffer->data[i];
@@ -204,28 +293,6 @@ UI_Color4 UI_animate_color_4(
 }
 
 
-char* UI_sprintf(StableDynarray<char>* string_array, const char *format, ...) {
-
-	va_list va;
-	va_start(va, format);
-	int size = vsnprintf(0, 0, format, va);
-	char* result = 0;
-
-	if (string_array->count + size + 1 < string_array->capacity)
-	{
-		string_array->commit(string_array->_grow_capacity(string_array->count + size + 1));
-	}
-
-	if (size >= 0) { 
-		result = &string_array->data[string_array->count];
-		vsnprintf(&string_array->data[string_array->count], size + 1, format, va);
-		string_array->count += size + 1;
-	}
-	va_end(va);
-
-	return result;
-}
-
 UI_Block *UI_get_current_parent(UI_Context *ctx) {
 	if (ctx->parents.count)
 		return ctx->parents.back();
@@ -249,9 +316,10 @@ u32 UI_hash_djb2(UI_Context* ctx, char *str, u32 hash = 5381) {
     return hash;
 }
 /**
+* @param updatable : the texture can be changed afterwards with UI_update_texture and UI_recreate_texture
 * @return returns -1 if there is no free texture slot available, otherwise returns a valid handle that is >= 0
 **/
-i32 UI_create_texture(UI_Context *ctx, u8 *data, int w, int h) {
+i32 UI_create_texture(UI_Context *ctx, u8 *data, int w, int h, bool updatable = false) {
     // check if we have a free texture slot available
     i32 handle = -1;
     for (int i = 0; i < UI_MAX_TEXTURES; i++) {
@@ -270,112 +338,414 @@ i32 UI_create_texture(UI_Context *ctx, u8 *data, int w, int h) {
     switch (ctx->backend)
     {
         case UI_Render_Backend_Type::D3D11: 
-            UI_d3d11_create_texture(ctx, handle, data, w, h); break;
+            UI_d3d11_create_texture(ctx, handle, data, w, h, updatable); break;
+        case UI_Render_Backend_Type::Software: 
+            UI_software_create_texture(ctx, handle, data, w, h); break;
     }
 
     return handle;
 }
 
-UI_Font *UI_load_font_memory(UI_Context *ctx, unsigned char *data, size_t file_size, int ASCII_start, int ASCII_end, int *sizes, int sizes_count)
-{
-    UI_assert(ctx != nullptr && "UI context *ctx is a null pointer!");
-    UI_assert(ctx->initialized && "UI context wasn't initialized!");
-    UI_assert(ctx->backend != UI_Render_Backend_Type::None && "No render backend is initialized!");
-
-    UI_Font newfont = {0};
-    ctx->fonts.push_back(newfont);
-    UI_Font *font = &ctx->fonts.back();
+// Replaces the updatable texture behind 'handle' with a new one of another size.
+void UI_recreate_texture(UI_Context *ctx, i32 handle, u8 *data, int w, int h) {
+    UI_assert(handle >= 0 && handle < UI_MAX_TEXTURES && ctx->textures[handle]);
+    switch (ctx->backend)
+    {
+        case UI_Render_Backend_Type::D3D11: 
+            UI_d3d11_create_texture(ctx, handle, data, w, h, true); break;
+        case UI_Render_Backend_Type::Software: 
+            UI_software_create_texture(ctx, handle, data, w, h); break;
+    }
+}
 
-    FT_Face face;
-    FT_New_Memory_Face(ctx->ft_lib, data, file_size, 0, &face);
+// Uploads the w*h rect at x, y of 'data', an RGBA image 'pitch' bytes per row, to the same rect of the
+// updatable texture behind 'handle'.
+void UI_update_texture(UI_Context *ctx, i32 handle, u8 *data, int pitch, int x, int y, int w, int h) {
+    UI_assert(handle >= 0 && handle < UI_MAX_TEXTURES && ctx->textures[handle]);
+    switch (ctx->backend)
+    {
+        case UI_Render_Backend_Type::D3D11: 
+            UI_d3d11_update_texture(ctx, handle, data, pitch, x, y, w, h); break;
+        case UI_Render_Backend_Type::Software: 
+            UI_software_update_texture(ctx, handle, data, pitch, x, y, w, h); break;
+    }
+}
 
-    int char_count = ASCII_end - ASCII_start + 1;
-    font->char_count = char_count;
+// Glyph atlas ////////////////////////////////////
+// Glyphs are rasterized with FreeType the first time they are asked for and packed into the font's
+// atlas with stb_rect_pack. The atlas starts at UI_GLYPH_ATLAS_MIN and doubles when full; once it is
+// UI_GLYPH_ATLAS_MAX, the least recently used glyphs are evicted to make room. None of this
+// touches the GPU, UI_sync_font_textures uploads what changed before the UI is drawn.
+
+// Decodes the UTF-8 sequence at 's' into 'bytes' bytes, malformed sequences decode to U+FFFD.
+u32 UI_utf8_decode(const char *s, int *bytes) {
+    const u8 *p = (const u8 *)s;
+    u32 c = p[0];
+    int n = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : (c >> 3) == 0x1E ? 4 : 0;
+    if (n == 0) {
+        *bytes = 1;
+        return 0xFFFD;
+    }
+    if (n > 1) c &= 0x3F >> (n - 1);
+    for (int i = 1; i < n; i++) {
+        if ((p[i] & 0xC0) != 0x80) {
+            *bytes = i;
+            return 0xFFFD;
+        }
+        c = (c << 6) | (p[i] & 0x3F);
+    }
+    *bytes = n;
+    return c;
+}
 
-    font->sizes = (int *)malloc(sizeof(int) * sizes_count);
-    font->true_sizes = (int *)malloc(sizeof(int) * sizes_count);
-    for (int i = 0; i < sizes_count; i++) {
-        font->sizes[i] = sizes[i];
-        font->true_sizes[i] = 0;
+void UI_glyph_atlas_mark_dirty(UI_Font *font, int x0, int y0, int x1, int y1) {
+    if (font->dirty_x0 >= font->dirty_x1) {
+        font->dirty_x0 = x0; font->dirty_y0 = y0;
+        font->dirty_x1 = x1; font->dirty_y1 = y1;
+        return;
     }
+    font->dirty_x0 = min(font->dirty_x0, x0); font->dirty_y0 = min(font->dirty_y0, y0);
+    font->dirty_x1 = max(font->dirty_x1, x1); font->dirty_y1 = max(font->dirty_y1, y1);
+}
 
-    int w = 2000, h = 2000; // TODO(Wassim): fixed for now but we need a better way to handle this.
+// (Re)starts the atlas as an empty w*h image.
+void UI_glyph_atlas_reset(UI_Font *font, int w, int h) {
+    free(font->pixels);
+    free(font->packer_nodes);
+    font->pixels = (u8 *)calloc((size_t)w * h * 4, 1);
+    font->packer_nodes = (stbrp_node *)malloc(sizeof(stbrp_node) * w);
     font->w = w;
     font->h = h;
-    u8 *pixels_RGB  = (u8 *)calloc(w * h * 3, sizeof(u8));
-    u8 *pixels_RGBA = (u8 *)calloc(w * h * 4, sizeof(u8));
-    int pen_x = 0, pen_y = 0;
-    font->char_info = (UI_Font_Glyph_Info *)malloc(sizeof(UI_Font_Glyph_Info) * char_count * sizes_count);
-    font->sizes_count = sizes_count;
-    int max_height_row = 0;
-    for (int size_index = 0; size_index < sizes_count; size_index++) {
-        int size_h = sizes[size_index] * 64 * 72 / 69.0f;
-        FT_Set_Char_Size(face, 0, size_h, 0, 0);
-        FT_BBox bbox = face->bbox;
-        for (int ASCII_code = ASCII_start; ASCII_code <= ASCII_end; ASCII_code++) {
-            FT_Load_Char(face, ASCII_code, FT_LOAD_RENDER | FT_LOAD_TARGET_LCD);
-            FT_GlyphSlot glyph_slot = face->glyph;
-            size_t offset = char_count * size_index;
-            UI_Font_Glyph_Info* target_char = &font->char_info[offset + ASCII_code - ASCII_start];
-            FT_Bitmap* bitmap = &face->glyph->bitmap;
-            if(pen_x + bitmap->width >= w) {
-			    pen_x = 0;
-			    pen_y += max_height_row;
-                max_height_row = 0;
-		    }
-            for(int row = 0; row < bitmap->rows; ++row){
-		    	for(int col = 0; col < bitmap->width; col += 3){
-		    		int x = pen_x + col / 3;
-		    		int y = pen_y + row;
-		    		pixels_RGB[y*w*3 + x*3 + 0] = bitmap->buffer[row * bitmap->pitch + col + 0];
-		    		pixels_RGB[y*w*3 + x*3 + 1] = bitmap->buffer[row * bitmap->pitch + col + 1];
-		    		pixels_RGB[y*w*3 + x*3 + 2] = bitmap->buffer[row * bitmap->pitch + col + 2];
-		    	}
-		    }
-            target_char->x0         = pen_x;
-		    target_char->y0         = pen_y;
-		    target_char->x1         = pen_x + bitmap->width / 3;
-		    target_char->y1         = pen_y + bitmap->rows;
-		    target_char->x_off      = face->glyph->bitmap_left;
-		    target_char->y_off      = face->glyph->bitmap_top;
-		    target_char->advance_x  = (face->glyph->advance.x >> 6);
-            target_char->ybearing   = (face->glyph->metrics.vertBearingY) >> 6;
-            target_char->xbearing   = (face->glyph->metrics.vertBearingX) >> 6;
-
-            int char_h = (face->glyph->metrics.horiBearingY) >> 6;
-            font->true_sizes[size_index] = max(font->true_sizes[size_index], char_h);
-            max_height_row = max(max_height_row, char_h);
+    stbrp_init_target(&font->packer, w, h, font->packer_nodes, w);
+    font->dirty_x0 = font->dirty_x1 = 0;
+    font->resized = true;
+}
+
+// Doubles the atlas, keeping what is packed in the top left quarter where it was.
+bool UI_glyph_atlas_grow(UI_Font *font) {
+    if (font->w >= UI_GLYPH_ATLAS_MAX) return false;
+    int w = font->w, h = font->h;
+    u8 *pixels = font->pixels;
+    font->pixels = nullptr;
+    UI_glyph_atlas_reset(font, w * 2, h * 2);
+    for (int y = 0; y < h; y++)
+        memcpy(font->pixels + (size_t)y * font->w * 4, pixels + (size_t)y * w * 4, (size_t)w * 4);
+    free(pixels);
+    stbrp_rect used = {};
+    used.w = w;
+    used.h = h;
+    stbrp_pack_rects(&font->packer, &used, 1); // an empty target puts it at 0,0
+    UI_assert(used.was_packed && used.x == 0 && used.y == 0);
+    return true;
+}
+
+bool UI_glyph_atlas_pack(UI_Font *font, int w, int h, int *x, int *y) {
+    stbrp_rect rect = {};
+    rect.w = w;
+    rect.h = h;
+    stbrp_pack_rects(&font->packer, &rect, 1);
+    *x = rect.x;
+    *y = rect.y;
+    return rect.was_packed;
+}
+
+void UI_glyph_set_size(UI_Font *font, int face, int size_index) {
+    if (font->face_size_index[face] == size_index) return;
+    int size_h = font->sizes[size_index] * 64 * 72 / 69.0f;
+    FT_Set_Char_Size(font->faces[face], 0, size_h, 0, 0);
+    font->face_size_index[face] = size_index;
+}
+
+// One row of an LCD bitmap, the coverage of each subpixel in rgb, to RGBA with their average in a.
+void UI_lcd_to_rgba_row(u8 *dst, const u8 *src, int w) {
+    __m128i rgb_mask  = _mm_set1_epi32(0x00FFFFFF);
+    __m128i byte_mask = _mm_set1_epi32(0xFF);
+    __m128i third     = _mm_set1_epi32(21846); // (sum * 21846) >> 16 == sum / 3 for sums up to 765
+    int x = 0;
+    // 4 pixels at a time, each read as 4 bytes of which the last is the next pixel's, so a pixel is
+    // left for the scalar loop to keep the reads inside the row
+    for (; x + 5 <= w; x += 4) {
+        const u8 *s = src + x * 3;
+        __m128i v = _mm_setr_epi32(*(const i32 *)(s + 0), *(const i32 *)(s + 3),
+                                   *(const i32 *)(s + 6), *(const i32 *)(s + 9));
+        v = _mm_and_si128(v, rgb_mask);
+        __m128i sum = _mm_add_epi32(_mm_add_epi32(_mm_and_si128(v, byte_mask),
+                                                  _mm_and_si128(_mm_srli_epi32(v, 8), byte_mask)),
+                                    _mm_srli_epi32(v, 16));
+        __m128i a = _mm_mulhi_epu16(sum, third);
+        _mm_storeu_si128((__m128i *)(dst + x * 4), _mm_or_si128(v, _mm_slli_epi32(a, 24)));
+    }
+    for (; x < w; x++) {
+        int r = src[x * 3 + 0];
+        int g = src[x * 3 + 1];
+        int b = src[x * 3 + 2];
+        dst[x * 4 + 0] = r;
+        dst[x * 4 + 1] = g;
+        dst[x * 4 + 2] = b;
+        dst[x * 4 + 3] = (r + g + b) / 3;
+    }
+}
+
+void UI_glyph_atlas_evict(UI_Context *ctx, UI_Font *font);
+
+// Loads the glyph's metrics and, unless it is blank, packs its bitmap into the atlas. A glyph that
+// doesn't fit even after eviction stays unpacked and is drawn as nothing.
+void UI_glyph_rasterize(UI_Context *ctx, UI_Font *font, UI_Glyph *glyph) {
+    UI_glyph_set_size(font, glyph->face, glyph->size_index);
+    FT_Face face = font->faces[glyph->face];
+    FT_Load_Char(face, glyph->codepoint, FT_LOAD_RENDER | FT_LOAD_TARGET_LCD);
+    FT_Bitmap* bitmap = &face->glyph->bitmap;
+    int w = bitmap->width / 3;
+    int h = bitmap->rows;
+
+    UI_Font_Glyph_Info* target_char = &glyph->info;
+    memset(target_char, 0, sizeof(*target_char));
+    target_char->x_off      = face->glyph->bitmap_left;
+    target_char->y_off      = face->glyph->bitmap_top;
+    target_char->advance_x  = (face->glyph->advance.x >> 6);
+    target_char->ybearing   = (face->glyph->metrics.vertBearingY) >> 6;
+    target_char->xbearing   = (face->glyph->metrics.vertBearingX) >> 6;
+    glyph->packed = true;
+    if (w == 0 || h == 0) return;
+
+    int pen_x, pen_y;
+    bool packed = UI_glyph_atlas_pack(font, w + 1, h + 1, &pen_x, &pen_y);
+    while (!packed && UI_glyph_atlas_grow(font))
+        packed = UI_glyph_atlas_pack(font, w + 1, h + 1, &pen_x, &pen_y);
+    if (!packed) {
+        // eviction doesn't touch FreeType, the bitmap is still there afterwards
+        UI_glyph_atlas_evict(ctx, font);
+        packed = UI_glyph_atlas_pack(font, w + 1, h + 1, &pen_x, &pen_y);
+    }
+    if (!packed) {
+        glyph->packed = false;
+        return;
+    }
+
+    for (int row = 0; row < h; ++row) {
+        u8 *src = bitmap->buffer + row * bitmap->pitch;
+        u8 *dst = font->pixels + ((size_t)(pen_y + row) * font->w + pen_x) * 4;
+        UI_lcd_to_rgba_row(dst, src, w);
+    }
+    UI_glyph_atlas_mark_dirty(font, pen_x, pen_y, pen_x + w, pen_y + h);
+    target_char->x0 = pen_x;
+    target_char->y0 = pen_y;
+    target_char->x1 = pen_x + w;
+    target_char->y1 = pen_y + h;
+}
+
+struct UI_Glyph_Age {
+    u64 last_used;
+    int index;
+};
 
-		    pen_x += bitmap->width / 3 + 1;
+int UI_glyph_age_compare(const void *a, const void *b) {
+    u64 a_used = ((const UI_Glyph_Age *)a)->last_used;
+    u64 b_used = ((const UI_Glyph_Age *)b)->last_used;
+    return a_used > b_used ? -1 : a_used < b_used ? 1 : 0;
+}
+
+// Makes room in the full atlas: the glyphs are packed again, most recently used first, into a fresh
+// atlas of the same size, until they cover half of it. The ones used in the current frame are always
+// kept, the rest become unpacked and are rasterized again on their next use. Leaving half the atlas
+// free means text that keeps changing evicts once in a while and not on every new glyph. Kept glyphs
+// are copied from the old pixels, but they move, ctx->glyph_atlas_resets tells UI_render so.
+void UI_glyph_atlas_evict(UI_Context *ctx, UI_Font *font) {
+    UI_Glyph_Age *ages = (UI_Glyph_Age *)malloc(sizeof(UI_Glyph_Age) * max(font->glyphs.count, 1));
+    int ages_count = 0;
+    for (int i = 0; i < font->glyphs.count; i++) {
+        UI_Glyph *glyph = &font->glyphs[i];
+        // blank glyphs have no rect to move
+        if (glyph->packed && glyph->info.x1 > glyph->info.x0)
+            ages[ages_count++] = { glyph->last_used, i };
+    }
+    qsort(ages, ages_count, sizeof(UI_Glyph_Age), UI_glyph_age_compare);
+
+    int w = font->w, h = font->h;
+    u8 *pixels = font->pixels;
+    font->pixels = nullptr;
+    UI_glyph_atlas_reset(font, w, h);
+    ctx->glyph_atlas_resets++;
+    size_t area = 0, budget = (size_t)w * h / 2;
+    for (int i = 0; i < ages_count; i++) {
+        UI_Glyph *glyph = &font->glyphs[ages[i].index];
+        UI_Font_Glyph_Info *info = &glyph->info;
+        int glyph_w = info->x1 - info->x0;
+        int glyph_h = info->y1 - info->y0;
+        size_t glyph_area = (size_t)(glyph_w + 1) * (glyph_h + 1);
+        int x, y;
+        bool keep = glyph->last_used == ctx->frame_id || area + glyph_area <= budget;
+        if (!keep || !UI_glyph_atlas_pack(font, glyph_w + 1, glyph_h + 1, &x, &y)) {
+            glyph->packed = false;
+            continue;
+        }
+        for (int row = 0; row < glyph_h; row++)
+            memcpy(font->pixels + ((size_t)(y + row) * w + x) * 4,
+                   pixels + ((size_t)(info->y0 + row) * w + info->x0) * 4, (size_t)glyph_w * 4);
+        info->x0 = x;
+        info->y0 = y;
+        info->x1 = x + glyph_w;
+        info->y1 = y + glyph_h;
+        area += glyph_area;
+    }
+    free(pixels);
+    free(ages);
+}
+
+bool UI_font_set_face(UI_Context *ctx, UI_Font *font, int index, unsigned char *data, size_t file_size) {
+    u8 *face_data = (u8 *)malloc(file_size); // FreeType reads from it for as long as the face lives
+    memcpy(face_data, data, file_size);
+    FT_Face face;
+    if (FT_New_Memory_Face(ctx->ft_lib, face_data, file_size, 0, &face) != 0) {
+        free(face_data);
+        return false;
+    }
+    font->faces[index] = face;
+    font->face_data[index] = face_data;
+    font->face_size_index[index] = -1;
+    return true;
+}
+
+// Reads the fallback added by path at 'index', the first time a codepoint isn't in the faces before it.
+// A file that can't be loaded is dropped.
+bool UI_font_open_face(UI_Context *ctx, UI_Font *font, int index) {
+    char *path = font->face_path[index];
+    if (!path) return false;
+    font->face_path[index] = nullptr;
+    bool result = false;
+    FILE *file = fopen(path, "rb");
+    if (file) {
+        fseek(file, 0, SEEK_END);
+        size_t size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        unsigned char *buffer = (unsigned char *)malloc(size);
+        fread(buffer, size, 1, file);
+        fclose(file);
+        result = UI_font_set_face(ctx, font, index, buffer, size);
+        free(buffer);
+    }
+    free(path);
+    return result;
+}
+
+// The glyph for 'codepoint' at the font's size_index, rasterized into the atlas if it isn't there.
+UI_Glyph *UI_find_glyph(UI_Context *ctx, UI_Font *font, int size_index, u32 codepoint) {
+    u32 key = codepoint * 32 + size_index;
+    if (font->glyphs_index.count < (font->glyphs.count + 1) * 2) {
+        UI_hash_index_reset(&font->glyphs_index, font->glyphs.count + 1);
+        for (int i = 0; i < font->glyphs.count; i++) {
+            UI_Hash_Slot *slot = UI_hash_index_lookup(&font->glyphs_index, font->glyphs[i].codepoint * 32 + font->glyphs[i].size_index);
+            slot->hash = font->glyphs[i].codepoint * 32 + font->glyphs[i].size_index;
+            slot->index = i + 1;
         }
     }
-    font->first = ASCII_start;
+    UI_Hash_Slot *slot = UI_hash_index_lookup(&font->glyphs_index, key);
+    UI_Glyph *glyph = nullptr;
+    if (slot->index != 0) {
+        glyph = &font->glyphs[slot->index - 1];
+    } else {
+        UI_Glyph new_glyph = { 0 };
+        new_glyph.codepoint = codepoint;
+        new_glyph.size_index = size_index;
+        for (int i = 0; i < font->faces_count; i++) {
+            if (!font->faces[i] && !UI_font_open_face(ctx, font, i))
+                continue;
+            if (FT_Get_Char_Index(font->faces[i], codepoint) != 0) {
+                new_glyph.face = i;
+                break;
+            }
+        }
+        font->glyphs.push_back(new_glyph);
+        slot->hash = key;
+        slot->index = font->glyphs.count;
+        glyph = &font->glyphs.back();
+    }
+    glyph->last_used = ctx->frame_id;
+    if (!glyph->packed)
+        UI_glyph_rasterize(ctx, font, glyph);
+    return glyph;
+}
+
+// Uploads what changed in the glyph atlases since the last frame.
+void UI_sync_font_textures(UI_Context *ctx) {
+    for (int i = 0; i < ctx->fonts.count; i++) {
+        UI_Font *font = &ctx->fonts[i];
+        if (font->resized) {
+            if (font->texture_handle < 0)
+                font->texture_handle = UI_create_texture(ctx, font->pixels, font->w, font->h, true);
+            else
+                UI_recreate_texture(ctx, font->texture_handle, font->pixels, font->w, font->h);
+        } else if (font->dirty_x0 < font->dirty_x1) {
+            UI_update_texture(ctx, font->texture_handle, font->pixels, font->w * 4, font->dirty_x0, font->dirty_y0,
+                              font->dirty_x1 - font->dirty_x0, font->dirty_y1 - font->dirty_y0);
+        }
+        font->resized = false;
+        font->dirty_x0 = font->dirty_x1 = 0;
+    }
+}
+
+// Adds a face to look up glyphs in that the font's own faces lack, e.g. CJK for a Latin UI font.
+bool UI_add_font_fallback_memory(UI_Context *ctx, UI_Font *font, unsigned char *data, size_t file_size) {
+    UI_assert(font != nullptr && "UI_Font *font is a null pointer!");
+    if (font->faces_count == UI_MAX_FONT_FACES) return false;
+    if (!UI_font_set_face(ctx, font, font->faces_count, data, file_size)) return false;
+    font->faces_count++;
+    return true;
+}
+
+// Like UI_add_font_fallback_memory, but the file is only read once a glyph is looked up in it. Fallback
+// fonts are often tens of MB that most UIs never need.
+bool UI_add_font_fallback_file(UI_Context *ctx, UI_Font *font, char *path) {
+    UI_assert(font != nullptr && "UI_Font *font is a null pointer!");
+    if (font->faces_count == UI_MAX_FONT_FACES) return false;
+    font->faces[font->faces_count] = nullptr;
+    font->face_path[font->faces_count] = _strdup(path);
+    font->faces_count++;
+    return true;
+}
 
-    for (int i = 0; i < w * h; ++i) {
-        int r = pixels_RGB[i * 3 + 0];
-        int g = pixels_RGB[i * 3 + 1];
-        int b = pixels_RGB[i * 3 + 2];
+/**
+* Loads a font whose glyphs are rasterized on first use, see UI_find_glyph. 'sizes' are the pixel
+* sizes text can be drawn at.
+**/
+UI_Font *UI_load_font_memory(UI_Context *ctx, unsigned char *data, size_t file_size, int *sizes, int sizes_count)
+{
+    UI_assert(ctx != nullptr && "UI context *ctx is a null pointer!");
+    UI_assert(ctx->initialized && "UI context wasn't initialized!");
+    UI_assert(ctx->backend != UI_Render_Backend_Type::None && "No render backend is initialized!");
+    UI_assert(sizes_count <= 32 && "Glyphs are keyed by codepoint * 32 + size index!");
 
-        pixels_RGBA[i * 4 + 0] = r;
-        pixels_RGBA[i * 4 + 1] = g;
-        pixels_RGBA[i * 4 + 2] = b;
+    UI_Font newfont = {0};
+    ctx->fonts.push_back(newfont);
+    UI_Font *font = &ctx->fonts.back();
+    font->texture_handle = -1;
+    font->glyphs.init_null();
+    font->glyphs_index.init_null();
+    if (!UI_add_font_fallback_memory(ctx, font, data, file_size)) {
+        ctx->fonts.pop_back();
+        return nullptr;
+    }
 
-        pixels_RGBA[i * 4 + 3] = (r + g + b) / 3;
+    font->sizes = (int *)malloc(sizeof(int) * sizes_count);
+    font->true_sizes = (int *)malloc(sizeof(int) * sizes_count);
+    font->sizes_count = sizes_count;
+    for (int i = 0; i < sizes_count; i++) {
+        font->sizes[i] = sizes[i];
+        font->true_sizes[i] = -1;
     }
 
-    font->texture_handle = UI_create_texture(ctx, pixels_RGBA, w, h);
-    free(pixels_RGB);
-    free(pixels_RGBA);
-    FT_Done_Face(face);
+    UI_glyph_atlas_reset(font, UI_GLYPH_ATLAS_MIN, UI_GLYPH_ATLAS_MIN);
+    UI_sync_font_textures(ctx);
     return font;
 }
 
-UI_Font *UI_load_font_file(UI_Context *ctx, char *path, int ASCII_start, int ASCII_end, int *sizes, int sizes_count)
+UI_Font *UI_load_font_file(UI_Context *ctx, char *path, int *sizes, int sizes_count)
 {
     int size = 0;
     unsigned char *buffer = nullptr;
 
     FILE *file = fopen(path, "rb");
+    if (!file) return nullptr;
     fseek(file, 0, SEEK_END);
     size = ftell(file);
     fseek(file, 0, SEEK_SET);
@@ -383,7 +753,7 @@ UI_Font *UI_load_font_file(UI_Context *ctx, char *path, int ASCII_start, int ASC
     fread(buffer, size, 1, file);
     fclose(file);
 
-    UI_Font *F = UI_load_font_memory(ctx, buffer, size, ASCII_start, ASCII_end, sizes, sizes_count);
+    UI_Font *F = UI_load_font_memory(ctx, buffer, size, sizes, sizes_count);
 
     free(buffer);
     return F;
@@ -396,6 +766,8 @@ void UI_push_vertex(UI_Context *ctx, UI_Vertex vertex) {
     {
         case UI_Render_Backend_Type::D3D11: 
             UI_d3d11_push_vertex(ctx, vertex); break;
+        case UI_Render_Backend_Type::Software: 
+            UI_software_push_vertex(ctx, vertex); break;
     }
 }
 
@@ -417,6 +789,21 @@ int UI_find_font_size_index(UI_Font *font, u16 size)
     return result;
 }
 
+// The line height of a size is its tallest printable ASCII glyph. Hinting all of them for every size
+// is a good part of loading a font, so a size is measured when text first uses it.
+int UI_font_line_height(UI_Font *font, int size_index) {
+    if (font->true_sizes[size_index] < 0) {
+        font->true_sizes[size_index] = 0;
+        UI_glyph_set_size(font, 0, size_index);
+        for (int ASCII_code = 32; ASCII_code <= 126; ASCII_code++) {
+            FT_Load_Char(font->faces[0], ASCII_code, FT_LOAD_TARGET_LCD);
+            int char_h = (font->faces[0]->glyph->metrics.horiBearingY) >> 6;
+            font->true_sizes[size_index] = max(font->true_sizes[size_index], char_h);
+        }
+    }
+    return font->true_sizes[size_index];
+}
+
 bool UI_font_size_exists(UI_Font *font, u16 size, int *size_index) {
     for (int i = 0; i < font->sizes_count; i++) {
         if (font->sizes[i] == size) {
@@ -428,17 +815,26 @@ bool UI_font_size_exists(UI_Font *font, u16 size, int *size_index) {
 }
 
 UI_Block_Data UI_find_else_allocate_data(UI_Context *ctx, u32 hash, size_t size, bool *created_new = 0) {
-	for (int i = 0; i < ctx->data_chunks.count; i++) {
-		if (ctx->data_chunks[i].hash == hash)
-			return ctx->data_chunks[i];
+	if (ctx->data_chunks_index.count < (ctx->data_chunks.count + 1) * 2) {
+		UI_hash_index_reset(&ctx->data_chunks_index, ctx->data_chunks.count + 1);
+		for (int i = 0; i < ctx->data_chunks.count; i++) {
+			UI_Hash_Slot *slot = UI_hash_index_lookup(&ctx->data_chunks_index, ctx->data_chunks[i].hash);
+			slot->hash = ctx->data_chunks[i].hash;
+			slot->index = i + 1;
+		}
 	}
+	UI_Hash_Slot *slot = UI_hash_index_lookup(&ctx->data_chunks_index, hash);
+	if (slot->index != 0)
+		return ctx->data_chunks[slot->index - 1];
 
     UI_Block_Data chunk;
-	chunk.buffer = (u8 *)UI_malloc(ctx, size);
+	chunk.buffer = (u8 *)UI_arena_push(&ctx->persistent_arena, size);
 	chunk.hash = hash;
 	chunk.size = size;
 	memset(chunk.buffer, 0, size);
 	ctx->data_chunks.push_back(chunk);
+	slot->hash = hash;
+	slot->index = ctx->data_chunks.count;
 	if (created_new) *created_new = true;
 
 	return chunk;
@@ -451,6 +847,101 @@ UI_Block_Data UI_find_else_allocate_data(UI_Context *ctx, u32 hash, size_t size,
 //	block->data.block_key = 0;
 //}
 
+// Finds the cached run of the zero terminated 'buff', measuring and laying it out on a miss. Labels are
+// mostly the same from frame to frame, so this saves walking their glyphs in UI_measure_text during
+// layout and again in UI_render. Returns null for runs that can't be cached.
+void UI_clear_text_runs(UI_Context *ctx) {
+    ctx->text_runs.reset_count();
+    ctx->text_run_glyphs.reset_count();
+    ctx->text_run_chars.reset_count();
+    ctx->text_runs_index.reset_count();
+}
+
+UI_Text_Run *UI_find_text_run(UI_Context *ctx, UI_Font *font, u16 size, char *buff) {
+    size_t length = strlen(buff);
+    if (length > 0xFFFF) return nullptr;
+    u64 hash = UI_hash_bytes(0xcbf29ce484222325ull, buff, length);
+    hash = UI_hash_value(hash, font);
+    hash = UI_hash_value(hash, size);
+
+    // glyph rects are only good until the atlas is evicted
+    if (ctx->text_runs.count > 0 && ctx->text_runs[0].atlas_resets != ctx->glyph_atlas_resets)
+        UI_clear_text_runs(ctx);
+
+    if (ctx->text_runs_index.count < (ctx->text_runs.count + 1) * 2) {
+        UI_hash_index_reset(&ctx->text_runs_index, ctx->text_runs.count + 1);
+        for (int i = 0; i < ctx->text_runs.count; i++) {
+            UI_Hash_Slot *slot = UI_hash_index_lookup(&ctx->text_runs_index, (u32)ctx->text_runs[i].hash);
+            if (slot->index != 0) continue;
+            slot->hash = (u32)ctx->text_runs[i].hash;
+            slot->index = i + 1;
+        }
+    }
+    UI_Hash_Slot *slot = UI_hash_index_lookup(&ctx->text_runs_index, (u32)hash);
+    if (slot->index != 0) {
+        UI_Text_Run *run = &ctx->text_runs[slot->index - 1];
+        bool same = run->hash == hash && run->font == font && run->size == size && run->length == length &&
+                    memcmp(&ctx->text_run_chars.data[run->chars], buff, length) == 0;
+        if (!same) return nullptr;
+        // the glyphs' atlas rects aren't looked up again, so keep them from being evicted
+        for (int i = 0; i < run->glyph_count; i++)
+            font->glyphs[ctx->text_run_glyphs.data[run->glyphs + i].glyph].last_used = ctx->frame_id;
+        return run;
+    }
+
+    int size_index = 0;
+    bool size_exists = UI_font_size_exists(font, size, &size_index);
+    UI_assert(size_exists && "Requested font size is not initialized!");
+    UI_Text_Run run;
+    run.font = font;
+    run.hash = hash;
+    run.chars = ctx->text_run_chars.count;
+    run.glyphs = ctx->text_run_glyphs.count;
+    run.length = (u16)length;
+    run.glyph_count = 0;
+    run.size = size;
+    run.atlas_resets = ctx->glyph_atlas_resets;
+    ctx->text_run_chars.resize(run.chars + length);
+    memcpy(&ctx->text_run_chars.data[run.chars], buff, length);
+    ctx->text_run_glyphs.resize(run.glyphs + length);
+
+    int x = 0;
+    int w = 0;
+    bool measuring = true;
+    for (int i = 0, bytes = 0; i < run.length; i += bytes) {
+        if (buff[i] == '#') measuring = false;
+        UI_Glyph *font_glyph = UI_find_glyph(ctx, font, size_index, UI_utf8_decode(buff + i, &bytes));
+        UI_Font_Glyph_Info* target_char = &font_glyph->info;
+        UI_Text_Glyph *glyph = &ctx->text_run_glyphs.data[run.glyphs + run.glyph_count++];
+        glyph->glyph = (u32)(font_glyph - font->glyphs.data);
+        glyph->offset = v2(x + target_char->x_off, -target_char->y_off);
+        glyph->src_p0 = v2(target_char->x0, target_char->y0);
+        glyph->src_size = v2(target_char->x1 - target_char->x0, target_char->y1 - target_char->y0);
+        x += target_char->advance_x;
+        if (measuring) w = x;
+    }
+    if (run.atlas_resets != ctx->glyph_atlas_resets) {
+        // the atlas was evicted halfway, the glyphs laid out before that moved
+        UI_clear_text_runs(ctx);
+        return nullptr;
+    }
+    ctx->text_run_glyphs.shrink(run.glyphs + run.glyph_count);
+    run.extent = v2(w, UI_font_line_height(font, size_index));
+    run.advance = x;
+
+    ctx->text_runs.push_back(run);
+    slot->hash = (u32)hash;
+    slot->index = ctx->text_runs.count;
+    return &ctx->text_runs[ctx->text_runs.count - 1];
+}
+
+// Starts the text run cache over once it has grown past UI_MAX_TEXT_RUNS, e.g. from a counter that
+// changes every frame.
+void UI_trim_text_runs(UI_Context *ctx) {
+    if (ctx->text_runs.count >= UI_MAX_TEXT_RUNS)
+        UI_clear_text_runs(ctx);
+}
+
 int UI_measure_text_upto_pixels(UI_Context *ctx, UI_Font *font, u16 size, char *buff, i16 up_to, i16 length = -1) {
     UI_assert(ctx != nullptr && "UI context *ctx is a null pointer!");
     UI_assert(ctx->initialized && "UI context wasn't initialized!");
@@ -458,7 +949,8 @@ int UI_measure_text_upto_pixels(UI_Context *ctx, UI_Font *font, u16 size, char *
     if (length == 0) return 0;
 
     int size_index = 0;
-    assert(UI_font_size_exists(font, size, &size_index) && "Requested font size is not initialized!");
+    bool size_exists = UI_font_size_exists(font, size, &size_index);
+    UI_assert(size_exists && "Requested font size is not initialized!");
 
     int w = 0;
     int h = 0;
@@ -466,12 +958,12 @@ int UI_measure_text_upto_pixels(UI_Context *ctx, UI_Font *font, u16 size, char *
     int y1 = 0;
     if (length < 0)
         length = strlen(buff);
-    size_t offset = font->char_count * size_index;
     int i = 0;
-    for (i = 0; i < length; i++) {
+    for (int bytes = 0; i < length; i += bytes) {
         if (w >= up_to) break;
         if (buff[i] == '#') break;
-        UI_Font_Glyph_Info* target_char = &font->char_info[offset + buff[i] - font->first];
+        UI_Font_Glyph_Info info = UI_find_glyph(ctx, font, size_index, UI_utf8_decode(buff + i, &bytes))->info;
+        UI_Font_Glyph_Info* target_char = &info;
         int local_y1 = target_char->y_off;
         int local_y0 = local_y1 - abs(target_char->y1 - target_char->y0);
         UI_assert(local_y0 <= local_y1);
@@ -481,7 +973,7 @@ int UI_measure_text_upto_pixels(UI_Context *ctx, UI_Font *font, u16 size, char *
 
         w += target_char->advance_x;
     }
-    h =  font->true_sizes[size_index];
+    h = UI_font_line_height(font, size_index);
     // h = y1 - y0;
     UI_assert(h >= 0);
     return i;
@@ -492,9 +984,14 @@ v2 UI_measure_text(UI_Context *ctx, UI_Font *font, u16 size, char *buff, i16 len
     UI_assert(ctx->initialized && "UI context wasn't initialized!");
     UI_assert(font != nullptr && "UI_Font *font is a null pointer!");
     if (length == 0) return v2(0);
+    if (length < 0) {
+        UI_Text_Run *run = UI_find_text_run(ctx, font, size, buff);
+        if (run) return run->extent;
+    }
 
     int size_index = 0;
-    assert(UI_font_size_exists(font, size, &size_index) && "Requested font size is not initialized!");
+    bool size_exists = UI_font_size_exists(font, size, &size_index);
+    UI_assert(size_exists && "Requested font size is not initialized!");
 
     int w = 0;
     int h = 0;
@@ -502,11 +999,11 @@ v2 UI_measure_text(UI_Context *ctx, UI_Font *font, u16 size, char *buff, i16 len
     int y1 = 0;
     if (length < 0)
         length = strlen(buff);
-    size_t offset = font->char_count * size_index;
-    for (int i = 0; i < length; i++) {
+    for (int i = 0, bytes = 0; i < length; i += bytes) {
         if (buff[i] == '#') break;
         if (buff[i] == 0) break;
-        UI_Font_Glyph_Info* target_char = &font->char_info[offset + buff[i] - font->first];
+        UI_Font_Glyph_Info info = UI_find_glyph(ctx, font, size_index, UI_utf8_decode(buff + i, &bytes))->info;
+        UI_Font_Glyph_Info* target_char = &info;
         int local_y1 = target_char->y_off;
         int local_y0 = local_y1 - abs(target_char->y1 - target_char->y0);
         UI_assert(local_y0 <= local_y1);
@@ -516,7 +1013,7 @@ v2 UI_measure_text(UI_Context *ctx, UI_Font *font, u16 size, char *buff, i16 len
 
         w += target_char->advance_x;
     }
-    h =  font->true_sizes[size_index];
+    h = UI_font_line_height(font, size_index);
     // h = y1 - y0;
     UI_assert(h >= 0);
     return v2(w, h);
@@ -540,19 +1037,44 @@ v2 UI_push_text(
     UI_assert(font != nullptr && "UI_Font *font is a null pointer!");
 
     int size_index = 0;
-    assert(UI_font_size_exists(font, size, &size_index) && "Requested font size is not initialized!");
+    bool size_exists = UI_font_size_exists(font, size, &size_index);
+    UI_assert(size_exists && "Requested font size is not initialized!");
 
     int x = dest_point.x, y = dest_point.y;
     int start_x = x;
     int w = 0;
     int h = 0;
     int l = 0;
+    UI_Text_Run *run = length == 0 ? UI_find_text_run(ctx, font, size, buff) : nullptr;
+    if (run) {
+        v2 pen = v2(x, y + h_offset);
+		UI_Vertex vertex = { 0 };
+        vertex.texture_id = font->texture_handle;
+        vertex.depth = depth;
+        vertex.colors[0] = UI_u32_to_v4(color.c[0]);
+        vertex.colors[1] = UI_u32_to_v4(color.c[1]);
+        vertex.colors[2] = UI_u32_to_v4(color.c[2]);
+        vertex.colors[3] = UI_u32_to_v4(color.c[3]);
+        vertex.clp_p0 = clip_0;
+        vertex.clp_p1 = clip_1;
+        vertex.ui_block = -1;
+		vertex.flags |= UI_Vertex_Flags_lcd;
+        for (int i = 0; i < run->glyph_count; i++) {
+            UI_Text_Glyph *glyph = &ctx->text_run_glyphs.data[run->glyphs + i];
+            vertex.dst_p0 = pen + glyph->offset;
+            vertex.dst_p1 = vertex.dst_p0 + glyph->src_size;
+            vertex.src_p0 = glyph->src_p0;
+            vertex.src_p1 = vertex.src_p0 + glyph->src_size;
+            UI_push_vertex(ctx, vertex);
+        }
+        return v2(run->advance, run->extent.y);
+    }
     if (length == 0)
         length = strlen(buff);
-    size_t offset = font->char_count * size_index;
-    for (int i = 0; i < length; i++) {
+    for (int i = 0, bytes = 0; i < length; i += bytes) {
         //if (buff[i] == '#') break;
-        UI_Font_Glyph_Info* target_char = &font->char_info[offset + buff[i] - font->first];
+        UI_Font_Glyph_Info info = UI_find_glyph(ctx, font, size_index, UI_utf8_decode(buff + i, &bytes))->info;
+        UI_Font_Glyph_Info* target_char = &info;
         UI_Rect src;
         src.x = target_char->x0;
         src.y = target_char->y0;
@@ -564,7 +1086,7 @@ v2 UI_push_text(
         dst.y = y - target_char->y_off + h_offset;
         dst.w = target_char->x1 - target_char->x0;
         dst.h = target_char->y1 - target_char->y0;
-        h =  font->true_sizes[size_index];
+        h = UI_font_line_height(font, size_index);
 
 		UI_Vertex vertex = { 0 };
         vertex.dst_p0 = v2(dst.x, dst.y);
@@ -602,17 +1124,28 @@ UI_Context * UI_init_context() {
     UI_Context *ctx = (UI_Context *)malloc(sizeof(UI_Context));
     UI_assert(ctx != nullptr);
     memset(ctx, 0, sizeof(*ctx));
-    // TODO(Wassim): We REALLY need an arena allocator, all this binary tree is run by pointers
-    // this is just a placeholder hack that should be changed later!
+    // the block storage only commits what it uses of these reservations, strings and widget state
+    // come from the arenas
 	ctx->buffers[0].init_reserve(GB(4), 5000);
 	ctx->buffers[1].init_reserve(GB(4), 5000);
     ctx->parents.init_reserve(GB(4), 1000);
 	ctx->data_chunks.init_reserve(GB(4), 1000);
-	ctx->blocks_hit_test.init_reserve(GB(4), 10000);
+	for (int i = 0; i < 2; i++) {
+		ctx->hit_grids[i].cells_x = ctx->hit_grids[i].cells_y = 0;
+		ctx->hit_grids[i].offsets.init_null();
+		ctx->hit_grids[i].items.init_null();
+	}
     ctx->hashes.init_reserve(GB(4), 5000);
+    ctx->previous_blocks_index.init_null();
+    ctx->data_chunks_index.init_null();
 
     ctx->vertices.init_null();
     ctx->fonts.init_null();         	ctx->fonts.reserve(100);
+    ctx->text_runs.init_null();
+    ctx->text_runs_index.init_null();
+    ctx->text_run_glyphs.init_null();
+    ctx->text_run_chars.init_null();
+    ctx->glyph_atlas_resets = 0;
 
     for (int i = 0; i < UI_MAX_TEXTURES; i++)
         ctx->textures[i] = 0;
@@ -620,7 +1153,9 @@ UI_Context * UI_init_context() {
     FT_Init_FreeType(&ctx->ft_lib);
     FT_Library_SetLcdFilter(ctx->ft_lib, FT_LCD_FILTER_LIGHT);
 
-	ctx->strings.init_reserve(GB(4), 1024 * 128);
+	UI_arena_init(&ctx->frame_arenas[0], GB(1));
+	UI_arena_init(&ctx->frame_arenas[1], GB(1));
+	UI_arena_init(&ctx->persistent_arena, GB(1));
 
 	ctx->buffer_index = 0;
     ctx->frame_id = 0;
@@ -628,12 +1163,15 @@ UI_Context * UI_init_context() {
     ctx->viewport = v2(0,0);
     ctx->backend_context = nullptr;
     ctx->vertices.init_null();
+    ctx->vertices_sorted.init_null();
+    ctx->vertex_keys.init_null();
+    ctx->vertex_order.init_null();
+    ctx->frame_hash = 0;
+    ctx->frame_reused = false;
+    ctx->vertices_dirty = true;
 	ctx->debug.last_block_count = 0;
 	ctx->debug.allocated_bytes = 0;
 	ctx->debug.last_vertex_count = 0;
-	ctx->string_storage_size = 0;
-	ctx->string_storage_capacity = 5000;
-	ctx->string_storage = (char*)malloc(ctx->string_storage_capacity);
 
     ctx->initialized = true;
     return ctx;
@@ -780,14 +1318,15 @@ void UI_begin_frame(UI_Context *ctx, u64 ms_since_last_frame) {
     // New frame://////////////////////////////////
     //UI_set_cursor(Cursor_Type_arrow);
 	ctx->buffer_index = 1 - ctx->buffer_index;
+	UI_index_previous_frame(ctx);
+	UI_trim_text_runs(ctx);
     ctx->frame_id++;
     ctx->unique_counter = 0;
-	ctx->strings.count = 0;
+	UI_arena_reset(UI_get_current_frame_arena(ctx));
 	UI_get_current_frame_buffer(ctx)->count = 0;
 
     // Reset the tree
     ctx->viewport = _v2(get_client_size());
-    ctx->vertices.reset_count();
 }
 
 void UI_preorder_traversal(
@@ -998,27 +1537,33 @@ UI_Intersection_Rect UI_intersect_rects(UI_Intersection_Rect A, UI_Intersection_
     return result;
 }
 
+// 'clip' is the intersection of the clip blocks of every ancestor, 'clipped' is false while there are none.
+void UI_set_clip_rects(UI_Block* block, UI_Intersection_Rect clip, bool clipped) {
+    UI_Block* intersector = block->style.clip_block;
+    if (intersector != nullptr) {
+        UI_Intersection_Rect current_intersection = 
+            UI_Intersection_Rect(intersector->position, intersector->position + intersector->size);
+        clip = clipped ? UI_intersect_rects(current_intersection, clip) : current_intersection;
+        clipped = true;
+    }
+    block->clip_rect = UI_Rect(v2(-1), v2(-1)); 
+    if (clipped) {
+        UI_Intersection_Rect main_rect = UI_Intersection_Rect(block->position, block->position + block->size);
+        UI_Intersection_Rect result_rect = UI_intersect_rects(main_rect, clip);
+        if (!(result_rect == main_rect))
+            block->clip_rect = UI_Rect(result_rect.p[0], result_rect.p[1] - result_rect.p[0]);
+    }
+    for (UI_Block* child = block->first; child != nullptr; child = child->next)
+        UI_set_clip_rects(child, clip, clipped);
+}
+
+// Clips every block to the clip blocks of itself and its ancestors, in one walk down from the roots.
 void UI_set_clip_rects(UI_Context * ctx) {
 	auto buffer = UI_get_current_frame_buffer(ctx);
 	for (int i = 0; i < buffer->count; i++) {
-		UI_Block* block = &buffer->data[i];
-        UI_Block* current_parent = block;
-        UI_Intersection_Rect main_rect = UI_Intersection_Rect(block->position, block->position + block->size);
-        UI_Intersection_Rect result_rect = main_rect;
-        block->clip_rect = UI_Rect(v2(-1), v2(-1)); 
-        while(current_parent) {
-            UI_Block* intersector = current_parent->style.clip_block;
-            if (intersector != nullptr) {
-                UI_Intersection_Rect current_intersection = 
-                    UI_Intersection_Rect(intersector->position, intersector->position + intersector->size);
-                result_rect = UI_intersect_rects(result_rect, current_intersection);
-            }
-            current_parent = current_parent->parent;
-        }
-        if (!(result_rect == main_rect)) {
-            //UI_assert(result_rect.p[1].x >= 0 && result_rect.p[1].y >= 0)
-            block->clip_rect = UI_Rect(result_rect.p[0], result_rect.p[1] - result_rect.p[0]);
-        }
+		UI_Block* root = &buffer->data[i];
+		if (root->parent == nullptr)
+			UI_set_clip_rects(root, UI_Intersection_Rect(), false);
     }
 }
 
@@ -1077,12 +1622,15 @@ void UI_apply_layout(UI_Context *ctx) {
     UI_assert(ctx != nullptr && "UI context *ctx is a null pointer!");
     UI_assert(ctx->initialized && "UI context wasn't initialized!");
 	auto buffer = UI_get_current_frame_buffer(ctx);
+	// sizes that don't depend on other blocks, once for all roots: the passes below only ever change
+	// blocks of the tree they run on
+	for (Axis2 axis = (Axis2)0; axis < axis_count; axis = (Axis2)((int)axis + 1))
+		UI_layout_solve_standalone_sizes(ctx, axis);
 	for (int i = 0; i < buffer->count; i++) {
 		UI_Block* root = &buffer->data[i];
 		if (root->parent != nullptr) 
 			continue;
 		for (Axis2 axis = (Axis2)0; axis < axis_count; axis = (Axis2)((int)axis + 1)) {
-			UI_layout_solve_standalone_sizes(ctx, axis);
 			UI_preorder_traversal(root, axis, UI_callback_solve_upwards_sizes);
 			UI_postorder_traversal(root, axis, UI_callback_solve_downwards_sizes);
 			UI_preorder_traversal (root, axis, UI_callback_solve_violations);
@@ -1098,34 +1646,184 @@ void UI_apply_layout(UI_Context *ctx) {
 //	}
 }
 
-void UI_end_frame(UI_Context *ctx) {
-    UI_assert(ctx != nullptr && "UI context *ctx is a null pointer!");
-    UI_assert(ctx->initialized && "UI context wasn't initialized!");
-    UI_apply_layout(ctx);
-    //ctx->parents.pop_back();
-	ctx->blocks_hit_test.reset_count();
+// Hashes everything about the current frame that layout and vertex generation depend on: the shape of
+// the tree, each block's style, flags and text, and the viewport. Pointers into the frame buffer are
+// hashed as indices since the buffers alternate. Style is hashed field by field to stay clear of
+// padding bytes.
+u64 UI_hash_frame(UI_Context *ctx) {
+	auto buffer = UI_get_current_frame_buffer(ctx);
+	u64 hash = 0xcbf29ce484222325ull;
+	hash = UI_hash_value(hash, ctx->viewport);
+	hash = UI_hash_value(hash, ctx->parents.capacity);
+	hash = UI_hash_value(hash, buffer->count);
+	for (int i = 0; i < buffer->count; i++) {
+		UI_Block *block = &buffer->data[i];
+		UI_Style *style = &block->style;
+		i32 parent = block->parent ? (i32)(block->parent - buffer->data) : -1;
+		i32 clip = style->clip_block ? (i32)(style->clip_block - buffer->data) : -1;
+		hash = UI_hash_value(hash, parent);
+		hash = UI_hash_value(hash, block->hash);
+		hash = UI_hash_value(hash, block->flags);
+		hash = UI_hash_value(hash, block->depth_level);
+		if (block->string.data)
+			hash = UI_hash_bytes(hash, block->string.data, block->string.count);
+		hash = UI_hash_value(hash, style->size);
+		hash = UI_hash_value(hash, style->position);
+		hash = UI_hash_value(hash, style->layout.axis);
+		hash = UI_hash_value(hash, style->layout.spacing);
+		hash = UI_hash_value(hash, style->layout.padding);
+		hash = UI_hash_value(hash, style->layout.align);
+		hash = UI_hash_value(hash, style->color);
+		hash = UI_hash_value(hash, style->font);
+		hash = UI_hash_value(hash, clip);
+		hash = UI_hash_value(hash, style->font_size);
+		hash = UI_hash_value(hash, style->border_size);
+		hash = UI_hash_value(hash, style->softness);
+		hash = UI_hash_value(hash, style->roundness);
+		hash = UI_hash_value(hash, style->texture_uv);
+		hash = UI_hash_value(hash, style->texture_src_size);
+		hash = UI_hash_value(hash, style->texture_rotation);
+		hash = UI_hash_value(hash, style->misc);
+		hash = UI_hash_value(hash, style->texture_handle);
+	}
+	return hash;
+}
+
+// Takes over the computed geometry of the previous frame, which UI_hash_frame found to be identical
+// block for block.
+void UI_reuse_layout(UI_Context *ctx) {
 	auto buffer = UI_get_current_frame_buffer(ctx);
+	auto previous = UI_get_previous_frame_buffer(ctx);
 	for (int i = 0; i < buffer->count; i++) {
-		UI_Block* block = &buffer->data[i];
-		if (block->hash == 0) continue;
-		if (!(block->flags & UI_Block_Flags_hit_test)) continue;
-		bool in_block = UI_point_in_rect(block->position, block->position + block->size, UI_get_mouse());
-		UI_Hit_Test_Item item;
-		item.hash = block->hash;
-		item.depth_level = block->depth_level;
-		if (in_block) {
-			ctx->blocks_hit_test.push_back(item);
+		UI_Block *block = &buffer->data[i];
+		UI_Block *prev = &previous->data[i];
+		block->size = prev->size;
+		block->position = prev->position;
+		block->rect = prev->rect;
+		block->clip_rect = prev->clip_rect;
+		block->cursor = prev->cursor;
+		block->interim_size = prev->interim_size;
+		block->layout_data[axis_x] = prev->layout_data[axis_x];
+		block->layout_data[axis_y] = prev->layout_data[axis_y];
+	}
+}
+
+// hit testing ///////////////////////////////////
+UI_Hit_Grid *UI_get_hit_grid(UI_Context *ctx, int frame) {
+	UI_assert(frame == UI_CURRENT || frame == UI_PREVIOUS);
+	return &ctx->hit_grids[frame == UI_CURRENT ? ctx->buffer_index : 1 - ctx->buffer_index];
+}
+
+// Cells are clamped to the grid, blocks and points outside the viewport land in the border cells so
+// that the exact rect test still decides.
+void UI_hit_grid_cell(UI_Hit_Grid *grid, v2 point, int *x, int *y) {
+	*x = (int)clamp(floorf(point.x / UI_HIT_GRID_CELL), 0.f, (f32)(grid->cells_x - 1));
+	*y = (int)clamp(floorf(point.y / UI_HIT_GRID_CELL), 0.f, (f32)(grid->cells_y - 1));
+}
+
+bool UI_is_hit_testable(UI_Block *block) {
+	return block->hash != 0 && (block->flags & (UI_Block_Flags_hit_test | UI_Block_Flags_capture_mouse));
+}
+
+// Bins the hit_test and capture_mouse blocks of the current frame, which has to be laid out already.
+void UI_build_hit_grid(UI_Context *ctx) {
+	UI_Hit_Grid *grid = UI_get_hit_grid(ctx, UI_CURRENT);
+	auto buffer = UI_get_current_frame_buffer(ctx);
+	grid->cells_x = max(1, (int)ceilf(ctx->viewport.x / UI_HIT_GRID_CELL));
+	grid->cells_y = max(1, (int)ceilf(ctx->viewport.y / UI_HIT_GRID_CELL));
+	int cells = grid->cells_x * grid->cells_y;
+	grid->offsets.resize(cells + 1);
+	memset(grid->offsets.data, 0, sizeof(u32) * (cells + 1));
+	for (int pass = 0; pass < 2; pass++) {
+		for (u32 i = 0; i < buffer->count; i++) {
+			UI_Block *block = &buffer->data[i];
+			if (!UI_is_hit_testable(block)) continue;
+			v2 p0 = block->position;
+			v2 p1 = block->position + block->size;
+			int x0, y0, x1, y1;
+			UI_hit_grid_cell(grid, v2(min(p0.x, p1.x), min(p0.y, p1.y)), &x0, &y0);
+			UI_hit_grid_cell(grid, v2(max(p0.x, p1.x), max(p0.y, p1.y)), &x1, &y1);
+			for (int y = y0; y <= y1; y++) {
+				for (int x = x0; x <= x1; x++) {
+					int cell = y * grid->cells_x + x;
+					if (pass == 0) grid->offsets[cell + 1]++;
+					else           grid->items[grid->offsets[cell]++] = i;
+				}
+			}
 		}
+		if (pass == 0) {
+			for (int cell = 0; cell < cells; cell++)
+				grid->offsets[cell + 1] += grid->offsets[cell];
+			grid->items.resize(grid->offsets[cells]);
+		} else {
+			// filling moved every offset to the start of the next cell
+			for (int cell = cells; cell > 0; cell--)
+				grid->offsets[cell] = grid->offsets[cell - 1];
+			grid->offsets[0] = 0;
+		}
+	}
+}
+
+// Fills 'result' with up to 'max_count' blocks of 'frame' that have any of 'flags' (hit_test or
+// capture_mouse) and contain 'point', in push order, and returns how many there are.
+int UI_blocks_at_point(UI_Context *ctx, v2 point, int frame, u32 flags, UI_Block **result, int max_count) {
+	UI_Hit_Grid *grid = UI_get_hit_grid(ctx, frame);
+	if (grid->offsets.count == 0) return 0;
+	auto buffer = frame == UI_CURRENT ? UI_get_current_frame_buffer(ctx) : UI_get_previous_frame_buffer(ctx);
+	int x, y;
+	UI_hit_grid_cell(grid, point, &x, &y);
+	int cell = y * grid->cells_x + x;
+	int count = 0;
+	for (u32 i = grid->offsets[cell]; i < grid->offsets[cell + 1]; i++) {
+		UI_Block *block = &buffer->data[grid->items[i]];
+		if (!(block->flags & flags)) continue;
+		if (!UI_point_in_rect(block->position, block->position + block->size, point)) continue;
+		if (count < max_count) result[count] = block;
+		count++;
 	}
+	return count;
+}
+
+// The deepest hit_test block of 'frame' under 'point', the first pushed one among equals. Blocks at
+// depth 0 never win.
+UI_Block *UI_hit_test(UI_Context *ctx, v2 point, int frame) {
+	UI_Hit_Grid *grid = UI_get_hit_grid(ctx, frame);
+	if (grid->offsets.count == 0) return nullptr;
+	auto buffer = frame == UI_CURRENT ? UI_get_current_frame_buffer(ctx) : UI_get_previous_frame_buffer(ctx);
+	int x, y;
+	UI_hit_grid_cell(grid, point, &x, &y);
+	int cell = y * grid->cells_x + x;
+	UI_Block *foremost = nullptr;
 	u32 max_depth = 0;
-    UI_Hit_Test_Item foremost = { 0 };
-	ctx->hit_test_result = foremost;
-	for (int i = 0; i < ctx->blocks_hit_test.count; i++) {
-		UI_Hit_Test_Item *current = &ctx->blocks_hit_test[i];
-		if (current->depth_level > max_depth) {
-			max_depth = current->depth_level;
-			foremost = *current;
-		}
+	for (u32 i = grid->offsets[cell]; i < grid->offsets[cell + 1]; i++) {
+		UI_Block *block = &buffer->data[grid->items[i]];
+		if (!(block->flags & UI_Block_Flags_hit_test) || block->depth_level <= max_depth) continue;
+		if (!UI_point_in_rect(block->position, block->position + block->size, point)) continue;
+		max_depth = block->depth_level;
+		foremost = block;
+	}
+	return foremost;
+}
+
+void UI_end_frame(UI_Context *ctx) {
+    UI_assert(ctx != nullptr && "UI context *ctx is a null pointer!");
+    UI_assert(ctx->initialized && "UI context wasn't initialized!");
+    f64 layout_start = UI_get_time_ms();
+    // immediate mode rebuilds the tree every frame, but most frames build the same one
+    u64 frame_hash = UI_hash_frame(ctx);
+    ctx->frame_reused = frame_hash == ctx->frame_hash && ctx->frame_id > 1;
+    ctx->frame_hash = frame_hash;
+    if (ctx->frame_reused)
+        UI_reuse_layout(ctx);
+    else
+        UI_apply_layout(ctx);
+    //ctx->parents.pop_back();
+	UI_build_hit_grid(ctx);
+	UI_Hit_Test_Item foremost = { 0 };
+	UI_Block *hit = UI_hit_test(ctx, UI_get_mouse(), UI_CURRENT);
+	if (hit) {
+		foremost.hash = hit->hash;
+		foremost.depth_level = hit->depth_level;
 	}
 	ctx->hit_test_result = foremost;
 
@@ -1134,15 +1832,58 @@ void UI_end_frame(UI_Context *ctx) {
     UI_assert(ctx->hashes.count == 0 && "UI ID stack must be empty at the end of the frame!");
     if (ctx->want_capture_keyboard)
         UI_release_char_keys();
-	ctx->string_storage_size = 0;
+	ctx->debug.last_frame_bytes = UI_get_current_frame_arena(ctx)->pos;
+	ctx->debug.allocated_bytes = ctx->persistent_arena.pos;
+	ctx->debug.last_layout_ms = UI_get_time_ms() - layout_start;
 }
 
-void UI_render(UI_Context *ctx) {
-    UI_assert(ctx != nullptr && "UI context *ctx is a null pointer!");
-    UI_assert(ctx->initialized && "UI context wasn't initialized!");
-    UI_assert(ctx->backend != UI_Render_Backend_Type::None && "No render backend is initialized!");
-    // prepare render data
+// Puts ctx->vertices in back to front order (descending depth) so that they can be sent in one draw
+// call, vertices of equal depth stay in the order they were pushed. This is an LSD radix sort over the
+// bits of the depth, linear in the vertex count; the UI only uses a handful of depths, so most of the
+// byte passes find a single bucket and are skipped.
+void UI_sort_vertices(UI_Context *ctx) {
+    int n = ctx->vertices.count;
+    if (n < 2) return;
+    ctx->vertex_keys.resize(n * 2);
+    ctx->vertex_order.resize(n * 2);
+    u32 *keys = ctx->vertex_keys.data, *keys_next = keys + n;
+    u32 *order = ctx->vertex_order.data, *order_next = order + n;
+    for (int i = 0; i < n; i++) {
+        u32 bits;
+        memcpy(&bits, &ctx->vertices.data[i].depth, sizeof(bits));
+        bits = (bits & 0x80000000) ? ~bits : bits | 0x80000000; // unsigned order == float order
+        keys[i] = ~bits;                                          // descending
+        order[i] = i;
+    }
+    for (int shift = 0; shift < 32; shift += 8) {
+        u32 offsets[256] = {};
+        for (int i = 0; i < n; i++)
+            offsets[(keys[i] >> shift) & 0xFF]++;
+        if (offsets[(keys[0] >> shift) & 0xFF] == (u32)n) continue;
+        u32 sum = 0;
+        for (int b = 0; b < 256; b++) {
+            u32 c = offsets[b];
+            offsets[b] = sum;
+            sum += c;
+        }
+        for (int i = 0; i < n; i++) {
+            u32 slot = offsets[(keys[i] >> shift) & 0xFF]++;
+            keys_next[slot] = keys[i];
+            order_next[slot] = order[i];
+        }
+        u32 *t = keys; keys = keys_next; keys_next = t;
+        t = order; order = order_next; order_next = t;
+    }
+    ctx->vertices_sorted.resize(n);
+    for (int i = 0; i < n; i++)
+        ctx->vertices_sorted.data[i] = ctx->vertices.data[order[i]];
+    ctx->vertices.swap(ctx->vertices_sorted);
+}
+
+// Turns the laid out blocks into ctx->vertices, in block order.
+void UI_build_vertices(UI_Context *ctx) {
 	auto buffer = UI_get_current_frame_buffer(ctx);
+    ctx->vertices.reset_count();
 	for (int i = 0; i < buffer->count; i++) {
 		UI_Vertex vertex = { 0 };
 		UI_Block *block = &buffer->data[i];
@@ -1212,13 +1953,40 @@ void UI_render(UI_Context *ctx) {
         }
     }
 
-    ctx->debug.last_block_count = buffer->count;
+}
+
+void UI_render(UI_Context *ctx) {
+    UI_assert(ctx != nullptr && "UI context *ctx is a null pointer!");
+    UI_assert(ctx->initialized && "UI context wasn't initialized!");
+    UI_assert(ctx->backend != UI_Render_Backend_Type::None && "No render backend is initialized!");
+    f64 build_start = UI_get_time_ms();
+    // an unchanged frame produces the same vertices, which are still in ctx->vertices and the backend
+    ctx->vertices_dirty = !ctx->frame_reused;
+    if (ctx->vertices_dirty) {
+        u32 atlas_resets = ctx->glyph_atlas_resets;
+        UI_build_vertices(ctx);
+        // glyphs pushed before a glyph atlas eviction moved, the second time round they all fit
+        if (ctx->glyph_atlas_resets != atlas_resets)
+            UI_build_vertices(ctx);
+    }
+    f64 sort_start = UI_get_time_ms();
+    if (ctx->vertices_dirty)
+        UI_sort_vertices(ctx);
+    f64 build_end = UI_get_time_ms();
+
+    ctx->debug.last_block_count = UI_get_current_frame_buffer(ctx)->count;
     ctx->debug.last_vertex_count = ctx->vertices.count;
+    ctx->debug.last_build_ms = build_end - build_start;
+    ctx->debug.last_sort_ms = build_end - sort_start;
+    ctx->debug.last_frame_reused = ctx->frame_reused;
+
+    UI_sync_font_textures(ctx);
 
     // dispatch the appropriate backend to draw the vertices
     switch (ctx->backend)
     {
         case UI_Render_Backend_Type::D3D11: UI_d3d11_render(ctx); break;
+        case UI_Render_Backend_Type::Software: UI_software_render(ctx); break;
     }
 }
 
@@ -10,12 +10,18 @@
 #include <stb_rect_pack.h>
 #include <stb_truetype.h>
 
+#include <emmintrin.h>
+
 #include <ft2build.h>
 #include <freetype/ftlcdfil.h>
 #include FT_FREETYPE_H
 
 #define UI_MAX_VERTICES 10000
 #define UI_MAX_TEXTURES 5
+#define UI_MAX_TEXT_RUNS 4096 // the text run cache starts over beyond this
+#define UI_MAX_FONT_FACES 8
+#define UI_GLYPH_ATLAS_MIN 512  // glyph atlases start at this size and double up to UI_GLYPH_ATLAS_MAX
+#define UI_GLYPH_ATLAS_MAX 2048
 
 #define THUMBS_DIM 50
 
@@ -46,12 +52,29 @@ typedef double      f64;
 enum struct UI_Render_Backend_Type {
     None,
     D3D11,
+    Software,
 };
 enum struct UI_Platform_Type {
     None,
     Win32,
 };
 
+// Bump allocator over reserved virtual memory, see UI_arena_push. Pages are committed as it grows and
+// stay committed when it is reset, so once it has seen its largest frame it doesn't allocate anymore.
+struct UI_Arena {
+    u8      *base;
+    u64     reserved;
+    u64     committed;
+    u64     pos;
+};
+
+// Open addressing slot mapping a block/data hash to an array index. 'index' is one based so that a
+// zeroed table is empty and 0 stays a valid hash.
+struct UI_Hash_Slot {
+	u32 hash;
+	u32 index;
+};
+
 struct UI_Font_Glyph_Info {
 	int x0, y0, x1, y1;	// uv int atlas
 	int x_off, y_off;   // bearing
@@ -59,15 +82,63 @@ struct UI_Font_Glyph_Info {
 	int advance_x;       
 };
 
+// A glyph a font was asked for, see UI_find_glyph. The metrics in 'info' stay valid, the atlas rect
+// only while 'packed', eviction clears it and the glyph is rasterized again on its next use.
+struct UI_Glyph {
+    u32                 codepoint;
+    u16                 size_index;
+    u8                  face;
+    bool                packed;
+    u64                 last_used;  // frame_id
+    UI_Font_Glyph_Info  info;
+};
+
 struct UI_Font {
     i32                 texture_handle;
     int                 *sizes;
-    int                 *true_sizes;
-    UI_Font_Glyph_Info  *char_info;
-    int                 char_count;
+    int                 *true_sizes;    // line heights, -1 until UI_font_line_height measures them
     int                 sizes_count;
-    int                 first;
+
+    // faces[0] is the font itself, the others are fallbacks for the codepoints it lacks. A fallback
+    // added by path is only read when a codepoint gets that far, until then its face is null.
+    FT_Face             faces[UI_MAX_FONT_FACES];
+    u8                  *face_data[UI_MAX_FONT_FACES];
+    char                *face_path[UI_MAX_FONT_FACES];
+    int                 face_size_index[UI_MAX_FONT_FACES]; // size last set on the face
+    int                 faces_count;
+
+    Dynarray <UI_Glyph>     glyphs;
+    Dynarray <UI_Hash_Slot> glyphs_index;
+
+    // glyph atlas, the LCD coverage in rgb and its average in a
+    u8                  *pixels;
     int                 w, h;
+    stbrp_context       packer;
+    stbrp_node          *packer_nodes;
+    int                 dirty_x0, dirty_y0, dirty_x1, dirty_y1; // not uploaded yet, empty if x0 >= x1
+    bool                resized;                                // the texture has to be created again
+};
+
+// A glyph of a cached text run, relative to the pen position the run is drawn at.
+struct UI_Text_Glyph {
+    u32                 glyph;      // in the run's font->glyphs
+    v2                  offset;
+    v2                  src_p0;
+    v2                  src_size;
+};
+
+// The measured extent and glyph quads of a string in a given font and size, see UI_find_text_run.
+struct UI_Text_Run {
+    UI_Font             *font;
+    u64                 hash;
+    u32                 chars;      // offset of the string in ctx->text_run_chars
+    u32                 glyphs;     // offset of the first glyph in ctx->text_run_glyphs
+    u16                 length;     // in bytes
+    u16                 glyph_count;
+    u16                 size;
+    u32                 atlas_resets; // ctx->glyph_atlas_resets when the glyphs were laid out
+    v2                  extent;     // UI_measure_text, which stops at a '#'
+    f32                 advance;    // UI_push_text, which doesn't
 };
 
 struct UI_Color4 {
@@ -138,6 +209,7 @@ struct UI_Vertex {
 #define    UI_Block_Flags_no_clip       	(1<<6)
 #define    UI_Block_Flags_hit_test       	(1<<7)
 #define    UI_Block_Flags_thumb		       	(1<<8)
+#define    UI_Block_Flags_capture_mouse    (1<<9) // the mouse over it belongs to the UI, see UI_blocks_at_point
 
 
 enum UI_Edge {
@@ -254,7 +326,7 @@ struct UI_Block {
 
     // per-frame info provided by builders
     u32             flags;
-    String8         string;
+    String8         string;     // points into the frame arena, set with UI_block_set_string
     u32             depth_level;
     UI_Style        style;
 
@@ -279,7 +351,12 @@ struct UI_Block {
 struct UI_Debug {
     int last_block_count = 0;
     int last_vertex_count = 0;
-	size_t allocated_bytes = 0;
+	f64 last_build_ms = 0; // UI_render turning the blocks into sorted vertices, backend excluded
+	f64 last_sort_ms = 0;
+	f64 last_layout_ms = 0; // UI_end_frame
+	bool last_frame_reused = false; // layout and vertices were taken over from the frame before
+	size_t allocated_bytes = 0; // persistent arena
+	size_t last_frame_bytes = 0; // frame arena at the end of the frame
 	int freed_blocks= 0;
 };
 
@@ -304,21 +381,39 @@ struct UI_Hit_Test_Item {
 	u32 hash;
 	u32 depth_level;
 };
+
+#define UI_HIT_GRID_CELL 64 // pixels
+
+// The hit_test and capture_mouse blocks of one frame binned by the grid cells they overlap, items[offsets[i]..offsets[i + 1])
+// are the block indices of cell i in push order. Built at the end of the frame, see UI_build_hit_grid.
+struct UI_Hit_Grid {
+	int									cells_x, cells_y;
+	Dynarray <u32>						offsets;
+	Dynarray <u32>						items;
+};
 struct UI_Context {
 	u32									buffer_index;
 	StableDynarray <UI_Block>       	buffers[2];
     StableDynarray <UI_Block*>      	parents;
     StableDynarray <u32>            	hashes;
 	StableDynarray <UI_Block_Data>		data_chunks;
-	StableDynarray <UI_Hit_Test_Item> 	blocks_hit_test;
+	Dynarray <UI_Hash_Slot>				previous_blocks_index; // rebuilt every frame, see UI_begin_frame
+	Dynarray <UI_Hash_Slot>				data_chunks_index;
+	UI_Hit_Grid							hit_grids[2]; // paired with buffers[2]
 
 	UI_Hit_Test_Item			hit_test_result;
 
     FT_Library                  ft_lib;
-	StableDynarray<char>		strings;
+	UI_Arena					frame_arenas[2];	// per-frame strings, paired with buffers[2], see UI_get_current_frame_arena
+	UI_Arena					persistent_arena;	// widget state (data_chunks), never reset
 
     bool                        textures[UI_MAX_TEXTURES];
     Dynarray <UI_Font>          fonts;  
+    Dynarray <UI_Text_Run>      text_runs;
+    Dynarray <UI_Hash_Slot>     text_runs_index;
+    Dynarray <UI_Text_Glyph>    text_run_glyphs;
+    Dynarray <char>             text_run_chars;
+    u32                         glyph_atlas_resets; // glyphs already pushed this frame may have moved
     u64                         frame_id; // starts at 0 and increments every frame
     u64                         last_frame_time; //in ms
     u64                         unique_counter; // resets to 0 every frame
@@ -326,10 +421,6 @@ struct UI_Context {
     bool                        want_capture_mouse;
     bool                        want_capture_keyboard;
 
-	char						*string_storage;
-	u32							string_storage_size;
-	u32							string_storage_capacity;
-
 	UI_Signals					signals;
 
     UI_Debug                    debug;
@@ -340,19 +431,15 @@ struct UI_Context {
     void                        *backend_context;
     v2                          viewport;
     Dynarray <UI_Vertex>        vertices;
+    Dynarray <UI_Vertex>        vertices_sorted;
+    Dynarray <u32>              vertex_keys;
+    Dynarray <u32>              vertex_order;
+    u64                         frame_hash;     // everything layout and vertex generation read, see UI_hash_frame
+    bool                        frame_reused;   // same frame_hash as the frame before
+    bool                        vertices_dirty; // backend must upload ctx->vertices again
 
     bool                        initialized;
 };
 
 
-void *UI_malloc(UI_Context *ctx, size_t size) {
-	ctx->debug.allocated_bytes += size;
-	void * result = malloc(size);
-	UI_assert(result);
-	return result;
-}
 
-void UI_free(UI_Context *ctx, size_t size, void* address) {
-	ctx->debug.allocated_bytes -= size;
-	free(address);
-}
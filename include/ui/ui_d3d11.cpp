@@ -224,18 +224,8 @@ void UI_d3d11_push_vertex(UI_Context *ctx, UI_Vertex vertex)  {
     UI_assert(ctx->initialized && "UI context wasn't initialized!");
     UI_assert(ctx->backend == UI_Render_Backend_Type::D3D11 && "Wrong UI render backend initialized.");
 
-    // auto-sorts the vertices by depth so that all can be sent in one draw call
-    if (ctx->vertices.count == 0) {
-        ctx->vertices.push_back(vertex);
-        return;
-    }
-    for (int i = 0; i < ctx->vertices.count; i++) {
-        if (vertex.depth <= ctx->vertices[i].depth) {
-            ctx->vertices.insert(&ctx->vertices[i], vertex);
-            return;
-        }
-    }
-    ctx->vertices.push_front(vertex);
+    // appended in push order, UI_render sorts them by depth once the frame is built
+    ctx->vertices.push_back(vertex);
 }
 
 void UI_d3d11_render(UI_Context *ctx) {
@@ -257,9 +247,9 @@ void UI_d3d11_render(UI_Context *ctx) {
     memcpy(mapped.pData, &constants, sizeof(UI_D3D11_Constants));
     d3d_ctx->device_ctx->Unmap(d3d_ctx->constant_buffer, 0);
 
-    // upload vertex data
-    ctx->vertices.reverse_order();
-    {
+    // upload vertex data, already in back to front order (see UI_sort_vertices). The buffer keeps the
+    // last upload, so unchanged frames skip this
+    if (ctx->vertices_dirty) {
         D3D11_MAPPED_SUBRESOURCE mappedResource = {};
         HRESULT hr = d3d_ctx->device_ctx->Map(d3d_ctx->vertex_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
         UI_Vertex* vertexData = (UI_Vertex*)mappedResource.pData;
@@ -302,7 +292,9 @@ void UI_d3d11_render(UI_Context *ctx) {
     d3d_ctx->device_ctx->DrawInstanced(4, ctx->vertices.count, 0, 0);
 }
 
-void UI_d3d11_create_texture(UI_Context *ctx, i32 handle, u8 *data, int w, int h) {
+// Creates the texture behind 'handle', replacing the one that was there. Updatable textures can be
+// written to with UI_d3d11_update_texture.
+void UI_d3d11_create_texture(UI_Context *ctx, i32 handle, u8 *data, int w, int h, bool updatable) {
     UI_assert(ctx != nullptr && "UI context *ctx is a null pointer!");
     UI_assert(ctx->initialized && "UI context wasn't initialized!");
     UI_D3D11_Context *d3d_ctx = (UI_D3D11_Context *)ctx->backend_context;
@@ -316,7 +308,7 @@ void UI_d3d11_create_texture(UI_Context *ctx, i32 handle, u8 *data, int w, int h
     texture_desc.ArraySize         = 1;
     texture_desc.Format            = DXGI_FORMAT_R8G8B8A8_UNORM;
     texture_desc.SampleDesc.Count  = 1;
-    texture_desc.Usage             = D3D11_USAGE_IMMUTABLE;
+    texture_desc.Usage             = updatable ? D3D11_USAGE_DEFAULT : D3D11_USAGE_IMMUTABLE;
     texture_desc.BindFlags         = D3D11_BIND_SHADER_RESOURCE;
 
     D3D11_SUBRESOURCE_DATA texture_SRD = {};
@@ -324,9 +316,20 @@ void UI_d3d11_create_texture(UI_Context *ctx, i32 handle, u8 *data, int w, int h
     texture_SRD.SysMemPitch = w * 4;
 
     UI_D3D11_Texture *texture = &d3d_ctx->textures[handle];
+    if (texture->srv)     texture->srv->Release();
+    if (texture->texture) texture->texture->Release();
     texture->size = v2(w, h);
     err(d3d_ctx->device->CreateTexture2D(&texture_desc, &texture_SRD, &texture->texture));
     err(d3d_ctx->device->CreateShaderResourceView(texture->texture, nullptr, &texture->srv));
 }
 
+void UI_d3d11_update_texture(UI_Context *ctx, i32 handle, u8 *data, int pitch, int x, int y, int w, int h) {
+    UI_D3D11_Context *d3d_ctx = (UI_D3D11_Context *)ctx->backend_context;
+    UI_assert(d3d_ctx != nullptr && "d3d11 UI context not initialized!");
+    UI_assert(handle >= 0 && handle < UI_MAX_TEXTURES); 
+    D3D11_BOX box = { (UINT)x, (UINT)y, 0, (UINT)(x + w), (UINT)(y + h), 1 };
+    d3d_ctx->device_ctx->UpdateSubresource(d3d_ctx->textures[handle].texture, 0, &box,
+                                           data + (size_t)y * pitch + (size_t)x * 4, pitch, 0);
+}
+
 #undef err
\ No newline at end of file
@@ -39,4 +39,16 @@ void UI_set_cursor(int type) {
 
 v2 UI_get_client_size() {
 	return _v2(get_client_size());
-}
\ No newline at end of file
+}
+// The performance counter's frequency is fixed at boot, UI_get_time_ms reads it once.
+f64 UI_win32_query_ms_per_tick() {
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return 1000.0 / frequency.QuadPart;
+}
+f64 UI_get_time_ms() {
+	static const f64 ms_per_tick = UI_win32_query_ms_per_tick();
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return (f64)counter.QuadPart * ms_per_tick;
+}
@@ -0,0 +1,377 @@
+#pragma once
+#include "ui_core.h"
+#include "ui_software.h"
+
+// CPU render backend. The vertices are drawn with the math of ui_d3d11_shaders.hlsl (attributes
+// interpolated over the quad's two triangles, point sampling, dual source blending into 8 bits per
+// channel) into an RGBA8 framebuffer in memory. The framebuffer is cut into tiles, every tile draws
+// the vertices that touch it in order, so tiles can be drawn on as many threads as there are. Nothing
+// here needs a GPU or Win32: it runs headless, tests/test_ui_software.cpp compares its frames with
+// reference images.
+
+void UI_software_resize(UI_Context *ctx, int w, int h);
+
+/**
+ * @param UI_Context *ctx : the exisitng and already initialized context where this render backend should be added to.
+ * @param parallel_for : runs the tiles on several threads, may be null.
+ * **/
+void UI_software_init(UI_Context *ctx, int w, int h, UI_Software_Parallel_For *parallel_for = nullptr) {
+    UI_assert(ctx != nullptr && "UI context *ctx is a null pointer!");
+    UI_assert(ctx->initialized && "UI context wasn't initialized!");
+    UI_assert(ctx->backend == UI_Render_Backend_Type::None && "A different backend was already initalized!");
+    UI_Software_Context *sw_ctx = (UI_Software_Context *)malloc(sizeof(UI_Software_Context));
+    memset(sw_ctx, 0, sizeof(*sw_ctx));
+    sw_ctx->parallel_for = parallel_for;
+    sw_ctx->tile_offsets.init_null();
+    sw_ctx->tile_items.init_null();
+    ctx->backend = UI_Render_Backend_Type::Software;
+    ctx->backend_context = sw_ctx;
+    UI_software_resize(ctx, w, h);
+}
+
+// Reallocates the framebuffer, cleared to 0.
+void UI_software_resize(UI_Context *ctx, int w, int h) {
+    UI_Software_Context *sw_ctx = (UI_Software_Context *)ctx->backend_context;
+    UI_assert(sw_ctx != nullptr && "software UI context not initialized!");
+    free(sw_ctx->framebuffer);
+    sw_ctx->framebuffer = (u8 *)calloc((size_t)w * h * 4, 1);
+    sw_ctx->w = w;
+    sw_ctx->h = h;
+    sw_ctx->tiles_x = (w + UI_SOFTWARE_TILE - 1) / UI_SOFTWARE_TILE;
+    sw_ctx->tiles_y = (h + UI_SOFTWARE_TILE - 1) / UI_SOFTWARE_TILE;
+}
+
+void UI_software_clear(UI_Context *ctx, v4 color) {
+    UI_Software_Context *sw_ctx = (UI_Software_Context *)ctx->backend_context;
+    u8 c[4];
+    for (int i = 0; i < 4; i++)
+        c[i] = (u8)(UI_clamp(color.e[i], 0.f, 1.f) * 255 + 0.5f);
+    u32 pixel;
+    memcpy(&pixel, c, 4);
+    u32 *dst = (u32 *)sw_ctx->framebuffer;
+    for (size_t i = 0; i < (size_t)sw_ctx->w * sw_ctx->h; i++)
+        dst[i] = pixel;
+}
+
+void UI_software_push_vertex(UI_Context *ctx, UI_Vertex vertex) {
+    UI_assert(ctx != nullptr && "UI context *ctx is a null pointer!");
+    UI_assert(ctx->backend == UI_Render_Backend_Type::Software && "Wrong UI render backend initialized.");
+    ctx->vertices.push_back(vertex);
+}
+
+void UI_software_create_texture(UI_Context *ctx, i32 handle, u8 *data, int w, int h) {
+    UI_Software_Context *sw_ctx = (UI_Software_Context *)ctx->backend_context;
+    UI_assert(sw_ctx != nullptr && "software UI context not initialized!");
+    UI_assert(handle >= 0 && handle < UI_MAX_TEXTURES);
+    UI_Software_Texture *texture = &sw_ctx->textures[handle];
+    if (texture->owned) free(texture->pixels);
+    texture->pixels = (u8 *)malloc((size_t)w * h * 4);
+    if (data) memcpy(texture->pixels, data, (size_t)w * h * 4);
+    else      memset(texture->pixels, 0, (size_t)w * h * 4);
+    texture->w = w;
+    texture->h = h;
+    texture->pitch = w * 4;
+    texture->owned = true;
+}
+
+// A texture bound with UI_software_bind_texture is the caller's memory and never written to: updating
+// it from that same memory is a no-op, from anywhere else it first becomes a copy of its own.
+void UI_software_update_texture(UI_Context *ctx, i32 handle, u8 *data, int pitch, int x, int y, int w, int h) {
+    UI_Software_Context *sw_ctx = (UI_Software_Context *)ctx->backend_context;
+    UI_assert(handle >= 0 && handle < UI_MAX_TEXTURES);
+    UI_Software_Texture *texture = &sw_ctx->textures[handle];
+    if (!texture->owned) {
+        if (data == texture->pixels && pitch == texture->pitch) return;
+        u8 *pixels = (u8 *)malloc((size_t)texture->w * texture->h * 4);
+        for (int row = 0; row < texture->h; row++)
+            memcpy(pixels + (size_t)row * texture->w * 4, texture->pixels + (size_t)row * texture->pitch, (size_t)texture->w * 4);
+        texture->pixels = pixels;
+        texture->pitch = texture->w * 4;
+        texture->owned = true;
+    }
+    for (int row = y; row < y + h; row++)
+        memcpy(texture->pixels + (size_t)row * texture->pitch + x * 4, data + (size_t)row * pitch + x * 4, (size_t)w * 4);
+}
+
+// Samples 'handle' straight from the caller's memory, which has to outlive its use. The counterpart of
+// the thumbnail atlas that UI_d3d11_render puts in slot 3.
+void UI_software_bind_texture(UI_Context *ctx, i32 handle, u8 *pixels, int w, int h, int pitch) {
+    UI_Software_Context *sw_ctx = (UI_Software_Context *)ctx->backend_context;
+    UI_assert(handle >= 0 && handle < UI_MAX_TEXTURES);
+    UI_Software_Texture *texture = &sw_ctx->textures[handle];
+    if (texture->owned) free(texture->pixels);
+    texture->pixels = pixels;
+    texture->w = w;
+    texture->h = h;
+    texture->pitch = pitch;
+    texture->owned = false;
+}
+
+// The pixels a vertex can touch, [x0, x1) * [y0, y1). Exact for unrotated quads, including the clip
+// rect and the rasterizer's top-left rule, a bounding box for rotated ones.
+bool UI_software_vertex_bounds(UI_Software_Context *sw_ctx, UI_Vertex *v, int *x0, int *y0, int *x1, int *y1) {
+    v2 half = (v->dst_p1 - v->dst_p0) / 2;
+    v2 center = v->dst_p0 + half;
+    if (half.x == 0 || half.y == 0) return false;
+    f32 ex = fabsf(half.x), ey = fabsf(half.y);
+    if (v->rotation != 0) {
+        f32 c = fabsf(cosf(v->rotation)), s = fabsf(sinf(v->rotation));
+        f32 rx = ex * c + ey * s, ry = ex * s + ey * c;
+        *x0 = (int)floorf(center.x - rx); *x1 = (int)ceilf(center.x + rx);
+        *y0 = (int)floorf(center.y - ry); *y1 = (int)ceilf(center.y + ry);
+    } else {
+        // pixel centers in [p0, p1)
+        *x0 = (int)ceilf(center.x - ex - 0.5f); *x1 = (int)ceilf(center.x + ex - 0.5f);
+        *y0 = (int)ceilf(center.y - ey - 0.5f); *y1 = (int)ceilf(center.y + ey - 0.5f);
+    }
+    if (v->clp_p0.x >= 0) {
+        // pixel centers in [p0, p1], like point_in_rect
+        f32 cx0 = min(v->clp_p0.x, v->clp_p1.x), cx1 = max(v->clp_p0.x, v->clp_p1.x);
+        f32 cy0 = min(v->clp_p0.y, v->clp_p1.y), cy1 = max(v->clp_p0.y, v->clp_p1.y);
+        *x0 = max(*x0, (int)ceilf(cx0 - 0.5f)); *x1 = min(*x1, (int)floorf(cx1 - 0.5f) + 1);
+        *y0 = max(*y0, (int)ceilf(cy0 - 0.5f)); *y1 = min(*y1, (int)floorf(cy1 - 0.5f) + 1);
+    }
+    *x0 = max(*x0, 0); *x1 = min(*x1, sw_ctx->w);
+    *y0 = max(*y0, 0); *y1 = min(*y1, sw_ctx->h);
+    return *x0 < *x1 && *y0 < *y1;
+}
+
+static inline f32 UI_software_rounded_rect_sdf(f32 px, f32 py, v2 center, v2 half, f32 r) {
+    r = r < 0 ? half.x : r;
+    f32 dx = fabsf(center.x - px) - half.x + r;
+    f32 dy = fabsf(center.y - py) - half.y + r;
+    f32 ox = max(dx, 0.f), oy = max(dy, 0.f);
+    return min(max(dx, dy), 0.f) + sqrtf(ox * ox + oy * oy) - r;
+}
+
+// smoothstep(0, edge, x), a zero edge is a step like on the GPU
+static inline f32 UI_software_smoothstep(f32 edge, f32 x) {
+    if (edge <= 0) return x > 0 ? 1.f : 0.f;
+    f32 t = UI_clamp(x / edge, 0.f, 1.f);
+    return t * t * (3 - 2 * t);
+}
+
+static inline f32 UI_software_to_linear(f32 x) {
+    return x <= 0.04045f ? x / 12.92f : powf((x + 0.055f) / 1.055f, 2.4f);
+}
+
+static inline __m128 UI_software_sample(UI_Software_Texture *texture, f32 x, f32 y) {
+    if (!texture->pixels) return _mm_setzero_ps();
+    int tx = UI_clamp((int)floorf(x), 0, texture->w - 1);
+    int ty = UI_clamp((int)floorf(y), 0, texture->h - 1);
+    u8 *px = texture->pixels + (size_t)ty * texture->pitch + tx * 4;
+    __m128i v = _mm_cvtsi32_si128(*(const i32 *)px);
+    v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(v, _mm_setzero_si128()), _mm_setzero_si128());
+    return _mm_div_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(255.0f));
+}
+
+// dst = color * blend + dst * (1 - blend.a), what the D3D11 blend state does with the pixel shader's
+// two outputs, stored back as 8 bits per channel
+static inline void UI_software_blend(u8 *dst, __m128 color, __m128 blend) {
+    __m128i d = _mm_cvtsi32_si128(*(const i32 *)dst);
+    d = _mm_unpacklo_epi16(_mm_unpacklo_epi8(d, _mm_setzero_si128()), _mm_setzero_si128());
+    __m128 dst_color = _mm_div_ps(_mm_cvtepi32_ps(d), _mm_set1_ps(255.0f));
+    __m128 inv_a = _mm_sub_ps(_mm_set1_ps(1), _mm_shuffle_ps(blend, blend, _MM_SHUFFLE(3, 3, 3, 3)));
+    __m128 out = _mm_add_ps(_mm_mul_ps(color, blend), _mm_mul_ps(dst_color, inv_a));
+    out = _mm_min_ps(_mm_max_ps(out, _mm_setzero_ps()), _mm_set1_ps(1));
+    __m128i q = _mm_cvtps_epi32(_mm_mul_ps(out, _mm_set1_ps(255)));
+    q = _mm_packs_epi32(q, q);
+    *(i32 *)dst = _mm_cvtsi128_si32(_mm_packus_epi16(q, q));
+}
+
+// A quad of a single color without texture, corners, softness or border covers its pixels fully, so
+// it blends one color over whole spans.
+static bool UI_software_is_solid(UI_Vertex *v) {
+    if (v->texture_id != -1 || v->rotation != 0 || v->softness != 0 || v->border_size != 0) return false;
+    if (v->flags & (UI_Vertex_Flags_srgb | UI_Vertex_Flags_lcd | UI_Vertex_Flags_thumb)) return false;
+    if (v->dst_p1.x < v->dst_p0.x || v->dst_p1.y < v->dst_p0.y) return false;
+    for (int i = 0; i < 4; i++) {
+        if (v->roundness.e[i] != 0) return false;
+        if (memcmp(&v->colors[i], &v->colors[0], sizeof(v4)) != 0) return false;
+    }
+    return true;
+}
+
+static void UI_software_fill_span(u8 *dst, int count, __m128 color, __m128 blend) {
+    f32 a[4];
+    _mm_storeu_ps(a, blend);
+    if (a[3] == 1) {
+        // the destination drops out of the blend, every pixel gets the same value
+        u8 px[4] = {};
+        UI_software_blend(px, color, blend);
+        u32 value;
+        memcpy(&value, px, 4);
+        u32 *p = (u32 *)dst;
+        for (int i = 0; i < count; i++) p[i] = value;
+        return;
+    }
+    for (int i = 0; i < count; i++)
+        UI_software_blend(dst + i * 4, color, blend);
+}
+
+// PSMain for the pixels of 'v' inside [x0, x1) * [y0, y1).
+static void UI_software_draw_vertex(UI_Software_Context *sw_ctx, UI_Vertex *v, int x0, int y0, int x1, int y1) {
+    size_t pitch = (size_t)sw_ctx->w * 4;
+    if (UI_software_is_solid(v)) {
+        __m128 color = _mm_loadu_ps(v->colors[0].e);
+        __m128 blend = _mm_shuffle_ps(color, color, _MM_SHUFFLE(3, 3, 3, 3));
+        for (int y = y0; y < y1; y++)
+            UI_software_fill_span(sw_ctx->framebuffer + y * pitch + x0 * 4, x1 - x0, color, blend);
+        return;
+    }
+
+    v2 half = (v->dst_p1 - v->dst_p0) / 2;
+    v2 center = v->dst_p0 + half;
+    v2 src_half = (v->src_p1 - v->src_p0) / 2;
+    v2 src_center = (v->src_p1 + v->src_p0) / 2;
+    f32 rot_c = cosf(v->rotation), rot_s = sinf(v->rotation);
+    __m128 colors[4];
+    for (int i = 0; i < 4; i++) colors[i] = _mm_loadu_ps(v->colors[i].e);
+
+    UI_Software_Texture *texture = nullptr;
+    if (v->texture_id >= 0 && v->texture_id < UI_MAX_TEXTURES)
+        texture = &sw_ctx->textures[v->texture_id];
+    bool thumb = (v->flags & UI_Vertex_Flags_thumb) != 0;
+    bool thumb_draw = thumb && v->misc >= 0;
+    f32 thumb_x = 0, thumb_y = 0, thumb_half = 0.5f * THUMBS_DIM;
+    if (thumb_draw) {
+        int per_row = 4000 / THUMBS_DIM;
+        thumb_x = (v->misc % per_row) * THUMBS_DIM + thumb_half;
+        thumb_y = (v->misc / per_row) * THUMBS_DIM + thumb_half;
+    }
+
+    f32 softness_padding = max(0.f, v->softness * 2 - 1);
+    v2 sdf_half = half - v2(softness_padding, softness_padding);
+    v2 interior_half = half - v2(v->border_size, v->border_size);
+    f32 interior_reduce = min(interior_half.x / half.x, interior_half.y / half.y);
+    v2 interior_sdf_half = interior_half - v2(softness_padding, softness_padding);
+
+    for (int y = y0; y < y1; y++) {
+        u8 *row = sw_ctx->framebuffer + y * pitch;
+        f32 py = y + 0.5f;
+        for (int x = x0; x < x1; x++) {
+            f32 px = x + 0.5f;
+            // position in the quad, (-1, -1) to (1, 1) before rotation
+            f32 dx = px - center.x, dy = py - center.y;
+            f32 u = (dx * rot_c + dy * rot_s) / half.x;
+            f32 w = (dy * rot_c - dx * rot_s) / half.y;
+            if (v->rotation != 0 && (u < -1 || u >= 1 || w < -1 || w >= 1)) continue;
+
+            // the strip A D B C is (-1, 1) (-1, -1) (1, 1) (1, -1), the attributes are interpolated over
+            // the triangle the pixel is in, ADB or DBC
+            f32 wu = (u + 1) * 0.5f, wv = (w + 1) * 0.5f;
+            f32 weights[4];
+            if (w >= u) { weights[0] = wv - wu; weights[1] = 1 - wv; weights[2] = wu; weights[3] = 0; }
+            else        { weights[0] = 0; weights[1] = 1 - wu; weights[2] = wv; weights[3] = wu - wv; }
+            __m128 color = _mm_setzero_ps();
+            f32 radius = 0;
+            for (int i = 0; i < 4; i++) {
+                color = _mm_add_ps(color, _mm_mul_ps(colors[i], _mm_set1_ps(weights[i])));
+                radius += v->roundness.e[i] * weights[i];
+            }
+
+            __m128 sampled = _mm_set1_ps(1);
+            if (texture)
+                sampled = UI_software_sample(texture, src_center.x + u * src_half.x, src_center.y + w * src_half.y);
+
+            f32 dist = UI_software_rounded_rect_sdf(px, py, center, sdf_half, radius);
+            f32 sdf_factor = 1.f - UI_software_smoothstep(2 * v->softness, dist);
+            f32 border_factor = 1.f;
+            if (v->border_size != 0) {
+                f32 inside_d = UI_software_rounded_rect_sdf(px, py, center, interior_sdf_half,
+                                                            radius * interior_reduce * interior_reduce);
+                border_factor = UI_software_smoothstep(2 * v->softness, inside_d);
+            }
+
+            __m128 out, blend;
+            if (thumb) {
+                sampled = _mm_setzero_ps();
+                if (thumb_draw)
+                    sampled = UI_software_sample(&sw_ctx->textures[3], thumb_x + u * thumb_half, thumb_y + w * thumb_half);
+                sampled = _mm_shuffle_ps(sampled, sampled, _MM_SHUFFLE(3, 0, 1, 2)); // .bgra
+                out = _mm_add_ps(_mm_mul_ps(sampled, _mm_set1_ps(border_factor * sdf_factor)),
+                                 _mm_mul_ps(color, _mm_set1_ps(0.3f)));
+                blend = _mm_shuffle_ps(out, out, _MM_SHUFFLE(3, 3, 3, 3));
+                UI_software_blend(row + x * 4, out, blend);
+                continue;
+            }
+            if (v->flags & UI_Vertex_Flags_srgb) {
+                f32 c[4];
+                _mm_storeu_ps(c, color);
+                c[0] = UI_software_to_linear(c[0]);
+                c[1] = UI_software_to_linear(c[1]);
+                c[2] = UI_software_to_linear(c[2]);
+                c[3] = 1 - (1 - c[3]) * (1 - c[3]);
+                color = _mm_loadu_ps(c);
+            }
+            if (v->flags & UI_Vertex_Flags_lcd) {
+                out = color;
+                blend = _mm_mul_ps(sampled, _mm_shuffle_ps(color, color, _MM_SHUFFLE(3, 3, 3, 3)));
+            } else {
+                out = _mm_mul_ps(_mm_mul_ps(sampled, color), _mm_set1_ps(border_factor * sdf_factor));
+                blend = _mm_shuffle_ps(out, out, _MM_SHUFFLE(3, 3, 3, 3));
+            }
+            UI_software_blend(row + x * 4, out, blend);
+        }
+    }
+}
+
+static void UI_software_draw_tiles(void *user, u32 begin, u32 end, u32 worker) {
+    UI_Context *ctx = (UI_Context *)user;
+    UI_Software_Context *sw_ctx = (UI_Software_Context *)ctx->backend_context;
+    for (u32 tile = begin; tile < end; tile++) {
+        int tx0 = (tile % sw_ctx->tiles_x) * UI_SOFTWARE_TILE;
+        int ty0 = (tile / sw_ctx->tiles_x) * UI_SOFTWARE_TILE;
+        int tx1 = min(tx0 + UI_SOFTWARE_TILE, sw_ctx->w);
+        int ty1 = min(ty0 + UI_SOFTWARE_TILE, sw_ctx->h);
+        for (u32 i = sw_ctx->tile_offsets[tile]; i < sw_ctx->tile_offsets[tile + 1]; i++) {
+            UI_Vertex *v = &ctx->vertices[sw_ctx->tile_items[i]];
+            int x0, y0, x1, y1;
+            UI_software_vertex_bounds(sw_ctx, v, &x0, &y0, &x1, &y1);
+            x0 = max(x0, tx0); y0 = max(y0, ty0);
+            x1 = min(x1, tx1); y1 = min(y1, ty1);
+            UI_software_draw_vertex(sw_ctx, v, x0, y0, x1, y1);
+        }
+    }
+}
+
+void UI_software_render(UI_Context *ctx) {
+    UI_assert(ctx != nullptr && "UI context *ctx is a null pointer!");
+    UI_assert(ctx->initialized && "UI context wasn't initialized!");
+    UI_Software_Context *sw_ctx = (UI_Software_Context *)ctx->backend_context;
+    UI_assert(sw_ctx != nullptr && "software UI context not initialized!");
+    if (ctx->vertices.count == 0 || sw_ctx->w == 0 || sw_ctx->h == 0) return;
+
+    // bin the vertices, already in back to front order (see UI_sort_vertices), by the tiles they touch
+    int tiles = sw_ctx->tiles_x * sw_ctx->tiles_y;
+    sw_ctx->tile_offsets.resize(tiles + 1);
+    memset(sw_ctx->tile_offsets.data, 0, sizeof(u32) * (tiles + 1));
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < ctx->vertices.count; i++) {
+            int x0, y0, x1, y1;
+            if (!UI_software_vertex_bounds(sw_ctx, &ctx->vertices[i], &x0, &y0, &x1, &y1)) continue;
+            for (int ty = y0 / UI_SOFTWARE_TILE; ty <= (y1 - 1) / UI_SOFTWARE_TILE; ty++) {
+                for (int tx = x0 / UI_SOFTWARE_TILE; tx <= (x1 - 1) / UI_SOFTWARE_TILE; tx++) {
+                    int tile = ty * sw_ctx->tiles_x + tx;
+                    if (pass == 0) sw_ctx->tile_offsets[tile + 1]++;
+                    else           sw_ctx->tile_items[sw_ctx->tile_offsets[tile]++] = i;
+                }
+            }
+        }
+        if (pass == 0) {
+            for (int tile = 0; tile < tiles; tile++)
+                sw_ctx->tile_offsets[tile + 1] += sw_ctx->tile_offsets[tile];
+            sw_ctx->tile_items.resize(sw_ctx->tile_offsets[tiles]);
+        } else {
+            // filling moved every offset to the start of the next tile
+            for (int tile = tiles; tile > 0; tile--)
+                sw_ctx->tile_offsets[tile] = sw_ctx->tile_offsets[tile - 1];
+            sw_ctx->tile_offsets[0] = 0;
+        }
+    }
+
+    if (sw_ctx->parallel_for)
+        sw_ctx->parallel_for(tiles, 1, UI_software_draw_tiles, ctx);
+    else
+        UI_software_draw_tiles(ctx, 0, tiles, 0);
+}
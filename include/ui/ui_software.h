@@ -0,0 +1,28 @@
+#pragma once
+#include "ui_core.h"
+
+#define UI_SOFTWARE_TILE 64 // tiles are drawn independently, each in vertex order
+
+// Same signature as parallel_for, so the application can hand its own in. Without one the tiles are
+// drawn on the calling thread.
+typedef void UI_Software_Parallel_Func(void *user, u32 begin, u32 end, u32 worker);
+typedef void UI_Software_Parallel_For(u32 count, u32 chunk, UI_Software_Parallel_Func *func, void *user);
+
+struct UI_Software_Texture {
+    u8                          *pixels;    // RGBA8
+    int                         w, h;
+    int                         pitch;
+    bool                        owned;      // a copy made by UI_create_texture, not bound memory
+};
+
+struct UI_Software_Context {
+    u8                          *framebuffer; // RGBA8, w * 4 bytes per row
+    int                         w, h;
+    UI_Software_Texture         textures[UI_MAX_TEXTURES];
+    UI_Software_Parallel_For    *parallel_for;
+
+    // vertices binned per tile, tile_items[tile_offsets[i]..tile_offsets[i + 1]) are tile i's
+    int                         tiles_x, tiles_y;
+    Dynarray <u32>              tile_offsets;
+    Dynarray <u32>              tile_items;
+};
@@ -1,4 +1,7 @@
 #pragma once
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 #if defined(_MSC_VER) && !defined(__clang__) && !defined(IMGUI_DEBUG_PARANOID)
 #define MSVC_RUNTIME_CHECKS_OFF      __pragma(runtime_checks("",off))     __pragma(check_stack(off)) __pragma(strict_gs_check(push,off))
 #define MSVC_RUNTIME_CHECKS_RESTORE  __pragma(runtime_checks("",restore)) __pragma(check_stack())    __pragma(strict_gs_check(pop))
@@ -46,6 +49,7 @@ struct Dynarray
     inline const T&     front() const                       { assert(count > 0); return data[0]; }
     inline T&           back()                              { assert(count > 0); return data[count - 1]; }
     inline const T&     back() const                        { assert(count > 0); return data[count - 1]; }
+    inline void         swap(Dynarray<T>& rhs)              { int rhs_count = rhs.count; rhs.count = count; count = rhs_count; int rhs_cap = rhs.capacity; rhs.capacity = capacity; capacity = rhs_cap; T* rhs_data = rhs.data; rhs.data = data; data = rhs_data; }
 
     inline int _grow_capacity(int sz) const { 
         int new_capacity = capacity ? (capacity + capacity / 2) : 8; 
@@ -108,6 +112,18 @@ struct Dynarray
 #define MB(X) (KB(X)*1024LL)
 #define GB(X) (MB(X)*1024LL)
 
+// Virtual memory: address space is reserved up front and pages are committed as they are needed,
+// reserved but uncommitted memory costs no RAM.
+#ifdef _WIN32
+inline void *w_vm_reserve(uint64_t bytes)                   { return VirtualAlloc(0, bytes, MEM_RESERVE, PAGE_NOACCESS); }
+inline bool  w_vm_commit(void *address, uint64_t bytes)     { return VirtualAlloc(address, bytes, MEM_COMMIT, PAGE_READWRITE) != nullptr; }
+inline void  w_vm_release(void *address, uint64_t bytes)    { VirtualFree(address, 0, MEM_RELEASE); }
+#else
+inline void *w_vm_reserve(uint64_t bytes)                   { void *p = mmap(0, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0); return p == MAP_FAILED ? nullptr : p; }
+inline bool  w_vm_commit(void *address, uint64_t bytes)     { return mprotect(address, bytes, PROT_READ | PROT_WRITE) == 0; }
+inline void  w_vm_release(void *address, uint64_t bytes)    { munmap(address, bytes); }
+#endif
+
 // NOTE(aidan): This is stable in the sense that pointers into it should always remain valid
 // 				this is achieved by reserving a large block of virtual memory using init_reserve
 template<typename T>
@@ -131,7 +147,7 @@ struct StableDynarray
     
     inline void         init_null()                         { count = capacity = iter = reserved_bytes = 0; data = nullptr; }  
     inline void         reset_count()                       { count = 0;}  
-    inline void         clear()                             { if (data) { count = capacity = reserved_bytes = 0; VirtualFree(data, 0, MEM_RELEASE); data = nullptr;} }  
+    inline void         clear()                             { if (data) { w_vm_release(data, reserved_bytes); count = capacity = reserved_bytes = 0; data = nullptr;} }  
     inline void         clear_destruct()                    { for (int n = 0; n < count; n++) data[n].~T(); clear(); }           
 
     inline bool         is_empty() const                    { return count == 0; }
@@ -156,7 +172,7 @@ struct StableDynarray
 	inline uint64_t _round_up_to_page(uint64_t bytes) const {
 		const static uint64_t page_size = 4096;
 		uint64_t mask = page_size - 1;
-		if (bytes & mask == 0)
+		if ((bytes & mask) == 0)
 		{
 			return bytes;
 		}
@@ -174,14 +190,14 @@ struct StableDynarray
 		count = reserved_bytes = capacity = iter = 0;
 		data = nullptr;
 
-        T* new_data = (T*)VirtualAlloc(0, new_reserve_bytes, MEM_RESERVE, PAGE_NOACCESS);
+        T* new_data = (T*)w_vm_reserve(new_reserve_bytes);
 		reserved_bytes = new_reserve_bytes;
         assert(new_data != nullptr);
 
 		uint64_t new_capacity_bytes = new_capacity * sizeof(T);
 		int commit_bytes = _round_up_to_page(new_capacity_bytes);
 
-		VirtualAlloc(new_data, commit_bytes, MEM_COMMIT, PAGE_READWRITE);
+		w_vm_commit(new_data, commit_bytes);
 
         data = new_data; 
         capacity = new_capacity;
@@ -198,7 +214,7 @@ struct StableDynarray
 
 		assert(new_bytes < reserved_bytes);
 		char* data_bytes = (char*)data;
-		VirtualAlloc(data_bytes + current_bytes, new_bytes - current_bytes, MEM_COMMIT, PAGE_READWRITE);
+		w_vm_commit(data_bytes + current_bytes, new_bytes - current_bytes);
 		capacity = new_capacity;
 	}
 
@@ -324,11 +340,17 @@ Dynarray<String8> w_tokenize(const String8 str)
 
 
 void*walloc(size_t size) {
-	//return malloc(size);
+#ifdef _WIN32
 	return VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+	return malloc(size);
+#endif
 }
 //NOTE (Wassim):  for some reaosn VirtualFree was crashing, need to investigate this later
 void wfree(void* address) {
-	//free(address);
+#ifdef _WIN32
 	VirtualFree(address, 0, MEM_RELEASE);
+#else
+	free(address);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,531 @@
+// Batch export: applies an edit preset to a list of files or folders without a window or a GPU,
+// from the image edit popup or from the command line (batch_main). Every worker decodes, processes
+// (cpu_pipeline.cpp) and encodes one whole file at a time, with one worker per core, so the decode
+// of one file overlaps with the pixel work and encoding of others.
+
+static HRESULT export_image_cpu(Encoder_Format encoder_format, wchar_t *path, const Shader_Constants_Main *constants,
+                                u8 *src, Pixel_Format src_format, i32 w, i32 h, const Grading_LUT *grading, i32 quality);
+static HRESULT wic_decode_pixels(IWICImagingFactory *factory, IWICBitmapFrameDecode *frame, bool color_manage,
+                                 u8 **data, u32 *w, u32 *h, Pixel_Format *format);
+static int check_valid_extention(wchar_t *EXT);
+static void remove_char(wchar_t *str, wchar_t ch);
+static f64 get_time();
+
+static const wchar_t *encoder_format_ext(Encoder_Format encoder_format) {
+	switch (encoder_format) {
+		case Format_Bmp:	return L"bmp";
+		case Format_Png:	return L"png";
+		case Format_Jpeg:	return L"jpg";
+		case Format_Tiff:	return L"tiff";
+		case Format_Dds:	return L"dds";
+		case Format_Heif:	return L"heif";
+		case Format_Webp:	return L"webp";
+		case Format_Webp_Lossless:	return L"webp";
+		default:			return L"png";
+	}
+}
+
+static bool encoder_format_from_name(const wchar_t *name, Encoder_Format *encoder_format) {
+	if (_wcsicmp(name, L"tif") == 0) name = L"tiff";
+	if (_wcsicmp(name, L"jpeg") == 0) name = L"jpg";
+	if (_wcsicmp(name, L"webp-lossless") == 0) {
+		*encoder_format = Format_Webp_Lossless;
+		return true;
+	}
+	for (int i = 0; i < Format_Count; i++) {
+		if (_wcsicmp(name, encoder_format_ext((Encoder_Format)i)) == 0) {
+			*encoder_format = (Encoder_Format)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+//
+// Presets. The crop is stored relative to the image size so one preset fits images of any size.
+//
+
+static Edit_Preset edit_preset_from_current() {
+	Edit_Preset preset = {};
+	v2 dim = v2(max(G->graphics.main_image.w, 1), max(G->graphics.main_image.h, 1));
+	preset.hue = G->hue;
+	preset.saturation = G->saturation;
+	preset.contrast = G->contrast;
+	preset.brightness = G->brightness;
+	preset.gamma = G->gamma;
+	preset.srgb = G->srgb;
+	preset.do_blur = G->do_blur;
+	preset.blur_samples = G->blur_samples;
+	preset.blur_lod = G->blur_lod;
+	preset.blur_scale = G->blur_scale;
+	preset.rgba_flags = v4((float)RGBAflags[0], (float)RGBAflags[1], (float)RGBAflags[2], (float)RGBAflags[3]);
+	preset.crop_a = _v2(G->crop_a) / dim;
+	preset.crop_b = _v2(G->crop_b) / dim;
+	if (G->graphics.main_image.w <= 0 || G->graphics.main_image.h <= 0) {
+		preset.crop_a = v2(0);
+		preset.crop_b = v2(1);
+	}
+	return preset;
+}
+
+static void edit_preset_apply(const Edit_Preset *preset) {
+	v2 dim = v2(G->graphics.main_image.w, G->graphics.main_image.h);
+	G->hue = preset->hue;
+	G->saturation = preset->saturation;
+	G->contrast = preset->contrast;
+	G->brightness = preset->brightness;
+	G->gamma = preset->gamma;
+	G->srgb = preset->srgb;
+	G->do_blur = preset->do_blur;
+	G->blur_samples = preset->blur_samples;
+	G->blur_lod = preset->blur_lod;
+	G->blur_scale = preset->blur_scale;
+	for (int i = 0; i < 4; i++) RGBAflags[i] = preset->rgba_flags[i] != 0;
+	G->crop_a = _iv2(preset->crop_a * dim + v2(0.5f));
+	G->crop_b = _iv2(preset->crop_b * dim + v2(0.5f));
+}
+
+// Constants for the CPU pipeline, as set_main_shader_constants would produce them for a w*h image
+// edited with 'preset'.
+static Shader_Constants_Main edit_preset_constants(const Edit_Preset *preset, i32 w, i32 h) {
+	Shader_Constants_Main result = { 0 };
+	v2 dim = v2(w, h);
+	result.image_dim = dim;
+	result.rgba_flags = preset->rgba_flags;
+	result.hue = preset->hue;
+	result.saturation = preset->saturation;
+	result.contrast = preset->contrast;
+	result.brightness = preset->brightness;
+	result.srgb = preset->srgb;
+	result.gamma = preset->gamma;
+	result.render_mode = RENDER_MODE_ENCODER;
+	result.do_blur = preset->do_blur;
+	result.blur_lod = preset->blur_lod;
+	result.blur_samples = preset->blur_samples;
+	result.blur_scale = preset->blur_scale;
+	iv2 a = _iv2(preset->crop_a * dim + v2(0.5f));
+	iv2 b = _iv2(preset->crop_b * dim + v2(0.5f));
+	a = iv2(clamp(a.x, 0, w - 1), clamp(a.y, 0, h - 1));
+	b = iv2(clamp(b.x, a.x + 1, w), clamp(b.y, a.y + 1, h));
+	result.crop_a = _v2(a);
+	result.crop_b = _v2(b);
+	return result;
+}
+
+static bool edit_preset_save(const Edit_Preset *preset, const wchar_t *path) {
+	cJSON *json = cJSON_CreateObject();
+	cJSON_AddItemToObject(json, "hue", cJSON_CreateNumber(preset->hue));
+	cJSON_AddItemToObject(json, "saturation", cJSON_CreateNumber(preset->saturation));
+	cJSON_AddItemToObject(json, "contrast", cJSON_CreateNumber(preset->contrast));
+	cJSON_AddItemToObject(json, "brightness", cJSON_CreateNumber(preset->brightness));
+	cJSON_AddItemToObject(json, "gamma", cJSON_CreateNumber(preset->gamma));
+	cJSON_AddItemToObject(json, "srgb", cJSON_CreateBool(preset->srgb));
+	cJSON_AddItemToObject(json, "blur", cJSON_CreateBool(preset->do_blur));
+	cJSON_AddItemToObject(json, "blur_samples", cJSON_CreateNumber(preset->blur_samples));
+	cJSON_AddItemToObject(json, "blur_lod", cJSON_CreateNumber(preset->blur_lod));
+	cJSON_AddItemToObject(json, "blur_scale", cJSON_CreateNumber(preset->blur_scale));
+	cJSON *channels = cJSON_CreateArray();
+	for (int i = 0; i < 4; i++) cJSON_AddItemToArray(channels, cJSON_CreateBool(preset->rgba_flags[i] != 0));
+	cJSON_AddItemToObject(json, "channels", channels);
+	cJSON *crop = cJSON_CreateArray();
+	cJSON_AddItemToArray(crop, cJSON_CreateNumber(preset->crop_a.x));
+	cJSON_AddItemToArray(crop, cJSON_CreateNumber(preset->crop_a.y));
+	cJSON_AddItemToArray(crop, cJSON_CreateNumber(preset->crop_b.x));
+	cJSON_AddItemToArray(crop, cJSON_CreateNumber(preset->crop_b.y));
+	cJSON_AddItemToObject(json, "crop", crop);
+
+	char *text = cJSON_Print(json);
+	FILE *F = _wfopen(path, L"w");
+	if (F && text) fputs(text, F);
+	if (F) fclose(F);
+	cJSON_free(text);
+	cJSON_Delete(json);
+	return F && text;
+}
+
+// The settings of an unedited image: applied, nothing about the pixels changes.
+static Edit_Preset edit_preset_neutral() {
+	Edit_Preset preset = {};
+	preset.saturation = 1;
+	preset.contrast = 1;
+	preset.gamma = 1;
+	preset.blur_samples = 32;
+	preset.blur_lod = 1;
+	preset.blur_scale = 0.001;
+	preset.rgba_flags = v4(1.0f);
+	preset.crop_b = v2(1);
+	return preset;
+}
+
+// Missing keys keep the defaults of an unedited image.
+static bool edit_preset_load(Edit_Preset *preset, const wchar_t *path) {
+	FILE *F = _wfopen(path, L"rb");
+	if (!F) return false;
+	fseek(F, 0, SEEK_END);
+	size_t size = ftell(F);
+	fseek(F, 0, SEEK_SET);
+	char *data = (char *)malloc(size);
+	size = data ? fread(data, 1, size, F) : 0;
+	fclose(F);
+	cJSON *json = data ? cJSON_ParseWithLength(data, size) : nullptr;
+	free(data);
+	if (!json) return false;
+
+	*preset = edit_preset_neutral();
+	cJSON *item = 0;
+	item = cJSON_GetObjectItemCaseSensitive(json, "hue"); 			if (item) preset->hue = item->valuedouble;
+	item = cJSON_GetObjectItemCaseSensitive(json, "saturation"); 	if (item) preset->saturation = item->valuedouble;
+	item = cJSON_GetObjectItemCaseSensitive(json, "contrast"); 		if (item) preset->contrast = item->valuedouble;
+	item = cJSON_GetObjectItemCaseSensitive(json, "brightness"); 	if (item) preset->brightness = item->valuedouble;
+	item = cJSON_GetObjectItemCaseSensitive(json, "gamma"); 		if (item) preset->gamma = item->valuedouble;
+	item = cJSON_GetObjectItemCaseSensitive(json, "srgb"); 			if (item) preset->srgb = cJSON_IsTrue(item);
+	item = cJSON_GetObjectItemCaseSensitive(json, "blur"); 			if (item) preset->do_blur = cJSON_IsTrue(item);
+	item = cJSON_GetObjectItemCaseSensitive(json, "blur_samples"); 	if (item) preset->blur_samples = clamp(item->valueint, 2, 64);
+	item = cJSON_GetObjectItemCaseSensitive(json, "blur_lod"); 		if (item) preset->blur_lod = clamp(item->valueint, 0, 4);
+	item = cJSON_GetObjectItemCaseSensitive(json, "blur_scale"); 	if (item) preset->blur_scale = item->valuedouble;
+	item = cJSON_GetObjectItemCaseSensitive(json, "channels");
+	if (cJSON_GetArraySize(item) == 4)
+		for (int i = 0; i < 4; i++) preset->rgba_flags[i] = cJSON_IsTrue(cJSON_GetArrayItem(item, i)) ? 1.0f : 0.0f;
+	item = cJSON_GetObjectItemCaseSensitive(json, "crop");
+	if (cJSON_GetArraySize(item) == 4) {
+		preset->crop_a = v2(cJSON_GetArrayItem(item, 0)->valuedouble, cJSON_GetArrayItem(item, 1)->valuedouble);
+		preset->crop_b = v2(cJSON_GetArrayItem(item, 2)->valuedouble, cJSON_GetArrayItem(item, 3)->valuedouble);
+	}
+	cJSON_Delete(json);
+	return true;
+}
+
+//
+// Jobs
+//
+
+// Adds 'path', or the supported images directly inside it when it is a folder.
+static void batch_add_input(Batch_Job *job, const wchar_t *path) {
+	DWORD attributes = GetFileAttributesW(path);
+	if (attributes == INVALID_FILE_ATTRIBUTES) return;
+	if (!(attributes & FILE_ATTRIBUTE_DIRECTORY)) {
+		job->inputs.push_back(_wcsdup(path));
+		return;
+	}
+	wchar_t folder[CUTE_FILES_MAX_PATH];
+	swprintf(folder, array_size(folder), L"%ls%ls", path, path[0] && path[wcslen(path) - 1] == L'\\' ? L"" : L"\\");
+	cf_dir_t dir;
+	if (!cf_dir_open(&dir, folder)) return;
+	while (dir.has_next) {
+		cf_file_t file;
+		cf_read_file(&dir, &file);
+		remove_char(file.path, '/');
+		if (!file.is_dir && check_valid_extention(file.ext) != TYPE_UNKNOWN)
+			job->inputs.push_back(_wcsdup(file.path));
+		cf_dir_next(&dir);
+	}
+	cf_dir_close(&dir);
+}
+
+// Null when out of memory.
+static Batch_Job *batch_create(const Edit_Preset *preset, const wchar_t *output_folder, Encoder_Format encoder_format,
+                               i32 quality, const Grading_LUT *lut) {
+	Batch_Job *job = (Batch_Job *)calloc(1, sizeof(Batch_Job));
+	if (!job) return nullptr;
+	job->preset = *preset;
+	job->format = encoder_format;
+	job->quality = quality;
+	job->color_manage = true;
+	swprintf(job->output_folder, array_size(job->output_folder), L"%ls", output_folder);
+	if (lut && lut->data) {
+		size_t bytes = (size_t)lut->size * lut->size * lut->size * 3 * sizeof(f32);
+		job->lut = *lut;
+		job->lut.data = (f32 *)malloc(bytes);
+		if (job->lut.data) memcpy(job->lut.data, lut->data, bytes);
+	}
+	return job;
+}
+
+static void batch_free(Batch_Job *job) {
+	for (int i = 0; i < job->inputs.Count; i++) free(job->inputs[i]);
+	job->inputs.clear();
+	for (int i = 0; i < job->outputs.Count; i++) free(job->outputs[i]);
+	job->outputs.clear();
+	free(job->lut.data);
+	free(job);
+}
+
+// Pixels of the first frame at their native depth, walloc'ed, in sRGB with 'color_manage'. Static WebP
+// goes through libwebp, everything else through WIC, the same split the viewer's loaders make.
+static u8 *batch_decode(IWICImagingFactory *factory, wchar_t *path, bool color_manage, i32 *w, i32 *h, Pixel_Format *format) {
+	wchar_t *ext = wcsrchr(path, L'.');
+	u8 *data = nullptr;
+	*format = Pixel_Rgba8;
+	if (ext && check_valid_extention(ext) == TYPE_WEBP) {
+		FILE *file = _wfopen(path, L"rb");
+		if (!file) return nullptr;
+		fseek(file, 0, SEEK_END);
+		size_t file_size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		u8 *file_data = (u8 *)malloc(file_size);
+		if (file_data) file_size = fread(file_data, 1, file_size, file);
+		fclose(file);
+		if (file_data && WebPGetInfo(file_data, file_size, w, h)) {
+			data = (u8 *)walloc((size_t)*w * *h * 4);
+			if (data && !WebPDecodeRGBAInto(file_data, file_size, data, (size_t)*w * *h * 4, *w * 4)) {
+				wfree(data);
+				data = nullptr;
+			}
+			if (data && color_manage) {
+				size_t icc_size = 0;
+				const u8 *icc = webp_icc_profile(file_data, file_size, &icc_size);
+				color_manage_pixels(icc, icc_size, data, Pixel_Rgba8, *w, *h);
+			}
+		}
+		free(file_data);
+		return data;
+	}
+
+	IWICBitmapDecoder *decoder = NULL;
+	IWICBitmapFrameDecode *frame = NULL;
+	UINT width = 0, height = 0;
+	HRESULT hr = factory->CreateDecoderFromFilename(path, NULL, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder);
+	if (SUCCEEDED(hr)) hr = decoder->GetFrame(0, &frame);
+	if (SUCCEEDED(hr)) hr = wic_decode_pixels(factory, frame, color_manage, &data, &width, &height, format);
+	if (frame) frame->Release();
+	if (decoder) decoder->Release();
+	*w = width;
+	*h = height;
+	return data;
+}
+
+// Output name: the input's name with the format's extension, in the output folder, numbered from 2 on
+// when the plain name is taken.
+static void batch_output_path(Batch_Job *job, const wchar_t *input, int number, wchar_t *out, size_t out_size) {
+	const wchar_t *name = wcsrchr(input, L'\\');
+	name = name ? name + 1 : input;
+	const wchar_t *dot = wcsrchr(name, L'.');
+	int name_len = dot ? (int)(dot - name) : (int)wcslen(name);
+	if (number > 1)
+		swprintf(out, out_size, L"%ls\\%.*ls (%d).%ls", job->output_folder, name_len, name, number, encoder_format_ext(job->format));
+	else
+		swprintf(out, out_size, L"%ls\\%.*ls.%ls", job->output_folder, name_len, name, encoder_format_ext(job->format));
+}
+
+// The full, lowercased path, equal for two spellings of the same file. Malloc'ed.
+static wchar_t *batch_path_key(const wchar_t *path) {
+	wchar_t full[CUTE_FILES_MAX_PATH];
+	DWORD length = GetFullPathNameW(path, array_size(full), full, NULL);
+	if (length == 0 || length >= array_size(full))
+		swprintf(full, array_size(full), L"%ls", path);
+	CharLowerW(full);
+	return _wcsdup(full);
+}
+
+// Index of 'key' in the sorted 'keys', or where it goes when 'found' comes back false.
+static int batch_key_search(dynarray<wchar_t *> *keys, const wchar_t *key, bool *found) {
+	int low = 0, high = keys->Count;
+	while (low < high) {
+		int middle = (low + high) / 2;
+		int order = wcscmp((*keys)[middle], key);
+		if (order == 0) {
+			*found = true;
+			return middle;
+		}
+		if (order < 0) low = middle + 1;
+		else high = middle;
+	}
+	*found = false;
+	return low;
+}
+
+static void batch_key_insert(dynarray<wchar_t *> *keys, wchar_t *key) {
+	bool found;
+	int index = batch_key_search(keys, key, &found);
+	if (found) free(key);
+	else keys->insert(keys->begin() + index, key);
+}
+
+// Picks the output of every input before the workers start, so that none of them writes over an input
+// or over another one's output. A name taken by an input or an earlier output (a.jpg and a.png both
+// make a.png) gets a number, "a (2).png". An input that would be written over itself, the output folder
+// being its own folder and the format its own, gets no output and fails.
+static void batch_assign_outputs(Batch_Job *job) {
+	dynarray<wchar_t *> taken;
+	for (int i = 0; i < job->inputs.Count; i++)
+		batch_key_insert(&taken, batch_path_key(job->inputs[i]));
+	for (int i = 0; i < job->outputs.Count; i++) free(job->outputs[i]);
+	job->outputs.reset_count();
+	for (int i = 0; i < job->inputs.Count; i++) {
+		wchar_t output[CUTE_FILES_MAX_PATH];
+		batch_output_path(job, job->inputs[i], 1, output, array_size(output));
+		wchar_t *input_key = batch_path_key(job->inputs[i]);
+		wchar_t *key = batch_path_key(output);
+		bool overwrites_input = wcscmp(key, input_key) == 0;
+		free(input_key);
+		if (overwrites_input) {
+			free(key);
+			job->outputs.push_back(nullptr);
+			continue;
+		}
+		for (int number = 2;; number++) {
+			bool found;
+			batch_key_search(&taken, key, &found);
+			if (!found) break;
+			free(key);
+			batch_output_path(job, job->inputs[i], number, output, array_size(output));
+			key = batch_path_key(output);
+		}
+		batch_key_insert(&taken, key);
+		job->outputs.push_back(_wcsdup(output));
+	}
+	for (int i = 0; i < taken.Count; i++) free(taken[i]);
+	taken.clear();
+}
+
+static bool batch_process_file(Batch_Job *job, IWICImagingFactory *factory, wchar_t *input, wchar_t *output) {
+	i32 w = 0, h = 0;
+	Pixel_Format format;
+	u8 *src = batch_decode(factory, input, job->color_manage, &w, &h, &format);
+	if (!src || w <= 0 || h <= 0) {
+		if (src) wfree(src);
+		return false;
+	}
+	Shader_Constants_Main constants = edit_preset_constants(&job->preset, w, h);
+	HRESULT hr = export_image_cpu(job->format, output, &constants, src, format, w, h, &job->lut, job->quality);
+	wfree(src);
+	return SUCCEEDED(hr);
+}
+
+static DWORD WINAPI batch_worker(LPVOID param) {
+	Batch_Job *job = (Batch_Job *)param;
+	parallel_serial = true; // the other workers already occupy the remaining cores
+	CoInitialize(NULL);
+	IWICImagingFactory *factory = 0;
+	CoCreateInstance(CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER, IID_IWICImagingFactory, (LPVOID*)&factory);
+	for (;;) {
+		LONG i = InterlockedIncrement(&job->next) - 1;
+		if (i >= job->inputs.Count || job->cancel) break;
+		wchar_t *output = job->outputs[i];
+		bool ok = factory && output && batch_process_file(job, factory, job->inputs[i], output);
+		InterlockedIncrement(ok ? &job->done : &job->failed);
+		if (job->verbose) {
+			if (!output)
+				printf("FAILED %ls: the output would overwrite it\n", job->inputs[i]);
+			else
+				printf("%s %ls -> %ls\n", ok ? "saved " : "FAILED", job->inputs[i], output);
+		}
+		if (job->wake) SetEvent(job->wake);
+	}
+	if (factory) factory->Release();
+	CoUninitialize();
+	return 0;
+}
+
+// Processes all inputs and returns when they're done.
+static void batch_run(Batch_Job *job) {
+	batch_assign_outputs(job);
+	u32 workers = min(parallel_worker_count(), (u32)max(job->inputs.Count, 1));
+	HANDLE threads[PARALLEL_MAX_WORKERS];
+	u32 started = 0;
+	for (u32 i = 1; i < workers; i++) {
+		threads[started] = CreateThread(NULL, 0, batch_worker, job, 0, NULL);
+		if (threads[started]) started++;
+	}
+	batch_worker(job);
+	if (started) {
+		WaitForMultipleObjects(started, threads, TRUE, INFINITE);
+		for (u32 i = 0; i < started; i++) CloseHandle(threads[i]);
+	}
+	parallel_serial = false;
+	job->finished = true;
+	if (job->wake) SetEvent(job->wake);
+}
+
+static DWORD WINAPI batch_thread(LPVOID param) {
+	batch_run((Batch_Job *)param);
+	return 0;
+}
+
+// Runs 'job' in the background, progress is in job->done / job->failed.
+static bool batch_start_async(Batch_Job *job) {
+	HANDLE thread = CreateThread(NULL, 0, batch_thread, job, 0, NULL);
+	if (thread) CloseHandle(thread);
+	return thread != 0;
+}
+
+//
+// Command line: CactusViewer.exe --batch <preset.json> --out <folder> [--format png] [--quality 90] [--lut file.cube]
+//               [--no-color-management] <files or folders>...
+//
+
+static int batch_main(int argc, wchar_t **argv) {
+	const wchar_t *preset_path = nullptr;
+	const wchar_t *output_folder = nullptr;
+	const wchar_t *lut_path = nullptr;
+	Encoder_Format encoder_format = Format_Png;
+	i32 quality = 90;
+	bool color_manage = true;
+	int first_input = argc;
+	for (int i = 0; i < argc; i++) {
+		if (wcscmp(argv[i], L"--out") == 0 && i + 1 < argc) {
+			output_folder = argv[++i];
+		} else if (wcscmp(argv[i], L"--format") == 0 && i + 1 < argc) {
+			if (!encoder_format_from_name(argv[++i], &encoder_format)) {
+				fprintf(stderr, "Unknown format '%ls' (bmp, png, jpg, tiff, dds, heif, webp, webp-lossless).\n", argv[i]);
+				return 2;
+			}
+		} else if (wcscmp(argv[i], L"--quality") == 0 && i + 1 < argc) {
+			quality = clamp(_wtoi(argv[++i]), 1, 100);
+		} else if (wcscmp(argv[i], L"--lut") == 0 && i + 1 < argc) {
+			lut_path = argv[++i];
+		} else if (wcscmp(argv[i], L"--no-color-management") == 0) {
+			color_manage = false;
+		} else if (!preset_path) {
+			preset_path = argv[i];
+		} else {
+			first_input = i;
+			break;
+		}
+	}
+	if (!preset_path || !output_folder || first_input >= argc) {
+		fprintf(stderr, "usage: CactusViewer --batch <preset.json> --out <folder> [--format png] [--quality 90] [--lut file.cube] [--no-color-management] <files or folders>...\n");
+		return 2;
+	}
+
+	Edit_Preset preset;
+	if (!edit_preset_load(&preset, preset_path)) {
+		fprintf(stderr, "Failed to read preset '%ls'.\n", preset_path);
+		return 1;
+	}
+	Grading_LUT lut = {};
+	if (lut_path) {
+		FILE *file = _wfopen(lut_path, L"rb");
+		char *text = nullptr;
+		if (file) {
+			fseek(file, 0, SEEK_END);
+			long size = ftell(file);
+			fseek(file, 0, SEEK_SET);
+			text = size > 0 ? (char *)malloc(size + 1) : nullptr;
+			if (text) text[fread(text, 1, size, file)] = 0;
+			fclose(file);
+		}
+		char error[128] = "Failed to read the file.";
+		if (!text || !cube_lut_parse(text, &lut, error, sizeof(error))) {
+			fprintf(stderr, "Invalid LUT '%ls': %s\n", lut_path, error);
+			free(text);
+			return 1;
+		}
+		free(text);
+	}
+	CreateDirectoryW(output_folder, NULL);
+
+	Batch_Job *job = batch_create(&preset, output_folder, encoder_format, quality, &lut);
+	if (!job) return 1;
+	job->color_manage = color_manage;
+	for (int i = first_input; i < argc; i++)
+		batch_add_input(job, argv[i]);
+	job->verbose = true;
+	f64 start = get_time();
+	batch_run(job);
+	printf("%ld saved, %ld failed in %.2fs\n", job->done, job->failed, get_time() - start);
+	int result = job->failed ? 1 : 0;
+	batch_free(job);
+	free(lut.data);
+	return result;
+}
@@ -0,0 +1,189 @@
+// Copying images to the clipboard. The image is written exactly once, as a bottom-up 32 bpp CF_DIBV5
+// (BGRA, straight alpha), straight into the memory the clipboard will own; Windows synthesizes CF_DIB
+// and CF_BITMAP from it for programs that ask for those. The transport sits behind Clipboard, so the
+// payload code runs the same against something other than the system clipboard.
+
+#define CLIPBOARD_BAND_ROWS 256
+
+enum Clipboard_Format {
+	Clipboard_Format_Dib_V5,
+};
+
+struct Clipboard {
+	// Writable memory of 'size' bytes for one payload, null on failure. Unless null, exactly one of
+	// commit and abort follows.
+	u8 *(*begin)(Clipboard *clipboard, Clipboard_Format format, size_t size);
+	bool (*commit)(Clipboard *clipboard);
+	void (*abort)(Clipboard *clipboard);
+	void *state;
+};
+
+//
+// System clipboard
+//
+
+struct Clipboard_Win32_State {
+	HGLOBAL memory;
+	Clipboard_Format format;
+};
+
+static u8 *clipboard_win32_begin(Clipboard *clipboard, Clipboard_Format format, size_t size) {
+	Clipboard_Win32_State *state = (Clipboard_Win32_State *)clipboard->state;
+	state->format = format;
+	state->memory = GlobalAlloc(GMEM_MOVEABLE, size);
+	if (!state->memory) return nullptr;
+	u8 *data = (u8 *)GlobalLock(state->memory);
+	if (!data) {
+		GlobalFree(state->memory);
+		state->memory = 0;
+	}
+	return data;
+}
+
+static bool clipboard_win32_commit(Clipboard *clipboard) {
+	Clipboard_Win32_State *state = (Clipboard_Win32_State *)clipboard->state;
+	UINT format = 0;
+	switch (state->format) {
+		case Clipboard_Format_Dib_V5: format = CF_DIBV5; break;
+	}
+	GlobalUnlock(state->memory);
+	bool ok = false;
+	if (OpenClipboard(NULL)) {
+		EmptyClipboard();
+		ok = SetClipboardData(format, state->memory) != NULL; // owned by the clipboard from here on
+		CloseClipboard();
+	}
+	if (!ok) GlobalFree(state->memory);
+	state->memory = 0;
+	return ok;
+}
+
+static void clipboard_win32_abort(Clipboard *clipboard) {
+	Clipboard_Win32_State *state = (Clipboard_Win32_State *)clipboard->state;
+	GlobalUnlock(state->memory);
+	GlobalFree(state->memory);
+	state->memory = 0;
+}
+
+static Clipboard clipboard_win32() {
+	static Clipboard_Win32_State state;
+	Clipboard result = { clipboard_win32_begin, clipboard_win32_commit, clipboard_win32_abort, &state };
+	return result;
+}
+
+//
+// Memory clipboard
+//
+
+// Keeps the last committed payload instead of handing it to Windows, so tests can look at exactly what
+// would have been copied. Free it with clipboard_memory_free.
+struct Clipboard_Memory_State {
+	u8 *data;				// the committed payload, null until a commit
+	size_t size;
+	Clipboard_Format format;
+	u8 *pending;			// between begin and commit/abort
+	size_t pending_size;
+	Clipboard_Format pending_format;
+};
+
+static u8 *clipboard_memory_begin(Clipboard *clipboard, Clipboard_Format format, size_t size) {
+	Clipboard_Memory_State *state = (Clipboard_Memory_State *)clipboard->state;
+	state->pending = (u8 *)malloc(size);
+	state->pending_size = size;
+	state->pending_format = format;
+	return state->pending;
+}
+
+static bool clipboard_memory_commit(Clipboard *clipboard) {
+	Clipboard_Memory_State *state = (Clipboard_Memory_State *)clipboard->state;
+	free(state->data); // like EmptyClipboard, the previous payload goes
+	state->data = state->pending;
+	state->size = state->pending_size;
+	state->format = state->pending_format;
+	state->pending = nullptr;
+	return true;
+}
+
+static void clipboard_memory_abort(Clipboard *clipboard) {
+	Clipboard_Memory_State *state = (Clipboard_Memory_State *)clipboard->state;
+	free(state->pending);
+	state->pending = nullptr;
+}
+
+static Clipboard clipboard_memory(Clipboard_Memory_State *state) {
+	*state = {};
+	Clipboard result = { clipboard_memory_begin, clipboard_memory_commit, clipboard_memory_abort, state };
+	return result;
+}
+
+static void clipboard_memory_free(Clipboard_Memory_State *state) {
+	free(state->data);
+	free(state->pending);
+	*state = {};
+}
+
+//
+// Image payloads
+//
+
+// Starts a w*h CF_DIBV5 and returns the first byte of its pixels, the bottom row.
+static u8 *clipboard_begin_dib(Clipboard *clipboard, i32 w, i32 h) {
+	size_t image_size = (size_t)w * h * 4;
+	if (w <= 0 || h <= 0 || image_size > 0xFFFFFFFF - sizeof(BITMAPV5HEADER)) // bV5SizeImage is a DWORD
+		return nullptr;
+	u8 *payload = clipboard->begin(clipboard, Clipboard_Format_Dib_V5, sizeof(BITMAPV5HEADER) + image_size);
+	if (!payload) return nullptr;
+	BITMAPV5HEADER *header = (BITMAPV5HEADER *)payload;
+	memset(header, 0, sizeof(*header));
+	header->bV5Size = sizeof(BITMAPV5HEADER);
+	header->bV5Width = w;
+	header->bV5Height = h; // bottom-up, top-down DIBs aren't understood by every program
+	header->bV5Planes = 1;
+	header->bV5BitCount = 32;
+	header->bV5Compression = BI_BITFIELDS;
+	header->bV5SizeImage = (DWORD)image_size;
+	header->bV5RedMask   = 0x00FF0000;
+	header->bV5GreenMask = 0x0000FF00;
+	header->bV5BlueMask  = 0x000000FF;
+	header->bV5AlphaMask = 0xFF000000;
+	header->bV5CSType = LCS_sRGB;
+	header->bV5Intent = LCS_GM_IMAGES;
+	return payload + sizeof(BITMAPV5HEADER);
+}
+
+// BGRA rows 'stride' bytes apart, e.g. a mapped staging texture.
+static bool copy_image_bgra(Clipboard *clipboard, const u8 *data, size_t stride, i32 w, i32 h) {
+	u8 *pixels = clipboard_begin_dib(clipboard, w, h);
+	if (!pixels) return false;
+	for (i32 y = 0; y < h; y++)
+		memcpy(pixels + (size_t)(h - 1 - y) * w * 4, data + (size_t)y * stride, (size_t)w * 4);
+	return clipboard->commit(clipboard);
+}
+
+// The clipboard counterpart of export_image_cpu: the CPU pipeline renders CLIPBOARD_BAND_ROWS rows at a
+// time into a small buffer, which is flipped into the DIB. Besides the payload and that band nothing
+// image sized is allocated.
+static bool copy_image_cpu(Clipboard *clipboard, const Shader_Constants_Main *constants,
+                           u8 *src, Pixel_Format src_format, i32 w, i32 h, const Grading_LUT *grading) {
+	i32 width = (i32)(constants->crop_b.x - constants->crop_a.x);
+	i32 height = (i32)(constants->crop_b.y - constants->crop_a.y);
+	size_t stride = (size_t)width * 4;
+	Cpu_Pipeline pipeline;
+	if (!cpu_pipeline_begin(&pipeline, constants, src, src_format, w, h, width, height, Pixel_Rgba8, true, grading))
+		return false;
+	u8 *band = (u8 *)malloc(stride * CLIPBOARD_BAND_ROWS);
+	u8 *pixels = band ? clipboard_begin_dib(clipboard, width, height) : nullptr;
+	bool ok = false;
+	if (pixels) {
+		for (i32 y = 0; y < height; y += CLIPBOARD_BAND_ROWS) {
+			i32 rows = min(CLIPBOARD_BAND_ROWS, height - y);
+			cpu_pipeline_rows(&pipeline, y, rows, band, stride);
+			for (i32 j = 0; j < rows; j++)
+				memcpy(pixels + (size_t)(height - 1 - y - j) * stride, band + j * stride, stride);
+		}
+		ok = clipboard->commit(clipboard);
+	}
+	free(band);
+	cpu_pipeline_end(&pipeline);
+	return ok;
+}
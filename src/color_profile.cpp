@@ -0,0 +1,325 @@
+// Color management of decoded images. Embedded ICC profiles (handed out by WIC as color contexts,
+// which covers JPEG APP2 and PNG iCCP among others, and the ICCP chunk of WebP) are turned into a
+// Color_Transform to sRGB, the space the shaders, the CPU pipeline and the encoders all assume.
+// Matrix/TRC profiles, RGB and gray, are understood: that is what cameras and editors embed for RGB
+// images. Anything else (LUT based profiles, CMYK) leaves the pixels alone, as before.
+//
+// A transform is three input curves as tables, one 3x3 matrix and an output table, so applying it
+// costs a few lookups and a matrix multiply per pixel. Built transforms are cached by profile, a
+// folder of images from one camera parses its profile once.
+
+#define ICC_CURVE_SIZE 4096 // intervals of the curve tables, which are lerped
+#define COLOR_PROFILE_CACHE_SIZE 16
+
+struct Color_Transform {
+	f32 curves[3][ICC_CURVE_SIZE + 1]; // encoded -> linear per channel, uniform over [0, 1]
+	f32 curves8[3][256];               // the same for 8-bit values, without lerp
+	f32 matrix[3][4];                  // columns: linear source R, G, B in linear sRGB, padded for SSE
+	f32 srgb[ICC_CURVE_SIZE + 1];      // linear -> sRGB encoded, indexed by sqrt(x) like cpu_color_curve
+};
+
+//
+// ICC parsing
+//
+
+static u32 icc_u32(const u8 *p) { return (u32)p[0] << 24 | (u32)p[1] << 16 | (u32)p[2] << 8 | p[3]; }
+static u16 icc_u16(const u8 *p) { return (u16)(p[0] << 8 | p[1]); }
+static f32 icc_s15f16(const u8 *p) { return (i32)icc_u32(p) / 65536.0f; }
+
+// Type and data of tag 'sig', or null if the profile doesn't have it or it runs past the end.
+static const u8 *icc_find_tag(const u8 *icc, u32 size, const char *sig, u32 *tag_size) {
+	u32 count = icc_u32(icc + 128);
+	if (count > (size - 132) / 12) return nullptr;
+	for (u32 i = 0; i < count; i++) {
+		const u8 *entry = icc + 132 + i * 12;
+		if (memcmp(entry, sig, 4) != 0) continue;
+		u32 offset = icc_u32(entry + 4);
+		*tag_size = icc_u32(entry + 8);
+		if (offset > size || *tag_size > size - offset || *tag_size < 8) return nullptr;
+		return icc + offset;
+	}
+	return nullptr;
+}
+
+static bool icc_read_xyz(const u8 *icc, u32 size, const char *sig, v3 *xyz) {
+	u32 tag_size;
+	const u8 *tag = icc_find_tag(icc, size, sig, &tag_size);
+	if (!tag || tag_size < 20 || memcmp(tag, "XYZ ", 4) != 0) return false;
+	*xyz = v3(icc_s15f16(tag + 8), icc_s15f16(tag + 12), icc_s15f16(tag + 16));
+	return true;
+}
+
+// 'curv' (identity, gamma or table) or 'para' (the five parametric function types) into 'table',
+// ICC_CURVE_SIZE + 1 samples over [0, 1].
+static bool icc_read_curve(const u8 *icc, u32 size, const char *sig, f32 *table) {
+	u32 tag_size;
+	const u8 *tag = icc_find_tag(icc, size, sig, &tag_size);
+	if (!tag || tag_size < 12) return false;
+	if (memcmp(tag, "curv", 4) == 0) {
+		u32 count = icc_u32(tag + 8);
+		if (count > (tag_size - 12) / 2) return false;
+		for (int i = 0; i <= ICC_CURVE_SIZE; i++) {
+			f32 x = (f32)i / ICC_CURVE_SIZE;
+			if (count == 0) {
+				table[i] = x;
+			} else if (count == 1) {
+				table[i] = powf(x, icc_u16(tag + 12) / 256.0f);
+			} else {
+				f32 pos = x * (count - 1);
+				u32 j = min((u32)pos, count - 2);
+				f32 a = icc_u16(tag + 12 + j * 2) / 65535.0f;
+				f32 b = icc_u16(tag + 12 + j * 2 + 2) / 65535.0f;
+				table[i] = lerp(a, b, pos - j);
+			}
+		}
+		return true;
+	}
+	if (memcmp(tag, "para", 4) == 0) {
+		static const int param_counts[] = { 1, 3, 4, 5, 7 };
+		u16 type = icc_u16(tag + 8);
+		if (type > 4 || tag_size < 12 + param_counts[type] * 4u) return false;
+		f32 p[7] = { 1, 1, 0, 0, 0, 0, 0 }; // g a b c d e f
+		for (int k = 0; k < param_counts[type]; k++) p[k] = icc_s15f16(tag + 12 + k * 4);
+		f32 g = p[0], a = p[1], b = p[2], c = p[3], d = p[4], e = p[5], f = p[6];
+		for (int i = 0; i <= ICC_CURVE_SIZE; i++) {
+			f32 x = (f32)i / ICC_CURVE_SIZE;
+			f32 y;
+			switch (type) {
+				case 0:  y = powf(x, g); break;
+				case 1:  y = a * x + b >= 0 ? powf(a * x + b, g) : 0; break;
+				case 2:  y = a * x + b >= 0 ? powf(a * x + b, g) + c : c; break;
+				case 3:  y = x >= d ? powf(max(a * x + b, 0.0f), g) : c * x; break;
+				default: y = x >= d ? powf(max(a * x + b, 0.0f), g) + e : c * x + f; break;
+			}
+			table[i] = y;
+		}
+		return true;
+	}
+	return false;
+}
+
+static inline f32 icc_curve_lookup(const f32 *table, f32 x) {
+	f32 pos = clamp(x, 0.0f, 1.0f) * ICC_CURVE_SIZE;
+	i32 i = min((i32)pos, ICC_CURVE_SIZE - 1);
+	return lerp(table[i], table[i + 1], pos - i);
+}
+
+// Builds the transform of an ICC profile to sRGB. False if the profile isn't one we can use, or if it
+// is sRGB already (close enough that 8-bit values would hardly change), nothing to do then.
+static bool color_transform_build(const u8 *icc, u32 size, Color_Transform *t) {
+	if (size < 132 || icc_u32(icc) > size || memcmp(icc + 36, "acsp", 4) != 0 || memcmp(icc + 20, "XYZ ", 4) != 0)
+		return false;
+	size = icc_u32(icc);
+
+	// XYZ (D50, which matrix/TRC profiles are adapted to) -> linear sRGB, Bradford adapted
+	static const f32 xyz_to_srgb[3][3] = {
+		{  3.1338561f, -1.6168667f, -0.4906146f },
+		{ -0.9787684f,  1.9161415f,  0.0334540f },
+		{  0.0719453f, -0.2289914f,  1.4052427f },
+	};
+	memset(t->matrix, 0, sizeof(t->matrix));
+	if (memcmp(icc + 16, "RGB ", 4) == 0) {
+		v3 columns[3];
+		if (!icc_read_xyz(icc, size, "rXYZ", &columns[0]) || !icc_read_xyz(icc, size, "gXYZ", &columns[1]) ||
+		    !icc_read_xyz(icc, size, "bXYZ", &columns[2]))
+			return false;
+		if (!icc_read_curve(icc, size, "rTRC", t->curves[0]) || !icc_read_curve(icc, size, "gTRC", t->curves[1]) ||
+		    !icc_read_curve(icc, size, "bTRC", t->curves[2]))
+			return false;
+		for (int col = 0; col < 3; col++)
+			for (int row = 0; row < 3; row++)
+				t->matrix[col][row] = xyz_to_srgb[row][0] * columns[col].x + xyz_to_srgb[row][1] * columns[col].y +
+				                      xyz_to_srgb[row][2] * columns[col].z;
+	} else if (memcmp(icc + 16, "GRAY", 4) == 0) {
+		// gray is neutral whatever the primaries, only the tone curve applies
+		if (!icc_read_curve(icc, size, "kTRC", t->curves[0])) return false;
+		memcpy(t->curves[1], t->curves[0], sizeof(t->curves[0]));
+		memcpy(t->curves[2], t->curves[0], sizeof(t->curves[0]));
+		for (int k = 0; k < 3; k++) t->matrix[k][k] = 1;
+	} else {
+		return false;
+	}
+
+	f32 error = 0;
+	for (int col = 0; col < 3; col++)
+		for (int row = 0; row < 3; row++)
+			error = max(error, fabsf(t->matrix[col][row] - (col == row ? 1.0f : 0.0f)));
+	for (int c = 0; c < 3; c++)
+		for (int i = 0; i <= ICC_CURVE_SIZE; i++)
+			error = max(error, fabsf(t->curves[c][i] - cpu_to_linear((f32)i / ICC_CURVE_SIZE)));
+	if (error < 0.002f) return false;
+
+	for (int c = 0; c < 3; c++)
+		for (int v = 0; v < 256; v++)
+			t->curves8[c][v] = icc_curve_lookup(t->curves[c], v / 255.0f);
+	for (int i = 0; i <= ICC_CURVE_SIZE; i++) {
+		f32 x = (f32)i / ICC_CURVE_SIZE;
+		t->srgb[i] = cpu_to_srgb(x * x);
+	}
+	return true;
+}
+
+//
+// Cache
+//
+
+struct Color_Profile_Cache_Entry {
+	u64 hash;
+	u32 size;
+	Color_Transform *transform; // null for profiles that need no transform
+};
+
+static SRWLOCK color_profile_lock = SRWLOCK_INIT;
+static Color_Profile_Cache_Entry color_profile_cache[COLOR_PROFILE_CACHE_SIZE];
+static u32 color_profile_cache_next;
+
+// Fills 't' with the transform of profile 'icc' to sRGB. False if the pixels should be left alone.
+static bool color_transform_for_profile(const u8 *icc, size_t size, Color_Transform *t) {
+	if (!icc || size < 132 || size > 0xFFFFFFFF) return false;
+	u64 hash = 14695981039346656037ull; // FNV-1a
+	for (size_t i = 0; i < size; i++) hash = (hash ^ icc[i]) * 1099511628211ull;
+
+	AcquireSRWLockShared(&color_profile_lock);
+	for (int i = 0; i < COLOR_PROFILE_CACHE_SIZE; i++) {
+		Color_Profile_Cache_Entry *entry = &color_profile_cache[i];
+		if (entry->size == size && entry->hash == hash) {
+			bool found = entry->transform != nullptr;
+			if (found) memcpy(t, entry->transform, sizeof(*t));
+			ReleaseSRWLockShared(&color_profile_lock);
+			return found;
+		}
+	}
+	ReleaseSRWLockShared(&color_profile_lock);
+
+	bool ok = color_transform_build(icc, (u32)size, t);
+	Color_Transform *copy = ok ? (Color_Transform *)malloc(sizeof(Color_Transform)) : nullptr;
+	if (copy) memcpy(copy, t, sizeof(*t));
+	if (!ok || copy) {
+		AcquireSRWLockExclusive(&color_profile_lock);
+		Color_Profile_Cache_Entry *entry = &color_profile_cache[color_profile_cache_next++ % COLOR_PROFILE_CACHE_SIZE];
+		free(entry->transform);
+		*entry = { hash, (u32)size, copy };
+		ReleaseSRWLockExclusive(&color_profile_lock);
+	}
+	return ok;
+}
+
+//
+// Applying
+//
+
+struct Color_Transform_Data {
+	const Color_Transform *t;
+	u8 *data;
+	Pixel_Format format;
+	i32 w;
+};
+
+static void color_transform_kernel(void *user, u32 begin, u32 end, u32 worker) {
+	Color_Transform_Data *cd = (Color_Transform_Data *)user;
+	const Color_Transform *t = cd->t;
+	__m128 col0 = _mm_loadu_ps(t->matrix[0]);
+	__m128 col1 = _mm_loadu_ps(t->matrix[1]);
+	__m128 col2 = _mm_loadu_ps(t->matrix[2]);
+	f32 scale = (f32)ICC_CURVE_SIZE;
+	for (u32 y = begin; y < end; y++) {
+		u8 *row = cd->data + (size_t)y * cd->w * pixel_format_size(cd->format);
+		for (i32 x = 0; x < cd->w; x++) {
+			f32 r, g, b;
+			if (cd->format == Pixel_Rgba8) {
+				u8 *px = row + x * 4;
+				r = t->curves8[0][px[0]];
+				g = t->curves8[1][px[1]];
+				b = t->curves8[2][px[2]];
+			} else {
+				u16 *px = (u16 *)row + x * 4;
+				r = icc_curve_lookup(t->curves[0], px[0] * (1.0f / 65535.0f));
+				g = icc_curve_lookup(t->curves[1], px[1] * (1.0f / 65535.0f));
+				b = icc_curve_lookup(t->curves[2], px[2] * (1.0f / 65535.0f));
+			}
+			__m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(col0, _mm_set1_ps(r)), _mm_mul_ps(col1, _mm_set1_ps(g))),
+			                      _mm_mul_ps(col2, _mm_set1_ps(b)));
+			// clip what is out of the sRGB gamut, then encode through the sqrt indexed table
+			v = _mm_sqrt_ps(_mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f)));
+			f32 c[4];
+			_mm_storeu_ps(c, _mm_mul_ps(v, _mm_set1_ps(scale)));
+			for (int k = 0; k < 3; k++) {
+				i32 i = min((i32)c[k], ICC_CURVE_SIZE - 1);
+				c[k] = lerp(t->srgb[i], t->srgb[i + 1], c[k] - i);
+			}
+			if (cd->format == Pixel_Rgba8) {
+				u8 *px = row + x * 4;
+				for (int k = 0; k < 3; k++) px[k] = cpu_unorm8(c[k]);
+			} else {
+				u16 *px = (u16 *)row + x * 4;
+				for (int k = 0; k < 3; k++) px[k] = cpu_unorm16(c[k]);
+			}
+		}
+	}
+}
+
+// Converts 'data' in place, alpha untouched. Float pixels are left alone: WIC hands those out linear
+// already, and float sources rarely carry a profile.
+static void color_transform_apply(const Color_Transform *t, u8 *data, Pixel_Format format, i32 w, i32 h) {
+	if (format == Pixel_Rgba32f) return;
+	Color_Transform_Data cd = { t, data, format, w };
+	parallel_for(h, CPU_BAND_ROWS, color_transform_kernel, &cd);
+}
+
+// Converts 'data' in place to sRGB if 'icc' describes another space.
+static void color_manage_pixels(const u8 *icc, size_t icc_size, u8 *data, Pixel_Format format, i32 w, i32 h) {
+	if (!icc || !data) return;
+	Color_Transform *t = (Color_Transform *)malloc(sizeof(Color_Transform));
+	if (t && color_transform_for_profile(icc, icc_size, t))
+		color_transform_apply(t, data, format, w, h);
+	free(t);
+}
+
+//
+// Sources of profiles
+//
+
+// The ICC profile of a WebP file, if it has one; it points into 'file'.
+static const u8 *webp_icc_profile(const u8 *file, size_t file_size, size_t *icc_size) {
+	WebPData webp_data = { file, file_size };
+	WebPDemuxer *demux = WebPDemux(&webp_data);
+	const u8 *result = nullptr;
+	if (demux) {
+		WebPChunkIterator iter;
+		if ((WebPDemuxGetI(demux, WEBP_FF_FORMAT_FLAGS) & ICCP_FLAG) && WebPDemuxGetChunk(demux, "ICCP", 1, &iter)) {
+			result = iter.chunk.bytes;
+			*icc_size = iter.chunk.size;
+			WebPDemuxReleaseChunkIterator(&iter);
+		}
+		WebPDemuxDelete(demux);
+	}
+	return result;
+}
+
+// The first ICC profile among the color contexts of a WIC frame, malloc'ed; null if there is none.
+static u8 *wic_icc_profile(IWICImagingFactory *factory, IWICBitmapFrameDecode *frame, size_t *icc_size) {
+	IWICColorContext *contexts[4] = {};
+	UINT count = 0;
+	u8 *result = nullptr;
+	if (FAILED(frame->GetColorContexts(0, NULL, &count)) || count == 0) return nullptr;
+	count = min(count, (UINT)array_size(contexts));
+	UINT created = 0;
+	while (created < count && SUCCEEDED(factory->CreateColorContext(&contexts[created]))) created++;
+	UINT actual = 0;
+	if (created == count && SUCCEEDED(frame->GetColorContexts(count, contexts, &actual))) {
+		for (UINT i = 0; i < actual && !result; i++) {
+			WICColorContextType type;
+			UINT size = 0;
+			if (FAILED(contexts[i]->GetType(&type)) || type != WICColorContextProfile) continue;
+			if (FAILED(contexts[i]->GetProfileBytes(0, NULL, &size)) || size == 0) continue;
+			result = (u8 *)malloc(size);
+			if (result && FAILED(contexts[i]->GetProfileBytes(size, result, &size))) {
+				free(result);
+				result = nullptr;
+			}
+			*icc_size = size;
+		}
+	}
+	for (UINT i = 0; i < created; i++) contexts[i]->Release();
+	return result;
+}
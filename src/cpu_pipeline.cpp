@@ -0,0 +1,942 @@
+#include <immintrin.h>
+
+// CPU reference of the pixel pipeline in shaders.hlsl (shader_text_main). The functions mirror their
+// HLSL counterparts one to one, including the early outs, so results match what the viewer shows.
+// Keep the two in sync when changing either side.
+
+static inline f32 cpu_to_linear(f32 x) {
+	// lerp(pow(...), x / 12.92, step(x, 0.04045))
+	if (x <= 0.04045f) return x / 12.92f;
+	return powf((fabsf(x) + 0.055f) / 1.055f, 2.4f);
+}
+
+static inline f32 cpu_alpha_to_linear(f32 alpha) {
+	return 1.0f - (1.0f - alpha) * (1.0f - alpha);
+}
+
+// Inverse of cpu_to_linear, continued past 1 for HDR values.
+static inline f32 cpu_to_srgb(f32 x) {
+	if (x <= 0.0031308f) return x * 12.92f;
+	return 1.055f * powf(x, 1.0f / 2.4f) - 0.055f;
+}
+
+static inline i32 pixel_format_size(Pixel_Format format) {
+	switch (format) {
+		case Pixel_Rgba16:	return 8;
+		case Pixel_Rgba32f:	return 16;
+		default:			return 4;
+	}
+}
+
+static void srgb_encode_kernel(void *user, u32 begin, u32 end, u32 worker) {
+	f32 *data = (f32 *)user;
+	for (u32 i = begin; i < end; i++)
+		for (int c = 0; c < 3; c++) data[i * 4 + c] = cpu_to_srgb(data[i * 4 + c]);
+}
+
+// Float decoders hand out linear values; everything else, and the pipeline, works on sRGB encoded
+// ones. Converts RGBA32F pixels in place, alpha untouched.
+static void srgb_encode_pixels(f32 *data, i32 w, i32 h) {
+	parallel_for((u32)w * h, 1 << 16, srgb_encode_kernel, data);
+}
+
+#define COLOR_CURVE_SIZE 4096
+
+struct Color_Params {
+	v4 rgba_flags;
+	f32 hue;
+	f32 saturation;
+	f32 contrast;
+	f32 brightness;
+	f32 gamma;
+	i32 srgb;
+	f32 hue_rotation[3][3]; // adjust_hue's matrix, built once instead of per pixel
+
+	// baked form, see color_params_bake
+	f32 affine[3][4];
+	f32 curve_scale;
+	f32 curve[COLOR_CURVE_SIZE];
+};
+
+// a = m * a, for 3x4 affine maps (the fourth column is the offset)
+static void color_affine_apply(f32 a[3][4], const f32 m[3][4]) {
+	f32 r[3][4];
+	for (int j = 0; j < 3; j++) {
+		for (int i = 0; i < 4; i++)
+			r[j][i] = m[j][0] * a[0][i] + m[j][1] * a[1][i] + m[j][2] * a[2][i];
+		r[j][3] += m[j][3];
+	}
+	memcpy(a, r, sizeof(r));
+}
+
+// modify_color factors into an affine map (hue rotation, saturation, contrast and brightness are all
+// linear plus an offset) followed by one curve per channel: pow(abs(x), 1 / gamma), then to_linear
+// with srgb on. The map is baked into a 3x4 matrix and the curve into a table indexed by sqrt(|x|),
+// which keeps the steep start of pow accurate under linear interpolation. Valid for inputs in
+// [0, 1], i.e. texels after the RGBA flags.
+static void color_params_bake(Color_Params *p) {
+	f32 a[3][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 } };
+	if (p->hue != 0) {
+		f32 m[3][4] = {};
+		for (int j = 0; j < 3; j++)
+			for (int i = 0; i < 3; i++) m[j][i] = p->hue_rotation[i][j];
+		color_affine_apply(a, m);
+	}
+	if (p->saturation != 1) {
+		const f32 luminance[3] = { 0.2125f, 0.7154f, 0.0721f };
+		f32 m[3][4] = {};
+		for (int j = 0; j < 3; j++)
+			for (int i = 0; i < 3; i++) m[j][i] = (1 - p->saturation) * luminance[i] + (i == j ? p->saturation : 0);
+		color_affine_apply(a, m);
+	}
+	if (p->contrast != 1) {
+		f32 m[3][4] = {};
+		for (int j = 0; j < 3; j++) { m[j][j] = p->contrast; m[j][3] = 0.5f * (1 - p->contrast); }
+		color_affine_apply(a, m);
+	}
+	if (p->brightness != 0) {
+		for (int j = 0; j < 3; j++) a[j][3] += p->brightness;
+	}
+	memcpy(p->affine, a, sizeof(a));
+
+	f32 bound = 0;
+	for (int j = 0; j < 3; j++)
+		bound = max(bound, fabsf(a[j][0]) + fabsf(a[j][1]) + fabsf(a[j][2]) + fabsf(a[j][3]));
+	f32 s_max = sqrtf(max(bound, 1e-12f));
+	p->curve_scale = (COLOR_CURVE_SIZE - 1) / s_max;
+	for (int k = 0; k < COLOR_CURVE_SIZE; k++) {
+		f32 s = (f32)k / p->curve_scale;
+		f32 y = p->gamma == 0 ? 1.0f : powf(s * s, 1.0f / p->gamma);
+		p->curve[k] = p->srgb == 1 ? cpu_to_linear(y) : y;
+	}
+}
+
+static Color_Params color_params_from_constants(const Shader_Constants_Main *constants) {
+	Color_Params p = {};
+	p.rgba_flags = constants->rgba_flags;
+	p.hue = constants->hue;
+	p.saturation = constants->saturation;
+	p.contrast = constants->contrast;
+	p.brightness = constants->brightness;
+	p.gamma = constants->gamma;
+	p.srgb = constants->srgb;
+
+	const f32 k = 0.57735f; //normalized axis for RGB
+	f32 cos_angle = cosf(p.hue);
+	f32 sin_angle = sinf(p.hue);
+	f32 t = (1.0f - cos_angle) * k * k;
+	f32 s = sin_angle * k;
+	f32 m[3][3] = {
+		{ cos_angle + t, t - s,         t + s         },
+		{ t + s,         cos_angle + t, t - s         },
+		{ t - s,         t + s,         cos_angle + t },
+	};
+	memcpy(p.hue_rotation, m, sizeof(m));
+	color_params_bake(&p);
+	return p;
+}
+
+// True if both constant sets produce the same colors in modify_color.
+static bool color_params_equal(const Shader_Constants_Main *a, const Shader_Constants_Main *b) {
+	return a->rgba_flags == b->rgba_flags &&
+		a->hue == b->hue &&
+		a->saturation == b->saturation &&
+		a->contrast == b->contrast &&
+		a->brightness == b->brightness &&
+		a->gamma == b->gamma &&
+		a->srgb == b->srgb;
+}
+
+// modify_color, applied to a sampled texel after the RGBA channel flags.
+static v4 cpu_modify_color(const Color_Params *p, v4 color) {
+	color.r *= p->rgba_flags.r;
+	color.g *= p->rgba_flags.g;
+	color.b *= p->rgba_flags.b;
+
+	if (p->hue != 0) {
+		const f32 (*m)[3] = p->hue_rotation;
+		v4 c = color;
+		color.r = c.r * m[0][0] + c.g * m[1][0] + c.b * m[2][0];
+		color.g = c.r * m[0][1] + c.g * m[1][1] + c.b * m[2][1];
+		color.b = c.r * m[0][2] + c.g * m[1][2] + c.b * m[2][2];
+	}
+	if (p->saturation != 1) {
+		f32 gray = color.r * 0.2125f + color.g * 0.7154f + color.b * 0.0721f;
+		color.r = lerp(gray, color.r, p->saturation);
+		color.g = lerp(gray, color.g, p->saturation);
+		color.b = lerp(gray, color.b, p->saturation);
+	}
+	if (p->contrast != 1) {
+		color.r = 0.5f + p->contrast * (color.r - 0.5f);
+		color.g = 0.5f + p->contrast * (color.g - 0.5f);
+		color.b = 0.5f + p->contrast * (color.b - 0.5f);
+	}
+	if (p->brightness != 0) {
+		color.r += p->brightness;
+		color.g += p->brightness;
+		color.b += p->brightness;
+	}
+	if (p->gamma == 0) {
+		color.r = color.g = color.b = 1;
+	} else {
+		f32 e = 1.0f / p->gamma;
+		color.r = powf(fabsf(color.r), e);
+		color.g = powf(fabsf(color.g), e);
+		color.b = powf(fabsf(color.b), e);
+	}
+	if (p->srgb == 1) {
+		color.r = cpu_to_linear(color.r);
+		color.g = cpu_to_linear(color.g);
+		color.b = cpu_to_linear(color.b);
+		color.a = cpu_alpha_to_linear(color.a);
+	}
+	if (p->rgba_flags.a == 0) color.a = 1;
+	return color;
+}
+
+// Float to UNORM8 the way the render target stores it: saturate, then round to nearest.
+static inline u8 cpu_unorm8(f32 x) {
+	return (u8)(clamp(x, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+static inline u16 cpu_unorm16(f32 x) {
+	return (u16)(clamp(x, 0.0f, 1.0f) * 65535.0f + 0.5f);
+}
+
+static inline f32 cpu_color_curve(const Color_Params *p, f32 x) {
+	f32 pos = min(sqrtf(fabsf(x)) * p->curve_scale, (f32)(COLOR_CURVE_SIZE - 1));
+	i32 i = min((i32)pos, COLOR_CURVE_SIZE - 2);
+	return lerp(p->curve[i], p->curve[i + 1], pos - i);
+}
+
+// cpu_modify_color through the baked matrix and curve, what ps_main runs with color_cache on.
+static v4 cpu_apply_color_cache(const Color_Params *p, v4 color) {
+	f32 r = color.r * p->rgba_flags.r;
+	f32 g = color.g * p->rgba_flags.g;
+	f32 b = color.b * p->rgba_flags.b;
+	const f32 (*m)[4] = p->affine;
+	color.r = cpu_color_curve(p, m[0][0] * r + m[0][1] * g + m[0][2] * b + m[0][3]);
+	color.g = cpu_color_curve(p, m[1][0] * r + m[1][1] * g + m[1][2] * b + m[1][3]);
+	color.b = cpu_color_curve(p, m[2][0] * r + m[2][1] * g + m[2][2] * b + m[2][3]);
+	if (p->srgb == 1) color.a = cpu_alpha_to_linear(color.a);
+	if (p->rgba_flags.a == 0) color.a = 1;
+	return color;
+}
+
+//
+// 3D LUTs. A grading LUT loaded from a .cube file is composed with the edits above into one RGBA
+// float grid (cpu_compose_color_lut), so with a LUT loaded ps_main runs a single tetrahedral lookup
+// per pixel (apply_color_lut in shaders.hlsl).
+//
+
+#define COLOR_LUT_MAX_SIZE 256
+#define COLOR_LUT_COMPOSED_SIZE 65 // gamma and sRGB are steep near black, 33 points lose several LSBs there
+
+// Parses the Adobe/Resolve .cube text format: LUT_3D_SIZE, DOMAIN_MIN/MAX, TITLE and N^3 "r g b"
+// lines with red varying fastest. 1D LUTs are rejected. On failure 'error' gets a message and
+// 'lut' is left untouched.
+static bool cube_lut_parse(const char *text, Grading_LUT *lut, char *error, size_t error_size) {
+	i32 size = 0;
+	v3 domain_min = v3(0.0f), domain_max = v3(1.0f);
+	char title[256] = {};
+	f32 *data = nullptr;
+	size_t count = 0, expected = 0;
+
+	for (const char *line = text; *line; ) {
+		const char *eol = line;
+		while (*eol && *eol != '\n' && *eol != '\r') eol++;
+		const char *s = line;
+		while (s < eol && (*s == ' ' || *s == '\t')) s++;
+		line = eol;
+		while (*line == '\n' || *line == '\r') line++;
+		if (s == eol || *s == '#') continue;
+
+		if ((*s >= '0' && *s <= '9') || *s == '-' || *s == '+' || *s == '.') {
+			if (!data) {
+				snprintf(error, error_size, "LUT_3D_SIZE missing before the table.");
+				return false;
+			}
+			f32 rgb[3];
+			char *end = (char *)s;
+			for (int c = 0; c < 3; c++) {
+				char *start = end;
+				rgb[c] = strtof(start, &end);
+				if (end == start || end > eol) {
+					snprintf(error, error_size, "Invalid table entry %zu.", count + 1);
+					free(data);
+					return false;
+				}
+			}
+			if (count == expected) {
+				snprintf(error, error_size, "More than %zu table entries.", expected);
+				free(data);
+				return false;
+			}
+			memcpy(data + count * 3, rgb, sizeof(rgb));
+			count++;
+		} else if (strncmp(s, "LUT_3D_SIZE", 11) == 0) {
+			size = atoi(s + 11);
+			if (size < 2 || size > COLOR_LUT_MAX_SIZE || data) {
+				snprintf(error, error_size, "Unsupported LUT_3D_SIZE.");
+				free(data);
+				return false;
+			}
+			expected = (size_t)size * size * size;
+			data = (f32 *)malloc(expected * 3 * sizeof(f32));
+			if (!data) {
+				snprintf(error, error_size, "Out of memory.");
+				return false;
+			}
+		} else if (strncmp(s, "LUT_1D_SIZE", 11) == 0) {
+			snprintf(error, error_size, "1D LUTs are not supported.");
+			free(data);
+			return false;
+		} else if (strncmp(s, "DOMAIN_MIN", 10) == 0) {
+			sscanf(s + 10, "%f %f %f", &domain_min.x, &domain_min.y, &domain_min.z);
+		} else if (strncmp(s, "DOMAIN_MAX", 10) == 0) {
+			sscanf(s + 10, "%f %f %f", &domain_max.x, &domain_max.y, &domain_max.z);
+		} else if (strncmp(s, "LUT_3D_INPUT_RANGE", 18) == 0) {
+			f32 lo = 0, hi = 1;
+			sscanf(s + 18, "%f %f", &lo, &hi);
+			domain_min = v3(lo);
+			domain_max = v3(hi);
+		} else if (strncmp(s, "TITLE", 5) == 0) {
+			const char *q = strchr(s, '"');
+			if (q && q < eol) {
+				q++;
+				size_t n = 0;
+				while (q + n < eol && q[n] != '"' && n < sizeof(title) - 1) n++;
+				memcpy(title, q, n);
+			}
+		}
+		// other keywords (LUT_1D_INPUT_RANGE, vendor extensions) don't affect a 3D table
+	}
+	if (!data || count != expected) {
+		snprintf(error, error_size, data ? "Expected %zu table entries, found %zu." : "No LUT_3D_SIZE found.", expected, count);
+		free(data);
+		return false;
+	}
+	for (int c = 0; c < 3; c++) {
+		if (!(domain_max[c] > domain_min[c])) {
+			snprintf(error, error_size, "Invalid DOMAIN_MIN/DOMAIN_MAX.");
+			free(data);
+			return false;
+		}
+	}
+	free(lut->data);
+	lut->data = data;
+	lut->size = size;
+	lut->domain_min = domain_min;
+	lut->domain_max = domain_max;
+	memcpy(lut->name, title, sizeof(lut->name));
+	return true;
+}
+
+// Tetrahedral interpolation of a size^3 grid with 'channels' floats per entry, red varying fastest.
+// The cube cell around 'c' is split into six tetrahedra along its diagonal, picked by the order of
+// the fractional parts; each result blends only four corners. Same math as apply_color_lut.
+static void cpu_lut_sample(const f32 *data, i32 size, i32 channels, f32 r, f32 g, f32 b, f32 *out) {
+	f32 x[3] = { clamp(r, 0.0f, 1.0f), clamp(g, 0.0f, 1.0f), clamp(b, 0.0f, 1.0f) };
+	i32 i[3];
+	f32 f[3];
+	for (int c = 0; c < 3; c++) {
+		x[c] *= size - 1;
+		i[c] = min((i32)x[c], size - 2);
+		f[c] = x[c] - i[c];
+	}
+	size_t sx = channels, sy = sx * size, sz = sy * size;
+	const f32 *c000 = data + i[0] * sx + i[1] * sy + i[2] * sz;
+	const f32 *c111 = c000 + sx + sy + sz;
+	const f32 *p1, *p2;
+	f32 w0, w1, w2, w3;
+	if (f[0] > f[1]) {
+		if (f[1] > f[2])      { p1 = c000 + sx;      p2 = c000 + sx + sy; w0 = 1 - f[0]; w1 = f[0] - f[1]; w2 = f[1] - f[2]; w3 = f[2]; }
+		else if (f[0] > f[2]) { p1 = c000 + sx;      p2 = c000 + sx + sz; w0 = 1 - f[0]; w1 = f[0] - f[2]; w2 = f[2] - f[1]; w3 = f[1]; }
+		else                  { p1 = c000 + sz;      p2 = c000 + sx + sz; w0 = 1 - f[2]; w1 = f[2] - f[0]; w2 = f[0] - f[1]; w3 = f[1]; }
+	} else {
+		if (f[2] > f[1])      { p1 = c000 + sz;      p2 = c000 + sy + sz; w0 = 1 - f[2]; w1 = f[2] - f[1]; w2 = f[1] - f[0]; w3 = f[0]; }
+		else if (f[2] > f[0]) { p1 = c000 + sy;      p2 = c000 + sy + sz; w0 = 1 - f[1]; w1 = f[1] - f[2]; w2 = f[2] - f[0]; w3 = f[0]; }
+		else                  { p1 = c000 + sy;      p2 = c000 + sx + sy; w0 = 1 - f[1]; w1 = f[1] - f[0]; w2 = f[0] - f[2]; w3 = f[2]; }
+	}
+	for (int c = 0; c < channels; c++)
+		out[c] = w0 * c000[c] + w1 * p1[c] + w2 * p2[c] + w3 * c111[c];
+}
+
+struct Color_LUT_Compose {
+	const Color_Params *params;
+	const Grading_LUT *grading;
+	f32 *out;
+	i32 size;
+};
+
+static void color_lut_compose_kernel(void *user, u32 begin, u32 end, u32 worker) {
+	Color_LUT_Compose *cc = (Color_LUT_Compose *)user;
+	const Grading_LUT *lut = cc->grading;
+	i32 n = cc->size;
+	f32 step = 1.0f / (n - 1);
+	for (u32 z = begin; z < end; z++) {
+		f32 *out = cc->out + (size_t)z * n * n * 4;
+		for (i32 y = 0; y < n; y++) {
+			for (i32 x = 0; x < n; x++, out += 4) {
+				v4 color = cpu_apply_color_cache(cc->params, v4(x * step, y * step, z * step, 1.0f));
+				f32 t[3];
+				for (int c = 0; c < 3; c++) {
+					f32 v = clamp(color[c], 0.0f, 1.0f);
+					t[c] = (v - lut->domain_min[c]) / (lut->domain_max[c] - lut->domain_min[c]);
+				}
+				cpu_lut_sample(lut->data, lut->size, 3, t[0], t[1], t[2], out);
+				out[3] = 1.0f;
+			}
+		}
+	}
+}
+
+// Evaluates the color adjustments in 'params' followed by 'grading' on a size^3 grid, RGBA float
+// per entry with red varying fastest. Channel flags and alpha are left to the caller, like ps_main
+// does around modify_color. Returns null when out of memory.
+static f32 *cpu_compose_color_lut(const Color_Params *params, const Grading_LUT *grading, i32 size) {
+	f32 *out = (f32 *)malloc((size_t)size * size * size * 4 * sizeof(f32));
+	if (!out) return nullptr;
+	Color_Params p = *params;
+	p.rgba_flags = v4(1.0f);
+	p.srgb = 0; // only affects alpha in cpu_apply_color_cache, the curve is already baked
+	Color_LUT_Compose cc = { &p, grading, out, size };
+	parallel_for(size, 1, color_lut_compose_kernel, &cc);
+	return out;
+}
+
+// cpu_apply_color_cache_soa with a composed LUT instead of the matrix and curve. Each corner is
+// one RGBA entry, so the four tetrahedron corners blend as whole __m128 loads.
+static void cpu_apply_color_lut_soa(const Color_Params *p, const f32 *lut, i32 size, f32 *r, f32 *g, f32 *b, f32 *a, i32 count) {
+	size_t sx = 4, sy = sx * size, sz = sy * size;
+	f32 scale = (f32)(size - 1);
+	for (i32 k = 0; k < count; k++) {
+		f32 x[3] = {
+			clamp(r[k] * p->rgba_flags.r, 0.0f, 1.0f) * scale,
+			clamp(g[k] * p->rgba_flags.g, 0.0f, 1.0f) * scale,
+			clamp(b[k] * p->rgba_flags.b, 0.0f, 1.0f) * scale,
+		};
+		i32 i[3];
+		f32 f[3];
+		for (int c = 0; c < 3; c++) {
+			i[c] = min((i32)x[c], size - 2);
+			f[c] = x[c] - i[c];
+		}
+		const f32 *c000 = lut + i[0] * sx + i[1] * sy + i[2] * sz;
+		const f32 *c111 = c000 + sx + sy + sz;
+		const f32 *p1, *p2;
+		f32 w0, w1, w2, w3;
+		if (f[0] > f[1]) {
+			if (f[1] > f[2])      { p1 = c000 + sx; p2 = c000 + sx + sy; w0 = 1 - f[0]; w1 = f[0] - f[1]; w2 = f[1] - f[2]; w3 = f[2]; }
+			else if (f[0] > f[2]) { p1 = c000 + sx; p2 = c000 + sx + sz; w0 = 1 - f[0]; w1 = f[0] - f[2]; w2 = f[2] - f[1]; w3 = f[1]; }
+			else                  { p1 = c000 + sz; p2 = c000 + sx + sz; w0 = 1 - f[2]; w1 = f[2] - f[0]; w2 = f[0] - f[1]; w3 = f[1]; }
+		} else {
+			if (f[2] > f[1])      { p1 = c000 + sz; p2 = c000 + sy + sz; w0 = 1 - f[2]; w1 = f[2] - f[1]; w2 = f[1] - f[0]; w3 = f[0]; }
+			else if (f[2] > f[0]) { p1 = c000 + sy; p2 = c000 + sy + sz; w0 = 1 - f[1]; w1 = f[1] - f[2]; w2 = f[2] - f[0]; w3 = f[0]; }
+			else                  { p1 = c000 + sy; p2 = c000 + sx + sy; w0 = 1 - f[1]; w1 = f[1] - f[0]; w2 = f[0] - f[2]; w3 = f[2]; }
+		}
+		__m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(w0), _mm_loadu_ps(c000)), _mm_mul_ps(_mm_set1_ps(w1), _mm_loadu_ps(p1))),
+		                      _mm_add_ps(_mm_mul_ps(_mm_set1_ps(w2), _mm_loadu_ps(p2)), _mm_mul_ps(_mm_set1_ps(w3), _mm_loadu_ps(c111))));
+		alignas(16) f32 out[4];
+		_mm_store_ps(out, v);
+		r[k] = out[0];
+		g[k] = out[1];
+		b[k] = out[2];
+		if (p->srgb == 1) a[k] = cpu_alpha_to_linear(a[k]);
+		if (p->rgba_flags.a == 0) a[k] = 1;
+	}
+}
+
+//
+// Full pipeline, RENDER_MODE_ENCODER semantics: crop, rotation, blur and color adjustments, producing
+// the same pixels save_image reads back from the offscreen render target. Sampling is point filtered
+// with clamped addressing like sampler_nearest. The pixel grid overlay is a viewer-only effect and
+// is not reproduced.
+//
+
+#define CPU_MAX_MIPS 16
+#define CPU_BAND_ROWS 16
+
+struct Cpu_Mips {
+	u8 *levels[CPU_MAX_MIPS]; // 'format' pixels, level 0 is the caller's image and is not owned
+	i32 w[CPU_MAX_MIPS];
+	i32 h[CPU_MAX_MIPS];
+	i32 count;
+	Pixel_Format format;
+};
+
+struct Cpu_Mip_Data {
+	const u8 *src;
+	i32 src_w, src_h;
+	u8 *dst;
+	i32 dst_w;
+	Pixel_Format format;
+};
+
+// 2x2 box filter per level, the same reduction GenerateMips uses for power of two sizes.
+static void cpu_mip_kernel(void *user, u32 begin, u32 end, u32 worker) {
+	Cpu_Mip_Data *md = (Cpu_Mip_Data *)user;
+	size_t size = pixel_format_size(md->format);
+	for (u32 y = begin; y < end; y++) {
+		const u8 *row0 = md->src + (size_t)min((i32)y * 2,     md->src_h - 1) * md->src_w * size;
+		const u8 *row1 = md->src + (size_t)min((i32)y * 2 + 1, md->src_h - 1) * md->src_w * size;
+		u8 *out = md->dst + (size_t)y * md->dst_w * size;
+		for (i32 x = 0; x < md->dst_w; x++, out += size) {
+			size_t x0 = min(x * 2, md->src_w - 1) * size;
+			size_t x1 = min(x * 2 + 1, md->src_w - 1) * size;
+			switch (md->format) {
+				case Pixel_Rgba8:
+					for (int c = 0; c < 4; c++)
+						out[c] = (u8)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+					break;
+				case Pixel_Rgba16: {
+					const u16 *a = (const u16 *)(row0 + x0), *b = (const u16 *)(row0 + x1);
+					const u16 *c = (const u16 *)(row1 + x0), *d = (const u16 *)(row1 + x1);
+					for (int k = 0; k < 4; k++)
+						((u16 *)out)[k] = (u16)((a[k] + b[k] + c[k] + d[k] + 2) >> 2);
+				} break;
+				case Pixel_Rgba32f: {
+					__m128 top = _mm_add_ps(_mm_loadu_ps((const f32 *)(row0 + x0)), _mm_loadu_ps((const f32 *)(row0 + x1)));
+					__m128 bottom = _mm_add_ps(_mm_loadu_ps((const f32 *)(row1 + x0)), _mm_loadu_ps((const f32 *)(row1 + x1)));
+					_mm_storeu_ps((f32 *)out, _mm_mul_ps(_mm_add_ps(top, bottom), _mm_set1_ps(0.25f)));
+				} break;
+			}
+		}
+	}
+}
+
+static bool cpu_build_mips(Cpu_Mips *mips, u8 *data, Pixel_Format format, i32 w, i32 h, i32 max_level) {
+	*mips = {};
+	mips->levels[0] = data;
+	mips->w[0] = w;
+	mips->h[0] = h;
+	mips->count = 1;
+	mips->format = format;
+	max_level = min(max_level, CPU_MAX_MIPS - 1);
+	for (i32 l = 1; l <= max_level && (mips->w[l - 1] > 1 || mips->h[l - 1] > 1); l++) {
+		i32 lw = max(mips->w[l - 1] / 2, 1);
+		i32 lh = max(mips->h[l - 1] / 2, 1);
+		u8 *level = (u8 *)malloc((size_t)lw * lh * pixel_format_size(format));
+		if (!level) return false;
+		Cpu_Mip_Data md = { mips->levels[l - 1], mips->w[l - 1], mips->h[l - 1], level, lw, format };
+		parallel_for(lh, CPU_BAND_ROWS, cpu_mip_kernel, &md);
+		mips->levels[l] = level;
+		mips->w[l] = lw;
+		mips->h[l] = lh;
+		mips->count++;
+	}
+	return true;
+}
+
+static void cpu_free_mips(Cpu_Mips *mips) {
+	for (i32 l = 1; l < mips->count; l++) free(mips->levels[l]);
+	*mips = {};
+}
+
+// Point sample with clamped addressing. Requests past the last built level use the smallest one,
+// like the sampler clamping to the texture's mip count.
+static inline const u8 *cpu_sample(const Cpu_Mips *mips, f32 u, f32 v, i32 level) {
+	level = min(level, mips->count - 1);
+	i32 w = mips->w[level];
+	i32 h = mips->h[level];
+	i32 x = clamp((i32)floorf(u * w), 0, w - 1);
+	i32 y = clamp((i32)floorf(v * h), 0, h - 1);
+	return mips->levels[level] + ((size_t)y * w + x) * pixel_format_size(mips->format);
+}
+
+static inline __m128 cpu_load_rgba8_ps(const u8 *px) {
+	__m128i v = _mm_cvtsi32_si128(*(const i32 *)px);
+	v = _mm_unpacklo_epi8(v, _mm_setzero_si128());
+	v = _mm_unpacklo_epi16(v, _mm_setzero_si128());
+	return _mm_cvtepi32_ps(v);
+}
+
+// One pixel as floats, integer formats normalized to [0, 1].
+static inline __m128 cpu_load_pixel_ps(Pixel_Format format, const u8 *px) {
+	switch (format) {
+		case Pixel_Rgba16: {
+			__m128i v = _mm_loadl_epi64((const __m128i *)px);
+			v = _mm_unpacklo_epi16(v, _mm_setzero_si128());
+			return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f / 65535.0f));
+		}
+		case Pixel_Rgba32f:
+			return _mm_loadu_ps((const f32 *)px);
+		default:
+			return _mm_mul_ps(cpu_load_rgba8_ps(px), _mm_set1_ps(1.0f / 255.0f));
+	}
+}
+
+// One pixel rounded to 8 bits per channel, for consumers that only look at 256 levels (histograms).
+static inline void cpu_pixel_unorm8(Pixel_Format format, const u8 *px, u8 out[4]) {
+	if (format == Pixel_Rgba8) {
+		memcpy(out, px, 4);
+		return;
+	}
+	f32 c[4];
+	_mm_storeu_ps(c, cpu_load_pixel_ps(format, px));
+	for (int k = 0; k < 4; k++) out[k] = cpu_unorm8(c[k]);
+}
+
+static inline void cpu_store_pixel(Pixel_Format format, u8 *out, const f32 c[4]) {
+	switch (format) {
+		case Pixel_Rgba16:
+			for (int k = 0; k < 4; k++) ((u16 *)out)[k] = cpu_unorm16(c[k]);
+			break;
+		case Pixel_Rgba32f:
+			memcpy(out, c, 4 * sizeof(f32));
+			break;
+		default:
+			for (int k = 0; k < 4; k++) out[k] = cpu_unorm8(c[k]);
+			break;
+	}
+}
+
+// rotate_uv
+static inline v2 cpu_rotate_uv(v2 uv, i32 rotation) {
+	v2 c = uv - v2(0.5f, 0.5f);
+	switch (rotation) {
+		case 1: c = v2(-c.y,  c.x); break;
+		case 2: c = v2(-c.x, -c.y); break;
+		case 3: c = v2( c.y, -c.x); break;
+	}
+	return c + v2(0.5f, 0.5f);
+}
+
+//
+// Separable blur, the CPU side of update_blur_cache: a horizontal pass over mip 'blur_lod' into a
+// 16-bit intermediate (float for float images), then a vertical pass to full size, divided by the accumulated alpha like
+// blur() in ps_main. Taps and weights are the shader's, so the result matches the 2D loop
+// evaluated at texel centers.
+//
+
+#define CPU_BLUR_MAX_TAPS 256
+
+struct Cpu_Blur_Data {
+	const Cpu_Mips *mips;
+	u32 lod;
+	u32 taps;
+	f32 scale;
+	f32 offsets[CPU_BLUR_MAX_TAPS];
+	f32 weights[CPU_BLUR_MAX_TAPS];
+	f32 weight_sum;
+	u16 *temp;          // RGBA16, w x temp_h, horizontal sums divided by weight_sum
+	f32 *temp_f;        // instead of 'temp' for float images, which may exceed 1
+	i32 w, h, temp_h;
+	u8 *dst;            // w x h, in the format of the mips
+};
+
+static void cpu_blur_h_kernel(void *user, u32 begin, u32 end, u32 worker) {
+	Cpu_Blur_Data *bd = (Cpu_Blur_Data *)user;
+	Pixel_Format format = bd->mips->format;
+	__m128 norm = _mm_set1_ps((bd->temp_f ? 1.0f : 65535.0f) / bd->weight_sum);
+	for (u32 y = begin; y < end; y++) {
+		f32 v = ((f32)y + 0.5f) / bd->temp_h;
+		u16 *out = bd->temp ? bd->temp + (size_t)y * bd->w * 4 : nullptr;
+		f32 *out_f = bd->temp_f ? bd->temp_f + (size_t)y * bd->w * 4 : nullptr;
+		for (i32 x = 0; x < bd->w; x++) {
+			f32 u = ((f32)x + 0.5f) / bd->w;
+			__m128 acc = _mm_setzero_ps();
+			for (u32 i = 0; i < bd->taps; i++) {
+				const u8 *px = cpu_sample(bd->mips, u + bd->scale * bd->offsets[i], v, bd->lod);
+				acc = _mm_add_ps(acc, _mm_mul_ps(cpu_load_pixel_ps(format, px), _mm_set1_ps(bd->weights[i])));
+			}
+			if (out_f) {
+				_mm_storeu_ps(out_f + x * 4, _mm_mul_ps(acc, norm));
+				continue;
+			}
+			__m128i q = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(acc, norm), _mm_set1_ps(0.5f)));
+			i32 c[4];
+			_mm_storeu_si128((__m128i *)c, q);
+			for (int k = 0; k < 4; k++) out[x * 4 + k] = (u16)min(c[k], 65535);
+		}
+	}
+}
+
+static void cpu_blur_v_kernel(void *user, u32 begin, u32 end, u32 worker) {
+	Cpu_Blur_Data *bd = (Cpu_Blur_Data *)user;
+	Pixel_Format format = bd->mips->format;
+	size_t size = pixel_format_size(format);
+	size_t rows[CPU_BLUR_MAX_TAPS]; // offsets of the temp rows, in channels
+	for (u32 y = begin; y < end; y++) {
+		f32 v = ((f32)y + 0.5f) / bd->h;
+		for (u32 j = 0; j < bd->taps; j++) {
+			i32 row = clamp((i32)floorf((v + bd->scale * bd->offsets[j]) * bd->temp_h), 0, bd->temp_h - 1);
+			rows[j] = (size_t)row * bd->w * 4;
+		}
+		u8 *out = bd->dst + (size_t)y * bd->w * size;
+		for (i32 x = 0; x < bd->w; x++, out += size) {
+			__m128 acc = _mm_setzero_ps();
+			for (u32 j = 0; j < bd->taps; j++) {
+				__m128 px;
+				if (bd->temp_f) {
+					px = _mm_loadu_ps(bd->temp_f + rows[j] + x * 4);
+				} else {
+					__m128i t = _mm_loadl_epi64((const __m128i *)(bd->temp + rows[j] + x * 4));
+					px = _mm_cvtepi32_ps(_mm_unpacklo_epi16(t, _mm_setzero_si128()));
+				}
+				acc = _mm_add_ps(acc, _mm_mul_ps(px, _mm_set1_ps(bd->weights[j])));
+			}
+			f32 c[4];
+			_mm_storeu_ps(c, acc);
+			if (c[3] <= 0) { // the shader produces NaN here, which the render target stores as 0
+				memset(out, 0, size);
+				continue;
+			}
+			for (int k = 0; k < 4; k++) c[k] /= c[3];
+			cpu_store_pixel(format, out, c);
+		}
+	}
+}
+
+// Blurs level 0 of 'mips' (built up to at least blur_lod) into a new w*h image of the same format.
+// Returns nullptr if the settings produce no taps or on allocation failure.
+static u8 *cpu_blur_image(const Shader_Constants_Main *c, const Cpu_Mips *mips) {
+	u32 lod_size = 1u << c->blur_lod;
+	u32 taps = c->blur_samples / lod_size;
+	if (taps == 0 || taps > CPU_BLUR_MAX_TAPS) return nullptr;
+
+	Cpu_Blur_Data *bd = (Cpu_Blur_Data *)calloc(1, sizeof(Cpu_Blur_Data));
+	if (!bd) return nullptr;
+	bd->mips = mips;
+	bd->lod = c->blur_lod;
+	bd->taps = taps;
+	bd->scale = c->blur_scale;
+	f32 sigma = c->blur_samples * 0.25f;
+	for (u32 i = 0; i < taps; i++) {
+		f32 d = (f32)i * lod_size - c->blur_samples * 0.5f;
+		f32 k = d / sigma;
+		bd->offsets[i] = d;
+		bd->weights[i] = expf(-0.5f * k * k);
+		bd->weight_sum += bd->weights[i];
+	}
+	bd->w = mips->w[0];
+	bd->h = mips->h[0];
+	bd->temp_h = max(bd->h >> c->blur_lod, 1);
+	if (mips->format == Pixel_Rgba32f)
+		bd->temp_f = (f32 *)malloc((size_t)bd->w * bd->temp_h * 4 * sizeof(f32));
+	else
+		bd->temp = (u16 *)malloc((size_t)bd->w * bd->temp_h * 4 * sizeof(u16));
+	bd->dst = (u8 *)malloc((size_t)bd->w * bd->h * pixel_format_size(mips->format));
+	if ((bd->temp || bd->temp_f) && bd->dst) {
+		parallel_for(bd->temp_h, CPU_BAND_ROWS, cpu_blur_h_kernel, bd);
+		parallel_for(bd->h, CPU_BAND_ROWS, cpu_blur_v_kernel, bd);
+	} else {
+		free(bd->dst);
+		bd->dst = nullptr;
+	}
+	u8 *result = bd->dst;
+	free(bd->temp);
+	free(bd->temp_f);
+	free(bd);
+	return result;
+}
+
+//
+// Vectorized cpu_apply_color_cache, four pixels at a time in structure-of-arrays form.
+//
+
+static inline __m128 cpu_color_curve_ps(const Color_Params *p, __m128 x) {
+	__m128 pos = _mm_mul_ps(_mm_sqrt_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), x)), _mm_set1_ps(p->curve_scale));
+	pos = _mm_min_ps(pos, _mm_set1_ps((f32)(COLOR_CURVE_SIZE - 1)));
+	__m128i i = _mm_min_epi16(_mm_cvttps_epi32(pos), _mm_set1_epi32(COLOR_CURVE_SIZE - 2)); // indices fit in 16 bits
+	__m128 t = _mm_sub_ps(pos, _mm_cvtepi32_ps(i));
+	alignas(16) i32 idx[4];
+	_mm_store_si128((__m128i *)idx, i);
+	__m128 lo = _mm_setr_ps(p->curve[idx[0]],     p->curve[idx[1]],     p->curve[idx[2]],     p->curve[idx[3]]);
+	__m128 hi = _mm_setr_ps(p->curve[idx[0] + 1], p->curve[idx[1] + 1], p->curve[idx[2] + 1], p->curve[idx[3] + 1]);
+	return _mm_add_ps(lo, _mm_mul_ps(t, _mm_sub_ps(hi, lo)));
+}
+
+// In place on r/g/b/a[i] for i in [0, count), count a multiple of 4.
+static void cpu_apply_color_cache_soa(const Color_Params *p, f32 *r, f32 *g, f32 *b, f32 *a, i32 count) {
+	const f32 (*m)[4] = p->affine;
+	for (i32 i = 0; i < count; i += 4) {
+		__m128 vr = _mm_mul_ps(_mm_loadu_ps(r + i), _mm_set1_ps(p->rgba_flags.r));
+		__m128 vg = _mm_mul_ps(_mm_loadu_ps(g + i), _mm_set1_ps(p->rgba_flags.g));
+		__m128 vb = _mm_mul_ps(_mm_loadu_ps(b + i), _mm_set1_ps(p->rgba_flags.b));
+		__m128 va = _mm_loadu_ps(a + i);
+
+		__m128 xr = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vr, _mm_set1_ps(m[0][0])), _mm_mul_ps(vg, _mm_set1_ps(m[0][1]))), _mm_add_ps(_mm_mul_ps(vb, _mm_set1_ps(m[0][2])), _mm_set1_ps(m[0][3])));
+		__m128 xg = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vr, _mm_set1_ps(m[1][0])), _mm_mul_ps(vg, _mm_set1_ps(m[1][1]))), _mm_add_ps(_mm_mul_ps(vb, _mm_set1_ps(m[1][2])), _mm_set1_ps(m[1][3])));
+		__m128 xb = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vr, _mm_set1_ps(m[2][0])), _mm_mul_ps(vg, _mm_set1_ps(m[2][1]))), _mm_add_ps(_mm_mul_ps(vb, _mm_set1_ps(m[2][2])), _mm_set1_ps(m[2][3])));
+		vr = cpu_color_curve_ps(p, xr);
+		vg = cpu_color_curve_ps(p, xg);
+		vb = cpu_color_curve_ps(p, xb);
+		if (p->srgb == 1) {
+			__m128 ia = _mm_sub_ps(_mm_set1_ps(1.0f), va);
+			va = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(ia, ia));
+		}
+		if (p->rgba_flags.a == 0) va = _mm_set1_ps(1.0f);
+
+		_mm_storeu_ps(r + i, vr);
+		_mm_storeu_ps(g + i, vg);
+		_mm_storeu_ps(b + i, vb);
+		_mm_storeu_ps(a + i, va);
+	}
+}
+
+// Saturate, round and interleave four pixels into 8-bit RGBA (or BGRA).
+static inline void cpu_store_unorm8_ps(u8 *out, __m128 R, __m128 G, __m128 B, __m128 A, bool bgra) {
+	__m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), k = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+	// max first, so NaN becomes 0 like saturate() does
+	__m128i r = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(R, zero), one), k), half));
+	__m128i g = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(G, zero), one), k), half));
+	__m128i b = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(B, zero), one), k), half));
+	__m128i a = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(A, zero), one), k), half));
+	if (bgra) { __m128i t = r; r = b; b = t; }
+	__m128i px = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)), _mm_or_si128(_mm_slli_epi32(b, 16), _mm_slli_epi32(a, 24)));
+	_mm_storeu_si128((__m128i *)out, px);
+}
+
+// 16-bit RGBA, native endian.
+static inline void cpu_store_unorm16(u16 *out, f32 r, f32 g, f32 b, f32 a) {
+	out[0] = cpu_unorm16(r);
+	out[1] = cpu_unorm16(g);
+	out[2] = cpu_unorm16(b);
+	out[3] = cpu_unorm16(a);
+}
+
+struct Cpu_Pipeline {
+	Shader_Constants_Main constants;
+	Color_Params color;
+	Cpu_Mips mips;
+	// uv of output pixel (x, y) is origin + x * du + y * dv, the interpolation the rasterizer does
+	// across the quad from vs_main
+	v2 origin, du, dv;
+	i32 out_w, out_h;
+	Pixel_Format out_format; // Rgba8 or Rgba16
+	bool bgra; // Rgba8 only
+	u8 *blurred; // source after cpu_blur_image, when blur is on
+	f32 *lut; // composed color LUT when a grading LUT is applied, see cpu_compose_color_lut
+	i32 lut_size;
+	f32 *scratch; // per worker rows, 4 channel arrays each
+	i32 scratch_stride;
+
+	// band being rendered by cpu_pipeline_rows
+	i32 row_offset;
+	u8 *dst;
+	size_t dst_stride;
+};
+
+static void cpu_pipeline_kernel(void *user, u32 begin, u32 end, u32 worker) {
+	Cpu_Pipeline *pl = (Cpu_Pipeline *)user;
+	i32 stride = pl->scratch_stride;
+	f32 *r = pl->scratch + (size_t)worker * stride * 4;
+	f32 *g = r + stride;
+	f32 *b = g + stride;
+	f32 *a = b + stride;
+
+	for (u32 row = begin; row < end; row++) {
+		f32 y = (f32)(pl->row_offset + (i32)row) + 0.5f;
+		for (i32 x = 0; x < pl->out_w; x++) {
+			v2 uv = pl->origin + pl->du * ((f32)x + 0.5f) + pl->dv * y;
+			const u8 *px = cpu_sample(&pl->mips, uv.x, uv.y, 0);
+			f32 c[4];
+			_mm_storeu_ps(c, cpu_load_pixel_ps(pl->mips.format, px));
+			r[x] = c[0];
+			g[x] = c[1];
+			b[x] = c[2];
+			a[x] = c[3];
+		}
+		if (pl->lut)
+			cpu_apply_color_lut_soa(&pl->color, pl->lut, pl->lut_size, r, g, b, a, pl->out_w);
+		else
+			cpu_apply_color_cache_soa(&pl->color, r, g, b, a, stride);
+
+		u8 *out = pl->dst + row * pl->dst_stride;
+		if (pl->out_format == Pixel_Rgba16) {
+			for (i32 x = 0; x < pl->out_w; x++)
+				cpu_store_unorm16((u16 *)out + x * 4, r[x], g[x], b[x], a[x]);
+			continue;
+		}
+		i32 x = 0;
+		for (; x + 4 <= pl->out_w; x += 4)
+			cpu_store_unorm8_ps(out + x * 4, _mm_loadu_ps(r + x), _mm_loadu_ps(g + x), _mm_loadu_ps(b + x), _mm_loadu_ps(a + x), pl->bgra);
+		if (x < pl->out_w) {
+			u8 tail[16];
+			cpu_store_unorm8_ps(tail, _mm_loadu_ps(r + x), _mm_loadu_ps(g + x), _mm_loadu_ps(b + x), _mm_loadu_ps(a + x), pl->bgra);
+			memcpy(out + x * 4, tail, (pl->out_w - x) * 4);
+		}
+	}
+}
+
+static void cpu_pipeline_end(Cpu_Pipeline *pl) {
+	free(pl->scratch);
+	free(pl->blurred);
+	free(pl->lut);
+	cpu_free_mips(&pl->mips);
+	*pl = {};
+}
+
+// Prepares rendering 'src' (w*h of 'src_format') the way save_image's offscreen pass does with 'constants'
+// in RENDER_MODE_ENCODER: the crop_a..crop_b region, rotated, blurred and color adjusted, at
+// out_w*out_h. 'grading', when it holds a table, is applied after the adjustments. Everything that
+// depends on the whole image (blur, composed LUT) happens here, so cpu_pipeline_rows can then
+// produce the output in any number of bands. The output is 'out_format', Rgba8 (BGRA with 'bgra')
+// or Rgba16; all the work in between is float. 'src' must stay alive until cpu_pipeline_end.
+static bool cpu_pipeline_begin(Cpu_Pipeline *pl, const Shader_Constants_Main *constants,
+                               u8 *src, Pixel_Format src_format, i32 w, i32 h,
+                               i32 out_w, i32 out_h, Pixel_Format out_format, bool bgra,
+                               const Grading_LUT *grading) {
+	*pl = {};
+	if (!src || out_w <= 0 || out_h <= 0) return false;
+	pl->constants = *constants;
+	pl->color = color_params_from_constants(constants);
+	pl->out_w = out_w;
+	pl->out_h = out_h;
+	pl->out_format = out_format;
+	pl->bgra = bgra;
+	if (grading && grading->data) {
+		pl->lut_size = COLOR_LUT_COMPOSED_SIZE;
+		pl->lut = cpu_compose_color_lut(&pl->color, grading, pl->lut_size);
+		if (!pl->lut) return false;
+	}
+
+	// set_uv_as_cropped maps the quad corners to the crop rect and rotates them, both affine
+	v2 dim = constants->image_dim;
+	v2 uv00 = cpu_rotate_uv(constants->crop_a / dim, constants->rotation);
+	v2 uv10 = cpu_rotate_uv(v2(constants->crop_b.x, constants->crop_a.y) / dim, constants->rotation);
+	v2 uv01 = cpu_rotate_uv(v2(constants->crop_a.x, constants->crop_b.y) / dim, constants->rotation);
+	pl->origin = uv00;
+	pl->du = (uv10 - uv00) / (f32)out_w;
+	pl->dv = (uv01 - uv00) / (f32)out_h;
+
+	// with blur on, the rows sample the blurred image, as ps_main does with the blur cache
+	if (constants->do_blur == 1) {
+		bool ok = cpu_build_mips(&pl->mips, src, src_format, w, h, constants->blur_lod);
+		if (ok) pl->blurred = cpu_blur_image(constants, &pl->mips);
+		cpu_free_mips(&pl->mips);
+		if (!pl->blurred) {
+			cpu_pipeline_end(pl);
+			return false;
+		}
+	}
+	cpu_build_mips(&pl->mips, pl->blurred ? pl->blurred : src, src_format, w, h, 0);
+	pl->scratch_stride = (out_w + 3) & ~3;
+	pl->scratch = (f32 *)calloc((size_t)parallel_worker_count() * pl->scratch_stride * 4, sizeof(f32));
+	if (!pl->scratch) {
+		cpu_pipeline_end(pl);
+		return false;
+	}
+	return true;
+}
+
+// Output rows [y, y + rows) into 'dst', 'dst_stride' bytes apart, split into bands across all cores.
+static void cpu_pipeline_rows(Cpu_Pipeline *pl, i32 y, i32 rows, u8 *dst, size_t dst_stride) {
+	pl->row_offset = y;
+	pl->dst = dst;
+	pl->dst_stride = dst_stride;
+	parallel_for(rows, CPU_BAND_ROWS, cpu_pipeline_kernel, pl);
+}
+
+// Whole output at once into 'dst' (out_w*out_h, 'dst_stride' bytes per row).
+static bool cpu_render_encoder(const Shader_Constants_Main *constants, u8 *src, Pixel_Format src_format, i32 w, i32 h,
+                               u8 *dst, i32 out_w, i32 out_h, size_t dst_stride, bool bgra,
+                               const Grading_LUT *grading = nullptr) {
+	Cpu_Pipeline pl;
+	if (!dst || !cpu_pipeline_begin(&pl, constants, src, src_format, w, h, out_w, out_h, Pixel_Rgba8, bgra, grading))
+		return false;
+	cpu_pipeline_rows(&pl, 0, out_h, dst, dst_stride);
+	cpu_pipeline_end(&pl);
+	return true;
+}
@@ -0,0 +1,620 @@
+// Still image encoders that don't go through WIC: PNG (stb_image_write's filters and deflate, run
+// in bands on all cores), JPEG (stb_image_write's baseline encoder) and lossy/lossless WebP (libwebp).
+// Nothing in here uses files or COM: the pixels come in through an Encoder_Source a band of rows at a
+// time, the bytes go out through an Encoder_Write_Func, and the caller decides where both live. The
+// PNG bands run on parallel_for (parallel.cpp), which is the only platform code involved.
+// Rows are tightly packed RGBA8, or native endian RGBA16 for the formats encoder_supports_rgba16
+// says can store it.
+
+typedef bool Encoder_Write_Func(void *user, const void *data, size_t size);
+
+// Fills 'dst' with rows [y, y + rows) of the image, 'stride' bytes apart. The encoders ask for the rows
+// top to bottom, so a source can produce them as it goes (export_image_cpu runs the CPU pipeline).
+typedef bool Encoder_Rows_Func(void *user, i32 y, i32 rows, u8 *dst, size_t stride);
+
+struct Encoder_Source {
+	Encoder_Rows_Func *rows;
+	void *user;
+	Pixel_Format format;
+	i32 w, h;
+};
+
+static bool encoder_is_portable(Encoder_Format encoder_format) {
+	return encoder_format == Format_Png || encoder_format == Format_Jpeg ||
+	       encoder_format == Format_Webp || encoder_format == Format_Webp_Lossless;
+}
+
+// Formats that keep 16 bits per channel, here or through WIC.
+static bool encoder_supports_rgba16(Encoder_Format encoder_format) {
+	return encoder_format == Format_Png || encoder_format == Format_Tiff;
+}
+
+//
+// PNG. The image is cut into bands of about PNG_BAND_BYTES of filtered data. Every band is filtered
+// and deflated on its own and written as its own IDAT chunk; a PNG decoder concatenates the IDAT
+// payloads, so the bands only have to form one valid zlib stream when appended. That takes a zlib
+// header in front of the first band, no final-block bit on any band but the last, a byte aligned end
+// for every band (an empty stored block, like zlib's Z_SYNC_FLUSH), and the adler32 of the whole
+// stream, which is combined from the per band checksums and written as a last, 4 byte IDAT.
+// The bands are fetched and compressed one batch at a time, a band per worker, and written before the
+// next batch is fetched; only a batch's rows and the row above them (for the filters) are resident.
+// 16-bit images are stored as such; PNG wants those samples big endian, so every band swaps a copy
+// of its rows (and the one above) first.
+//
+
+#define PNG_BAND_BYTES (1 << 20)
+
+struct Png_Band {
+	unsigned char *chunk; // stb stretchy buffer: length, "IDAT", deflate data, crc
+	u32 adler;
+	i32 filtered_size;
+};
+
+struct Png_Encode {
+	const u8 *pixels; // rows of the current batch, starting with image row 'first_row'
+	i32 first_row;
+	i32 w, h;
+	i32 n; // bytes per pixel, 4 or 8
+	i32 band_rows;
+	i32 band_count;
+	i32 batch_band;   // first band of the current batch, png_band_kernel's indices start there
+	Png_Band *bands;
+};
+
+static u32 png_adler32(const u8 *data, i32 len) {
+	u32 s1 = 1, s2 = 0;
+	i32 blocklen = len % 5552;
+	for (i32 j = 0; j < len; j += blocklen, blocklen = 5552) {
+		for (i32 i = 0; i < blocklen; i++) { s1 += data[j + i]; s2 += s1; }
+		s1 %= 65521; s2 %= 65521;
+	}
+	return (s2 << 16) | s1;
+}
+
+// adler32 of A followed by B, from adler32(A), adler32(B) and the length of B (zlib's adler32_combine).
+static u32 png_adler32_combine(u32 adler_a, u32 adler_b, i32 len_b) {
+	const u32 base = 65521;
+	u32 rem = (u32)len_b % base;
+	u32 sum1 = adler_a & 0xffff;
+	u32 sum2 = (rem * sum1) % base;
+	sum1 += (adler_b & 0xffff) + base - 1;
+	sum2 += (adler_a >> 16) + (adler_b >> 16) + base - rem;
+	if (sum1 >= base) sum1 -= base;
+	if (sum1 >= base) sum1 -= base;
+	if (sum2 >= base << 1) sum2 -= base << 1;
+	if (sum2 >= base) sum2 -= base;
+	return sum1 | (sum2 << 16);
+}
+
+// stbi_zlib_compress without the zlib header and adler32, appending to 'chunk'. Unless 'last', the
+// block isn't marked final and is followed by an empty stored block, so the output ends on a byte
+// boundary and the next band can start right after it. Matches never reach into the previous band.
+static bool png_deflate_band(unsigned char **chunk, unsigned char *data, int data_len, int quality, bool last) {
+	static unsigned short lengthc[] = { 3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258, 259 };
+	static unsigned char  lengtheb[]= { 0,0,0,0,0,0,0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4,  4,  5,  5,  5,  5,  0 };
+	static unsigned short distc[]   = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577, 32768 };
+	static unsigned char  disteb[]  = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+	unsigned int bitbuf = 0;
+	int i, j, bitcount = 0;
+	unsigned char *out = *chunk;
+	int start = stbiw__sbn(out);
+	unsigned char ***hash_table = (unsigned char ***)STBIW_MALLOC(stbiw__ZHASH * sizeof(unsigned char **));
+	if (hash_table == NULL)
+		return false;
+	if (quality < 5) quality = 5;
+
+	stbiw__zlib_add(last ? 1 : 0, 1); // BFINAL
+	stbiw__zlib_add(1, 2);            // BTYPE = 1 -- fixed huffman
+
+	for (i = 0; i < stbiw__ZHASH; ++i)
+		hash_table[i] = NULL;
+
+	i = 0;
+	while (i < data_len - 3) {
+		int h = stbiw__zhash(data + i) & (stbiw__ZHASH - 1), best = 3;
+		unsigned char *bestloc = 0;
+		unsigned char **hlist = hash_table[h];
+		int n = stbiw__sbcount(hlist);
+		for (j = 0; j < n; ++j) {
+			if (hlist[j] - data > i - 32768) {
+				int d = stbiw__zlib_countm(hlist[j], data + i, data_len - i);
+				if (d >= best) { best = d; bestloc = hlist[j]; }
+			}
+		}
+		if (hash_table[h] && stbiw__sbn(hash_table[h]) == 2 * quality) {
+			STBIW_MEMMOVE(hash_table[h], hash_table[h] + quality, sizeof(hash_table[h][0]) * quality);
+			stbiw__sbn(hash_table[h]) = quality;
+		}
+		stbiw__sbpush(hash_table[h], data + i);
+
+		if (bestloc) { // lazy matching, as in stb
+			h = stbiw__zhash(data + i + 1) & (stbiw__ZHASH - 1);
+			hlist = hash_table[h];
+			n = stbiw__sbcount(hlist);
+			for (j = 0; j < n; ++j) {
+				if (hlist[j] - data > i - 32767) {
+					int e = stbiw__zlib_countm(hlist[j], data + i + 1, data_len - i - 1);
+					if (e > best) {
+						bestloc = NULL;
+						break;
+					}
+				}
+			}
+		}
+
+		if (bestloc) {
+			int d = (int)(data + i - bestloc);
+			for (j = 0; best > lengthc[j + 1] - 1; ++j);
+			stbiw__zlib_huff(j + 257);
+			if (lengtheb[j]) stbiw__zlib_add(best - lengthc[j], lengtheb[j]);
+			for (j = 0; d > distc[j + 1] - 1; ++j);
+			stbiw__zlib_add(stbiw__zlib_bitrev(j, 5), 5);
+			if (disteb[j]) stbiw__zlib_add(d - distc[j], disteb[j]);
+			i += best;
+		} else {
+			stbiw__zlib_huffb(data[i]);
+			++i;
+		}
+	}
+	for (; i < data_len; ++i)
+		stbiw__zlib_huffb(data[i]);
+	stbiw__zlib_huff(256); // end of block
+	if (!last)
+		stbiw__zlib_add(0, 3); // BFINAL = 0, BTYPE = 0 -- empty stored block, LEN/NLEN follow aligned
+	while (bitcount)
+		stbiw__zlib_add(0, 1);
+	if (!last) {
+		stbiw__sbpush(out, 0x00);
+		stbiw__sbpush(out, 0x00);
+		stbiw__sbpush(out, 0xff);
+		stbiw__sbpush(out, 0xff);
+	}
+
+	for (i = 0; i < stbiw__ZHASH; ++i)
+		(void)stbiw__sbfree(hash_table[i]);
+	STBIW_FREE(hash_table);
+
+	// stored blocks instead if compression was worse; those end byte aligned on their own
+	if (stbiw__sbn(out) - start > data_len + ((data_len + 32766) / 32767) * 5) {
+		stbiw__sbn(out) = start;
+		for (j = 0; j < data_len;) {
+			int blocklen = min(data_len - j, 32767);
+			stbiw__sbpush(out, last && data_len - j == blocklen);
+			stbiw__sbpush(out, STBIW_UCHAR(blocklen));
+			stbiw__sbpush(out, STBIW_UCHAR(blocklen >> 8));
+			stbiw__sbpush(out, STBIW_UCHAR(~blocklen));
+			stbiw__sbpush(out, STBIW_UCHAR(~blocklen >> 8));
+			stbiw__sbmaybegrow(out, blocklen);
+			memcpy(out + stbiw__sbn(out), data + j, blocklen);
+			stbiw__sbn(out) += blocklen;
+			j += blocklen;
+		}
+	}
+	*chunk = out;
+	return true;
+}
+
+static void png_band_kernel(void *user, u32 begin, u32 end, u32 worker) {
+	Png_Encode *pe = (Png_Encode *)user;
+	i32 n = pe->n;
+	i32 stride = pe->w * n;
+	i32 row_size = stride + 1;
+	unsigned char *filtered = (unsigned char *)malloc((size_t)row_size * pe->band_rows);
+	signed char *line = (signed char *)malloc((size_t)stride);
+	unsigned char *swapped = n == 8 ? (unsigned char *)malloc((size_t)stride * (pe->band_rows + 1)) : nullptr;
+
+	for (u32 i = begin; i < end; i++) {
+		u32 b = (u32)pe->batch_band + i;
+		Png_Band *band = &pe->bands[b];
+		if (!filtered || !line || (n == 8 && !swapped)) continue;
+		i32 y0 = (i32)b * pe->band_rows;
+		i32 rows = min(pe->band_rows, pe->h - y0);
+
+		// the rows stbiw__encode_png_line reads: the batch, or the big endian copy of this band. Their
+		// row 0 is the image's first row only where y is 0, which decides the filters available.
+		unsigned char *pixels = (unsigned char *)pe->pixels;
+		i32 y = y0 - pe->first_row;
+		if (swapped) {
+			i32 first = max(y0 - 1, 0);
+			const u16 *src = (const u16 *)(pe->pixels + (size_t)(first - pe->first_row) * stride);
+			size_t count = (size_t)(y0 + rows - first) * pe->w * 4;
+			for (size_t i = 0; i < count; i++) {
+				swapped[i * 2 + 0] = (unsigned char)(src[i] >> 8);
+				swapped[i * 2 + 1] = (unsigned char)src[i];
+			}
+			pixels = swapped;
+			y = y0 - first; // 0 only for the image's first row, which must stay 0 for the filter choice
+		}
+
+		// same per row filter choice as stbi_write_png_to_mem: the one with the smallest sum of abs
+		for (i32 j = 0; j < rows; j++) {
+			int best_filter = 0, best_value = 0x7fffffff;
+			for (int filter = 0; filter < 5; filter++) {
+				stbiw__encode_png_line(pixels, stride, pe->w, pe->h, y + j, n, filter, line);
+				int value = 0;
+				for (i32 i = 0; i < stride; i++)
+					value += abs(line[i]);
+				if (value < best_value) { best_value = value; best_filter = filter; }
+			}
+			if (best_filter != 4)
+				stbiw__encode_png_line(pixels, stride, pe->w, pe->h, y + j, n, best_filter, line);
+			filtered[(size_t)j * row_size] = (unsigned char)best_filter;
+			memcpy(filtered + (size_t)j * row_size + 1, line, stride);
+		}
+		band->filtered_size = rows * row_size;
+		band->adler = png_adler32(filtered, band->filtered_size);
+
+		unsigned char *chunk = 0;
+		for (int i = 0; i < 8; i++) stbiw__sbpush(chunk, 0); // length and tag, filled in below
+		if (b == 0) {
+			stbiw__sbpush(chunk, 0x78); // DEFLATE 32K window
+			stbiw__sbpush(chunk, 0x5e); // FLEVEL = 1
+		}
+		bool last = b == (u32)pe->band_count - 1;
+		if (!png_deflate_band(&chunk, filtered, band->filtered_size, stbi_write_png_compression_level, last)) {
+			(void)stbiw__sbfree(chunk);
+			continue;
+		}
+		int len = stbiw__sbn(chunk) - 8;
+		unsigned char *o = chunk;
+		stbiw__wp32(o, len);
+		stbiw__wptag(o, "IDAT");
+		u32 crc = stbiw__crc32(chunk + 4, len + 4);
+		stbiw__sbpush(chunk, STBIW_UCHAR(crc >> 24));
+		stbiw__sbpush(chunk, STBIW_UCHAR(crc >> 16));
+		stbiw__sbpush(chunk, STBIW_UCHAR(crc >> 8));
+		stbiw__sbpush(chunk, STBIW_UCHAR(crc));
+		band->chunk = chunk;
+	}
+	free(filtered);
+	free(line);
+	free(swapped);
+}
+
+static bool png_encode(const Encoder_Source *source, Encoder_Write_Func *write, void *user) {
+	Png_Encode pe = {};
+	i32 w = source->w;
+	i32 h = source->h;
+	pe.w = w;
+	pe.h = h;
+	pe.n = source->format == Pixel_Rgba16 ? 8 : 4;
+	if ((i64)w * pe.n + 1 > 0x7fffffff) return false;
+	pe.band_rows = clamp(PNG_BAND_BYTES / (w * pe.n + 1), 1, h);
+	pe.band_count = (h + pe.band_rows - 1) / pe.band_rows;
+	i32 batch_bands = min((i32)parallel_worker_count(), pe.band_count);
+	size_t stride = (size_t)w * pe.n;
+	pe.bands = (Png_Band *)calloc(pe.band_count, sizeof(Png_Band));
+	u8 *rows = (u8 *)malloc(stride * ((size_t)batch_bands * pe.band_rows + 1)); // the row above, then the batch
+	if (!pe.bands || !rows) {
+		free(pe.bands);
+		free(rows);
+		return false;
+	}
+
+	unsigned char head[8 + 25 + 13];
+	unsigned char *o = head;
+	unsigned char sig[8] = { 137,80,78,71,13,10,26,10 };
+	memcpy(o, sig, 8); o += 8;
+	stbiw__wp32(o, 13);
+	stbiw__wptag(o, "IHDR");
+	stbiw__wp32(o, w);
+	stbiw__wp32(o, h);
+	*o++ = (unsigned char)(pe.n * 2); // bit depth
+	*o++ = 6; // RGBA
+	*o++ = 0;
+	*o++ = 0;
+	*o++ = 0;
+	stbiw__wpcrc(&o, 13);
+	stbiw__wp32(o, 1); // pixels are sRGB, color_profile.cpp converts everything else on load
+	stbiw__wptag(o, "sRGB");
+	*o++ = 0; // perceptual
+	stbiw__wpcrc(&o, 1);
+	bool ok = write(user, head, sizeof(head));
+
+	u32 adler = 1;
+	for (i32 b0 = 0; ok && b0 < pe.band_count; b0 += batch_bands) {
+		i32 count = min(batch_bands, pe.band_count - b0);
+		i32 y0 = b0 * pe.band_rows;
+		i32 batch_rows = min(count * pe.band_rows, h - y0);
+		ok = source->rows(source->user, y0, batch_rows, rows + stride, stride);
+		if (!ok) break;
+		pe.pixels = y0 > 0 ? rows : rows + stride;
+		pe.first_row = y0 > 0 ? y0 - 1 : 0;
+		pe.batch_band = b0;
+		parallel_for(count, 1, png_band_kernel, &pe);
+		for (i32 i = b0; i < b0 + count; i++) {
+			if (!pe.bands[i].chunk) ok = false;
+			adler = png_adler32_combine(adler, pe.bands[i].adler, pe.bands[i].filtered_size);
+			if (ok) ok = write(user, pe.bands[i].chunk, stbiw__sbn(pe.bands[i].chunk));
+			(void)stbiw__sbfree(pe.bands[i].chunk);
+			pe.bands[i].chunk = nullptr;
+		}
+		memcpy(rows, rows + stride * batch_rows, stride);
+	}
+
+	unsigned char tail[16 + 12];
+	o = tail;
+	stbiw__wp32(o, 4);
+	stbiw__wptag(o, "IDAT");
+	stbiw__wp32(o, adler);
+	stbiw__wpcrc(&o, 4);
+	stbiw__wp32(o, 0);
+	stbiw__wptag(o, "IEND");
+	stbiw__wpcrc(&o, 0);
+	if (ok) ok = write(user, tail, sizeof(tail));
+
+	for (i32 i = 0; i < pe.band_count; i++)
+		(void)stbiw__sbfree(pe.bands[i].chunk);
+	free(pe.bands);
+	free(rows);
+	return ok;
+}
+
+//
+// JPEG and WebP
+//
+
+struct Encoder_Sink {
+	Encoder_Write_Func *write;
+	void *user;
+	bool ok;
+};
+
+static void jpeg_write_callback(void *context, void *data, int size) {
+	Encoder_Sink *sink = (Encoder_Sink *)context;
+	if (sink->ok) sink->ok = sink->write(sink->user, data, size);
+}
+
+static int webp_write_callback(const uint8_t *data, size_t data_size, const WebPPicture *picture) {
+	Encoder_Sink *sink = (Encoder_Sink *)picture->custom_ptr;
+	sink->ok = sink->write(sink->user, data, data_size);
+	return sink->ok;
+}
+
+//
+// JPEG: stb_image_write's baseline encoder (stbi_write_jpg_core), fed a band of JPEG_BAND_ROWS rows at
+// a time instead of the whole image. Same tables, color conversion and block order, so the output is
+// the same as stbi_write_jpg_to_func's. stb keeps its Huffman code tables as static locals, so they
+// are rebuilt here from the standard code counts and values, which is what stb's were generated from.
+//
+
+#define JPEG_BAND_ROWS 256 // a multiple of the 16 rows in a subsampled macroblock
+
+static const unsigned char jpeg_dc_luminance_nrcodes[] = {0,0,1,5,1,1,1,1,1,1,0,0,0,0,0,0,0};
+static const unsigned char jpeg_dc_luminance_values[] = {0,1,2,3,4,5,6,7,8,9,10,11};
+static const unsigned char jpeg_ac_luminance_nrcodes[] = {0,0,2,1,3,3,2,4,3,5,5,4,4,0,0,1,0x7d};
+static const unsigned char jpeg_ac_luminance_values[] = {
+	0x01,0x02,0x03,0x00,0x04,0x11,0x05,0x12,0x21,0x31,0x41,0x06,0x13,0x51,0x61,0x07,0x22,0x71,0x14,0x32,0x81,0x91,0xa1,0x08,
+	0x23,0x42,0xb1,0xc1,0x15,0x52,0xd1,0xf0,0x24,0x33,0x62,0x72,0x82,0x09,0x0a,0x16,0x17,0x18,0x19,0x1a,0x25,0x26,0x27,0x28,
+	0x29,0x2a,0x34,0x35,0x36,0x37,0x38,0x39,0x3a,0x43,0x44,0x45,0x46,0x47,0x48,0x49,0x4a,0x53,0x54,0x55,0x56,0x57,0x58,0x59,
+	0x5a,0x63,0x64,0x65,0x66,0x67,0x68,0x69,0x6a,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7a,0x83,0x84,0x85,0x86,0x87,0x88,0x89,
+	0x8a,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9a,0xa2,0xa3,0xa4,0xa5,0xa6,0xa7,0xa8,0xa9,0xaa,0xb2,0xb3,0xb4,0xb5,0xb6,
+	0xb7,0xb8,0xb9,0xba,0xc2,0xc3,0xc4,0xc5,0xc6,0xc7,0xc8,0xc9,0xca,0xd2,0xd3,0xd4,0xd5,0xd6,0xd7,0xd8,0xd9,0xda,0xe1,0xe2,
+	0xe3,0xe4,0xe5,0xe6,0xe7,0xe8,0xe9,0xea,0xf1,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,0xf9,0xfa
+};
+static const unsigned char jpeg_dc_chrominance_nrcodes[] = {0,0,3,1,1,1,1,1,1,1,1,1,0,0,0,0,0};
+static const unsigned char jpeg_dc_chrominance_values[] = {0,1,2,3,4,5,6,7,8,9,10,11};
+static const unsigned char jpeg_ac_chrominance_nrcodes[] = {0,0,2,1,2,4,4,3,4,7,5,4,4,0,1,2,0x77};
+static const unsigned char jpeg_ac_chrominance_values[] = {
+	0x00,0x01,0x02,0x03,0x11,0x04,0x05,0x21,0x31,0x06,0x12,0x41,0x51,0x07,0x61,0x71,0x13,0x22,0x32,0x81,0x08,0x14,0x42,0x91,
+	0xa1,0xb1,0xc1,0x09,0x23,0x33,0x52,0xf0,0x15,0x62,0x72,0xd1,0x0a,0x16,0x24,0x34,0xe1,0x25,0xf1,0x17,0x18,0x19,0x1a,0x26,
+	0x27,0x28,0x29,0x2a,0x35,0x36,0x37,0x38,0x39,0x3a,0x43,0x44,0x45,0x46,0x47,0x48,0x49,0x4a,0x53,0x54,0x55,0x56,0x57,0x58,
+	0x59,0x5a,0x63,0x64,0x65,0x66,0x67,0x68,0x69,0x6a,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7a,0x82,0x83,0x84,0x85,0x86,0x87,
+	0x88,0x89,0x8a,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9a,0xa2,0xa3,0xa4,0xa5,0xa6,0xa7,0xa8,0xa9,0xaa,0xb2,0xb3,0xb4,
+	0xb5,0xb6,0xb7,0xb8,0xb9,0xba,0xc2,0xc3,0xc4,0xc5,0xc6,0xc7,0xc8,0xc9,0xca,0xd2,0xd3,0xd4,0xd5,0xd6,0xd7,0xd8,0xd9,0xda,
+	0xe2,0xe3,0xe4,0xe5,0xe6,0xe7,0xe8,0xe9,0xea,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,0xf9,0xfa
+};
+
+// Canonical Huffman codes, {code, length} per symbol, from the code counts per length (nrcodes[1..16]).
+static void jpeg_huffman_table(const unsigned char *nrcodes, const unsigned char *values, unsigned short table[256][2]) {
+	memset(table, 0, sizeof(unsigned short) * 256 * 2);
+	u32 code = 0;
+	i32 k = 0;
+	for (i32 length = 1; length <= 16; length++) {
+		for (i32 i = 0; i < nrcodes[length]; i++, k++) {
+			table[values[k]][0] = (unsigned short)code++;
+			table[values[k]][1] = (unsigned short)length;
+		}
+		code <<= 1;
+	}
+}
+
+// 'size' x 'size' pixels at (x, y) of the image to Y, U and V like stb, repeating the last row and
+// column past the edges. 'band' holds the image rows from 'band_y' on, which includes the last one
+// whenever a block reaches past it.
+static void jpeg_load_block(const u8 *band, i32 band_y, i32 w, i32 h, i32 x, i32 y, i32 size, float *Y, float *U, float *V) {
+	for (i32 row = y, pos = 0; row < y + size; row++) {
+		i32 clamped_row = row < h ? row : h - 1;
+		const u8 *line = band + (size_t)(clamped_row - band_y) * w * 4;
+		for (i32 col = x; col < x + size; col++, pos++) {
+			const u8 *p = line + (size_t)(col < w ? col : w - 1) * 4;
+			float r = p[0], g = p[1], b = p[2];
+			Y[pos] = +0.29900f*r + 0.58700f*g + 0.11400f*b - 128;
+			U[pos] = -0.16874f*r - 0.33126f*g + 0.50000f*b;
+			V[pos] = +0.50000f*r - 0.41869f*g - 0.08131f*b;
+		}
+	}
+}
+
+// 'quality' 1..100, above 90 the chroma isn't subsampled (stb's rule).
+static bool jpeg_encode(const Encoder_Source *source, i32 quality, Encoder_Write_Func *write, void *user) {
+	static const int YQT[] = {16,11,10,16,24,40,51,61,12,12,14,19,26,58,60,55,14,13,16,24,40,57,69,56,14,17,22,29,51,87,80,62,18,22,
+	                          37,56,68,109,103,77,24,35,55,64,81,104,113,92,49,64,78,87,103,121,120,101,72,92,95,98,112,100,103,99};
+	static const int UVQT[] = {17,18,24,47,99,99,99,99,18,21,26,66,99,99,99,99,24,26,56,99,99,99,99,99,47,66,99,99,99,99,99,99,
+	                           99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99};
+	static const float aasf[] = { 1.0f * 2.828427125f, 1.387039845f * 2.828427125f, 1.306562965f * 2.828427125f, 1.175875602f * 2.828427125f,
+	                              1.0f * 2.828427125f, 0.785694958f * 2.828427125f, 0.541196100f * 2.828427125f, 0.275899379f * 2.828427125f };
+	static const unsigned short fill_bits[] = {0x7F, 7};
+	i32 w = source->w;
+	i32 h = source->h;
+	if (w > 65535 || h > 65535) return false; // JPEG stores 16 bit dimensions
+
+	unsigned short YDC_HT[256][2], UVDC_HT[256][2], YAC_HT[256][2], UVAC_HT[256][2];
+	jpeg_huffman_table(jpeg_dc_luminance_nrcodes, jpeg_dc_luminance_values, YDC_HT);
+	jpeg_huffman_table(jpeg_dc_chrominance_nrcodes, jpeg_dc_chrominance_values, UVDC_HT);
+	jpeg_huffman_table(jpeg_ac_luminance_nrcodes, jpeg_ac_luminance_values, YAC_HT);
+	jpeg_huffman_table(jpeg_ac_chrominance_nrcodes, jpeg_ac_chrominance_values, UVAC_HT);
+
+	bool subsample = quality <= 90;
+	quality = clamp(quality, 1, 100);
+	quality = quality < 50 ? 5000 / quality : 200 - quality * 2;
+	float fdtbl_Y[64], fdtbl_UV[64];
+	unsigned char YTable[64], UVTable[64];
+	for (i32 i = 0; i < 64; i++) {
+		int yti = (YQT[i] * quality + 50) / 100;
+		YTable[stbiw__jpg_ZigZag[i]] = (unsigned char)(yti < 1 ? 1 : yti > 255 ? 255 : yti);
+		int uvti = (UVQT[i] * quality + 50) / 100;
+		UVTable[stbiw__jpg_ZigZag[i]] = (unsigned char)(uvti < 1 ? 1 : uvti > 255 ? 255 : uvti);
+	}
+	for (i32 row = 0, k = 0; row < 8; row++) {
+		for (i32 col = 0; col < 8; col++, k++) {
+			fdtbl_Y[k]  = 1 / (YTable [stbiw__jpg_ZigZag[k]] * aasf[row] * aasf[col]);
+			fdtbl_UV[k] = 1 / (UVTable[stbiw__jpg_ZigZag[k]] * aasf[row] * aasf[col]);
+		}
+	}
+
+	u8 *band = (u8 *)malloc((size_t)w * 4 * min(h, JPEG_BAND_ROWS));
+	if (!band) return false;
+	Encoder_Sink sink = { write, user, true };
+	stbi__write_context s = {};
+	stbi__start_write_callbacks(&s, jpeg_write_callback, &sink);
+
+	static const unsigned char head0[] = { 0xFF,0xD8,0xFF,0xE0,0,0x10,'J','F','I','F',0,1,1,0,0,1,0,1,0,0,0xFF,0xDB,0,0x84,0 };
+	static const unsigned char head2[] = { 0xFF,0xDA,0,0xC,3,1,0,2,0x11,3,0x11,0,0x3F,0 };
+	const unsigned char head1[] = { 0xFF,0xC0,0,0x11,8,(unsigned char)(h>>8),STBIW_UCHAR(h),(unsigned char)(w>>8),STBIW_UCHAR(w),
+	                                3,1,(unsigned char)(subsample?0x22:0x11),0,2,0x11,1,3,0x11,1,0xFF,0xC4,0x01,0xA2,0 };
+	s.func(s.context, (void *)head0, sizeof(head0));
+	s.func(s.context, (void *)YTable, sizeof(YTable));
+	stbiw__putc(&s, 1);
+	s.func(s.context, UVTable, sizeof(UVTable));
+	s.func(s.context, (void *)head1, sizeof(head1));
+	s.func(s.context, (void *)(jpeg_dc_luminance_nrcodes + 1), sizeof(jpeg_dc_luminance_nrcodes) - 1);
+	s.func(s.context, (void *)jpeg_dc_luminance_values, sizeof(jpeg_dc_luminance_values));
+	stbiw__putc(&s, 0x10); // HTYACinfo
+	s.func(s.context, (void *)(jpeg_ac_luminance_nrcodes + 1), sizeof(jpeg_ac_luminance_nrcodes) - 1);
+	s.func(s.context, (void *)jpeg_ac_luminance_values, sizeof(jpeg_ac_luminance_values));
+	stbiw__putc(&s, 1); // HTUDCinfo
+	s.func(s.context, (void *)(jpeg_dc_chrominance_nrcodes + 1), sizeof(jpeg_dc_chrominance_nrcodes) - 1);
+	s.func(s.context, (void *)jpeg_dc_chrominance_values, sizeof(jpeg_dc_chrominance_values));
+	stbiw__putc(&s, 0x11); // HTUACinfo
+	s.func(s.context, (void *)(jpeg_ac_chrominance_nrcodes + 1), sizeof(jpeg_ac_chrominance_nrcodes) - 1);
+	s.func(s.context, (void *)jpeg_ac_chrominance_values, sizeof(jpeg_ac_chrominance_values));
+	s.func(s.context, (void *)head2, sizeof(head2));
+
+	int DCY = 0, DCU = 0, DCV = 0;
+	int bitBuf = 0, bitCnt = 0;
+	for (i32 band_y = 0; sink.ok && band_y < h; band_y += JPEG_BAND_ROWS) {
+		i32 rows = min(JPEG_BAND_ROWS, h - band_y);
+		if (!source->rows(source->user, band_y, rows, band, (size_t)w * 4)) {
+			sink.ok = false;
+			break;
+		}
+		if (subsample) {
+			for (i32 y = band_y; y < band_y + rows; y += 16) {
+				for (i32 x = 0; x < w; x += 16) {
+					float Y[256], U[256], V[256];
+					jpeg_load_block(band, band_y, w, h, x, y, 16, Y, U, V);
+					DCY = stbiw__jpg_processDU(&s, &bitBuf, &bitCnt, Y+0,   16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+					DCY = stbiw__jpg_processDU(&s, &bitBuf, &bitCnt, Y+8,   16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+					DCY = stbiw__jpg_processDU(&s, &bitBuf, &bitCnt, Y+128, 16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+					DCY = stbiw__jpg_processDU(&s, &bitBuf, &bitCnt, Y+136, 16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+					float subU[64], subV[64];
+					for (i32 yy = 0, pos = 0; yy < 8; yy++) {
+						for (i32 xx = 0; xx < 8; xx++, pos++) {
+							i32 j = yy*32 + xx*2;
+							subU[pos] = (U[j+0] + U[j+1] + U[j+16] + U[j+17]) * 0.25f;
+							subV[pos] = (V[j+0] + V[j+1] + V[j+16] + V[j+17]) * 0.25f;
+						}
+					}
+					DCU = stbiw__jpg_processDU(&s, &bitBuf, &bitCnt, subU, 8, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
+					DCV = stbiw__jpg_processDU(&s, &bitBuf, &bitCnt, subV, 8, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
+				}
+			}
+		} else {
+			for (i32 y = band_y; y < band_y + rows; y += 8) {
+				for (i32 x = 0; x < w; x += 8) {
+					float Y[64], U[64], V[64];
+					jpeg_load_block(band, band_y, w, h, x, y, 8, Y, U, V);
+					DCY = stbiw__jpg_processDU(&s, &bitBuf, &bitCnt, Y, 8, fdtbl_Y,  DCY, YDC_HT, YAC_HT);
+					DCU = stbiw__jpg_processDU(&s, &bitBuf, &bitCnt, U, 8, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
+					DCV = stbiw__jpg_processDU(&s, &bitBuf, &bitCnt, V, 8, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
+				}
+			}
+		}
+	}
+	stbiw__jpg_writeBits(&s, &bitBuf, &bitCnt, fill_bits); // bit alignment of the EOI marker
+	stbiw__putc(&s, 0xFF);
+	stbiw__putc(&s, 0xD9);
+	free(band);
+	return sink.ok;
+}
+
+//
+// WebP. libwebp wants the whole picture before it starts, so the rows are converted into the
+// picture's own ARGB buffer a band at a time rather than into an RGBA copy that is then imported.
+// Lossy encoding converts that to YUV the same way WebPPictureImportRGBA would have.
+//
+
+#define WEBP_BAND_ROWS 256
+
+// 'quality' (1..100) is the lossy quality. For lossless libwebp takes it as the effort to put into
+// compression, the default 75 is used there.
+static bool webp_encode(const Encoder_Source *source, bool lossless, i32 quality, Encoder_Write_Func *write, void *user) {
+	WebPConfig config;
+	WebPPicture picture;
+	Encoder_Sink sink = { write, user, true };
+	i32 w = source->w;
+	i32 h = source->h;
+	if (w > WEBP_MAX_DIMENSION || h > WEBP_MAX_DIMENSION)
+		return false;
+	if (!WebPConfigInit(&config) || !WebPPictureInit(&picture))
+		return false;
+	config.lossless = lossless;
+	config.quality = lossless ? 75.0f : (f32)clamp(quality, 1, 100);
+	config.thread_level = 1; // analysis and filtering on a second thread
+	config.exact = lossless; // keep RGB under transparent pixels, like the PNG path does
+	picture.use_argb = 1;
+	picture.width = w;
+	picture.height = h;
+	picture.writer = webp_write_callback;
+	picture.custom_ptr = &sink;
+	if (!WebPPictureAlloc(&picture))
+		return false;
+
+	bool ok = true;
+	u8 *band = (u8 *)malloc((size_t)w * 4 * min(h, WEBP_BAND_ROWS));
+	if (!band) ok = false;
+	for (i32 band_y = 0; ok && band_y < h; band_y += WEBP_BAND_ROWS) {
+		i32 rows = min(WEBP_BAND_ROWS, h - band_y);
+		ok = source->rows(source->user, band_y, rows, band, (size_t)w * 4);
+		for (i32 y = 0; ok && y < rows; y++) {
+			const u8 *src = band + (size_t)y * w * 4;
+			uint32_t *dst = picture.argb + (size_t)(band_y + y) * picture.argb_stride;
+			for (i32 x = 0; x < w; x++, src += 4)
+				dst[x] = ((uint32_t)src[3] << 24) | ((uint32_t)src[0] << 16) | ((uint32_t)src[1] << 8) | src[2];
+		}
+	}
+	free(band);
+	if (ok) ok = WebPEncode(&config, &picture) != 0;
+	WebPPictureFree(&picture);
+	return ok && sink.ok;
+}
+
+static bool encode_image(Encoder_Format encoder_format, const Encoder_Source *source, i32 quality,
+                         Encoder_Write_Func *write, void *user) {
+	if (!source->rows || source->w <= 0 || source->h <= 0) return false;
+	Pixel_Format format = source->format;
+	if (format != Pixel_Rgba8 && !(format == Pixel_Rgba16 && encoder_supports_rgba16(encoder_format))) return false;
+	switch (encoder_format) {
+		case Format_Png:
+			return png_encode(source, write, user);
+		case Format_Jpeg:
+			return jpeg_encode(source, quality, write, user);
+		case Format_Webp:
+			return webp_encode(source, false, quality, write, user);
+		case Format_Webp_Lossless:
+			return webp_encode(source, true, quality, write, user);
+		default:
+			return false;
+	}
+}
@@ -0,0 +1,395 @@
+#include <immintrin.h>
+#ifndef PF_AVX2_INSTRUCTIONS_AVAILABLE
+#define PF_AVX2_INSTRUCTIONS_AVAILABLE 40
+#endif
+
+// Animated GIF decoding that keeps every frame in its native 8-bit indexed form. Only the frame on
+// screen gets composited to RGBA (gif_anim_seek), instead of holding all frames expanded in memory.
+// Compositing follows stbi__gif_load_next (disposal modes included), except that the background
+// fill uses the palette in RGB order and "restore to previous" reads the right frame.
+
+struct Gif_Frame {
+	i32 x, y, w, h;       // image descriptor rect inside the canvas
+	u8 *indices;          // w*h palette indices, already de-interlaced
+	u32 palette[256];     // RGBA, the transparent entry has alpha 0
+	i32 transparent;      // -1 if the frame has no transparent index
+	i32 dispose;
+};
+
+struct Gif_Anim {
+	i32 w, h;
+	Gif_Frame *frames;
+	i32 frame_count;
+	i32 frames_allocated;
+	bool has_bg;
+	u32 bg_color;         // fill for the canvas area the first frame doesn't cover
+	bool uses_previous;   // some frame disposes to previous, we need to keep one more canvas
+
+	int *delays;          // handed over to G->anim_frame_delays
+	Anim_Rect *dirty_rects; // handed over to G->anim_dirty_rects
+
+	u8 *canvas;           // composited RGBA of frame 'current'
+	u8 *background;       // canvas after disposal, before 'current' was drawn
+	u8 *previous;         // composited RGBA of frame 'current - 1'
+	u8 *scratch;
+	i32 current;          // -1 before the first seek
+};
+
+static bool gif_use_avx2 = false;
+
+static inline u32 gif_color(u8 r, u8 g, u8 b, u8 a) {
+	return r | (g << 8) | (b << 16) | ((u32)a << 24);
+}
+
+// Palette lookup of one row: dst[i] = palette[src[i]], except transparent indices leave dst alone.
+static void gif_expand_row(u32 *dst, const u8 *src, int count, const u32 *palette, i32 transparent) {
+	int i = 0;
+	if (gif_use_avx2) {
+		__m256i t = _mm256_set1_epi32(transparent);
+		for (; i + 8 <= count; i += 8) {
+			__m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i)));
+			__m256i col = _mm256_i32gather_epi32((const int *)palette, idx, 4);
+			__m256i old = _mm256_loadu_si256((const __m256i *)(dst + i));
+			__m256i keep = _mm256_cmpeq_epi32(idx, t);
+			_mm256_storeu_si256((__m256i *)(dst + i), _mm256_blendv_epi8(col, old, keep));
+		}
+	} else {
+		// SSE2 has no gather, but the transparency blend is still done 16 pixels at a time
+		__m128i t = _mm_set1_epi8((char)transparent);
+		for (; i + 16 <= count; i += 16) {
+			const u8 *s = src + i;
+			__m128i keep8  = transparent < 0 ? _mm_setzero_si128() : _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)s), t);
+			__m128i keep16[2] = { _mm_unpacklo_epi8(keep8, keep8), _mm_unpackhi_epi8(keep8, keep8) };
+			for (int q = 0; q < 4; q++) {
+				__m128i keep = (q & 1) ? _mm_unpackhi_epi16(keep16[q >> 1], keep16[q >> 1])
+				                       : _mm_unpacklo_epi16(keep16[q >> 1], keep16[q >> 1]);
+				__m128i col = _mm_setr_epi32(palette[s[q*4 + 0]], palette[s[q*4 + 1]],
+				                             palette[s[q*4 + 2]], palette[s[q*4 + 3]]);
+				__m128i old = _mm_loadu_si128((const __m128i *)(dst + i + q*4));
+				__m128i res = _mm_or_si128(_mm_and_si128(keep, old), _mm_andnot_si128(keep, col));
+				_mm_storeu_si128((__m128i *)(dst + i + q*4), res);
+			}
+		}
+	}
+	for (; i < count; i++) {
+		if (src[i] != transparent) dst[i] = palette[src[i]];
+	}
+}
+
+static void gif_copy_rect(u8 *dst, const u8 *src, int canvas_w, i32 x, i32 y, i32 w, i32 h) {
+	for (i32 row = y; row < y + h; row++) {
+		u64 offset = ((u64)row * canvas_w + x) * 4;
+		memcpy(dst + offset, src + offset, w * 4);
+	}
+}
+
+static void gif_draw_frame(Gif_Anim *anim, Gif_Frame *frame) {
+	for (i32 row = 0; row < frame->h; row++) {
+		u32 *dst = (u32 *)anim->canvas + (u64)(frame->y + row) * anim->w + frame->x;
+		gif_expand_row(dst, frame->indices + (u64)row * frame->w, frame->w, frame->palette, frame->transparent);
+	}
+}
+
+// Advances the canvas from frame 'current' to 'current + 1'.
+static void gif_step(Gif_Anim *anim) {
+	u64 canvas_size = (u64)anim->w * anim->h * 4;
+	i32 next = anim->current + 1;
+	Gif_Frame *frame = &anim->frames[next];
+
+	if (next == 0) {
+		memset(anim->canvas, 0, canvas_size);
+		if (anim->has_bg) {
+			u32 *px = (u32 *)anim->canvas;
+			for (u64 i = 0; i < (u64)anim->w * anim->h; i++) px[i] = anim->bg_color;
+			// the first frame's rect stays transparent where the frame itself is transparent
+			for (i32 row = frame->y; row < frame->y + frame->h; row++)
+				memset(px + (u64)row * anim->w + frame->x, 0, frame->w * 4);
+		}
+		memcpy(anim->background, anim->canvas, canvas_size);
+	} else {
+		Gif_Frame *prev = &anim->frames[anim->current];
+		i32 dispose = prev->dispose;
+		if (dispose == 3 && next < 2) dispose = 2; // nothing to revert to yet
+		if (anim->uses_previous) memcpy(anim->scratch, anim->canvas, canvas_size);
+
+		if (dispose == 3)
+			gif_copy_rect(anim->canvas, anim->previous, anim->w, prev->x, prev->y, prev->w, prev->h);
+		else if (dispose == 2)
+			gif_copy_rect(anim->canvas, anim->background, anim->w, prev->x, prev->y, prev->w, prev->h);
+
+		// background only ever differed from the canvas inside the previous frame's rect
+		gif_copy_rect(anim->background, anim->canvas, anim->w, prev->x, prev->y, prev->w, prev->h);
+
+		if (anim->uses_previous) swap(u8 *, anim->previous, anim->scratch);
+	}
+
+	gif_draw_frame(anim, frame);
+	anim->current = next;
+}
+
+// Returns the RGBA pixels of frame 'index'. Stepping forward is incremental, seeking backwards
+// replays the animation from the first frame.
+static u8 *gif_anim_seek(Gif_Anim *anim, i32 index) {
+	index = clamp(index, 0, anim->frame_count - 1);
+	if (index < anim->current) anim->current = -1;
+	while (anim->current < index) gif_step(anim);
+	return anim->canvas;
+}
+
+static void gif_anim_free(Gif_Anim *anim) {
+	for (i32 i = 0; i < anim->frame_count; i++)
+		free(anim->frames[i].indices);
+	free(anim->frames);
+	free(anim->delays);
+	free(anim->dirty_rects);
+	free(anim->canvas);
+	free(anim->background);
+	free(anim->previous);
+	free(anim->scratch);
+	memset(anim, 0, sizeof(*anim));
+}
+
+struct Gif_Raster {
+	u8 *out;
+	i32 w, h;
+	i32 x, y;
+	i32 step, pass;
+};
+
+static void gif_out_code(Gif_Raster *r, stbi__gif_lzw *codes, i32 code) {
+	u8 stack[8192];
+	int n = 0;
+	for (i32 c = code; c >= 0 && n < (int)sizeof(stack); c = codes[c].prefix)
+		stack[n++] = codes[c].suffix;
+	while (n--) {
+		if (r->y >= r->h) return;
+		r->out[(u64)r->y * r->w + r->x] = stack[n];
+		if (++r->x >= r->w) {
+			r->x = 0;
+			r->y += r->step;
+			while (r->y >= r->h && r->pass > 0) {
+				r->step = 1 << r->pass;
+				r->y = r->step >> 1;
+				--r->pass;
+			}
+		}
+	}
+}
+
+// LZW decoder of stbi__process_gif_raster, writing palette indices instead of RGBA.
+static bool gif_decode_raster(stbi__context *s, stbi__gif_lzw *codes, Gif_Raster *r) {
+	i32 lzw_cs = stbi__get8(s);
+	if (lzw_cs > 12) return false;
+	i32 clear = 1 << lzw_cs;
+	bool first = true;
+	i32 codesize = lzw_cs + 1;
+	i32 codemask = (1 << codesize) - 1;
+	i32 bits = 0, valid_bits = 0;
+	for (i32 i = 0; i < clear; i++) {
+		codes[i].prefix = -1;
+		codes[i].first = (u8)i;
+		codes[i].suffix = (u8)i;
+	}
+	i32 avail = clear + 2;
+	i32 oldcode = -1;
+	i32 len = 0;
+	for (;;) {
+		if (valid_bits < codesize) {
+			if (len == 0) {
+				len = stbi__get8(s); // start new block
+				if (len == 0) return true;
+			}
+			--len;
+			bits |= (i32)stbi__get8(s) << valid_bits;
+			valid_bits += 8;
+			continue;
+		}
+		i32 code = bits & codemask;
+		bits >>= codesize;
+		valid_bits -= codesize;
+		if (code == clear) {
+			codesize = lzw_cs + 1;
+			codemask = (1 << codesize) - 1;
+			avail = clear + 2;
+			oldcode = -1;
+			first = false;
+		} else if (code == clear + 1) { // end of stream
+			stbi__skip(s, len);
+			while ((len = stbi__get8(s)) > 0) stbi__skip(s, len);
+			return true;
+		} else if (code <= avail) {
+			if (first) return false;
+			if (oldcode >= 0) {
+				stbi__gif_lzw *p = &codes[avail++];
+				if (avail > 8192) return false;
+				p->prefix = (stbi__int16)oldcode;
+				p->first = codes[oldcode].first;
+				p->suffix = (code == avail) ? p->first : codes[code].first;
+			} else if (code == avail) {
+				return false;
+			}
+			gif_out_code(r, codes, code);
+			if ((avail & codemask) == 0 && avail <= 0x0FFF) {
+				codesize++;
+				codemask = (1 << codesize) - 1;
+			}
+			oldcode = code;
+		} else {
+			return false;
+		}
+	}
+}
+
+static int gif_anim_read_file(wchar_t *path, Gif_Anim *anim) {
+	int ok = 0;
+	int comp;
+	i32 eflags = 0, delay = 0, transparent = -1;
+	u32 global_palette[256] = {0};
+	stbi__context s;
+	stbi__gif *g = nullptr;
+
+	memset(anim, 0, sizeof(*anim));
+	anim->current = -1;
+	gif_use_avx2 = IsProcessorFeaturePresent(PF_AVX2_INSTRUCTIONS_AVAILABLE);
+
+	FILE *file = _wfopen(path, L"rb");
+	if (!file) return 0;
+	stbi__start_file(&s, file);
+
+	g = (stbi__gif *)calloc(1, sizeof(stbi__gif)); // the LZW table is too big for the stack
+	if (!g || !stbi__gif_header(&s, g, &comp, 0)) goto cleanup;
+	anim->w = g->w;
+	anim->h = g->h;
+	if (anim->w <= 0 || anim->h <= 0) goto cleanup;
+
+	for (int i = 0; i < 256; i++)
+		global_palette[i] = gif_color(g->pal[i][2], g->pal[i][1], g->pal[i][0], 255);
+	if (g->bgindex > 0) {
+		anim->has_bg = true;
+		anim->bg_color = global_palette[g->bgindex];
+	}
+
+	for (bool done = false; !done;) {
+		int tag = stbi__get8(&s);
+		switch (tag) {
+		case 0x2C: { // Image Descriptor
+			i32 x = stbi__get16le(&s);
+			i32 y = stbi__get16le(&s);
+			i32 w = stbi__get16le(&s);
+			i32 h = stbi__get16le(&s);
+			if (x + w > anim->w || y + h > anim->h) { done = true; break; }
+			i32 lflags = stbi__get8(&s);
+
+			if (anim->frame_count == anim->frames_allocated) {
+				i32 allocated = anim->frames_allocated + 30;
+				Gif_Frame *frames = (Gif_Frame *)realloc(anim->frames, allocated * sizeof(Gif_Frame));
+				int *delays = (int *)realloc(anim->delays, allocated * sizeof(int));
+				if (frames) anim->frames = frames;
+				if (delays) anim->delays = delays;
+				if (!frames || !delays) { done = true; break; }
+				anim->frames_allocated = allocated;
+			}
+			Gif_Frame *frame = &anim->frames[anim->frame_count];
+			memset(frame, 0, sizeof(*frame));
+			frame->x = x; frame->y = y; frame->w = w; frame->h = h;
+			frame->transparent = (eflags & 0x01) ? transparent : -1;
+			frame->dispose = (eflags & 0x1C) >> 2;
+
+			if (lflags & 0x80) {
+				int entries = 2 << (lflags & 7);
+				for (int i = 0; i < entries; i++) {
+					u8 r = stbi__get8(&s), gr = stbi__get8(&s), b = stbi__get8(&s);
+					frame->palette[i] = gif_color(r, gr, b, 255);
+				}
+			} else if (g->flags & 0x80) {
+				memcpy(frame->palette, global_palette, sizeof(global_palette));
+			} else {
+				done = true; // missing color table
+				break;
+			}
+			if (frame->transparent >= 0) frame->palette[frame->transparent] &= 0x00FFFFFF;
+
+			frame->indices = (u8 *)malloc((u64)w * h + 1);
+			if (!frame->indices) { done = true; break; }
+			// pixels a truncated stream never reaches keep whatever was below them
+			memset(frame->indices, frame->transparent >= 0 ? frame->transparent : 0, (u64)w * h);
+
+			Gif_Raster raster = { frame->indices, w, h, 0, 0, 1, 0 };
+			if (lflags & 0x40) {
+				raster.step = 8; // interlaced
+				raster.pass = 3;
+			}
+			if (w == 0) raster.y = h;
+			if (!gif_decode_raster(&s, g->codes, &raster)) {
+				free(frame->indices);
+				done = true;
+				break;
+			}
+			if (frame->dispose == 3) anim->uses_previous = true;
+			anim->delays[anim->frame_count] = delay;
+			anim->frame_count++;
+		} break;
+
+		case 0x21: { // Extension
+			int len;
+			int ext = stbi__get8(&s);
+			if (ext == 0xF9) { // Graphic Control Extension
+				len = stbi__get8(&s);
+				if (len == 4) {
+					eflags = stbi__get8(&s);
+					delay = 10 * stbi__get16le(&s); // 1/100th of a second, saving as 1/1000ths
+					transparent = stbi__get8(&s);
+				} else {
+					stbi__skip(&s, len);
+					break;
+				}
+			}
+			while ((len = stbi__get8(&s)) != 0)
+				stbi__skip(&s, len);
+		} break;
+
+		default: // 0x3B is the regular end of the stream, anything else is corruption
+			done = true;
+			break;
+		}
+	}
+	if (anim->frame_count == 0) goto cleanup;
+
+	// Dirty rects for stepping forward: the frame's own rect, plus the previous one if its
+	// disposal restored something.
+	anim->dirty_rects = (Anim_Rect *)malloc(anim->frame_count * sizeof(Anim_Rect));
+	if (!anim->dirty_rects) goto cleanup;
+	anim->dirty_rects[0] = { 0, 0, anim->w, anim->h };
+	for (i32 i = 1; i < anim->frame_count; i++) {
+		Gif_Frame *frame = &anim->frames[i], *prev = &anim->frames[i - 1];
+		Anim_Rect r = { frame->x, frame->y, frame->w, frame->h };
+		if (prev->dispose == 2 || prev->dispose == 3) {
+			i32 x1 = max(r.x + r.w, prev->x + prev->w);
+			i32 y1 = max(r.y + r.h, prev->y + prev->h);
+			r.x = min(r.x, prev->x);
+			r.y = min(r.y, prev->y);
+			r.w = x1 - r.x;
+			r.h = y1 - r.y;
+		}
+		anim->dirty_rects[i] = r;
+	}
+
+	{
+		u64 canvas_size = (u64)anim->w * anim->h * 4;
+		anim->canvas     = (u8 *)malloc(canvas_size);
+		anim->background = (u8 *)malloc(canvas_size);
+		if (anim->uses_previous) {
+			anim->previous = (u8 *)calloc(1, canvas_size);
+			anim->scratch  = (u8 *)malloc(canvas_size);
+		}
+		if (!anim->canvas || !anim->background || (anim->uses_previous && (!anim->previous || !anim->scratch)))
+			goto cleanup;
+	}
+	ok = 1;
+
+cleanup:
+	free(g);
+	fclose(file);
+	if (!ok) gif_anim_free(anim);
+	return ok;
+}
@@ -1,6 +1,6 @@
 #define UI_MAX_STRING_LEN 256
 #define ARRAY_SIZE(x)  (sizeof(x) / sizeof((x)[0]))
-#define UI_hash_formatted(__ctx__, ...) UI_hash_djb2(__ctx__, UI_sprintf(&__ctx__->strings, __VA_ARGS__))
+#define UI_hash_formatted(__ctx__, ...) UI_hash_djb2(__ctx__, UI_tprintf(__ctx__, __VA_ARGS__))
 #define UI_push_parent_defer(__ctx__, __parent__) for (int _i_ = 1, j = UI_push_parent(__ctx__, __parent__); _i_; _i_ = 0, UI_pop_parent(__ctx__))
 
 UI_Theme *UI_get_theme() {
@@ -196,7 +196,7 @@ UI_Block* UI_text(UI_Color4 color, UI_Font* font, u32 size, char* text, ...) {
 	content->style.font = font;
 	content->style.color[c_text] = color;
 	content->style.font_size = size;
-	content->string = string;
+	UI_block_set_string(ctx, content, string);
 	content->flags |= UI_Block_Flags_draw_text;
 	content->hash = UI_hash_formatted(ctx, "%s#__UI_TEXT__", string);
 
@@ -290,7 +290,7 @@ bool UI_button(UI_Button_Style *style, char* name, ...) {
 		inner_block->style.softness = 0;
 		box->style.softness = 0;
 	} else {
-		inner_block->string = formatted_name;
+		UI_block_set_string(ctx, inner_block, formatted_name);
 		inner_block->flags |= UI_Block_Flags_draw_text;
 		inner_block->style.font = style->font;
 		inner_block->style.font_size = style->font_size;
@@ -563,8 +563,7 @@ bool UI_color_picker(UI_Color_Picker_Style *style, u32 *color, bool with_alpha,
 
 		popup->depth_level = button->depth_level + 200;
 		popup->hash = UI_hash_djb2(ctx, "popup", button->hash);
-		popup->flags |= UI_Block_Flags_hit_test;
-		G->check_mouse_hashes.push_back(popup->hash);
+		popup->flags |= UI_Block_Flags_hit_test | UI_Block_Flags_capture_mouse;
 
 		UI_push_parent_defer(ctx, popup) {
 			UI_push_parent_defer(ctx, UI_bar(axis_x)) {
@@ -1304,6 +1303,11 @@ struct UI_Image_Edit_Style {
 };
 
 static void reset_image_edit();
+static void load_cube_lut_dialogue();
+static void clear_grading_lut();
+static void batch_export_dialogue();
+static void save_edit_preset_dialogue();
+static void load_edit_preset_dialogue();
 
 bool UI_image_edit(UI_Image_Edit_Style *style, char* label) {
 	UI_Context *ctx = G->ui;
@@ -1333,8 +1337,7 @@ bool UI_image_edit(UI_Image_Edit_Style *style, char* label) {
 		UI_Block *popup = UI_push_block(ctx, 0);
 		popup->depth_level = UI_get_current_parent(ctx)->depth_level + 200;
 		popup->hash = UI_hash_djb2(ctx, "popup", hash);
-		popup->flags |= UI_Block_Flags_hit_test;
-		G->check_mouse_hashes.push_back(popup->hash);
+		popup->flags |= UI_Block_Flags_hit_test | UI_Block_Flags_capture_mouse;
 		UI_Block *pop_prv = UI_find_block(ctx, popup->hash, UI_PREVIOUS);
 		if (pop_prv) {
 			if (!UI_mouse_in_block_force(pop_prv) && keydn(MouseL)) {
@@ -1441,7 +1444,7 @@ bool UI_image_edit(UI_Image_Edit_Style *style, char* label) {
 				}
 			}
 			UI_checkbox(&style->checkbox_style, &G->srgb, "Render base colors in sRGB");
-			UI_checkbox(&style->checkbox_style,(bool*)(&G->do_blur), "Gaussian blur (GPU intensive)");
+			UI_checkbox(&style->checkbox_style,(bool*)(&G->do_blur), "Gaussian blur");
 			bool prev_disabled = G->gui_disabled;
 			if (!G->do_blur)
 				G->gui_disabled = true;
@@ -1481,6 +1484,78 @@ bool UI_image_edit(UI_Image_Edit_Style *style, char* label) {
 				}
 			}
 			G->gui_disabled = prev_disabled;
+			UI_push_parent_defer(ctx, UI_bar(axis_x)) {
+				UI_get_current_parent(ctx)->style.layout.align[axis_y] = align_center;
+				UI_push_parent_defer(ctx, UI_bar(axis_x)) {
+					UI_get_current_parent(ctx)->style.size[axis_x] = {UI_Size_t::percent_of_parent, text_bar_frac, 0};
+					UI_text(style->color_text, G->ui_font, style->button_style.font_size, "Quality:");
+				}
+				UI_push_parent_defer(ctx, UI_bar(axis_x)) {
+					UI_get_current_parent(ctx)->style.layout.align[axis_x] = align_end;
+					sprintf(style->slider_style.string, "%i", G->export_quality);
+					style->slider_style.snap_value = 90;
+					style->slider_style.snap_range = 2;
+					style->slider_style.reset_value = 90;
+					style->slider_style.logarithmic = false;
+					float t_quality = G->export_quality;
+					UI_slider(&style->slider_style, axis_x, &t_quality, 1, 100, UI_hash_formatted(ctx, "%s_export_quality", label));
+					G->export_quality = clamp((i32)(t_quality + 0.5f), 1, 100);
+					UI_tooltip("JPEG and WebP quality when saving, right click to reset", 20);
+				}
+			}
+			UI_push_parent_defer(ctx, UI_bar(axis_x)) {
+				auto bar = UI_get_current_parent(ctx);
+				bar->style.layout.align[axis_x] = align_center;
+				bar->style.size[axis_x] = { UI_Size_t::percent_of_parent, 1, 1 };
+				UI_Button_Style lut_style = style->button_style;
+				lut_style.size.x = 120;
+				if (UI_button(&lut_style, "Load .cube LUT"))
+					load_cube_lut_dialogue();
+				UI_tooltip("applied after the edits above, kept across images", 20);
+				UI_spacer_hor(20);
+				if (!G->grading_lut.data)
+					G->gui_disabled = true;
+				if (UI_button(&lut_style, "Clear LUT"))
+					clear_grading_lut();
+				G->gui_disabled = prev_disabled;
+			}
+			if (G->grading_lut.data)
+				UI_text(style->color_text, G->ui_font, style->button_style.font_size, "LUT: %s", G->grading_lut.name);
+			UI_push_parent_defer(ctx, UI_bar(axis_x)) {
+				auto bar = UI_get_current_parent(ctx);
+				bar->style.layout.align[axis_x] = align_center;
+				bar->style.size[axis_x] = { UI_Size_t::percent_of_parent, 1, 1 };
+				UI_Button_Style preset_style = style->button_style;
+				preset_style.size.x = 120;
+				if (UI_button(&preset_style, "Save preset"))
+					save_edit_preset_dialogue();
+				UI_spacer_hor(20);
+				if (UI_button(&preset_style, "Load preset"))
+					load_edit_preset_dialogue();
+			}
+			UI_push_parent_defer(ctx, UI_bar(axis_x)) {
+				auto bar = UI_get_current_parent(ctx);
+				bar->style.layout.align[axis_x] = align_center;
+				bar->style.size[axis_x] = { UI_Size_t::percent_of_parent, 1, 1 };
+				UI_Button_Style batch_style = style->button_style;
+				batch_style.size.x = 120;
+				if (G->batch) {
+					UI_text(style->color_text, G->ui_font, style->button_style.font_size, "Exporting %ld / %d",
+					        G->batch->done + G->batch->failed, G->batch->inputs.Count);
+					UI_spacer_hor(20);
+					if (UI_button(&batch_style, "Cancel"))
+						G->batch->cancel = true;
+				} else {
+					char format_label[32];
+					sprintf(format_label, "Format: %s", encoder_formats_str[G->batch_format]);
+					if (UI_button(&batch_style, format_label))
+						G->batch_format = (Encoder_Format)((G->batch_format + 1) % Format_Count);
+					UI_spacer_hor(20);
+					if (UI_button(&batch_style, "Batch export..."))
+						batch_export_dialogue();
+					UI_tooltip("applies the edits above to many files, without the GPU", 20);
+				}
+			}
 		}
 		popup->style.size[axis_x] = { UI_Size_t::pixels, 300, 1.0f };
 		popup->style.size[axis_y] = { UI_Size_t::sum_of_children, 1, 1.f };
@@ -1538,8 +1613,7 @@ bool UI_files_reload_menu(UI_Button_Style *button_style, UI_Button_Style *button
 		UI_Block *popup = UI_push_block(ctx, 0);
 		popup->depth_level = UI_get_current_parent(ctx)->depth_level + 200;
 		popup->hash = UI_hash_djb2(ctx, "popup", hash);
-		popup->flags |= UI_Block_Flags_hit_test;
-		G->check_mouse_hashes.push_back(popup->hash);
+		popup->flags |= UI_Block_Flags_hit_test | UI_Block_Flags_capture_mouse;
 		UI_Block *pop_prv = UI_find_block(ctx, popup->hash, UI_PREVIOUS);
 		if (pop_prv) {
 			if (!UI_mouse_in_block_force(pop_prv) && keydn(MouseL)) {
@@ -1621,7 +1695,7 @@ bool UI_histogram(UI_Histogram_Style *style, char* label) {
 		if (!G->graphics.main_image.has_histo)
 			UI_tooltip("no histogram loaded for this image, reload to calculate");
 		else
-			UI_tooltip("show original image's histogram");
+			UI_tooltip("show the image's histogram, before or after edits");
 	} else {
 		UI_tooltip("this is disabled from settings. you can change it in 'config'");
 	}
@@ -1631,8 +1705,7 @@ bool UI_histogram(UI_Histogram_Style *style, char* label) {
 		UI_Block *popup = UI_push_block(ctx, 0);
 		popup->depth_level = UI_get_current_parent(ctx)->depth_level + 200;
 		popup->hash = UI_hash_djb2(ctx, "popup", hash);
-		popup->flags |= UI_Block_Flags_hit_test;
-		G->check_mouse_hashes.push_back(popup->hash);
+		popup->flags |= UI_Block_Flags_hit_test | UI_Block_Flags_capture_mouse;
 		UI_Block *pop_prv = UI_find_block(ctx, popup->hash, UI_PREVIOUS);
 		if (pop_prv) {
 			if (!UI_mouse_in_block_force(pop_prv) && keydn(MouseL)) {
@@ -1658,13 +1731,18 @@ bool UI_histogram(UI_Histogram_Style *style, char* label) {
 			UI_Color4 col_b = UI_color4_sld_u32(0x0000FFDD);
 			UI_Color4 col_t = UI_color4_sld_u32(0xFFFFFFDD);
 			UI_Block* br = 0;
+			bool adjusted = G->histo_show_adjusted && G->has_histo_adjusted;
+			u64 *histo_r = adjusted ? G->histo_adj_r : G->histo_r;
+			u64 *histo_g = adjusted ? G->histo_adj_g : G->histo_g;
+			u64 *histo_b = adjusted ? G->histo_adj_b : G->histo_b;
+			u64 *histo_t = adjusted ? G->histo_adj_t : G->histo_t;
 			UI_Block *ref_frame = UI_find_block(ctx, hframe->hash, UI_PREVIOUS);
 			if (ref_frame) {
 				if (UI_mouse_in_block_force(ref_frame)) {
 					G->histo_max_edit *= 1 + G->keys.scroll_y_diff * 0.1 / (1 + G->settings_shiftslowmag * keypress(Key_Shift));
 					G->histo_max_edit = max(G->histo_max_edit, 5);
 					if (keyup(MouseR)) {
-						G->histo_max_edit = G->histo_max;
+						G->histo_max_edit = adjusted ? G->histo_adj_max : G->histo_max;
 					}
 				}
 			}
@@ -1672,10 +1750,10 @@ bool UI_histogram(UI_Histogram_Style *style, char* label) {
 
 			f32 height = 150 - 4;
 			for (int i = 0; i < 256; i++) {
-				G->p_histo_r[i] = v2(i, height - min(((f32)G->histo_r[i] / G->histo_max_edit) * height, height));
-				G->p_histo_g[i] = v2(i, height - min(((f32)G->histo_g[i] / G->histo_max_edit) * height, height));
-				G->p_histo_b[i] = v2(i, height - min(((f32)G->histo_b[i] / G->histo_max_edit) * height, height));
-				G->p_histo_t[i] = v2(i, height - min(((f32)G->histo_t[i] / G->histo_max_edit) * height, height));
+				G->p_histo_r[i] = v2(i, height - min(((f32)histo_r[i] / G->histo_max_edit) * height, height));
+				G->p_histo_g[i] = v2(i, height - min(((f32)histo_g[i] / G->histo_max_edit) * height, height));
+				G->p_histo_b[i] = v2(i, height - min(((f32)histo_b[i] / G->histo_max_edit) * height, height));
+				G->p_histo_t[i] = v2(i, height - min(((f32)histo_t[i] / G->histo_max_edit) * height, height));
 			}
 
 			UI_push_parent_defer(ctx, UI_bar(axis_x)) {
@@ -1684,6 +1762,12 @@ bool UI_histogram(UI_Histogram_Style *style, char* label) {
 				UI_checkbox(&style->checkbox_style, &G->draw_histo_g, "green");
 				UI_checkbox(&style->checkbox_style, &G->draw_histo_b, "blue");
 				UI_checkbox(&style->checkbox_style, &G->draw_histo_t, "luminosity");
+				UI_checkbox(&style->checkbox_style, &G->histo_show_adjusted, "adjusted");
+				UI_tooltip("histogram with hue, saturation, contrast, brightness and gamma applied, estimated from a downsampled copy");
+			}
+			if (adjusted) {
+				UI_text(style->color_text, style->button_style.font, 10, "clipped: %.2f%% shadows, %.2f%% highlights",
+				        G->histo_clipped_low * 100, G->histo_clipped_high * 100);
 			}
 
 			popup->style.size[axis_x] = { UI_Size_t::sum_of_children, 1, 1.0f };
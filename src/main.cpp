@@ -22,6 +22,10 @@ int wmain(int argc, wchar_t **argv) {
     
     // This tells us where user executed CactusViewer.exe from.
     GetCurrentDirectoryW(sizeof(CURRENT_FOLDER), CURRENT_FOLDER);
+
+    // Headless batch export, see batch_main.
+    if (argc > 1 && wcscmp(argv[1], L"--batch") == 0)
+        return batch_main(argc - 2, argv + 2);
 #else
     APPDATA_FOLDER = "./";
     // TODO(): Store exe folder and current working directory for other platforms.
@@ -31,7 +35,8 @@ int wmain(int argc, wchar_t **argv) {
 	G->main_loop_fiber =  ConvertThreadToFiber(NULL);
 	G->message_loop_fiber = CreateFiber(0, poll_events, NULL);
 
-    init_all();
+    if (!init_all())
+        return 1;
 	if (G->settings_start_in_fullscreen)
 		enter_fullscreen(hwnd);
 	{
@@ -41,6 +46,7 @@ int wmain(int argc, wchar_t **argv) {
 			CreateThread(NULL, 0, loader_thread, (LPVOID) & inputs, 0, NULL);
 		}
 	}
+	init_ui_font();
 
     while (Running) {
         bool gifmode = false;
@@ -105,6 +111,8 @@ int wmain(int argc, wchar_t **argv) {
 		if (keyup(MouseL))
 			G->mouse_dn_hash = 0;
     }
+    dump_anim_stats();
+    if (G->ui_stats_file) fclose(G->ui_stats_file);
     save_settings();
     return 0;
 }
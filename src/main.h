@@ -28,6 +28,7 @@
 #include <dynarray.h>
 #include <emaths.h>
 #include <webp/webp/decode.h>
+#include <webp/webp/encode.h>
 #include <webp/demux/demux.c>
 #include <wincodec.h>
 #include <propidl.h>
@@ -0,0 +1,106 @@
+// Minimal fork/join helper for CPU kernels (histograms, pixel pipelines). parallel_for splits
+// [0, count) into chunks that workers pull from a shared counter, and blocks until all are done.
+// The calling thread participates as worker 0, helped by a pool of threads started on first use.
+// The pool serves one parallel_for at a time: a call made while it is busy (from another thread,
+// or nested inside a task) runs on the calling thread alone.
+
+#define PARALLEL_MAX_WORKERS 64
+
+typedef void Parallel_Func(void *user, u32 begin, u32 end, u32 worker);
+
+struct Parallel_Task {
+	Parallel_Func *func;
+	void *user;
+	u32 count;
+	u32 chunk;
+	volatile LONG next;
+	volatile LONG joined;	// helpers that picked the task up, gives each its worker index
+	volatile LONG pending;	// helpers that haven't finished it yet
+};
+
+struct Parallel_Pool {
+	SRWLOCK lock;			// held by the parallel_for that currently owns the helpers
+	HANDLE wake;			// semaphore, released once per helper that should join 'task'
+	HANDLE done;			// auto-reset event, set by the last helper to finish 'task'
+	Parallel_Task *task;
+	u32 helpers;
+};
+
+static Parallel_Pool parallel_pool = { SRWLOCK_INIT };
+static INIT_ONCE parallel_pool_once = INIT_ONCE_STATIC_INIT;
+
+// Set on threads that are already one of many workers (batch export): parallel_for then runs the
+// whole range on the calling thread instead of starting more.
+static thread_local bool parallel_serial = false;
+
+static u32 parallel_worker_count() {
+	static u32 count = 0;
+	if (count == 0) {
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		count = clamp((u32)info.dwNumberOfProcessors, 1u, (u32)PARALLEL_MAX_WORKERS);
+	}
+	return count;
+}
+
+static void parallel_run(Parallel_Task *task, u32 worker) {
+	for (;;) {
+		LONG begin = InterlockedExchangeAdd(&task->next, (LONG)task->chunk);
+		if ((u32)begin >= task->count) break;
+		u32 end = min((u32)begin + task->chunk, task->count);
+		task->func(task->user, (u32)begin, end, worker);
+	}
+}
+
+static DWORD WINAPI parallel_thread(LPVOID param) {
+	Parallel_Pool *pool = (Parallel_Pool *)param;
+	parallel_serial = true;
+	for (;;) {
+		WaitForSingleObject(pool->wake, INFINITE);
+		Parallel_Task *task = pool->task;
+		parallel_run(task, (u32)InterlockedIncrement(&task->joined));
+		if (InterlockedDecrement(&task->pending) == 0)
+			SetEvent(pool->done);
+	}
+}
+
+static BOOL CALLBACK parallel_start_pool(PINIT_ONCE, PVOID, PVOID *) {
+	Parallel_Pool *pool = &parallel_pool;
+	u32 helpers = parallel_worker_count() - 1;
+	pool->wake = CreateSemaphoreA(NULL, 0, PARALLEL_MAX_WORKERS, NULL);
+	pool->done = CreateEventA(NULL, FALSE, FALSE, NULL);
+	if (!pool->wake || !pool->done) return TRUE;
+	for (u32 i = 0; i < helpers; i++) {
+		HANDLE thread = CreateThread(NULL, 0, parallel_thread, pool, 0, NULL);
+		if (!thread) break;
+		CloseHandle(thread);
+		pool->helpers++;
+	}
+	return TRUE;
+}
+
+// Worker indices passed to 'func' are in [0, parallel_worker_count()), so per-worker scratch can
+// be allocated up front and reduced after the call returns.
+static void parallel_for(u32 count, u32 chunk, Parallel_Func *func, void *user) {
+	if (count == 0) return;
+	Parallel_Task task = { func, user, count, max(chunk, 1u), 0, 0, 0 };
+	u32 chunks = (count + task.chunk - 1) / task.chunk;
+	if (parallel_serial || chunks == 1) {
+		parallel_run(&task, 0);
+		return;
+	}
+	Parallel_Pool *pool = &parallel_pool;
+	InitOnceExecuteOnce(&parallel_pool_once, parallel_start_pool, NULL, NULL);
+	if (pool->helpers == 0 || !TryAcquireSRWLockExclusive(&pool->lock)) {
+		parallel_run(&task, 0);
+		return;
+	}
+	u32 helpers = min(pool->helpers, chunks - 1);
+	task.pending = (LONG)helpers;
+	pool->task = &task;
+	ReleaseSemaphore(pool->wake, (LONG)helpers, NULL);
+	parallel_run(&task, 0);
+	WaitForSingleObject(pool->done, INFINITE);
+	pool->task = nullptr;
+	ReleaseSRWLockExclusive(&pool->lock);
+}
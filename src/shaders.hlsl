@@ -32,12 +32,19 @@ cbuffer Main_Constants : register(b0) {
 	float2 crop_a;
 	float2 crop_b;
 	int crop_mode;
+	int color_cache;
+	float curve_scale;
+	int color_lut_size;
 
+	float4 color_matrix[3];
 };
 
 Texture2D<float4> 	image_texture 	: register(t0);
 Texture2D<float4> 	thumbs_texture 	: register(t1);
+Texture1D<float> 	color_curve 	: register(t2);
+Texture3D<float4> 	color_lut 		: register(t3);
 SamplerState 		texture_sampler	: register(s0);
+SamplerState 		curve_sampler	: register(s1);
 
 #define PI 3.14159265359
 #define RENDER_MODE_VEIWER	0
@@ -195,7 +202,55 @@ float gaussian(float2 i) {
 	return exp(-0.5 * dot(i, i)) / (6.28 * sigma * sigma);
 }
 
+#define COLOR_CURVE_SIZE 4096
+
+// The adjustments below, baked on the CPU whenever they change (color_params_bake): one affine
+// map for hue, saturation, contrast and brightness, then a per channel curve for gamma and sRGB,
+// tabulated over sqrt(|x|).
+float apply_curve(float x) {
+	float pos = min(sqrt(abs(x)) * curve_scale, COLOR_CURVE_SIZE - 1);
+	return color_curve.SampleLevel(curve_sampler, (pos + 0.5) / COLOR_CURVE_SIZE, 0);
+}
+
+float3 lut_at(int3 p) {
+	return color_lut.Load(int4(p, 0)).rgb;
+}
+
+// Tetrahedral interpolation in the composed LUT (red along x, green along y, blue along z).
+// Same math as cpu_lut_sample.
+float3 apply_color_lut(float3 c) {
+	float3 x = saturate(c) * (color_lut_size - 1);
+	int3 i = min(int3(x), color_lut_size - 2);
+	float3 f = x - i;
+	float3 c000 = lut_at(i);
+	float3 c111 = lut_at(i + int3(1, 1, 1));
+	if (f.r > f.g) {
+		if (f.g > f.b)      return (1 - f.r) * c000 + (f.r - f.g) * lut_at(i + int3(1, 0, 0)) + (f.g - f.b) * lut_at(i + int3(1, 1, 0)) + f.b * c111;
+		else if (f.r > f.b) return (1 - f.r) * c000 + (f.r - f.b) * lut_at(i + int3(1, 0, 0)) + (f.b - f.g) * lut_at(i + int3(1, 0, 1)) + f.g * c111;
+		else                return (1 - f.b) * c000 + (f.b - f.r) * lut_at(i + int3(0, 0, 1)) + (f.r - f.g) * lut_at(i + int3(1, 0, 1)) + f.g * c111;
+	} else {
+		if (f.b > f.g)      return (1 - f.b) * c000 + (f.b - f.g) * lut_at(i + int3(0, 0, 1)) + (f.g - f.r) * lut_at(i + int3(0, 1, 1)) + f.r * c111;
+		else if (f.b > f.r) return (1 - f.g) * c000 + (f.g - f.b) * lut_at(i + int3(0, 1, 0)) + (f.b - f.r) * lut_at(i + int3(0, 1, 1)) + f.r * c111;
+		else                return (1 - f.g) * c000 + (f.g - f.r) * lut_at(i + int3(0, 1, 0)) + (f.r - f.b) * lut_at(i + int3(1, 1, 0)) + f.b * c111;
+	}
+}
+
 float4 modify_color(float4 color) {
+	if (color_lut_size > 0) {
+		color.rgb = apply_color_lut(color.rgb);
+		if (srgb == 1)
+			color.a = alpha_to_linear(color.a);
+		return color;
+	}
+	if (color_cache == 1) {
+		float4 rgb1 = float4(color.rgb, 1);
+		color.r = apply_curve(dot(color_matrix[0], rgb1));
+		color.g = apply_curve(dot(color_matrix[1], rgb1));
+		color.b = apply_curve(dot(color_matrix[2], rgb1));
+		if (srgb == 1)
+			color.a = alpha_to_linear(color.a);
+		return color;
+	}
 	color = adjust_hue(color, hue);
 	color = adjust_saturation(color, saturation);
 	color = adjust_contrast(color, contrast);
@@ -373,4 +428,49 @@ float4 ps_lines() : SV_Target {
     return color;
 }
 
-)###";
\ No newline at end of file
+)###";
+/////////////////////////////////
+
+// One axis of the Gaussian in ps_main's blur(). Running it horizontally and then vertically gives
+// the same sum as the 2D loop, since the weights and the sample positions are separable.
+char *shader_text_blur = R"###(
+cbuffer Blur_Constants : register(b0) {
+	float2 step;
+	float lod;
+	float lod_size;
+
+	float sigma;
+	float half_samples;
+	uint taps;
+	int normalize;
+};
+
+Texture2D<float4> 	image_texture 	: register(t0);
+SamplerState 		texture_sampler	: register(s0);
+
+struct VS_Output {
+	float4 pos 	: SV_POSITION;
+	float2 uv 	: TEXCOORD0;
+};
+
+VS_Output vs_blur(uint id : SV_VertexID) {
+	uint x = id % 2;
+	uint y = id / 2;
+	VS_Output output;
+	output.uv = float2(x, 1.0 - y);
+	output.pos = float4(float2(x, y) * 2.0 - 1.0, 0, 1);
+	return output;
+}
+
+float4 ps_blur(VS_Output input) : SV_TARGET {
+	float4 output = float4(0, 0, 0, 0);
+	for (uint i = 0; i < taps; i++) {
+		float d = float(i) * lod_size - half_samples;
+		float k = d / sigma;
+		output += exp(-0.5 * k * k) * image_texture.SampleLevel(texture_sampler, input.uv + step * d, lod);
+	}
+	if (normalize == 1)
+		return output / output.a;
+	return output;
+}
+)###";
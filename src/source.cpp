@@ -7,8 +7,16 @@
 
 #include "ui_platform_win32.cpp"
 #include "ui_d3d11.cpp"
+#include "ui_software.cpp"
 #include "ui_core.cpp"
 #include "web_anim.cpp"
+#include "gif_anim.cpp"
+#include "parallel.cpp"
+#include "cpu_pipeline.cpp"
+#include "color_profile.cpp"
+#include "encoders.cpp"
+#include "clipboard.cpp"
+#include "batch.cpp"
 
 #include "gui.cpp"
 
@@ -150,23 +158,29 @@ static void upload_constants(Shader_Program* program, void* data) {
 	G->graphics.device_ctx->Unmap(program->constants_buffer, 0);
 }
 
-static void upload_texture(Texture* texture, void* data, u64 size) {
-	D3D11_MAPPED_SUBRESOURCE mapped;
-	ZeroMemory(&mapped, sizeof(D3D11_MAPPED_SUBRESOURCE));
-	HRESULT hr = G->graphics.device_ctx->Map(texture->d3d_texture, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
-
-	BYTE* dest = static_cast<BYTE*>(mapped.pData);
-	BYTE* src = G->anim_buffer + G->anim_index * G->graphics.main_image.w * G->graphics.main_image.h * 4;
-
-	int row_pitch = mapped.RowPitch;
-	int row_size = G->graphics.main_image.w * 4; // 4 bytes per pixel as it's RGBA
+// RGBA pixels of an animation frame. GIF frames are kept indexed and get composited on demand.
+static u8 *anim_frame_pixels(int index) {
+	if (G->anim_gif) return gif_anim_seek(G->anim_gif, index);
+	return G->anim_buffer + (u64)index * G->graphics.main_image.w * G->graphics.main_image.h * 4;
+}
 
-	for (int y = 0; y < G->graphics.main_image.h; ++y) {
-		memcpy(dest, src, row_size);
-		dest += row_pitch;
-		src += row_size;
-	}
-	G->graphics.device_ctx->Unmap(texture->d3d_texture, 0);
+// Uploads the current animation frame. Stepping forward by one frame only sends that frame's dirty
+// rect, seeking or looping back re-sends the whole canvas, and an unchanged index sends nothing.
+static void upload_anim_frame(Texture* texture) {
+	int w = G->graphics.main_image.w;
+	int h = G->graphics.main_image.h;
+	if (G->anim_index == G->anim_uploaded_index) return;
+	if (texture->d3d_texture == nullptr || texture->size.x != w || texture->size.y != h) return;
+
+	Anim_Rect rect = { 0, 0, w, h };
+	if (G->anim_dirty_rects && G->anim_uploaded_index >= 0 && G->anim_index == G->anim_uploaded_index + 1)
+		rect = G->anim_dirty_rects[G->anim_index];
+	G->anim_uploaded_index = G->anim_index;
+	if (rect.w <= 0 || rect.h <= 0) return;
+
+	BYTE* src = anim_frame_pixels(G->anim_index) + ((u64)rect.y * w + rect.x) * 4;
+	D3D11_BOX box = { (UINT)rect.x, (UINT)rect.y, 0, (UINT)(rect.x + rect.w), (UINT)(rect.y + rect.h), 1 };
+	G->graphics.device_ctx->UpdateSubresource(texture->d3d_texture, 0, &box, src, w * 4, 0);
 }
 
 static void set_framebuffer_size(Graphics *ctx, iv2 size, bool set_dpi) {
@@ -206,15 +220,12 @@ static void set_framebuffer_size(Graphics *ctx, iv2 size, bool set_dpi) {
 }
 
 
-static void init_d3d11(HWND window_handle, int ww, int wh) {
+// The device, shaders and pipeline states: everything that doesn't need a window. The tests render
+// with just this. Fails when neither the GPU nor WARP give a device.
+static HRESULT init_d3d11_device() {
 
 	Graphics *ctx = &G->graphics;
 
-	RECT rect;
-	GetClientRect(hwnd, &rect);
-	ww = rect.right - rect.left;
-	wh = rect.bottom - rect.top;
-
 	D3D_FEATURE_LEVEL feature_levels[] = {
 		D3D_FEATURE_LEVEL_11_1,
 		D3D_FEATURE_LEVEL_11_0,
@@ -228,59 +239,32 @@ static void init_d3d11(HWND window_handle, int ww, int wh) {
 	createDeviceFlags |= D3D11_CREATE_DEVICE_DEBUG;
 #endif
 
-	D3D11CreateDevice(
+	HRESULT hr = D3D11CreateDevice(
 		nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, createDeviceFlags,
 		feature_levels, array_size(feature_levels),
 		D3D11_SDK_VERSION, &base_device,
 		nullptr, &base_device_ctx
 	);
-
-	base_device->QueryInterface(__uuidof(ID3D11Device1), (void**)&ctx->device);
-	base_device_ctx->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&ctx->device_ctx);
-
-	IDXGIDevice1* dxgi_device;
-	(ctx->device)->QueryInterface(__uuidof(IDXGIDevice1), (void**)&dxgi_device);
-	IDXGIAdapter* dxgi_adapter;
-	dxgi_device->GetAdapter(&dxgi_adapter);
-	IDXGIFactory2* dxgi_factory;
-	dxgi_adapter->GetParent(__uuidof(IDXGIFactory2), (void**)&dxgi_factory);
-
-	DXGI_SWAP_CHAIN_DESC1 swap_chain_desc = { 0 };
-	swap_chain_desc.Width = 0;
-	swap_chain_desc.Height = 0;
-	swap_chain_desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-	swap_chain_desc.Stereo = FALSE;
-	swap_chain_desc.SampleDesc.Count = 1;
-	swap_chain_desc.SampleDesc.Quality = 0;
-	swap_chain_desc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-	swap_chain_desc.BufferCount = 2;
-	swap_chain_desc.Scaling = DXGI_SCALING_STRETCH;
-	swap_chain_desc.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
-	swap_chain_desc.AlphaMode = DXGI_ALPHA_MODE_UNSPECIFIED;
-	swap_chain_desc.Flags = 0;
-	dxgi_factory->CreateSwapChainForHwnd(ctx->device, window_handle, &swap_chain_desc, nullptr, nullptr, &ctx->swap_chain);
-	ctx->swap_chain->GetDesc1(&swap_chain_desc);
-
-	D3D11_TEXTURE2D_DESC frame_buffer_desc = { 0 };;
-	frame_buffer_desc.Width = ww ;
-	frame_buffer_desc.Height = wh ;
-	frame_buffer_desc.SampleDesc.Count = 1;
-	frame_buffer_desc.MipLevels = 1;
-	frame_buffer_desc.ArraySize = 1;
-	frame_buffer_desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	frame_buffer_desc.Usage = D3D11_USAGE_DEFAULT;
-	frame_buffer_desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-
-	D3D11_TEXTURE2D_DESC depth_buffer_desc = frame_buffer_desc;
-	depth_buffer_desc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
-	depth_buffer_desc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
-
-	err(ctx->swap_chain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)&ctx->frame_buffer)); // substitutes needing to call createtexture since we're using the swap chain's texture
-	err(ctx->device->CreateRenderTargetView(ctx->frame_buffer, nullptr, &ctx->frame_buffer_view));
-
-	err(ctx->device->CreateTexture2D(&depth_buffer_desc, nullptr, &ctx->depth_buffer));
-	err(ctx->device->CreateDepthStencilView(ctx->depth_buffer, nullptr, &ctx->depth_buffer_view));
-
+	// no usable GPU (remote sessions, VMs, broken drivers): Windows' own software rasterizer
+	if (FAILED(hr))
+		hr = D3D11CreateDevice(
+			nullptr, D3D_DRIVER_TYPE_WARP, nullptr, createDeviceFlags,
+			feature_levels, array_size(feature_levels),
+			D3D11_SDK_VERSION, &base_device,
+			nullptr, &base_device_ctx
+		);
+	if (FAILED(hr)) return hr;
+
+	hr = base_device->QueryInterface(__uuidof(ID3D11Device1), (void**)&ctx->device);
+	if (SUCCEEDED(hr)) hr = base_device_ctx->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&ctx->device_ctx);
+	base_device_ctx->Release();
+	base_device->Release();
+	if (FAILED(hr)) {
+		if (ctx->device) ctx->device->Release();
+		ctx->device = nullptr;
+		ctx->device_ctx = nullptr;
+		return hr;
+	}
 
 	ctx->main_program = create_shader_program(ctx, shader_text_main, strlen(shader_text_main),
 	                                          "vs_main", "ps_main", sizeof(Shader_Constants_Main), 0, 0);
@@ -288,6 +272,8 @@ static void init_d3d11(HWND window_handle, int ww, int wh) {
 	                                          "vs_bg", "ps_bg", sizeof(Shader_Constants_BG), 0, 0);
 	ctx->crop_program = create_shader_program(ctx, shader_text_crop, strlen(shader_text_crop),
 	                                          "vs_crop", "ps_crop", sizeof(Shader_Constants_Crop), 0, 0);
+	ctx->blur_program = create_shader_program(ctx, shader_text_blur, strlen(shader_text_blur),
+	                                          "vs_blur", "ps_blur", sizeof(Shader_Constants_Blur), 0, 0);
 
 	D3D11_INPUT_ELEMENT_DESC lines_layout[] = {
 		{ "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 }
@@ -347,17 +333,79 @@ static void init_d3d11(HWND window_handle, int ww, int wh) {
 	sampler_desc.Filter = 			D3D11_FILTER_MIN_MAG_MIP_POINT;
 	err(ctx->device->CreateSamplerState(&sampler_desc, &ctx->sampler_nearest));
 
-	set_framebuffer_size(ctx, iv2(ww, wh));
-
 	G->graphics.MAX_GPU = D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION;
 
 	ID3D10Multithread* multi_thread = nullptr;
-    HRESULT hr = ctx->device->QueryInterface(__uuidof(ID3D10Multithread), reinterpret_cast<void**>(&multi_thread));
+    hr = ctx->device->QueryInterface(__uuidof(ID3D10Multithread), reinterpret_cast<void**>(&multi_thread));
     if (SUCCEEDED(hr) && multi_thread)
     {
         multi_thread->SetMultithreadProtected(TRUE);
         multi_thread->Release();
     }
+	return S_OK;
+}
+
+static bool init_d3d11(HWND window_handle, int ww, int wh) {
+
+	Graphics *ctx = &G->graphics;
+
+	RECT rect;
+	GetClientRect(hwnd, &rect);
+	ww = rect.right - rect.left;
+	wh = rect.bottom - rect.top;
+
+	HRESULT hr = init_d3d11_device();
+	if (FAILED(hr)) {
+		win32_get_error(hr, true);
+		return false;
+	}
+
+	IDXGIDevice1* dxgi_device;
+	(ctx->device)->QueryInterface(__uuidof(IDXGIDevice1), (void**)&dxgi_device);
+	IDXGIAdapter* dxgi_adapter;
+	dxgi_device->GetAdapter(&dxgi_adapter);
+	IDXGIFactory2* dxgi_factory;
+	dxgi_adapter->GetParent(__uuidof(IDXGIFactory2), (void**)&dxgi_factory);
+
+	DXGI_SWAP_CHAIN_DESC1 swap_chain_desc = { 0 };
+	swap_chain_desc.Width = 0;
+	swap_chain_desc.Height = 0;
+	swap_chain_desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+	swap_chain_desc.Stereo = FALSE;
+	swap_chain_desc.SampleDesc.Count = 1;
+	swap_chain_desc.SampleDesc.Quality = 0;
+	swap_chain_desc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+	swap_chain_desc.BufferCount = 2;
+	swap_chain_desc.Scaling = DXGI_SCALING_STRETCH;
+	swap_chain_desc.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
+	swap_chain_desc.AlphaMode = DXGI_ALPHA_MODE_UNSPECIFIED;
+	swap_chain_desc.Flags = 0;
+	dxgi_factory->CreateSwapChainForHwnd(ctx->device, window_handle, &swap_chain_desc, nullptr, nullptr, &ctx->swap_chain);
+	ctx->swap_chain->GetDesc1(&swap_chain_desc);
+
+	D3D11_TEXTURE2D_DESC frame_buffer_desc = { 0 };;
+	frame_buffer_desc.Width = ww ;
+	frame_buffer_desc.Height = wh ;
+	frame_buffer_desc.SampleDesc.Count = 1;
+	frame_buffer_desc.MipLevels = 1;
+	frame_buffer_desc.ArraySize = 1;
+	frame_buffer_desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	frame_buffer_desc.Usage = D3D11_USAGE_DEFAULT;
+	frame_buffer_desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+
+	D3D11_TEXTURE2D_DESC depth_buffer_desc = frame_buffer_desc;
+	depth_buffer_desc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+	depth_buffer_desc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+
+	err(ctx->swap_chain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)&ctx->frame_buffer)); // substitutes needing to call createtexture since we're using the swap chain's texture
+	err(ctx->device->CreateRenderTargetView(ctx->frame_buffer, nullptr, &ctx->frame_buffer_view));
+
+	err(ctx->device->CreateTexture2D(&depth_buffer_desc, nullptr, &ctx->depth_buffer));
+	err(ctx->device->CreateDepthStencilView(ctx->depth_buffer, nullptr, &ctx->depth_buffer_view));
+
+
+	set_framebuffer_size(ctx, iv2(ww, wh));
+	return true;
 }
 
 static Shader_Constants_Main set_main_shader_constants() {
@@ -389,24 +437,104 @@ static Shader_Constants_Main set_main_shader_constants() {
 	return result;
 }
 
-static Texture create_texture(u8 *data, int w, int h, bool dynamic) {
+// Bakes the color adjustments (color_params_bake) into the color_curve texture and the matrix in
+// 'constants', but only when they changed since the last call, and binds the curve for ps_main.
+// Every frame ps_main then runs one matrix multiply and three curve lookups per pixel instead of
+// the whole modify_color chain. If the texture can't be created ps_main keeps the original path.
+static void update_color_cache(Shader_Constants_Main *constants) {
+	Graphics *ctx = &G->graphics;
+	if (!ctx->color_curve) {
+		D3D11_TEXTURE1D_DESC desc = {};
+		desc.Width     = COLOR_CURVE_SIZE;
+		desc.MipLevels = 1;
+		desc.ArraySize = 1;
+		desc.Format    = DXGI_FORMAT_R32_FLOAT;
+		desc.Usage     = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		HRESULT hr = ctx->device->CreateTexture1D(&desc, nullptr, &ctx->color_curve);
+		if (SUCCEEDED(hr)) hr = ctx->device->CreateShaderResourceView(ctx->color_curve, nullptr, &ctx->color_curve_srv);
+		if (FAILED(hr)) {
+			if (ctx->color_curve) ctx->color_curve->Release();
+			ctx->color_curve = nullptr;
+			return;
+		}
+		ctx->color_cache_valid = false;
+	}
+	if (!ctx->color_cache_valid || !color_params_equal(constants, &ctx->color_cache_key)) {
+		Color_Params params = color_params_from_constants(constants);
+		ctx->device_ctx->UpdateSubresource(ctx->color_curve, 0, nullptr, params.curve, 0, 0);
+		memcpy(ctx->color_matrix, params.affine, sizeof(ctx->color_matrix));
+		ctx->curve_scale = params.curve_scale;
+		ctx->color_cache_key = *constants;
+		ctx->color_cache_valid = true;
+	}
+	constants->color_cache = 1;
+	constants->curve_scale = ctx->curve_scale;
+	for (int j = 0; j < 3; j++)
+		constants->color_matrix[j] = v4(ctx->color_matrix[j]);
+	ctx->device_ctx->PSSetShaderResources(2, 1, &ctx->color_curve_srv);
+	ctx->device_ctx->PSSetSamplers(1, 1, &ctx->sampler_linear);
+
+	// With a grading LUT loaded, the adjustments and the LUT are composed into one 3D texture
+	// (cpu_compose_color_lut), rebuilt when either changes. On failure the LUT is skipped.
+	constants->color_lut_size = 0;
+	Grading_LUT *grading = &G->grading_lut;
+	if (!grading->data) return;
+	i32 size = COLOR_LUT_COMPOSED_SIZE;
+	if (!ctx->color_lut) {
+		D3D11_TEXTURE3D_DESC desc = {};
+		desc.Width     = size;
+		desc.Height    = size;
+		desc.Depth     = size;
+		desc.MipLevels = 1;
+		desc.Format    = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		desc.Usage     = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		HRESULT hr = ctx->device->CreateTexture3D(&desc, nullptr, &ctx->color_lut);
+		if (SUCCEEDED(hr)) hr = ctx->device->CreateShaderResourceView(ctx->color_lut, nullptr, &ctx->color_lut_srv);
+		if (FAILED(hr)) {
+			if (ctx->color_lut) ctx->color_lut->Release();
+			ctx->color_lut = nullptr;
+			return;
+		}
+		ctx->color_lut_valid = false;
+	}
+	if (!ctx->color_lut_valid || ctx->color_lut_version != grading->version || !color_params_equal(constants, &ctx->color_lut_key)) {
+		Color_Params params = color_params_from_constants(constants);
+		f32 *data = cpu_compose_color_lut(&params, grading, size);
+		if (!data) return;
+		ctx->device_ctx->UpdateSubresource(ctx->color_lut, 0, nullptr, data, size * 4 * sizeof(f32), size * size * 4 * sizeof(f32));
+		free(data);
+		ctx->color_lut_key = *constants;
+		ctx->color_lut_version = grading->version;
+		ctx->color_lut_valid = true;
+	}
+	constants->color_lut_size = size;
+	ctx->device_ctx->PSSetShaderResources(3, 1, &ctx->color_lut_srv);
+}
+
+static Texture create_texture(u8 *data, int w, int h, bool dynamic, Pixel_Format format = Pixel_Rgba8) {
 	Graphics *d3d_ctx = &G->graphics;
+	u32 pitch = w * pixel_format_size(format);
 	D3D11_TEXTURE2D_DESC texture_desc = {};
 	texture_desc.Width             = w;
 	texture_desc.Height            = h;
 	texture_desc.MipLevels         = dynamic ? 1 : 0; 
 	texture_desc.ArraySize         = 1;
 	texture_desc.SampleDesc.Count  = 1;
-	texture_desc.Format            = DXGI_FORMAT_R8G8B8A8_UNORM;
 	texture_desc.BindFlags         = D3D11_BIND_SHADER_RESOURCE;
-	texture_desc.Usage             = dynamic ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_DEFAULT;
+	texture_desc.Usage             = D3D11_USAGE_DEFAULT; // dynamic textures get partial UpdateSubresource calls, see upload_anim_frame
+	switch (format) {
+		case Pixel_Rgba16:	texture_desc.Format = DXGI_FORMAT_R16G16B16A16_UNORM; break;
+		case Pixel_Rgba32f:	texture_desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT; break; // mips need a renderable format, 32F is one on feature level 10+
+		default:			texture_desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM; break;
+	}
 	if (!dynamic) texture_desc.BindFlags |= D3D11_BIND_RENDER_TARGET;
 	if (!dynamic) texture_desc.MiscFlags  = D3D11_RESOURCE_MISC_GENERATE_MIPS;
-	if (dynamic)  texture_desc.CPUAccessFlags  = D3D11_CPU_ACCESS_WRITE;
 
 	D3D11_SUBRESOURCE_DATA texture_SRD = {};
 	texture_SRD.pSysMem     = data;
-	texture_SRD.SysMemPitch = w * 4;
+	texture_SRD.SysMemPitch = pitch;
 
 	D3D11_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
 	srv_desc.Format = texture_desc.Format;
@@ -419,14 +547,174 @@ static Texture create_texture(u8 *data, int w, int h, bool dynamic) {
 	err(d3d_ctx->device->CreateShaderResourceView(result.d3d_texture, &srv_desc, &result.srv));
 	
 
-	if (!dynamic && data) {
-		d3d_ctx->device_ctx->UpdateSubresource(result.d3d_texture, 0, NULL, data, w * 4, w * h * 4);
-		d3d_ctx->device_ctx->GenerateMips(result.srv);
+	if (data) {
+		d3d_ctx->device_ctx->UpdateSubresource(result.d3d_texture, 0, NULL, data, pitch, pitch * h);
+		if (!dynamic) d3d_ctx->device_ctx->GenerateMips(result.srv);
 	}
 
 	return result;
 }
 
+// Mip 0 of a texture made by create_texture, copied back into walloc'ed, tightly packed w*h pixels of
+// 'format'. Null on failure.
+static u8 *read_texture_pixels(Texture *texture, int w, int h, Pixel_Format format) {
+	Graphics *d3d_ctx = &G->graphics;
+	D3D11_TEXTURE2D_DESC desc;
+	texture->d3d_texture->GetDesc(&desc);
+	desc.MipLevels      = 1;
+	desc.BindFlags      = 0;
+	desc.MiscFlags      = 0;
+	desc.Usage          = D3D11_USAGE_STAGING;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	ID3D11Texture2D *staging = nullptr;
+	if (FAILED(d3d_ctx->device->CreateTexture2D(&desc, nullptr, &staging)))
+		return nullptr;
+	d3d_ctx->device_ctx->CopySubresourceRegion(staging, 0, 0, 0, 0, texture->d3d_texture, 0, nullptr);
+
+	u8 *data = nullptr;
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (SUCCEEDED(d3d_ctx->device_ctx->Map(staging, 0, D3D11_MAP_READ, 0, &mapped))) {
+		size_t stride = (size_t)w * pixel_format_size(format);
+		data = (u8 *)walloc(stride * h);
+		for (int y = 0; data && y < h; y++)
+			memcpy(data + y * stride, (u8 *)mapped.pData + (size_t)y * mapped.RowPitch, stride);
+		d3d_ctx->device_ctx->Unmap(staging, 0);
+	}
+	staging->Release();
+	return data;
+}
+
+static void release_blur_cache(Blur_Cache *cache) {
+	if (cache->temp_srv) 				cache->temp_srv->Release();
+	if (cache->temp_rtv) 				cache->temp_rtv->Release();
+	if (cache->temp) 					cache->temp->Release();
+	if (cache->result_rtv) 				cache->result_rtv->Release();
+	if (cache->result.srv) 				cache->result.srv->Release();
+	if (cache->result.d3d_texture) 		cache->result.d3d_texture->Release();
+	*cache = {};
+}
+
+static bool create_blur_cache(Blur_Cache *cache, i32 w, i32 h, i32 temp_h, DXGI_FORMAT result_format) {
+	Graphics *ctx = &G->graphics;
+	release_blur_cache(cache);
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width             = w;
+	desc.Height            = temp_h;
+	desc.MipLevels         = 1;
+	desc.ArraySize         = 1;
+	desc.SampleDesc.Count  = 1;
+	desc.Format            = DXGI_FORMAT_R16G16B16A16_FLOAT; // holds weighted sums, not normalized yet
+	desc.Usage             = D3D11_USAGE_DEFAULT;
+	desc.BindFlags         = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+	HRESULT hr = ctx->device->CreateTexture2D(&desc, nullptr, &cache->temp);
+	if (SUCCEEDED(hr)) hr = ctx->device->CreateRenderTargetView(cache->temp, nullptr, &cache->temp_rtv);
+	if (SUCCEEDED(hr)) hr = ctx->device->CreateShaderResourceView(cache->temp, nullptr, &cache->temp_srv);
+
+	desc.Height            = h;
+	desc.MipLevels         = 0;
+	desc.Format            = result_format;
+	desc.MiscFlags         = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+	if (SUCCEEDED(hr)) hr = ctx->device->CreateTexture2D(&desc, nullptr, &cache->result.d3d_texture);
+	if (SUCCEEDED(hr)) hr = ctx->device->CreateRenderTargetView(cache->result.d3d_texture, nullptr, &cache->result_rtv);
+	if (SUCCEEDED(hr)) hr = ctx->device->CreateShaderResourceView(cache->result.d3d_texture, nullptr, &cache->result.srv);
+	if (FAILED(hr)) {
+		release_blur_cache(cache);
+		return false;
+	}
+	cache->result.size = v2(w, h);
+	cache->w = w;
+	cache->h = h;
+	cache->temp_h = temp_h;
+	cache->result_format = result_format;
+	return true;
+}
+
+// Blurs 'source' into G->graphics.blur_cache with two 1D passes, unless the cache already holds
+// this source (and 'source_version' of it) with the current blur settings. The result is a
+// regular mipmapped texture that replaces the source in ps_main with do_blur off, so panning and
+// zooming a blurred image cost the same as an unblurred one. Returns nullptr if the cache can't
+// be used, callers then fall back to the per pixel blur in ps_main.
+// Leaves the pipeline state modified, call it before setting up a draw.
+static Texture *update_blur_cache(Texture *source, i32 source_version, bool nearest) {
+	Graphics *ctx = &G->graphics;
+	Blur_Cache *cache = &ctx->blur_cache;
+	u32 lod = G->blur_lod;
+	u32 samples = G->blur_samples;
+	f32 scale = G->blur_scale;
+	u32 lod_size = 1u << lod;
+	u32 taps = samples / lod_size;
+	if (!source || !source->d3d_texture || !ctx->blur_program.pixel_shader || taps == 0) return nullptr;
+
+	if (cache->valid && cache->source == source->d3d_texture && cache->source_version == source_version &&
+	    cache->samples == samples && cache->lod == lod && cache->scale == scale && cache->nearest == nearest)
+		return &cache->result;
+
+	i32 w = (i32)source->size.x;
+	i32 h = (i32)source->size.y;
+	i32 temp_h = max(h >> lod, 1);
+	D3D11_TEXTURE2D_DESC source_desc;
+	source->d3d_texture->GetDesc(&source_desc);
+	DXGI_FORMAT result_format = source_desc.Format == DXGI_FORMAT_R8G8B8A8_UNORM ? DXGI_FORMAT_R8G8B8A8_UNORM : DXGI_FORMAT_R16G16B16A16_FLOAT;
+	if (cache->w != w || cache->h != h || cache->temp_h != temp_h || cache->result_format != result_format || !cache->result.d3d_texture) {
+		if (!create_blur_cache(cache, w, h, temp_h, result_format)) return nullptr;
+	}
+
+	ID3D11DeviceContext1 *dc = ctx->device_ctx;
+	ID3D11ShaderResourceView *null_srv = nullptr;
+	Shader_Constants_Blur constants = {};
+	constants.lod = (f32)lod;
+	constants.lod_size = (f32)lod_size;
+	constants.sigma = samples * 0.25f;
+	constants.half_samples = samples * 0.5f;
+	constants.taps = taps;
+
+	dc->OMSetBlendState(nullptr, nullptr, 0xffffffff);
+	dc->RSSetState(ctx->raster_state);
+	dc->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+	dc->IASetInputLayout(nullptr);
+	dc->VSSetShader(ctx->blur_program.vertex_shader, nullptr, 0);
+	dc->PSSetShader(ctx->blur_program.pixel_shader, nullptr, 0);
+	dc->VSSetConstantBuffers(0, 1, &ctx->blur_program.constants_buffer);
+	dc->PSSetConstantBuffers(0, 1, &ctx->blur_program.constants_buffer);
+	dc->PSSetSamplers(0, 1, nearest ? &ctx->sampler_nearest : &ctx->sampler_linear);
+
+	// horizontal: source mip 'lod' -> temp, one row per mip row and one column per source column
+	constants.step = v2(scale, 0);
+	constants.normalize = 0;
+	upload_constants(&ctx->blur_program, &constants);
+	D3D11_VIEWPORT vp = { 0.0f, 0.0f, (f32)w, (f32)temp_h, 0.0f, 1.0f };
+	dc->RSSetViewports(1, &vp);
+	dc->OMSetRenderTargets(1, &cache->temp_rtv, nullptr);
+	dc->PSSetShaderResources(0, 1, &source->srv);
+	dc->Draw(4, 0);
+
+	// vertical: temp -> result at full size, divided by the accumulated alpha like blur() does
+	constants.step = v2(0, scale);
+	constants.lod = 0;
+	constants.normalize = 1;
+	upload_constants(&ctx->blur_program, &constants);
+	vp.Height = (f32)h;
+	dc->RSSetViewports(1, &vp);
+	dc->PSSetShaderResources(0, 1, &null_srv);
+	dc->OMSetRenderTargets(1, &cache->result_rtv, nullptr);
+	dc->PSSetShaderResources(0, 1, &cache->temp_srv);
+	dc->Draw(4, 0);
+
+	dc->PSSetShaderResources(0, 1, &null_srv);
+	dc->OMSetRenderTargets(0, nullptr, nullptr);
+	dc->GenerateMips(cache->result.srv);
+
+	cache->valid = true;
+	cache->source = source->d3d_texture;
+	cache->source_version = source_version;
+	cache->samples = samples;
+	cache->lod = lod;
+	cache->scale = scale;
+	cache->nearest = nearest;
+	return &cache->result;
+}
+
 #include <windows.h>
 
 RECT g_original_window_rect;
@@ -505,12 +793,15 @@ static void save_settings() {
     cJSON_AddItemToObject(config_file, "pixel_grid", cJSON_CreateBool(G->pixel_grid));
     cJSON_AddItemToObject(config_file, "settings_sort", cJSON_CreateBool(G->settings_sort));
     cJSON_AddItemToObject(config_file, "settings_exif", cJSON_CreateBool(G->settings_exif));
+    cJSON_AddItemToObject(config_file, "settings_color_management", cJSON_CreateBool(G->settings_color_management));
     cJSON_AddItemToObject(config_file, "settings_hide_status_fullscreen", cJSON_CreateBool(G->settings_hide_status_fullscreen));
     cJSON_AddItemToObject(config_file, "settings_start_in_fullscreen", cJSON_CreateBool(G->settings_start_in_fullscreen));
     cJSON_AddItemToObject(config_file, "settings_dont_resize", cJSON_CreateBool(G->settings_dont_resize));
     cJSON_AddItemToObject(config_file, "settings_selected_theme", cJSON_CreateNumber(G->settings_selected_theme));
     cJSON_AddItemToObject(config_file, "settings_calculate_histograms", cJSON_CreateBool(G->settings_calculate_histograms));
     cJSON_AddItemToObject(config_file, "settings_preview_thumbs", cJSON_CreateBool(G->settings_preview_thumbs));
+    cJSON_AddItemToObject(config_file, "settings_anim_stats", cJSON_CreateBool(G->settings_anim_stats));
+    cJSON_AddItemToObject(config_file, "settings_ui_stats", cJSON_CreateBool(G->settings_ui_stats));
     cJSON_AddItemToObject(config_file, "settings_hide_status_with_gui", cJSON_CreateBool(G->settings_hide_status_with_gui));
     cJSON_AddItemToObject(config_file, "settings_always_show_gui", cJSON_CreateBool(G->settings_always_show_gui));
     cJSON_AddItemToObject(config_file, "settings_newfilezoom", cJSON_CreateNumber(G->settings_newfilezoom));
@@ -518,6 +809,8 @@ static void save_settings() {
     cJSON_AddItemToObject(config_file, "settings_copy_color_enclose_type", cJSON_CreateNumber(G->settings_copy_color_enclose_type));
     cJSON_AddItemToObject(config_file, "settings_copy_color_include_alpha", cJSON_CreateBool(G->settings_copy_color_include_alpha));
     cJSON_AddItemToObject(config_file, "settings_copy_color_normalize_rgb", cJSON_CreateBool(G->settings_copy_color_normalize_rgb));
+    cJSON_AddItemToObject(config_file, "batch_format", cJSON_CreateNumber(G->batch_format));
+    cJSON_AddItemToObject(config_file, "export_quality", cJSON_CreateNumber(G->export_quality));
     fprintf(F, cJSON_Print(config_file));
 	fclose(F);
     }
@@ -566,12 +859,15 @@ static void load_settings() {
 		item = cJSON_GetObjectItemCaseSensitive(config_file, "pixel_grid"); 						if (item) G->pixel_grid = item->valueint;
 		item = cJSON_GetObjectItemCaseSensitive(config_file, "settings_sort"); 						if (item) G->settings_sort = item->valueint;
 		item = cJSON_GetObjectItemCaseSensitive(config_file, "settings_exif"); 						if (item) G->settings_exif = item->valueint;
+		item = cJSON_GetObjectItemCaseSensitive(config_file, "settings_color_management"); 			if (item) G->settings_color_management = item->valueint;
 		item = cJSON_GetObjectItemCaseSensitive(config_file, "settings_hide_status_fullscreen"); 	if (item) G->settings_hide_status_fullscreen = item->valueint;
 		item = cJSON_GetObjectItemCaseSensitive(config_file, "settings_start_in_fullscreen"); 		if (item) G->settings_start_in_fullscreen = item->valueint;
 		item = cJSON_GetObjectItemCaseSensitive(config_file, "settings_dont_resize"); 				if (item) G->settings_dont_resize = item->valueint;
 		item = cJSON_GetObjectItemCaseSensitive(config_file, "settings_selected_theme"); 			if (item) G->settings_selected_theme = item->valueint;
 		item = cJSON_GetObjectItemCaseSensitive(config_file, "settings_calculate_histograms"); 		if (item) G->settings_calculate_histograms = item->valueint;
 		item = cJSON_GetObjectItemCaseSensitive(config_file, "settings_preview_thumbs"); 			if (item) G->settings_preview_thumbs = item->valueint;
+		item = cJSON_GetObjectItemCaseSensitive(config_file, "settings_anim_stats"); 				if (item) G->settings_anim_stats = item->valueint;
+		item = cJSON_GetObjectItemCaseSensitive(config_file, "settings_ui_stats"); 				if (item) G->settings_ui_stats = item->valueint;
 		item = cJSON_GetObjectItemCaseSensitive(config_file, "settings_hide_status_with_gui"); 		if (item) G->settings_hide_status_with_gui = item->valueint;
 		item = cJSON_GetObjectItemCaseSensitive(config_file, "settings_always_show_gui"); 			if (item) G->settings_always_show_gui = item->valueint;
 		item = cJSON_GetObjectItemCaseSensitive(config_file, "settings_newfilezoom"); 				if (item) G->settings_newfilezoom = item->valueint;
@@ -579,6 +875,8 @@ static void load_settings() {
 		item = cJSON_GetObjectItemCaseSensitive(config_file, "settings_copy_color_enclose_type"); 	if (item) G->settings_copy_color_enclose_type = item->valueint;
 		item = cJSON_GetObjectItemCaseSensitive(config_file, "settings_copy_color_include_alpha"); 	if (item) G->settings_copy_color_include_alpha = item->valueint;
 		item = cJSON_GetObjectItemCaseSensitive(config_file, "settings_copy_color_normalize_rgb"); 	if (item) G->settings_copy_color_normalize_rgb = item->valueint;
+		item = cJSON_GetObjectItemCaseSensitive(config_file, "batch_format"); 						if (item) G->batch_format = (Encoder_Format)clamp(item->valueint, 0, Format_Count - 1);
+		item = cJSON_GetObjectItemCaseSensitive(config_file, "export_quality"); 					if (item) G->export_quality = clamp(item->valueint, 1, 100);
         fclose(F);
 		free(data);
     }
@@ -591,6 +889,147 @@ static uint32_t get_ticks() {
     QueryPerformanceCounter(&result);
     return 1000 * result.QuadPart / frequency.QuadPart;
 }
+
+// The performance counter's frequency is fixed at boot, get_time reads it once.
+static f64 query_seconds_per_tick() {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return 1.0 / frequency.QuadPart;
+}
+
+static f64 get_time() {
+    static const f64 seconds_per_tick = query_seconds_per_tick();
+    LARGE_INTEGER  result;
+    QueryPerformanceCounter(&result);
+    return (f64)result.QuadPart * seconds_per_tick;
+}
+
+#define ANIM_MIN_FRAME_DELAY 0.01  // zero-delay frames would otherwise advance on every rendered frame
+#define ANIM_LATE_TOLERANCE  0.017 // one 60 Hz refresh, we only get to present on vsync anyway
+#define ANIM_RESYNC_LIMIT    1.0   // further behind than this (minimized, stalled) we restart the timeline
+
+static f64 anim_frame_delay(int index) {
+	return max(G->anim_frame_delays[index] * 0.001, ANIM_MIN_FRAME_DELAY);
+}
+
+static f64 anim_nominal_fps() {
+	f64 total = 0;
+	for (int i = 0; i < G->anim_frames; i++) total += anim_frame_delay(i);
+	return total > 0 ? G->anim_frames / total : 0;
+}
+
+// Appends the playback statistics of the current animation to anim_stats.jsonl as one JSON object per line.
+static void dump_anim_stats() {
+	Anim_Clock *clock = &G->anim_clock;
+	if (!G->settings_anim_stats || clock->frames_shown == 0) return;
+	char buffer[0x400];
+	snprintf(buffer, sizeof(buffer), "%s\\anim_stats.jsonl", APPDATA_FOLDER);
+	FILE *F = fopen(buffer, "a");
+	if (!F) return;
+
+	u64 n = clock->frames_shown;
+	f64 mean = clock->lateness_sum / n;
+	f64 jitter = sqrt(max(clock->lateness_sq_sum / n - mean * mean, 0.0));
+	cJSON *stats = cJSON_CreateObject();
+	cJSON_AddItemToObject(stats, "file", cJSON_CreateString(clock->file_name));
+	cJSON_AddItemToObject(stats, "frames", cJSON_CreateNumber(clock->frames));
+	cJSON_AddItemToObject(stats, "nominal_fps", cJSON_CreateNumber(clock->nominal_fps));
+	cJSON_AddItemToObject(stats, "achieved_fps", cJSON_CreateNumber(clock->play_time > 0 ? n / clock->play_time : 0));
+	cJSON_AddItemToObject(stats, "play_time_s", cJSON_CreateNumber(clock->play_time));
+	cJSON_AddItemToObject(stats, "frames_shown", cJSON_CreateNumber(n));
+	cJSON_AddItemToObject(stats, "frames_skipped", cJSON_CreateNumber(clock->frames_skipped));
+	cJSON_AddItemToObject(stats, "frames_late", cJSON_CreateNumber(clock->frames_late));
+	cJSON_AddItemToObject(stats, "stalls", cJSON_CreateNumber(clock->stalls));
+	cJSON_AddItemToObject(stats, "mean_lateness_ms", cJSON_CreateNumber(mean * 1000));
+	cJSON_AddItemToObject(stats, "jitter_ms", cJSON_CreateNumber(jitter * 1000));
+	cJSON_AddItemToObject(stats, "max_lateness_ms", cJSON_CreateNumber(clock->lateness_max * 1000));
+	char *line = cJSON_PrintUnformatted(stats);
+	fprintf(F, "%s\n", line);
+	fclose(F);
+	cJSON_free(line);
+	cJSON_Delete(stats);
+}
+
+// Appends the block/vertex counts and build times of the UI frame just rendered to ui_stats.jsonl, so
+// that UI_render's cost can be plotted against the size of the UI. This runs every frame, so the file
+// stays open with a large buffer while the setting is on; the lines reach the disk a few hundred
+// frames at a time, and when the setting is turned off or the app exits.
+static void dump_ui_stats() {
+	if (!G->settings_ui_stats) {
+		if (G->ui_stats_file) {
+			fclose(G->ui_stats_file);
+			G->ui_stats_file = nullptr;
+		}
+		return;
+	}
+	if (!G->ui_stats_file) {
+		char buffer[0x400];
+		snprintf(buffer, sizeof(buffer), "%s\\ui_stats.jsonl", APPDATA_FOLDER);
+		G->ui_stats_file = fopen(buffer, "a");
+		if (!G->ui_stats_file) return;
+		setvbuf(G->ui_stats_file, nullptr, _IOFBF, 1 << 16);
+	}
+	UI_Debug *debug = &G->ui->debug;
+	fprintf(G->ui_stats_file, "{\"blocks\":%d,\"vertices\":%d,\"reused\":%s,\"layout_ms\":%.4f,\"build_ms\":%.4f,\"sort_ms\":%.4f,\"frame_bytes\":%zu,\"persistent_bytes\":%zu}\n",
+		debug->last_block_count, debug->last_vertex_count, debug->last_frame_reused ? "true" : "false",
+		debug->last_layout_ms, debug->last_build_ms, debug->last_sort_ms, debug->last_frame_bytes, debug->allocated_bytes);
+}
+
+static void reset_anim_clock() {
+	dump_anim_stats();
+	memset(&G->anim_clock, 0, sizeof(G->anim_clock));
+	if (G->files.Count > 0)
+		strncpy(G->anim_clock.file_name, G->files[G->current_file_index].file.name_utf8, sizeof(G->anim_clock.file_name) - 1);
+	G->anim_clock.frames = G->anim_frames;
+	G->anim_clock.nominal_fps = anim_nominal_fps();
+}
+
+// Advances G->anim_index on a timeline that accumulates the frame delays from when each frame was
+// due rather than from when it was shown, so presentation latency never turns into drift. When we
+// fall behind by more than one frame the frames in between are skipped.
+static void update_anim_clock() {
+	Anim_Clock *clock = &G->anim_clock;
+	f64 now = get_time();
+	if (!G->anim_play) {
+		clock->running = false;
+		return;
+	}
+	if (!G->minimized)
+		G->force_loop = true;
+	if (!clock->running) {
+		clock->running = true;
+		clock->next_due = now + anim_frame_delay(G->anim_index);
+		clock->last_update = now;
+		return;
+	}
+	clock->play_time += now - clock->last_update;
+	clock->last_update = now;
+
+	if (now < clock->next_due) return;
+	if (now - clock->next_due > ANIM_RESYNC_LIMIT) {
+		clock->stalls++;
+		clock->next_due = now;
+	}
+
+	f64 due = clock->next_due;
+	int advanced = 0;
+	while (now >= clock->next_due && advanced < G->anim_frames) {
+		due = clock->next_due;
+		G->anim_index = (G->anim_index + 1) % G->anim_frames;
+		clock->next_due += anim_frame_delay(G->anim_index);
+		advanced++;
+	}
+	if (now >= clock->next_due) // behind by more than a whole loop, don't spin through it again
+		clock->next_due = now + anim_frame_delay(G->anim_index);
+
+	f64 lateness = now - due;
+	clock->frames_shown++;
+	clock->frames_skipped += advanced - 1;
+	if (lateness > ANIM_LATE_TOLERANCE) clock->frames_late++;
+	clock->lateness_sum += lateness;
+	clock->lateness_sq_sum += lateness * lateness;
+	clock->lateness_max = max(clock->lateness_max, lateness);
+}
 static void center_window() {
     v2 display_size = v2(GetSystemMetrics(SM_CXSCREEN), GetSystemMetrics(SM_CYSCREEN));
     RECT rect;
@@ -629,7 +1068,7 @@ bool get_font_file_from_system(char* output, int output_size, char* font) {
     return result;
 }
 
-static void init_all() {
+static bool init_all() {
     WW  = 700;
     WH = 800;
 
@@ -667,11 +1106,8 @@ static void init_all() {
 
 	SetProcessDpiAwareness(PROCESS_PER_MONITOR_DPI_AWARE);
 
-	Gdiplus::GdiplusStartupInput gdipsi;
-	ULONG_PTR gdipt;
-	Gdiplus::GdiplusStartup(&gdipt, &gdipsi, NULL);
-
-	init_d3d11(hwnd, WW, WH);
+	if (!init_d3d11(hwnd, WW, WH))
+		return false;
 	init_logo_image();
 
 	bg_color[0] = 0.15;
@@ -743,28 +1179,6 @@ static void init_all() {
 	UI_d3d11_init(G->ui, G->graphics.device, G->graphics.device_ctx);
 	UI_init_platform_win32(G->ui);
 
-	int sizes[] = { 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 20 };
-	int ascii_start = 32;
-	int ascii_end = 126;
-
-//#if	DEBUG_MODE
-//	G->ui_font = UI_load_font_file(G->ui, "../src/FiraSans-Regular.ttf", 
-//	                                 ascii_start, ascii_end, sizes, array_size(sizes));
-//#else
-//	u8 font_file[] = {
-//		#include "FiraSans-Regular.ttf.cpp"
-//	};
-//	G->ui_font = UI_load_font_memory(G->ui, font_file, array_size(font_file), 
-//	                                 ascii_start, ascii_end, sizes, array_size(sizes));
-//	#endif
-
-	// just getting the font from the system now:
-	char system_font[512] = {};
-	if (!get_font_file_from_system(system_font, 512, "Segoe UI (TrueType)"))
-		get_font_file_from_system(system_font, 512, "Arial (TrueType)");
-	G->ui_font = UI_load_font_file(G->ui, system_font, 
-								   ascii_start, ascii_end, sizes, array_size(sizes));
-
 //	G->shapes_texture_id = UI_create_texture(G->ui, 
 //	                                         (u8*)UI_asset_shape_arrow,
 //	                                         UI_ASSET_SHAPE_ARROW_WIDTH,
@@ -780,9 +1194,42 @@ static void init_all() {
 		FALSE,              // initial state is nonsignaled
 		TEXT("loader event")     
 	);
+	return true;
+}
 
+// Loads the UI font. Not part of init_all so that main can start decoding the image first, nothing
+// needs the font before the first UI frame.
+static void init_ui_font() {
+	int sizes[] = { 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 20 };
 
+//#if	DEBUG_MODE
+//	G->ui_font = UI_load_font_file(G->ui, "../src/FiraSans-Regular.ttf", sizes, array_size(sizes));
+//#else
+//	u8 font_file[] = {
+//		#include "FiraSans-Regular.ttf.cpp"
+//	};
+//	G->ui_font = UI_load_font_memory(G->ui, font_file, array_size(font_file), sizes, array_size(sizes));
+//	#endif
 
+	// just getting the font from the system now:
+	char system_font[512] = {};
+	if (!get_font_file_from_system(system_font, 512, "Segoe UI (TrueType)"))
+		get_font_file_from_system(system_font, 512, "Arial (TrueType)");
+	G->ui_font = UI_load_font_file(G->ui, system_font, sizes, array_size(sizes));
+
+	// file names are Unicode, glyphs the main font lacks are taken from these, in order
+	char *fallback_fonts[] = {
+		"Segoe UI Symbol (TrueType)",
+		"Microsoft YaHei & Microsoft YaHei UI (TrueType)",
+		"Yu Gothic Regular & Yu Gothic UI Regular (TrueType)",
+		"Malgun Gothic (TrueType)",
+		"Nirmala UI (TrueType)",
+	};
+	for (int i = 0; G->ui_font && i < array_size(fallback_fonts); i++) {
+		char fallback_font[512] = {};
+		if (get_font_file_from_system(fallback_font, 512, fallback_fonts[i]))
+			UI_add_font_fallback_file(G->ui, G->ui_font, fallback_font);
+	}
 }
 
 static void push_alert(char *string, Alert_Type type = Alert_Error) {
@@ -818,25 +1265,332 @@ static void set_to_no_file() {
     send_signal(G->signals.update_truescale);
 }
 
-void calculate_histogram(unsigned char* data, u64 size) {
+#define HISTO_BANKS       4
+#define HISTO_BLOCK_PIXELS (1 << 16)
+
+#define HISTO_PROXY_SIZE  512 // longest side of the downsampled copy used for the adjusted histogram
+
+// Takes ownership of 'data' (walloc'ed, in 'format'). On failure 'data' is freed and null is returned.
+static Shared_Pixels *shared_pixels_create(u8 *data, i32 w, i32 h, Pixel_Format format) {
+	Shared_Pixels *pixels = (Shared_Pixels *)malloc(sizeof(Shared_Pixels));
+	if (!pixels) {
+		wfree(data);
+		return nullptr;
+	}
+	*pixels = { data, w, h, format, 1 };
+	return pixels;
+}
+
+static Shared_Pixels *shared_pixels_retain(Shared_Pixels *pixels) {
+	if (pixels) InterlockedIncrement(&pixels->refs);
+	return pixels;
+}
+
+static void shared_pixels_release(Shared_Pixels *pixels) {
+	if (pixels && InterlockedDecrement(&pixels->refs) == 0) {
+		wfree(pixels->data);
+		free(pixels);
+	}
+}
+
+struct Histogram_Job {
+	Shared_Pixels *pixels; // reference held by the job
+	u8 *data;              // pixels->data
+	i32 w;
+	i32 h;
+	Pixel_Format format;
+	u32 file_id;
+	LONG generation;
+};
+
+// Per-worker counts. Consecutive pixels go to different banks, so runs of equal values (flat skies,
+// backgrounds) don't serialize on incrementing the same counter.
+struct Histogram_Partial {
+	u32 banks[HISTO_BANKS][3][256];
+	u64 sums[3][256];
+};
+
+struct Histogram_Kernel_Data {
+	Histogram_Job *job;
+	Histogram_Partial *partials;
+};
+
+static void histogram_kernel(void *user, u32 begin, u32 end, u32 worker) {
+	Histogram_Kernel_Data *kd = (Histogram_Kernel_Data *)user;
+	Histogram_Partial *p = &kd->partials[worker];
+	u64 first = (u64)begin * HISTO_BLOCK_PIXELS;
+	u64 last = min((u64)end * HISTO_BLOCK_PIXELS, (u64)kd->job->w * kd->job->h);
+	memset(p->banks, 0, sizeof(p->banks));
+
+	u64 n = last - first;
+	u64 i = 0;
+	if (kd->job->format == Pixel_Rgba8) {
+		const u8 *px = kd->job->data + first * 4;
+		for (; i + HISTO_BANKS <= n; i += HISTO_BANKS, px += 4 * HISTO_BANKS) {
+			for (int b = 0; b < HISTO_BANKS; b++) {
+				p->banks[b][0][px[b * 4 + 0]]++;
+				p->banks[b][1][px[b * 4 + 1]]++;
+				p->banks[b][2][px[b * 4 + 2]]++;
+			}
+		}
+		for (; i < n; i++, px += 4) {
+			p->banks[0][0][px[0]]++;
+			p->banks[0][1][px[1]]++;
+			p->banks[0][2][px[2]]++;
+		}
+	} else { // deeper pixels count in the bin of their 8-bit rounding
+		i32 size = pixel_format_size(kd->job->format);
+		const u8 *src = kd->job->data + first * size;
+		for (; i < n; i++, src += size) {
+			u8 px[4];
+			cpu_pixel_unorm8(kd->job->format, src, px);
+			u32 b = i % HISTO_BANKS;
+			p->banks[b][0][px[0]]++;
+			p->banks[b][1][px[1]]++;
+			p->banks[b][2][px[2]]++;
+		}
+	}
+	for (int c = 0; c < 3; c++)
+		for (int v = 0; v < 256; v++)
+			p->sums[c][v] += p->banks[0][c][v] + p->banks[1][c][v] + p->banks[2][c][v] + p->banks[3][c][v];
+}
+
+struct Histogram_Proxy_Data {
+	const u8 *src;
+	Pixel_Format format;
+	i32 w;
+	u8 *dst;
+	i32 dst_w;
+	i32 factor;
+};
+
+// Box filters 'factor' x 'factor' source pixels into each proxy pixel, one proxy row per index. The
+// proxy is RGBA8 whatever the source format.
+static void histogram_proxy_kernel(void *user, u32 begin, u32 end, u32 worker) {
+	Histogram_Proxy_Data *pd = (Histogram_Proxy_Data *)user;
+	u32 area = pd->factor * pd->factor;
+	i32 size = pixel_format_size(pd->format);
+	for (u32 y = begin; y < end; y++) {
+		u8 *out = pd->dst + (size_t)y * pd->dst_w * 4;
+		for (i32 x = 0; x < pd->dst_w; x++, out += 4) {
+			u32 sum[4] = {0};
+			for (i32 j = 0; j < pd->factor; j++) {
+				const u8 *src = pd->src + ((size_t)(y * pd->factor + j) * pd->w + x * pd->factor) * size;
+				for (i32 i = 0; i < pd->factor; i++, src += size) {
+					u8 px[4];
+					cpu_pixel_unorm8(pd->format, src, px);
+					sum[0] += px[0]; sum[1] += px[1]; sum[2] += px[2]; sum[3] += px[3];
+				}
+			}
+			for (int c = 0; c < 4; c++) out[c] = (u8)((sum[c] + area / 2) / area);
+		}
+	}
+}
+
+// Runs after the image is already on screen, publishes the result if the image is still current.
+static DWORD WINAPI histogram_thread(LPVOID param) {
+	Histogram_Job *job = (Histogram_Job *)param;
+	u32 workers = parallel_worker_count();
+	Histogram_Partial *partials = nullptr;
+	if (job->generation == G->histo_generation)
+		partials = (Histogram_Partial *)calloc(workers, sizeof(Histogram_Partial));
+
+	if (partials) {
+		Histogram_Kernel_Data kd = { job, partials };
+		u64 pixel_count = (u64)job->w * job->h;
+		u32 blocks = (u32)((pixel_count + HISTO_BLOCK_PIXELS - 1) / HISTO_BLOCK_PIXELS);
+		parallel_for(blocks, 4, histogram_kernel, &kd);
+
+		u64 histo[4][256] = {0};
+		u64 histo_max = 0;
+		for (u32 w = 0; w < workers; w++)
+			for (int c = 0; c < 3; c++)
+				for (int v = 0; v < 256; v++)
+					histo[c][v] += partials[w].sums[c][v];
+		for (int v = 0; v < 256; v++) {
+			histo[3][v] = histo[0][v] + histo[1][v] + histo[2][v];
+			histo_max = max(histo_max, histo[3][v]);
+		}
+
+		i32 factor = max((max(job->w, job->h) + HISTO_PROXY_SIZE - 1) / HISTO_PROXY_SIZE, 1);
+		Histogram_Proxy_Data pd = { job->data, job->format, job->w, nullptr, max(job->w / factor, 1), factor };
+		i32 proxy_h = max(job->h / factor, 1);
+		if (job->w >= factor && job->h >= factor)
+			pd.dst = (u8 *)malloc((size_t)pd.dst_w * proxy_h * 4);
+		if (pd.dst)
+			parallel_for(proxy_h, 16, histogram_proxy_kernel, &pd);
+
+		EnterCriticalSection(&G->mutex);
+		if (job->generation == G->histo_generation && job->file_id == G->current_file_index) {
+			memcpy(G->histo_r, histo[0], sizeof(G->histo_r));
+			memcpy(G->histo_g, histo[1], sizeof(G->histo_g));
+			memcpy(G->histo_b, histo[2], sizeof(G->histo_b));
+			memcpy(G->histo_t, histo[3], sizeof(G->histo_t));
+			G->histo_max = histo_max;
+			G->histo_max_edit = histo_max;
+			G->graphics.main_image.has_histo = true;
+			if (pd.dst) {
+				swap(u8 *, G->histo_proxy, pd.dst);
+				G->histo_proxy_w = pd.dst_w;
+				G->histo_proxy_h = proxy_h;
+				G->histo_proxy_scale = (f32)pixel_count / ((f32)pd.dst_w * proxy_h);
+				G->histo_proxy_id++;
+			}
+		}
+		LeaveCriticalSection(&G->mutex);
+		SetEvent(G->loader_event);
+		free(pd.dst);
+		free(partials);
+	}
+	shared_pixels_release(job->pixels);
+	free(job);
+	return 0;
+}
+
+// Computes the histogram of 'pixels' in the background, holding its own reference meanwhile.
+static void calculate_histogram_async(Shared_Pixels *pixels, u32 file_id) {
 	G->graphics.main_image.has_histo = false;
-	if (!G->settings_calculate_histograms) return;
-	assert(size % 4 == 0);
-	memset(G->histo_r, 0, 256 * sizeof(u64));
-	memset(G->histo_g, 0, 256 * sizeof(u64));
-	memset(G->histo_b, 0, 256 * sizeof(u64));
-	memset(G->histo_t, 0, 256 * sizeof(u64));
-	G->histo_max = 0;
-	for (int i = 0; i < size - 4; i+=4) {
-		G->histo_r[data[i + 0]]++; G->histo_t[data[i + 0]]++; 
-		G->histo_g[data[i + 1]]++; G->histo_t[data[i + 1]]++;
-		G->histo_b[data[i + 2]]++; G->histo_t[data[i + 2]]++;
+	G->has_histo_adjusted = false;
+	LONG generation = InterlockedIncrement(&G->histo_generation);
+	Histogram_Job *job = (Histogram_Job *)malloc(sizeof(Histogram_Job));
+	HANDLE thread = 0;
+	if (job) {
+		*job = { shared_pixels_retain(pixels), pixels->data, pixels->w, pixels->h, pixels->format, file_id, generation };
+		thread = CreateThread(NULL, 0, histogram_thread, job, 0, NULL);
+	}
+	if (thread) {
+		CloseHandle(thread);
+	} else {
+		if (job) shared_pixels_release(job->pixels);
+		free(job);
+	}
+}
+
+struct Adjusted_Histogram_Data {
+	const u8 *proxy;
+	i32 w;
+	Color_Params params;
+	Histogram_Partial *partials;
+	const f32 *lut; // composed grading LUT, or null
+	i32 lut_size;
+};
+
+static void adjusted_histogram_kernel(void *user, u32 begin, u32 end, u32 worker) {
+	Adjusted_Histogram_Data *ad = (Adjusted_Histogram_Data *)user;
+	Histogram_Partial *p = &ad->partials[worker];
+	const u8 *px = ad->proxy + (size_t)begin * ad->w * 4;
+	for (u64 i = (u64)(end - begin) * ad->w; i > 0; i--, px += 4) {
+		v4 color = v4(px[0], px[1], px[2], px[3]) / 255.0f;
+		if (ad->lut) {
+			f32 rgba[4];
+			cpu_lut_sample(ad->lut, ad->lut_size, 4, color.r * ad->params.rgba_flags.r, color.g * ad->params.rgba_flags.g, color.b * ad->params.rgba_flags.b, rgba);
+			color = v4(rgba);
+		} else {
+			color = cpu_apply_color_cache(&ad->params, color);
+		}
+		p->sums[0][cpu_unorm8(color.r)]++;
+		p->sums[1][cpu_unorm8(color.g)]++;
+		p->sums[2][cpu_unorm8(color.b)]++;
+	}
+}
+
+// Long lived worker behind request_adjusted_histogram. Requests only overwrite the latest parameters
+// and signal an auto-reset event, so while one pass runs any number of slider moves collapse into a
+// single follow-up pass with the newest values.
+static DWORD WINAPI adjusted_histogram_thread(LPVOID param) {
+	u32 workers = parallel_worker_count();
+	Histogram_Partial *partials = (Histogram_Partial *)malloc(workers * sizeof(Histogram_Partial));
+	u8 *proxy = nullptr;
+	size_t proxy_capacity = 0;
+	Grading_LUT grading = {};
+	if (!partials) return 0;
+
+	for (;;) {
+		WaitForSingleObject(G->histo_adjust_event, INFINITE);
+
+		EnterCriticalSection(&G->mutex);
+		Shader_Constants_Main constants = G->histo_adjust_constants;
+		LONG request = G->histo_adjust_request;
+		u32 proxy_id = G->histo_proxy_id;
+		i32 w = G->histo_proxy_w;
+		i32 h = G->histo_proxy_h;
+		f32 proxy_scale = G->histo_proxy_scale;
+		size_t bytes = G->histo_proxy ? (size_t)w * h * 4 : 0;
+		if (bytes > proxy_capacity) {
+			free(proxy);
+			proxy = (u8 *)malloc(bytes);
+			proxy_capacity = proxy ? bytes : 0;
+		}
+		if (bytes && proxy) memcpy(proxy, G->histo_proxy, bytes);
+		if (grading.version != G->grading_lut.version) {
+			free(grading.data);
+			grading = G->grading_lut;
+			size_t lut_bytes = (size_t)grading.size * grading.size * grading.size * 3 * sizeof(f32);
+			grading.data = G->grading_lut.data ? (f32 *)malloc(lut_bytes) : nullptr;
+			if (grading.data) memcpy(grading.data, G->grading_lut.data, lut_bytes);
+		}
+		LeaveCriticalSection(&G->mutex);
+		if (!bytes || !proxy) continue;
+
+		memset(partials, 0, workers * sizeof(Histogram_Partial));
+		Adjusted_Histogram_Data ad = { proxy, w, color_params_from_constants(&constants), partials };
+		f32 *lut = nullptr;
+		if (grading.data) {
+			ad.lut_size = COLOR_LUT_COMPOSED_SIZE;
+			ad.lut = lut = cpu_compose_color_lut(&ad.params, &grading, ad.lut_size);
+		}
+		parallel_for(h, 16, adjusted_histogram_kernel, &ad);
+		free(lut);
+
+		// Scaled to the full image's pixel count so both histograms share the same vertical scale.
+		u64 histo[4][256] = {0};
+		u64 histo_max = 0;
+		for (int v = 0; v < 256; v++) {
+			for (int c = 0; c < 3; c++) {
+				u64 sum = 0;
+				for (u32 k = 0; k < workers; k++) sum += partials[k].sums[c][v];
+				histo[c][v] = (u64)(sum * proxy_scale);
+			}
+			histo[3][v] = histo[0][v] + histo[1][v] + histo[2][v];
+			histo_max = max(histo_max, histo[3][v]);
+		}
+		f32 samples = (f32)w * h * 3;
+
+		EnterCriticalSection(&G->mutex);
+		if (request == G->histo_adjust_request && proxy_id == G->histo_proxy_id) {
+			memcpy(G->histo_adj_r, histo[0], sizeof(G->histo_adj_r));
+			memcpy(G->histo_adj_g, histo[1], sizeof(G->histo_adj_g));
+			memcpy(G->histo_adj_b, histo[2], sizeof(G->histo_adj_b));
+			memcpy(G->histo_adj_t, histo[3], sizeof(G->histo_adj_t));
+			G->histo_adj_max = histo_max;
+			G->histo_clipped_low  = histo[3][0]   / proxy_scale / samples;
+			G->histo_clipped_high = histo[3][255] / proxy_scale / samples;
+			G->has_histo_adjusted = true;
+		}
+		LeaveCriticalSection(&G->mutex);
+		SetEvent(G->loader_event);
 	}
-	for (int i = 0; i < 256; i++) {
-		G->histo_max = max(G->histo_max, G->histo_t[i]);
+}
+
+// Called every frame while the adjusted histogram is on screen, does nothing unless the edit
+// parameters or the image changed since the last request.
+static void request_adjusted_histogram() {
+	Shader_Constants_Main constants = set_main_shader_constants();
+	if (G->histo_adjust_proxy_id == G->histo_proxy_id && G->histo_adjust_lut_version == G->grading_lut.version &&
+		color_params_equal(&constants, &G->histo_adjust_constants))
+		return;
+	if (!G->histo_adjust_event) {
+		G->histo_adjust_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+		HANDLE thread = CreateThread(NULL, 0, adjusted_histogram_thread, NULL, 0, NULL);
+		if (thread) CloseHandle(thread);
 	}
-	G->histo_max_edit = G->histo_max;
-	G->graphics.main_image.has_histo = true;
+	EnterCriticalSection(&G->mutex);
+	G->histo_adjust_constants = constants;
+	G->histo_adjust_proxy_id = G->histo_proxy_id;
+	G->histo_adjust_lut_version = G->grading_lut.version;
+	G->histo_adjust_request++;
+	LeaveCriticalSection(&G->mutex);
+	SetEvent(G->histo_adjust_event);
 }
 
 static int load_image_pre(wchar_t *path, u32 id, bool dropped) {
@@ -847,7 +1601,15 @@ static int load_image_pre(wchar_t *path, u32 id, bool dropped) {
     int size = stbi_convert_wchar_to_utf8(0, 0, path);
 	char *filename_utf8 = (char *)malloc(size);
 	stbi_convert_wchar_to_utf8(filename_utf8, size, path);
-    unsigned char *data = stbi_load(filename_utf8, &w, &h, &n, 4);
+    Pixel_Format format = Pixel_Rgba8;
+    unsigned char *data;
+    if (stbi_is_16_bit(filename_utf8)) {
+        data = (unsigned char *)stbi_load_16(filename_utf8, &w, &h, &n, 4);
+        format = Pixel_Rgba16;
+    } else {
+        data = stbi_load(filename_utf8, &w, &h, &n, 4);
+    }
+    free(filename_utf8);
     G->files[id].loading = false;
     if (data == nullptr) {
         push_alert("Loading the file failed");
@@ -872,6 +1634,7 @@ static int load_image_pre(wchar_t *path, u32 id, bool dropped) {
 					G->graphics.main_image.data = 0;
 				}
                 G->graphics.main_image.data = data;
+                G->graphics.main_image.format = format;
                 send_signal(G->signals.init_step_2);
             }
             else {
@@ -884,13 +1647,80 @@ static int load_image_pre(wchar_t *path, u32 id, bool dropped) {
     return result;
 }
 
+// The format 'source' decodes to without losing precision: float and fixed point pixels (HDR, JPEG XR)
+// as RGBA32F, integers above 8 bits per channel (16-bit PNG and TIFF, raw) as RGBA16, the rest RGBA8.
+static Pixel_Format wic_native_format(IWICImagingFactory *factory, IWICBitmapSource *source) {
+	WICPixelFormatGUID guid;
+	IWICComponentInfo *info = NULL;
+	IWICPixelFormatInfo2 *format_info = NULL;
+	Pixel_Format result = Pixel_Rgba8;
+	HRESULT hr = source->GetPixelFormat(&guid);
+	if (SUCCEEDED(hr)) hr = factory->CreateComponentInfo(guid, &info);
+	if (SUCCEEDED(hr)) hr = info->QueryInterface(IID_IWICPixelFormatInfo2, (void **)&format_info);
+	if (SUCCEEDED(hr)) {
+		WICPixelFormatNumericRepresentation numeric = WICPixelFormatNumericRepresentationUnspecified;
+		UINT bits = 0, channels = 0;
+		format_info->GetNumericRepresentation(&numeric);
+		format_info->GetBitsPerPixel(&bits);
+		format_info->GetChannelCount(&channels);
+		if (numeric == WICPixelFormatNumericRepresentationFloat || numeric == WICPixelFormatNumericRepresentationFixed)
+			result = Pixel_Rgba32f;
+		else if (numeric == WICPixelFormatNumericRepresentationUnsignedInteger && channels && bits / channels > 8)
+			result = Pixel_Rgba16;
+	}
+	if (format_info) format_info->Release();
+	if (info) info->Release();
+	return result;
+}
+
+// Decodes 'frame' at its native depth (see wic_native_format) into walloc'ed pixels. Float pixels,
+// linear in WIC, are returned sRGB encoded like all the others. With 'color_manage', pixels with an
+// embedded ICC profile are converted to sRGB (color_profile.cpp).
+static HRESULT wic_decode_pixels(IWICImagingFactory *factory, IWICBitmapFrameDecode *frame, bool color_manage,
+                                 u8 **data, u32 *w, u32 *h, Pixel_Format *format) {
+	IWICBitmapSource *source = frame;
+	*data = nullptr;
+	*format = wic_native_format(factory, source);
+	const WICPixelFormatGUID *target = &GUID_WICPixelFormat32bppRGBA;
+	if (*format == Pixel_Rgba16)  target = &GUID_WICPixelFormat64bppRGBA;
+	if (*format == Pixel_Rgba32f) target = &GUID_WICPixelFormat128bppRGBAFloat;
+
+	IWICFormatConverter *converter = NULL;
+	HRESULT hr = factory->CreateFormatConverter(&converter);
+	if (SUCCEEDED(hr)) hr = converter->Initialize(source, *target, WICBitmapDitherTypeNone, NULL, 0.0, WICBitmapPaletteTypeCustom);
+	if (SUCCEEDED(hr)) hr = converter->GetSize(w, h);
+	if (SUCCEEDED(hr)) {
+		size_t stride = (size_t)*w * pixel_format_size(*format);
+		if (stride * *h > 0xFFFFFFFF) hr = E_OUTOFMEMORY; // CopyPixels takes a UINT size
+		if (SUCCEEDED(hr)) {
+			*data = (u8 *)walloc(stride * *h);
+			if (!*data) hr = E_OUTOFMEMORY;
+		}
+		if (SUCCEEDED(hr)) hr = converter->CopyPixels(NULL, (UINT)stride, (UINT)(stride * *h), *data);
+		if (FAILED(hr) && *data) {
+			wfree(*data);
+			*data = nullptr;
+		}
+	}
+	if (converter) converter->Release();
+	if (SUCCEEDED(hr) && *format == Pixel_Rgba32f)
+		srgb_encode_pixels((f32 *)*data, *w, *h);
+	if (SUCCEEDED(hr) && color_manage) {
+		size_t icc_size = 0;
+		u8 *icc = wic_icc_profile(factory, frame, &icc_size);
+		color_manage_pixels(icc, icc_size, *data, *format, *w, *h);
+		free(icc);
+	}
+	return hr;
+}
+
 static int load_image_wic_pre(wchar_t *path, u32 id, bool dropped, File_Data* file_data) {
     u32 w, h;
     int result = 0;
     G->files[id].loading = true;
 	IWICBitmapDecoder* decoder = NULL;
 	IWICBitmapFrameDecode* frame = NULL;
-	IWICFormatConverter* converter = NULL;
+	Pixel_Format format = Pixel_Rgba8;
 
 	// Initialize the COM library
 	CoInitialize(NULL);
@@ -905,12 +1735,8 @@ static int load_image_wic_pre(wchar_t *path, u32 id, bool dropped, File_Data* fi
 	unsigned char *data = 0;
 	HRESULT hr = G->wic_factory->CreateDecoderFromFilename(path, NULL, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder);
 	if(SUCCEEDED(hr)) hr = decoder->GetFrame(0, &frame);
-	if(SUCCEEDED(hr)) hr =G->wic_factory->CreateFormatConverter(&converter);
-	if(SUCCEEDED(hr)) hr = converter->Initialize(frame, GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, NULL, 0.0, WICBitmapPaletteTypeCustom);
+	if(SUCCEEDED(hr)) hr = wic_decode_pixels(G->wic_factory, frame, G->settings_color_management, &data, &w, &h, &format);
 	if (SUCCEEDED(hr)) {
-		converter->GetSize(&w, &h);
-		data = (unsigned char *)walloc(w * h * 4);
-		converter->CopyPixels(NULL, w * 4, w * h * 4, data);
 
 		// expensive, but requested:
 		if (G->settings_exif) {
@@ -941,10 +1767,14 @@ static int load_image_wic_pre(wchar_t *path, u32 id, bool dropped, File_Data* fi
 	}
 	G->files[id].loading = false;
 	if (FAILED(hr) || data == 0) {
+		// this runs on the loader thread, so the message can't come from the UI's frame arena
+		char message[256];
 		if (hr == WINCODEC_ERR_COMPONENTNOTFOUND) {
-			push_alert(UI_sprintf(&G->ui->strings, "Component not found: File type '%s' not supported.", UI_sprintf(&G->ui->strings, "%S", file_data->file.ext)));
+			snprintf(message, sizeof(message), "Component not found: File type '%S' not supported.", file_data->file.ext);
+			push_alert(message);
 		} else if (hr == WINCODEC_ERR_COMPONENTINITIALIZEFAILURE) {
-			push_alert(UI_sprintf(&G->ui->strings, "Component initialization failed: Codec of '%s' is likely not installed.", UI_sprintf(&G->ui->strings, "%S", file_data->file.ext)));
+			snprintf(message, sizeof(message), "Component initialization failed: Codec of '%S' is likely not installed.", file_data->file.ext);
+			push_alert(message);
 		} else {
 			LPVOID lpMsgBuf;
 			DWORD bufLen = FormatMessageA(
@@ -979,7 +1809,7 @@ static int load_image_wic_pre(wchar_t *path, u32 id, bool dropped, File_Data* fi
 			//		G->graphics.main_image.data = 0;
 			//	}
 				G->graphics.main_image.data = data;
-				calculate_histogram(data, w * h * 4);
+				G->graphics.main_image.format = format;
                 send_signal(G->signals.init_step_2);
             } else {
                 wfree(data);
@@ -993,7 +1823,6 @@ static int load_image_wic_pre(wchar_t *path, u32 id, bool dropped, File_Data* fi
 
 	if (frame) frame->Release();
 	if (decoder) decoder->Release();
-	if (converter) converter->Release();
 	CoUninitialize();
 
     return result;
@@ -1005,6 +1834,14 @@ static void unload_anim_image() {
 	G->anim_buffer = nullptr;
 	free(G->anim_frame_delays);
 	G->anim_frame_delays = nullptr;
+	free(G->anim_dirty_rects);
+	G->anim_dirty_rects = nullptr;
+	G->anim_uploaded_index = -1;
+	if (G->anim_gif) {
+		gif_anim_free(G->anim_gif);
+		free(G->anim_gif);
+		G->anim_gif = nullptr;
+	}
 }
 
 static int load_webp_pre(wchar_t *path, u32 id, bool dropped, int* type) {
@@ -1032,6 +1869,11 @@ static int load_webp_pre(wchar_t *path, u32 id, bool dropped, int* type) {
 	if (!features.has_animation) {
 		G->files[id].loading = true;
 		unsigned char *data = WebPDecodeRGBA(file_data, file_size, &w, &h);
+		if (data && G->settings_color_management) {
+			size_t icc_size = 0;
+			const u8 *icc = webp_icc_profile(file_data, file_size, &icc_size);
+			color_manage_pixels(icc, icc_size, data, Pixel_Rgba8, w, h);
+		}
 		G->files[id].loading = false;
 		if (data == nullptr) {
 			push_alert("Loading the file failed");
@@ -1056,7 +1898,7 @@ static int load_webp_pre(wchar_t *path, u32 id, bool dropped, int* type) {
 					//	G->graphics.main_image.data = 0;
 					//}
 					G->graphics.main_image.data = data;
-					calculate_histogram(data, w * h * 4);
+					G->graphics.main_image.format = Pixel_Rgba8;
 					send_signal(G->signals.init_step_2);
 				} else {
 					wfree(data);
@@ -1078,6 +1920,7 @@ static int load_webp_pre(wchar_t *path, u32 id, bool dropped, int* type) {
 			G->anim_frames = webp_anim_image.num_frames;
 			G->anim_frame_delays = webp_anim_image.durations;
 			G->anim_buffer = (unsigned char *)webp_anim_image.raw_mem;
+			G->anim_dirty_rects = webp_anim_image.dirty_rects;
 
 			G->anim_index = 0;
 			G->anim_play = G->settings_autoplayGIFs;
@@ -1168,6 +2011,7 @@ static int load_ppm_pre(wchar_t *path, u32 id, bool dropped, int* type) {
 		}
 #endif
 		G->graphics.main_image.data = data;
+		G->graphics.main_image.format = Pixel_Rgba8;
 		send_signal(G->signals.init_step_2);
 	} else {
 		wfree(data);
@@ -1196,23 +2040,24 @@ void save_PPM() {
 }
 
 static int load_GIF_pre(wchar_t *File, u32 id, bool dropped) {
-    int w, h;
-    int frames;
-    int *delays;
     int result = 0;
 
     unload_anim_image();
 
+    Gif_Anim *gif = (Gif_Anim *)malloc(sizeof(Gif_Anim));
     G->files[id].loading = true;
-    unsigned char *data = stbi_xload_file(File, &w, &h, &frames, &delays);
+    bool loaded = gif && gif_anim_read_file(File, gif);
     G->files[id].loading = false;
 
-    if (data != nullptr) {
-        G->graphics.main_image.w = w;
-        G->graphics.main_image.h = h;
-        G->anim_frames = frames;
-        G->anim_frame_delays = delays;
-        G->anim_buffer = data;
+    if (loaded) {
+        G->graphics.main_image.w = gif->w;
+        G->graphics.main_image.h = gif->h;
+        G->anim_frames = gif->frame_count;
+        G->anim_frame_delays = gif->delays;
+        G->anim_dirty_rects = gif->dirty_rects;
+        gif->delays = nullptr;
+        gif->dirty_rects = nullptr;
+        G->anim_gif = gif;
 
         G->anim_index = 0;
         G->anim_play = G->settings_autoplayGIFs;
@@ -1223,6 +2068,7 @@ static int load_GIF_pre(wchar_t *File, u32 id, bool dropped) {
             send_signal(G->signals.init_step_2);
         result = 1;
     } else {
+        free(gif); // gif_anim_read_file frees what it allocated, not the struct
         push_alert("Loading GIF file failed");
         G->files[G->current_file_index].failed = true;
         G->loaded = true;
@@ -1370,14 +2216,17 @@ static void apply_settings() {
 }
 #include <d3d11.h>
 static void load_image_post() {
+	G->graphics.main_image.has_histo = false;
+	G->graphics.blur_cache.valid = false;
     if (G->files[G->current_file_index].type == TYPE_GIF || G->files[G->current_file_index].type == TYPE_WEBP_ANIM) {
 		if (G->anim_texture.d3d_texture != 0)
 			G->anim_texture.d3d_texture->Release();
 		if (G->anim_texture.d3d_texture == 0)
             refresh_display();
 
-		G->anim_texture = create_texture(G->anim_buffer + G->anim_index * G->graphics.main_image.w * G->graphics.main_image.h * 4, 
-		                                G->graphics.main_image.w, G->graphics.main_image.h, true);
+		G->anim_texture = create_texture(anim_frame_pixels(G->anim_index), G->graphics.main_image.w, G->graphics.main_image.h, true);
+		G->anim_uploaded_index = G->anim_index;
+		reset_anim_clock();
     } else {
 		if (G->graphics.main_image.texture.d3d_texture != 0)
 			G->graphics.main_image.texture.d3d_texture->Release();
@@ -1385,9 +2234,16 @@ static void load_image_post() {
 		if (G->graphics.main_image.texture.d3d_texture == 0)
             refresh_display();
 
-		G->graphics.main_image.texture = create_texture(G->graphics.main_image.data, G->graphics.main_image.w, G->graphics.main_image.h, false);
+		G->graphics.main_image.texture = create_texture(G->graphics.main_image.data, G->graphics.main_image.w, G->graphics.main_image.h, false, G->graphics.main_image.format);
 		if (G->graphics.main_image.data) {
-			wfree(G->graphics.main_image.data);
+			// the texture holds the pixels from here on, save_image reads them back when it needs them
+			if (G->settings_calculate_histograms) {
+				Shared_Pixels *pixels = shared_pixels_create(G->graphics.main_image.data, G->graphics.main_image.w, G->graphics.main_image.h, G->graphics.main_image.format);
+				if (pixels) calculate_histogram_async(pixels, G->current_file_index);
+				shared_pixels_release(pixels);
+			} else {
+				wfree(G->graphics.main_image.data);
+			}
 			//SetProcessWorkingSetSize(GetCurrentProcess(), -1, -1);
 			G->graphics.main_image.data = 0;
 		}
@@ -1994,47 +2850,195 @@ static int scan_folder(wchar_t *path) {
 
 
 
-unsigned long create_RBG(int r, int g, int b) {
-    return (r << 16) | (g << 8) | b;
+unsigned long create_RBG(int r, int g, int b) {
+    return (r << 16) | (g << 8) | b;
+}
+
+
+static GUID get_GUID(Encoder_Format encoder_format) {
+
+	switch (encoder_format) {
+		case Format_Bmp:	return GUID_ContainerFormatBmp;
+		case Format_Png:	return GUID_ContainerFormatPng;
+		//case Format_Ico:	return GUID_ContainerFormatIco;
+		//case Format_Jpeg:	return GUID_ContainerFormatJpeg;
+		case Format_Tiff:	return GUID_ContainerFormatTiff;
+		//case Format_Gif:	return GUID_ContainerFormatGif;
+		//case Format_Wmp:	return GUID_ContainerFormatWmp;
+		case Format_Dds:	return GUID_ContainerFormatDds;
+		//case Format_Adng:	return GUID_ContainerFormatAdng;
+		case Format_Heif:	return GUID_ContainerFormatHeif;
+		//case Format_Webp:	return GUID_ContainerFormatWebp;
+		//case Format_Raw:	return GUID_ContainerFormatRaw;
+
+		default:  			return GUID_ContainerFormatJpeg;
+	}
+}
+
+#define EXPORT_BAND_ROWS 256
+
+static bool export_file_write(void *user, const void *data, size_t size) {
+	return fwrite(data, 1, size, (FILE *)user) == size;
+}
+
+// Formats handled by encoders.cpp instead of WIC, pulling their rows from 'source'. A partially
+// written file is deleted again.
+static HRESULT export_image_portable(Encoder_Format encoder_format, wchar_t *path, const Encoder_Source *source, i32 quality) {
+	FILE *file = _wfopen(path, L"wb");
+	if (!file)
+		return HRESULT_FROM_WIN32(ERROR_OPEN_FAILED);
+	bool ok = encode_image(encoder_format, source, quality, export_file_write, file);
+	if (fclose(file) != 0) ok = false;
+	if (!ok) _wremove(path);
+	return ok ? S_OK : E_FAIL;
+}
+
+// The mapped BGRA8 staging texture of the GPU export, swizzled to RGBA as the encoders ask for rows.
+struct Export_Mapped_Rows {
+	u8 *data;
+	UINT pitch;
+};
+
+static bool export_mapped_rows(void *user, i32 y, i32 rows, u8 *dst, size_t stride) {
+	Export_Mapped_Rows *mapped = (Export_Mapped_Rows *)user;
+	i32 w = (i32)(stride / 4);
+	for (i32 j = 0; j < rows; j++) {
+		u8 *row = mapped->data + (size_t)(y + j) * mapped->pitch;
+		u8 *out = dst + (size_t)j * stride;
+		for (i32 x = 0; x < w; x++) {
+			out[x * 4 + 0] = row[x * 4 + 2];
+			out[x * 4 + 1] = row[x * 4 + 1];
+			out[x * 4 + 2] = row[x * 4 + 0];
+			out[x * 4 + 3] = row[x * 4 + 3];
+		}
+	}
+	return true;
+}
+
+static bool export_pipeline_rows(void *user, i32 y, i32 rows, u8 *dst, size_t stride) {
+	cpu_pipeline_rows((Cpu_Pipeline *)user, y, rows, dst, stride);
+	return true;
+}
+
+// Encodes 'src' (w*h of 'src_format') through the CPU pipeline (cpu_pipeline.cpp) with 'constants'
+// in RENDER_MODE_ENCODER. For WIC formats rows are produced EXPORT_BAND_ROWS at a time and handed
+// straight to the WIC frame, so neither a render target nor the full output image is needed; the
+// D3D device isn't touched at all. PNG, JPEG and WebP pull their rows from the pipeline a band at a
+// time too (encoders.cpp).
+// Sources deeper than 8 bits are written with 16 bits per channel where the format allows it.
+static HRESULT export_image_cpu(Encoder_Format encoder_format, wchar_t *path, const Shader_Constants_Main *constants,
+                                u8 *src, Pixel_Format src_format, i32 w, i32 h, const Grading_LUT *grading, i32 quality) {
+	UINT width = (UINT)(constants->crop_b.x - constants->crop_a.x);
+	UINT height = (UINT)(constants->crop_b.y - constants->crop_a.y);
+	bool portable = encoder_is_portable(encoder_format);
+	Pixel_Format out_format = Pixel_Rgba8;
+	if (src_format != Pixel_Rgba8 && encoder_supports_rgba16(encoder_format))
+		out_format = Pixel_Rgba16;
+	UINT pixel_size = pixel_format_size(out_format);
+	Cpu_Pipeline pipeline;
+	if (!cpu_pipeline_begin(&pipeline, constants, src, src_format, w, h, width, height, out_format, !portable, grading))
+		return E_OUTOFMEMORY;
+
+	if (portable) {
+		Encoder_Source source = { export_pipeline_rows, &pipeline, out_format, (i32)width, (i32)height };
+		HRESULT hr = export_image_portable(encoder_format, path, &source, quality);
+		cpu_pipeline_end(&pipeline);
+		return hr;
+	}
+
+	IWICImagingFactory *factory = 0;
+	IWICBitmapEncoder *encoder = 0;
+	IWICStream *stream = 0;
+	IWICBitmapFrameEncode *frame = 0;
+	IPropertyBag2 *property_bag = 0;
+	WICPixelFormatGUID pixel_format = out_format == Pixel_Rgba16 ? GUID_WICPixelFormat64bppRGBA : GUID_WICPixelFormat32bppBGRA;
+	UINT stride = width * pixel_size;
+	u8 *band = (u8 *)malloc((size_t)stride * EXPORT_BAND_ROWS);
+
+	CoInitialize(NULL);
+	HRESULT hr = band ? S_OK : E_OUTOFMEMORY;
+	if (SUCCEEDED(hr))	hr = CoCreateInstance(CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER, IID_IWICImagingFactory, (LPVOID*)&factory);
+	if (SUCCEEDED(hr))	hr = factory->CreateStream(&stream);
+	if (SUCCEEDED(hr))	hr = stream->InitializeFromFilename(path, GENERIC_WRITE);
+	if (SUCCEEDED(hr))	hr = factory->CreateEncoder(get_GUID(encoder_format), nullptr, &encoder);
+	if (SUCCEEDED(hr))	hr = encoder->Initialize(stream, WICBitmapEncoderNoCache);
+	if (SUCCEEDED(hr))	hr = encoder->CreateNewFrame(&frame, &property_bag);
+	if (SUCCEEDED(hr))	hr = frame->Initialize(property_bag);
+	if (SUCCEEDED(hr))	hr = frame->SetSize(width, height);
+	if (SUCCEEDED(hr))	hr = frame->SetPixelFormat(&pixel_format);
+	// Encoders without alpha (JPEG) answer with 24bpp BGR, the bands are packed down for those.
+	bool packed = IsEqualGUID(pixel_format, GUID_WICPixelFormat24bppBGR) != 0;
+	if (out_format == Pixel_Rgba16) {
+		if (SUCCEEDED(hr) && !IsEqualGUID(pixel_format, GUID_WICPixelFormat64bppRGBA))
+			hr = WINCODEC_ERR_UNSUPPORTEDPIXELFORMAT;
+	} else if (SUCCEEDED(hr) && !packed && !IsEqualGUID(pixel_format, GUID_WICPixelFormat32bppBGRA) && !IsEqualGUID(pixel_format, GUID_WICPixelFormat32bppBGR)) {
+		hr = WINCODEC_ERR_UNSUPPORTEDPIXELFORMAT;
+	}
+
+	for (UINT y = 0; SUCCEEDED(hr) && y < height; y += EXPORT_BAND_ROWS) {
+		UINT rows = min((UINT)EXPORT_BAND_ROWS, height - y);
+		cpu_pipeline_rows(&pipeline, y, rows, band, stride);
+		UINT band_stride = stride;
+		if (packed) {
+			band_stride = width * 3;
+			for (UINT j = 0; j < rows; j++) {
+				u8 *row = band + (size_t)j * stride;
+				u8 *out = band + (size_t)j * band_stride;
+				for (UINT x = 0; x < width; x++) {
+					out[x * 3 + 0] = row[x * 4 + 0];
+					out[x * 3 + 1] = row[x * 4 + 1];
+					out[x * 3 + 2] = row[x * 4 + 2];
+				}
+			}
+		}
+		hr = frame->WritePixels(rows, band_stride, band_stride * rows, band);
+	}
+	if (SUCCEEDED(hr))	hr = frame->Commit();
+	if (SUCCEEDED(hr))	hr = encoder->Commit();
+
+	if (property_bag) property_bag->Release();
+	if (frame) frame->Release();
+	if (encoder) encoder->Release();
+	if (stream) stream->Release();
+	if (factory) factory->Release();
+	CoUninitialize();
+
+	free(band);
+	cpu_pipeline_end(&pipeline);
+	return hr;
 }
 
+// Writes to 'path', or to 'clipboard' if given (clipboard.cpp).
+// save_image's GPU path, what animations are exported with: ps_main in RENDER_MODE_ENCODER with the
+// current edit over the main image, into a BGRA8 texture the size of the crop, copied into a staging
+// texture that stays mapped until release_offscreen_render. The CPU pipeline has to produce the same
+// pixels, the tests compare the two.
+struct Offscreen_Render {
+	ID3D11Texture2D *texture;
+	ID3D11RenderTargetView *rtv;
+	ID3D11Texture2D *staging;
+	u8 *data;		// w*h BGRA8, rows 'pitch' bytes apart
+	UINT pitch;
+	i32 w, h;
+};
 
-static GUID get_GUID(Encoder_Format encoder_format) {
-
-	switch (encoder_format) {
-		case Format_Bmp:	return GUID_ContainerFormatBmp;
-		case Format_Png:	return GUID_ContainerFormatPng;
-		//case Format_Ico:	return GUID_ContainerFormatIco;
-		//case Format_Jpeg:	return GUID_ContainerFormatJpeg;
-		case Format_Tiff:	return GUID_ContainerFormatTiff;
-		//case Format_Gif:	return GUID_ContainerFormatGif;
-		//case Format_Wmp:	return GUID_ContainerFormatWmp;
-		case Format_Dds:	return GUID_ContainerFormatDds;
-		//case Format_Adng:	return GUID_ContainerFormatAdng;
-		case Format_Heif:	return GUID_ContainerFormatHeif;
-		//case Format_Webp:	return GUID_ContainerFormatWebp;
-		//case Format_Raw:	return GUID_ContainerFormatRaw;
-
-		default:  			return GUID_ContainerFormatJpeg;
-	}
+static void release_offscreen_render(Offscreen_Render *render) {
+	Graphics* ctx = &G->graphics;
+	if (render->rtv) render->rtv->Release();
+	if (render->texture) render->texture->Release();
+	if (render->data) ctx->device_ctx->Unmap(render->staging, 0);
+	if (render->staging) render->staging->Release();
+	*render = {};
 }
 
-static HRESULT save_image(Encoder_Format encoder_format, wchar_t* path, bool clipboard = false) {
+static HRESULT render_image_offscreen(Offscreen_Render *render) {
 	Graphics* ctx = &G->graphics;
-
-	IWICBitmapEncoder* encoder = 0;
-	IWICStream* stream = 0;
-	IWICBitmapFrameEncode* frame = 0;
-
-	HRESULT hr = 0;
-	if (!clipboard && path == 0) {
-		push_alert("Failed to fetch file path from `save as` dialogue.");
-		return -1;
-	}
-
+	*render = {};
 	DXGI_FORMAT image_format = DXGI_FORMAT_B8G8R8A8_UNORM;
 
 	v2 new_size = _v2(G->crop_b - G->crop_a);
+	render->w = (i32)new_size.x;
+	render->h = (i32)new_size.y;
 
 	// create an offscreen texture
 	D3D11_TEXTURE2D_DESC tex_desc = { };
@@ -2049,16 +3053,22 @@ static HRESULT save_image(Encoder_Format encoder_format, wchar_t* path, bool cli
 	tex_desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
 	tex_desc.CPUAccessFlags = 0;
 	tex_desc.MiscFlags = 0;
-	ID3D11Texture2D* offscreen_texture = nullptr;
-	ID3D11RenderTargetView* offscreen_texture_rtv = nullptr;
-	hr = ctx->device->CreateTexture2D(&tex_desc, NULL, &offscreen_texture);
-	hr = ctx->device->CreateRenderTargetView(offscreen_texture, NULL, &offscreen_texture_rtv);
+	HRESULT hr = ctx->device->CreateTexture2D(&tex_desc, NULL, &render->texture);
+	if (SUCCEEDED(hr)) hr = ctx->device->CreateRenderTargetView(render->texture, NULL, &render->rtv);
+	if (FAILED(hr)) {
+		release_offscreen_render(render);
+		return hr;
+	}
 
 	// run the shaders on it
+	Texture *blurred = G->do_blur ? update_blur_cache(&G->graphics.main_image.texture, 0, true) : nullptr;
 	ctx->device_ctx->ClearState();
 	Shader_Constants_Main constants_main = set_main_shader_constants();
 	constants_main.render_mode = RENDER_MODE_ENCODER;
 	constants_main.aspect_img = new_size.x / new_size.y;
+	if (blurred)
+		constants_main.do_blur = false;
+	update_color_cache(&constants_main);
 	upload_constants(&ctx->main_program, &constants_main);
 	D3D11_VIEWPORT vp;
 	vp.Width = new_size.x;
@@ -2073,11 +3083,11 @@ static HRESULT save_image(Encoder_Format encoder_format, wchar_t* path, bool cli
 	ctx->device_ctx->VSSetConstantBuffers(0, 1, &ctx->main_program.constants_buffer);
 	ctx->device_ctx->PSSetShader(ctx->main_program.pixel_shader, nullptr, 0);
 	ctx->device_ctx->PSSetConstantBuffers(0, 1, &ctx->main_program.constants_buffer);
-	ctx->device_ctx->PSSetShaderResources(0, 1, &G->graphics.main_image.texture.srv);
+	ctx->device_ctx->PSSetShaderResources(0, 1, blurred ? &blurred->srv : &G->graphics.main_image.texture.srv);
 	ctx->device_ctx->PSSetSamplers(0, 1, &ctx->sampler_nearest);
 	ctx->device_ctx->RSSetState(ctx->raster_state);
 	ctx->device_ctx->RSSetViewports(1, &vp);
-	ctx->device_ctx->OMSetRenderTargets(1, &offscreen_texture_rtv, nullptr); // we don't need a depth/stencil view here
+	ctx->device_ctx->OMSetRenderTargets(1, &render->rtv, nullptr); // we don't need a depth/stencil view here
 	ctx->device_ctx->Draw(4, 0);
 
 	// Create a staging texture with the same format as the render target
@@ -2091,64 +3101,76 @@ static HRESULT save_image(Encoder_Format encoder_format, wchar_t* path, bool cli
 	staging_desc.Usage = D3D11_USAGE_STAGING;
 	staging_desc.BindFlags = 0;
 	staging_desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
-
-	ID3D11Texture2D* staging_texture = nullptr;
-	hr = ctx->device->CreateTexture2D(&staging_desc, nullptr, &staging_texture);
+	hr = ctx->device->CreateTexture2D(&staging_desc, nullptr, &render->staging);
 	if (FAILED(hr)) {
-		goto cleanup;
+		release_offscreen_render(render);
+		return hr;
 	}
 
 	// Copy the whole texture from the render target to the staging texture
-	ctx->device_ctx->CopySubresourceRegion(staging_texture, 0, 0, 0, 0, offscreen_texture, 0, 0);
+	ctx->device_ctx->CopySubresourceRegion(render->staging, 0, 0, 0, 0, render->texture, 0, 0);
 
 	// Map the staging texture
 	D3D11_MAPPED_SUBRESOURCE mapped_resource;
-	hr = ctx->device_ctx->Map(staging_texture, 0, D3D11_MAP_READ, 0, &mapped_resource);
+	hr = ctx->device_ctx->Map(render->staging, 0, D3D11_MAP_READ, 0, &mapped_resource);
+	if (SUCCEEDED(hr) && !mapped_resource.pData) hr = E_FAIL;
 	if (FAILED(hr)) {
-		goto cleanup;
-	}
-
-	u8* data = reinterpret_cast<u8*>(mapped_resource.pData);
-	if (data == nullptr) {
-		printf("invalid data ptr\n");
-		goto cleanup;
+		release_offscreen_render(render);
+		return hr;
 	}
+	render->data = (u8 *)mapped_resource.pData;
+	render->pitch = mapped_resource.RowPitch;
+	return S_OK;
+}
 
-	if (clipboard) {
-		// @hkva: GdiPlus required here as Gdi32 does not easily support bitmaps with alpha channels.
-		//	      First create a device-independent bitmap (GdiPlus::Bitmap), then convert to a
-		//		  device-compatible bitmap for WinAPI use.
-		// References:
-		//        https://github.com/nakst/imgview/blob/d3e918b7f65cfb5a595b1b756c69cd1c1a30b13e/imgview.cpp#L574
-
-		Gdiplus::Bitmap dib(new_size.x, new_size.y, mapped_resource.RowPitch, PixelFormat32bppARGB, data);
-		if (dib.GetLastStatus() != Gdiplus::Ok) {
-			printf("Failed to create GDI+ bitmap\n");
-			return 1;
-		}
+static HRESULT save_image(Encoder_Format encoder_format, wchar_t* path, Clipboard *clipboard = nullptr) {
+	Graphics* ctx = &G->graphics;
 
-		HBITMAP hdib;
-		dib.GetHBITMAP(0, &hdib);
+	// Still images export on the CPU. Their decoded pixels are read back from the texture and only kept
+	// while the export runs. Animations, and a failed read back, go through the offscreen render below.
+	int type = G->files.Count > 0 ? G->files[G->current_file_index].type : 0;
+	bool animated = type == TYPE_GIF || type == TYPE_WEBP_ANIM;
+	u8 *src = nullptr;
+	if (!animated && ctx->main_image.texture.d3d_texture && (clipboard || path))
+		src = read_texture_pixels(&ctx->main_image.texture, ctx->main_image.w, ctx->main_image.h, ctx->main_image.format);
+	if (src) {
+		Shader_Constants_Main constants = set_main_shader_constants();
+		constants.render_mode = RENDER_MODE_ENCODER;
+		Image *image = &ctx->main_image;
+		HRESULT result;
+		if (clipboard)
+			result = copy_image_cpu(clipboard, &constants, src, image->format, image->w, image->h, &G->grading_lut) ? S_OK : E_FAIL;
+		else
+			result = export_image_cpu(encoder_format, path, &constants, src, image->format, image->w, image->h, &G->grading_lut, G->export_quality);
+		wfree(src);
+		return result;
+	}
 
-		DIBSECTION hdibs;
-		GetObject(hdib, sizeof(hdibs), &hdibs);
+	IWICBitmapEncoder* encoder = 0;
+	IWICStream* stream = 0;
+	IWICBitmapFrameEncode* frame = 0;
 
-		HBITMAP ddb = CreateDIBitmap(hdc, &hdibs.dsBmih, CBM_INIT, hdibs.dsBm.bmBits, (const BITMAPINFO*)&hdibs.dsBmih, DIB_RGB_COLORS);
-		if (!ddb) {
-			printf("Failed to to convert GDI+ bitmap to a device-compatible bitmap\n");
-			return 1;
-		}
+	HRESULT hr = 0;
+	if (!clipboard && path == 0) {
+		push_alert("Failed to fetch file path from `save as` dialogue.");
+		return -1;
+	}
 
-		if (!OpenClipboard(NULL)) {
-			printf("Failed to open clipboard\n");
-			return 1;
-		}
-		EmptyClipboard();
-		SetClipboardData(CF_BITMAP, ddb);
-		CloseClipboard();
+	Offscreen_Render render;
+	hr = render_image_offscreen(&render);
+	if (FAILED(hr)) {
+		goto cleanup;
+	}
 
-		DeleteObject(ddb);
+	if (clipboard) {
+		hr = copy_image_bgra(clipboard, render.data, render.pitch, render.w, render.h) ? S_OK : E_FAIL;
+		goto cleanup;
+	}
 
+	if (encoder_is_portable(encoder_format)) {
+		Export_Mapped_Rows mapped = { render.data, render.pitch };
+		Encoder_Source source = { export_mapped_rows, &mapped, Pixel_Rgba8, render.w, render.h };
+		hr = export_image_portable(encoder_format, path, &source, G->export_quality);
 		goto cleanup;
 	}
 
@@ -2162,9 +3184,9 @@ static HRESULT save_image(Encoder_Format encoder_format, wchar_t* path, bool cli
 	                      CLSCTX_INPROC_SERVER,
 	                      IID_IWICImagingFactory,
 	                      (LPVOID*) & G->wic_factory);
-	UINT width = new_size.x;
-	UINT height = new_size.y;
-	UINT stride = mapped_resource.RowPitch;
+	UINT width = render.w;
+	UINT height = render.h;
+	UINT stride = render.pitch;
 	UINT buffer_size = stride * height;
 	if (SUCCEEDED(hr))	hr = G->wic_factory->CreateStream(&stream);
 	if (SUCCEEDED(hr))	hr = stream->InitializeFromFilename(path, GENERIC_WRITE);
@@ -2176,7 +3198,7 @@ static HRESULT save_image(Encoder_Format encoder_format, wchar_t* path, bool cli
 	if (SUCCEEDED(hr))	hr = frame->SetPixelFormat(&pixel_format);
 	//	if (SUCCEEDED(hr)) // We're expecting to write out 32bppBGRA. Fail if the encoder cannot do it.
 	//		hr = IsEqualGUID(req_pixel_format, pixel_format) ? S_OK : E_FAIL;
-	if (SUCCEEDED(hr)) 	hr = frame->WritePixels(height, stride, buffer_size, data);
+	if (SUCCEEDED(hr)) 	hr = frame->WritePixels(height, stride, buffer_size, render.data);
 	if (SUCCEEDED(hr)) 	hr = frame->Commit();
 	if (SUCCEEDED(hr)) 	hr = encoder->Commit();
 	if (SUCCEEDED(hr)) {
@@ -2191,11 +3213,7 @@ static HRESULT save_image(Encoder_Format encoder_format, wchar_t* path, bool cli
 	if (stream) stream->Release();
 	if (encoder) encoder->Release();
 
-	if (offscreen_texture_rtv) offscreen_texture_rtv->Release();
-	if (offscreen_texture) offscreen_texture->Release();
-
-	if (staging_texture) ctx->device_ctx->Unmap(staging_texture, 0);
-	if (staging_texture) staging_texture->Release();
+	release_offscreen_render(&render);
 
 	CoUninitialize();
 
@@ -2243,6 +3261,8 @@ HRESULT save_as_dialogue() {
 }
 
 
+static COMDLG_FILTERSPEC image_file_types[] = { { L"Images", L"*.3fr;*.ari;*.arw;*.avci;*.avcs;*.avif;*.avifs;*.bay;*.bmp;*.cap;*.cr2;*.cr3;*.crw;*.cur;*.dcr;*.dcs;*.dds;*.dib;*.dng;*.drf;*.eip;*.erf;*.exif;*.fff;*.gif;*.heic;*.heics;*.heif;*.heifs;*.hif;*.ico;*.icon;*.iiq;*.jfif;*.jpe;*.jpeg;*.jpg;*.jxr;*.k25;*.kdc;*.mef;*.mos;*.mrw;*.nef;*.nrw;*.orf;*.ori;*.pef;*.png;*.ptx;*.pxn;*.raf;*.raw;*.rle;*.rw2;*.rwl;*.sr2;*.srf;*.srw;*.tif;*.tiff;*.wdp;*.webp;*.x3f" } };
+
 void file_open_dialogue() {
     IFileOpenDialog *dialogue = 0;
 	IShellItem *item = 0;
@@ -2251,13 +3271,11 @@ void file_open_dialogue() {
 	CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
     HRESULT hr = CoCreateInstance(CLSID_FileOpenDialog, NULL, CLSCTX_ALL, 
             IID_IFileOpenDialog, reinterpret_cast<void**>(&dialogue));
-	COMDLG_FILTERSPEC extensions[] = {  { L"Images", L"*.3fr;*.ari;*.arw;*.avci;*.avcs;*.avif;*.avifs;*.bay;*.bmp;*.cap;*.cr2;*.cr3;*.crw;*.cur;*.dcr;*.dcs;*.dds;*.dib;*.dng;*.drf;*.eip;*.erf;*.exif;*.fff;*.gif;*.heic;*.heics;*.heif;*.heifs;*.hif;*.ico;*.icon;*.iiq;*.jfif;*.jpe;*.jpeg;*.jpg;*.jxr;*.k25;*.kdc;*.mef;*.mos;*.mrw;*.nef;*.nrw;*.orf;*.ori;*.pef;*.png;*.ptx;*.pxn;*.raf;*.raw;*.rle;*.rw2;*.rwl;*.sr2;*.srf;*.srw;*.tif;*.tiff;*.wdp;*.webp;*.x3f" },
-    };
 
 	if (dialogue == 0) 
 		goto cleanup;
 	if (SUCCEEDED(hr))
-		hr = dialogue->SetFileTypes(1, extensions);
+		hr = dialogue->SetFileTypes(array_size(image_file_types), image_file_types);
 	if (SUCCEEDED(hr))
 		hr = dialogue->Show(NULL);
 	if (SUCCEEDED(hr))
@@ -2281,6 +3299,240 @@ void file_open_dialogue() {
 
     CoUninitialize();
 }
+
+// Replaces the grading LUT. Readers on other threads copy it under G->mutex and notice the swap
+// through 'version'.
+static void set_grading_lut(Grading_LUT *lut) {
+	EnterCriticalSection(&G->mutex);
+	free(G->grading_lut.data);
+	u32 version = G->grading_lut.version;
+	G->grading_lut = *lut;
+	G->grading_lut.version = version + 1;
+	LeaveCriticalSection(&G->mutex);
+}
+
+static void clear_grading_lut() {
+	Grading_LUT lut = {};
+	set_grading_lut(&lut);
+}
+
+static void load_cube_lut_dialogue() {
+	IFileOpenDialog *dialogue = 0;
+	IShellItem *item = 0;
+	PWSTR file_path = 0;
+
+	CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
+	HRESULT hr = CoCreateInstance(CLSID_FileOpenDialog, NULL, CLSCTX_ALL,
+			IID_IFileOpenDialog, reinterpret_cast<void**>(&dialogue));
+	COMDLG_FILTERSPEC extensions[] = { { L"3D LUT", L"*.cube" } };
+
+	if (dialogue == 0)
+		goto cleanup;
+	if (SUCCEEDED(hr))
+		hr = dialogue->SetFileTypes(1, extensions);
+	if (SUCCEEDED(hr))
+		hr = dialogue->Show(NULL);
+	if (SUCCEEDED(hr))
+		hr = dialogue->GetResult(&item);
+	if (SUCCEEDED(hr))
+		hr = item->GetDisplayName(SIGDN_FILESYSPATH, &file_path);
+	if (SUCCEEDED(hr)) {
+		FILE *file = _wfopen(file_path, L"rb");
+		char *text = nullptr;
+		if (file) {
+			fseek(file, 0, SEEK_END);
+			long size = ftell(file);
+			fseek(file, 0, SEEK_SET);
+			text = size > 0 ? (char *)malloc(size + 1) : nullptr;
+			if (text) text[fread(text, 1, size, file)] = 0;
+			fclose(file);
+		}
+		Grading_LUT lut = {};
+		char error[128];
+		if (!text) {
+			push_alert("Failed to read the LUT file.");
+		} else if (!cube_lut_parse(text, &lut, error, sizeof(error))) {
+			push_alert(UI_tprintf(G->ui, "Invalid .cube file: %s", error));
+		} else {
+			if (!lut.name[0]) {
+				wchar_t *name = wcsrchr(file_path, L'\\');
+				WideCharToMultiByte(CP_UTF8, 0, name ? name + 1 : file_path, -1, lut.name, sizeof(lut.name) - 1, NULL, NULL);
+			}
+			set_grading_lut(&lut);
+		}
+		free(text);
+		CoTaskMemFree(file_path);
+	}
+
+	cleanup:
+
+	if (item) 		item->Release();
+	if (dialogue) 	dialogue->Release();
+
+	CoUninitialize();
+}
+
+// Batch export of the picked files with the current edits (and grading LUT) into a picked folder.
+static void batch_export_dialogue() {
+	IFileOpenDialog *dialogue = 0;
+	IFileOpenDialog *folder_dialogue = 0;
+	IShellItemArray *items = 0;
+	IShellItem *folder = 0;
+	PWSTR folder_path = 0;
+	DWORD count = 0;
+	DWORD options = 0;
+	Batch_Job *job = 0;
+
+	if (G->batch) return;
+	CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
+	HRESULT hr = CoCreateInstance(CLSID_FileOpenDialog, NULL, CLSCTX_ALL, IID_IFileOpenDialog, reinterpret_cast<void**>(&dialogue));
+	if (SUCCEEDED(hr))
+		hr = CoCreateInstance(CLSID_FileOpenDialog, NULL, CLSCTX_ALL, IID_IFileOpenDialog, reinterpret_cast<void**>(&folder_dialogue));
+	if (dialogue == 0 || folder_dialogue == 0)
+		goto cleanup;
+	if (SUCCEEDED(hr))
+		hr = dialogue->SetFileTypes(array_size(image_file_types), image_file_types);
+	if (SUCCEEDED(hr))
+		hr = dialogue->GetOptions(&options);
+	if (SUCCEEDED(hr))
+		hr = dialogue->SetOptions(options | FOS_ALLOWMULTISELECT);
+	if (SUCCEEDED(hr))
+		hr = dialogue->SetTitle(L"Batch export: files to process");
+	if (SUCCEEDED(hr))
+		hr = dialogue->Show(NULL);
+	if (SUCCEEDED(hr))
+		hr = dialogue->GetResults(&items);
+	if (SUCCEEDED(hr))
+		hr = folder_dialogue->GetOptions(&options);
+	if (SUCCEEDED(hr))
+		hr = folder_dialogue->SetOptions(options | FOS_PICKFOLDERS);
+	if (SUCCEEDED(hr))
+		hr = folder_dialogue->SetTitle(L"Batch export: output folder");
+	if (SUCCEEDED(hr))
+		hr = folder_dialogue->Show(NULL);
+	if (SUCCEEDED(hr))
+		hr = folder_dialogue->GetResult(&folder);
+	if (SUCCEEDED(hr))
+		hr = folder->GetDisplayName(SIGDN_FILESYSPATH, &folder_path);
+	if (SUCCEEDED(hr))
+		hr = items->GetCount(&count);
+	if (SUCCEEDED(hr)) {
+		Edit_Preset preset = edit_preset_from_current();
+		job = batch_create(&preset, folder_path, G->batch_format, G->export_quality, &G->grading_lut);
+		if (job) job->color_manage = G->settings_color_management;
+		for (DWORD i = 0; job && i < count; i++) {
+			IShellItem *item = 0;
+			PWSTR path = 0;
+			if (SUCCEEDED(items->GetItemAt(i, &item)) && SUCCEEDED(item->GetDisplayName(SIGDN_FILESYSPATH, &path)))
+				batch_add_input(job, path);
+			if (path) CoTaskMemFree(path);
+			if (item) item->Release();
+		}
+		if (job) job->wake = G->loader_event;
+		if (job && job->inputs.Count > 0 && batch_start_async(job)) {
+			G->batch = job;
+		} else {
+			push_alert("Failed to start the batch export.");
+			if (job) batch_free(job);
+		}
+	}
+
+	cleanup:
+
+	if (folder_path)		CoTaskMemFree(folder_path);
+	if (folder) 			folder->Release();
+	if (items) 				items->Release();
+	if (folder_dialogue) 	folder_dialogue->Release();
+	if (dialogue) 			dialogue->Release();
+
+	CoUninitialize();
+}
+
+// Reports a finished batch export started from the UI.
+static void update_batch() {
+	if (!G->batch || !G->batch->finished) return;
+	if (G->batch->failed)
+		push_alert(UI_tprintf(G->ui, "Batch export: %ld saved, %ld failed.", G->batch->done, G->batch->failed));
+	else
+		push_alert(UI_tprintf(G->ui, "Batch export: %ld images saved.", G->batch->done), Alert_Info);
+	batch_free(G->batch);
+	G->batch = nullptr;
+}
+
+static COMDLG_FILTERSPEC preset_file_types[] = { { L"Edit preset", L"*.json" } };
+
+static void save_edit_preset_dialogue() {
+	IFileSaveDialog *dialogue = 0;
+	IShellItem *item = 0;
+	PWSTR file_path = 0;
+
+	CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
+	HRESULT hr = CoCreateInstance(CLSID_FileSaveDialog, NULL, CLSCTX_ALL,
+	                              IID_IFileSaveDialog, reinterpret_cast<void**>(&dialogue));
+	if (dialogue == 0)
+		goto cleanup;
+	if (SUCCEEDED(hr))
+		hr = dialogue->SetFileTypes(array_size(preset_file_types), preset_file_types);
+	if (SUCCEEDED(hr))
+		hr = dialogue->SetDefaultExtension(L"json");
+	if (SUCCEEDED(hr))
+		hr = dialogue->Show(NULL);
+	if (SUCCEEDED(hr))
+		hr = dialogue->GetResult(&item);
+	if (SUCCEEDED(hr))
+		hr = item->GetDisplayName(SIGDN_FILESYSPATH, &file_path);
+	if (SUCCEEDED(hr)) {
+		Edit_Preset preset = edit_preset_from_current();
+		if (edit_preset_save(&preset, file_path))
+			push_alert("Preset saved.", Alert_Info);
+		else
+			push_alert("Failed to save the preset.");
+	}
+
+	cleanup:
+
+	if (file_path)	CoTaskMemFree(file_path);
+	if (item) 		item->Release();
+	if (dialogue) 	dialogue->Release();
+
+	CoUninitialize();
+}
+
+static void load_edit_preset_dialogue() {
+	IFileOpenDialog *dialogue = 0;
+	IShellItem *item = 0;
+	PWSTR file_path = 0;
+
+	CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
+	HRESULT hr = CoCreateInstance(CLSID_FileOpenDialog, NULL, CLSCTX_ALL,
+	                              IID_IFileOpenDialog, reinterpret_cast<void**>(&dialogue));
+	if (dialogue == 0)
+		goto cleanup;
+	if (SUCCEEDED(hr))
+		hr = dialogue->SetFileTypes(array_size(preset_file_types), preset_file_types);
+	if (SUCCEEDED(hr))
+		hr = dialogue->Show(NULL);
+	if (SUCCEEDED(hr))
+		hr = dialogue->GetResult(&item);
+	if (SUCCEEDED(hr))
+		hr = item->GetDisplayName(SIGDN_FILESYSPATH, &file_path);
+	if (SUCCEEDED(hr)) {
+		Edit_Preset preset;
+		if (edit_preset_load(&preset, file_path))
+			edit_preset_apply(&preset);
+		else
+			push_alert("Failed to read the preset.");
+	}
+
+	cleanup:
+
+	if (file_path)	CoTaskMemFree(file_path);
+	if (item) 		item->Release();
+	if (dialogue) 	dialogue->Release();
+
+	CoUninitialize();
+}
+
 bool should_show_gui() {
     POINT cursorPos;
     GetCursorPos(&cursorPos);
@@ -2478,6 +3730,82 @@ static void update_gui() {
 
 		UI_pop_parent(ctx);
 	}
+	bool animated = G->files.Count > 0 && (G->files[G->current_file_index].type == TYPE_GIF || G->files[G->current_file_index].type == TYPE_WEBP_ANIM);
+	if (G->settings_anim_stats && animated && G->anim_frames > 0) {
+		Anim_Clock *clock = &G->anim_clock;
+		u64 n = max(clock->frames_shown, 1ull);
+		f64 mean = clock->lateness_sum / n;
+		f64 jitter = sqrt(max(clock->lateness_sq_sum / n - mean * mean, 0.0));
+
+		UI_Block *poup = UI_push_block(ctx, 0);
+		poup->style.size[axis_x] = { UI_Size_t::pixels, 200, 1 };
+		poup->style.size[axis_y] = { UI_Size_t::sum_of_children, 0, 1 };
+		poup->style.position[axis_x] = { UI_Position_t::absolute, 5 };
+		poup->style.position[axis_y] = { UI_Position_t::absolute, 5 };
+		poup->style.layout.padding = v2(5);
+		poup->style.roundness = v4(6.f);
+		poup->style.color[c_background] = theme->bg_main_0;
+		poup->flags |= UI_Block_Flags_draw_background;
+		poup->style.layout.spacing = v2(4);
+
+		UI_push_parent(ctx, poup);
+		UI_Color4 col_0 = theme->text_header_2;
+		UI_Color4 col_1 = theme->text_reg_main;
+		UI_text(theme->text_header_1, G->ui_font, 14, "Animation timing:");
+		UI_push_parent_defer(ctx, UI_bar(axis_x)) {
+			UI_text(col_0, G->ui_font, 12, "FPS: ");
+			UI_text(col_1, G->ui_font, 12, "%.2f (nominal %.2f)", clock->play_time > 0 ? clock->frames_shown / clock->play_time : 0, clock->nominal_fps);
+		}
+		UI_push_parent_defer(ctx, UI_bar(axis_x)) {
+			UI_text(col_0, G->ui_font, 12, "Shown / skipped: ");
+			UI_text(col_1, G->ui_font, 12, "%llu / %llu", clock->frames_shown, clock->frames_skipped);
+		}
+		UI_push_parent_defer(ctx, UI_bar(axis_x)) {
+			UI_text(col_0, G->ui_font, 12, "Late frames: ");
+			UI_text(col_1, G->ui_font, 12, "%llu (stalls: %llu)", clock->frames_late, clock->stalls);
+		}
+		UI_push_parent_defer(ctx, UI_bar(axis_x)) {
+			UI_text(col_0, G->ui_font, 12, "Jitter: ");
+			UI_text(col_1, G->ui_font, 12, "%.2f ms (max late %.1f ms)", jitter * 1000, clock->lateness_max * 1000);
+		}
+		UI_pop_parent(ctx);
+		if (G->anim_play) G->force_loop = true;
+	}
+	if (G->settings_ui_stats) {
+		UI_Debug *debug = &ctx->debug;
+		UI_Block *poup = UI_push_block(ctx, 0);
+		poup->style.size[axis_x] = { UI_Size_t::pixels, 200, 1 };
+		poup->style.size[axis_y] = { UI_Size_t::sum_of_children, 0, 1 };
+		poup->style.position[axis_x] = { UI_Position_t::absolute, 5 };
+		poup->style.position[axis_y] = { UI_Position_t::absolute, WH - 140.f };
+		poup->style.layout.padding = v2(5);
+		poup->style.roundness = v4(6.f);
+		poup->style.color[c_background] = theme->bg_main_0;
+		poup->flags |= UI_Block_Flags_draw_background;
+		poup->style.layout.spacing = v2(4);
+
+		UI_push_parent(ctx, poup);
+		UI_Color4 col_0 = theme->text_header_2;
+		UI_Color4 col_1 = theme->text_reg_main;
+		UI_text(theme->text_header_1, G->ui_font, 14, "UI frame (previous):");
+		UI_push_parent_defer(ctx, UI_bar(axis_x)) {
+			UI_text(col_0, G->ui_font, 12, "Blocks / vertices: ");
+			UI_text(col_1, G->ui_font, 12, "%d / %d", debug->last_block_count, debug->last_vertex_count);
+		}
+		UI_push_parent_defer(ctx, UI_bar(axis_x)) {
+			UI_text(col_0, G->ui_font, 12, "Build: ");
+			UI_text(col_1, G->ui_font, 12, "%.3f ms (sort %.3f ms)", debug->last_build_ms, debug->last_sort_ms);
+		}
+		UI_push_parent_defer(ctx, UI_bar(axis_x)) {
+			UI_text(col_0, G->ui_font, 12, "Layout: ");
+			UI_text(col_1, G->ui_font, 12, "%.3f ms%s", debug->last_layout_ms, debug->last_frame_reused ? " (reused)" : "");
+		}
+		UI_push_parent_defer(ctx, UI_bar(axis_x)) {
+			UI_text(col_0, G->ui_font, 12, "Memory: ");
+			UI_text(col_1, G->ui_font, 12, "%.1f KB frame, %.1f KB state", debug->last_frame_bytes / 1024.f, debug->allocated_bytes / 1024.f);
+		}
+		UI_pop_parent(ctx);
+	}
 	if (G->crop_mode) {
 		UI_Block *poup = UI_push_block(ctx, 0);
 		poup->style.size[axis_x] = { UI_Size_t::pixels, 200, 1 };
@@ -2723,7 +4051,7 @@ static void update_gui() {
 				left_menu->style.roundness = v4(8);
 				left_menu->flags |= UI_Block_Flags_draw_background;
 				left_menu->hash = UI_hash_djb2(ctx, "left_menu");
-				G->check_mouse_hashes.push_back(left_menu->hash);
+				left_menu->flags |= UI_Block_Flags_capture_mouse;
 				UI_push_parent_defer(ctx, left_menu)
 				{
 					UI_push_parent_defer(ctx, UI_bar(axis_y))
@@ -2751,6 +4079,8 @@ static void update_gui() {
 						UI_set_disabled_defer((!G->settings_calculate_histograms || !G->graphics.main_image.has_histo))
 						{
 							popup_open |= UI_histogram(&histogram_style, "histogram");
+							if (G->histo_block && G->histo_show_adjusted)
+								request_adjusted_histogram();
 						}
 
 						UI_Button_Style style = btn_default;
@@ -2809,7 +4139,7 @@ static void update_gui() {
 				control_menu->style.roundness = v4(8);
 				control_menu->flags |= UI_Block_Flags_draw_background;
 				control_menu->hash = UI_hash_djb2(ctx, "control_menu");
-				G->check_mouse_hashes.push_back(control_menu->hash);
+				control_menu->flags |= UI_Block_Flags_capture_mouse;
 				UI_push_parent_defer(ctx, control_menu)
 				{
 					if (G->files.Count && (G->files[G->current_file_index].type == TYPE_GIF || G->files[G->current_file_index].type == TYPE_WEBP_ANIM)) {
@@ -2904,7 +4234,7 @@ static void update_gui() {
 				right_menu->style.roundness = v4(8);
 				right_menu->flags |= UI_Block_Flags_draw_background;
 				right_menu->hash = UI_hash_djb2(ctx, "right_menu");
-				G->check_mouse_hashes.push_back(right_menu->hash);
+				right_menu->flags |= UI_Block_Flags_capture_mouse;
 				UI_push_parent_defer(ctx, right_menu)
 				{
 					UI_push_parent_defer(ctx, UI_bar(axis_x))
@@ -3013,7 +4343,7 @@ static void update_gui() {
 				thumbs_bar->style.layout.align[axis_x] = align_center;
 				thumbs_bar->style.softness = 0;
 				thumbs_bar->hash = UI_hash_djb2(ctx, "thumbs_bar");
-				G->check_mouse_hashes.push_back(thumbs_bar->hash);
+				thumbs_bar->flags |= UI_Block_Flags_capture_mouse;
 				UI_push_parent_defer(ctx, thumbs_bar)
 				{
 					static f32 begin = 0;
@@ -3088,7 +4418,7 @@ static void update_gui() {
 		exif_menu->flags |= UI_Block_Flags_draw_background;
 		exif_menu->hash = UI_hash_djb2(ctx, "settings_menu");
 		exif_menu->depth_level += 200;
-		G->check_mouse_hashes.push_back(exif_menu->hash);
+		exif_menu->flags |= UI_Block_Flags_capture_mouse;
 		UI_Block *menu_ref = UI_find_block(ctx, exif_menu->hash, UI_PREVIOUS);
 		if (menu_ref) {
 			if (!UI_point_in_rect(menu_ref->position, menu_ref->position + menu_ref->size, UI_get_mouse())) {
@@ -3227,7 +4557,7 @@ static void update_gui() {
 		settings_menu->flags |= UI_Block_Flags_draw_background;
 		settings_menu->hash = UI_hash_djb2(ctx, "settings_menu");
 		settings_menu->depth_level += 200;
-		G->check_mouse_hashes.push_back(settings_menu->hash);
+		settings_menu->flags |= UI_Block_Flags_capture_mouse;
 		UI_Block *menu_ref = UI_find_block(ctx, settings_menu->hash, UI_PREVIOUS);
 		if (menu_ref) {
 			if (!UI_point_in_rect(menu_ref->position, menu_ref->position + menu_ref->size, UI_get_mouse())) {
@@ -3401,14 +4731,20 @@ static void update_gui() {
 				UI_checkbox(&checkbox_default, &G->settings_movementinvert, "Inverted pan movement with WASD");
 				UI_checkbox(&checkbox_default, &G->settings_exif, "Parse EXIF data from JPEGs");
 				UI_tooltip("Parses image orientation, disablable for optional performance improvement");
+				UI_checkbox(&checkbox_default, &G->settings_color_management, "Convert images with an embedded color profile to sRGB");
+				UI_tooltip("Wide gamut images (Adobe RGB, Display P3, ProPhoto) otherwise look oversaturated. Applies to images loaded afterwards");
 				UI_checkbox(&checkbox_default, &G->settings_hide_status_fullscreen, "Hide status bar in fullscreen mode");
 				UI_checkbox(&checkbox_default, &G->settings_start_in_fullscreen, "Start Cactus Viewer in fullscreen mode");
 				UI_checkbox(&checkbox_default, &G->settings_hide_status_with_gui, "Only show status bar on hover");
 				UI_checkbox(&checkbox_default, &G->settings_always_show_gui, "Always show GUI");
 				UI_checkbox(&checkbox_default, &G->settings_dont_resize, "Don't resize window on image change");
-				UI_checkbox(&checkbox_default, &G->settings_calculate_histograms, "Calculate image histograms (relatively performance intensive on load)");
+				UI_checkbox(&checkbox_default, &G->settings_calculate_histograms, "Calculate image histograms (computed in the background after loading)");
 				UI_checkbox(&checkbox_default, &G->settings_preview_thumbs, "Show thumbnail bar of images in folder.");
 				UI_tooltip("Generates thumbnails for images in the folder (can be performance intensive with large folders and is limited to 25.600 images.)");
+				UI_checkbox(&checkbox_default, &G->settings_anim_stats, "Show animation timing statistics");
+				UI_tooltip("Shows achieved FPS, skipped/late frames and jitter of GIF/WebP playback, and appends them to anim_stats.jsonl in the settings folder");
+				UI_checkbox(&checkbox_default, &G->settings_ui_stats, "Show UI frame statistics");
+				UI_tooltip("Shows block/vertex counts and the time spent on layout and building each UI frame, and appends them to ui_stats.jsonl in the settings folder");
 
 			}
 			UI_push_parent_defer(ctx, UI_bar(axis_x)) {
@@ -3479,6 +4815,8 @@ static void shuffle_folder() {
 static void update_logic() {
 	bool WantCaptureMouse = G->ui_want_capture_mouse;
 
+	update_batch();
+
     if (G->alert.timer > 0)
         G->alert.timer++;
     if (G->alert.timer == 300)
@@ -3614,7 +4952,8 @@ static void update_logic() {
 	}
 	if (G->files.Count > 0 && keyup(Key_C)) {
 		if (keypress(Key_Ctrl)) {
-			if (SUCCEEDED(save_image(Format_Bmp, NULL, true))) {
+			Clipboard clipboard = clipboard_win32();
+			if (SUCCEEDED(save_image(Format_Bmp, NULL, &clipboard))) {
 				push_alert("Image copied successfully!", Alert_Info);
 			} else {
 				push_alert("Failed to copy image to clipboard");
@@ -3725,17 +5064,8 @@ static void update_logic() {
 
 static void UI_check_mouse() {
 	UI_Context *ctx = G->ui;
-	G->ui_want_capture_mouse = false;
-	for (int i = 0; i < G->check_mouse_hashes.count; i++) {
-		UI_Block *ref = UI_find_block(ctx, G->check_mouse_hashes[i], UI_PREVIOUS);
-		if (ref) {
-			if (UI_point_in_rect(ref->position, ref->position + ref->size, UI_get_mouse())) {
-				G->ui_want_capture_mouse = true;
-				break;
-			}
-		}
-	}
-	G->check_mouse_hashes.reset_count();
+	UI_Block *hit;
+	G->ui_want_capture_mouse = UI_blocks_at_point(ctx, UI_get_mouse(), UI_PREVIOUS, UI_Block_Flags_capture_mouse, &hit, 1) > 0;
 }
 
 static void render_histogram() {
@@ -3787,6 +5117,7 @@ static void render() {
 	Graphics* ctx = &G->graphics;
 	ID3D11ShaderResourceView** target_srv = 0;
 	bool force_nearest = false;
+	bool blur_cached = false;
 
 	if (G->signals.init_step_2 || G->loaded || G->files.Count == 0) {
 		handle_signal(G->signals.init_step_2) {
@@ -3807,22 +5138,19 @@ static void render() {
 
 		if (G->files.Count > 0 && !G->files[G->current_file_index].failed) { // check if we have a folder open and no failed to load image 
 			if ((G->files[G->current_file_index].type == TYPE_GIF || G->files[G->current_file_index].type == TYPE_WEBP_ANIM) && G->anim_frames > 0) {
-				static uint32_t time = 0;
-				uint32_t delta = get_ticks() - time;
-				if (G->anim_play && !G->minimized)
-					G->force_loop = true;
-				if (delta >= G->anim_frame_delays[G->anim_index] && G->anim_play) {
-					G->anim_index++;
-					if (G->anim_index == G->anim_frames) {
-						G->anim_index = 0;
-					}
-					time = get_ticks();
-				}
-				upload_texture(&G->anim_texture, G->anim_buffer + u32(G->anim_index * G->anim_texture.size.x * G->anim_texture.size.y * 4),
-				               G->anim_texture.size.x * G->anim_texture.size.y * 4);
+				update_anim_clock();
+				upload_anim_frame(&G->anim_texture);
 				target_srv = &G->anim_texture.srv;
+				if (G->do_blur) {
+					Texture *blurred = update_blur_cache(&G->anim_texture, G->anim_uploaded_index, G->nearest_filtering);
+					if (blurred) { target_srv = &blurred->srv; blur_cached = true; }
+				}
 			} else {
 				target_srv = &G->graphics.main_image.texture.srv;
+				if (G->do_blur) {
+					Texture *blurred = update_blur_cache(&G->graphics.main_image.texture, 0, G->nearest_filtering);
+					if (blurred) { target_srv = &blurred->srv; blur_cached = true; }
+				}
 			}
 		} else {
 			target_srv = &G->graphics.logo_image.srv;
@@ -3872,6 +5200,9 @@ static void render() {
 			constants_main.do_blur = false;
 			constants_main.crop_mode = true; // hack
 		}
+		if (blur_cached)
+			constants_main.do_blur = false;
+		update_color_cache(&constants_main);
 		upload_constants(&ctx->main_program, &constants_main);
 		ctx->device_ctx->VSSetShader(ctx->main_program.vertex_shader, nullptr, 0);
 		ctx->device_ctx->VSSetConstantBuffers(0, 1, &ctx->main_program.constants_buffer);
@@ -3903,6 +5234,7 @@ static void render() {
 	G->imgui_in_frame = false;
 	UI_end_frame(G->ui);
 	UI_render(G->ui);
+	dump_ui_stats();
 
 	render_histogram();
 
@@ -209,6 +209,11 @@ struct Shader_Constants_Main { //packed to 16 byte alignment
 	v2 crop_a;
 	v2 crop_b;
 	i32 crop_mode;
+	i32 color_cache;		// modify_color uses color_matrix and the color_curve texture, see update_color_cache
+	f32 curve_scale;
+	i32 color_lut_size;		// > 0: modify_color is one lookup in the composed color_lut instead
+
+	v4 color_matrix[3];
 };
 
 struct Shader_Constants_BG { //packed to 16 byte alignment
@@ -237,6 +242,17 @@ struct Shader_Constants_Crop { //packed to 16 byte alignment
 	f32 scale;
 };
 
+struct Shader_Constants_Blur { //packed to 16 byte alignment
+	v2 step;            // uv offset per sample unit, along one axis
+	f32 lod;
+	f32 lod_size;
+
+	f32 sigma;
+	f32 half_samples;
+	u32 taps;
+	i32 normalize;      // last pass divides by the accumulated alpha
+};
+
 struct Shader_Constants_Lines { //packed to 16 byte alignment
 	v4 color;
 
@@ -251,18 +267,23 @@ struct Texture {
 	ID3D11ShaderResourceView*   srv_srgb;
 };
 
+struct Anim_Rect { // canvas region of a frame that differs from the previous one, see upload_anim_frame
+	i32 x, y, w, h;
+};
+
 enum Encoder_Format {
 	Format_Bmp,
 	Format_Png,
 	//Format_Ico,
-	//Format_Jpeg,
+	Format_Jpeg,
 	Format_Tiff,
 	//Format_Gif,
 	//Format_Wmp,
 	Format_Dds,
 	//Format_Adng,
 	Format_Heif,
-	//Format_Webp,
+	Format_Webp,
+	Format_Webp_Lossless,
 	//Format_Raw,
 
 	Format_Count
@@ -272,14 +293,15 @@ char* encoder_formats_str[] = {
 	"BMP",
 	"PNG",
 	//"Ico",
-	//"Jpeg",
+	"JPEG",
 	"TIFF",
 	//"Gif",
 	//"Wmp",
 	"DDS",
 	//"Adng",
 	"HEIF",
-	//"Webp",
+	"WebP",
+	"WebP lossless",
 	//"Raw"
 };
 
@@ -287,23 +309,61 @@ COMDLG_FILTERSPEC encoder_formats_filter[] = {
 	{ L"BMP", 	L"*.bmp;*.dib" },
 	{ L"PNG", 	L"*.png" },
 	// ICO
-	// JPEG
+	{ L"JPEG",	L"*.jpg;*.jpeg" },
 	{ L"TIFF",	L"*.tiff;*.tif" },
 	// GIF
 	// WMP
 	{ L"DDS",	L"*.dds" },
 	// ADNG
 	{ L"HEIF",	L"*.heif;*.heifs;*.heic;*.heics;*.avci;*.avcs;*.avif;*.HIF" },
-	// WEBP
+	{ L"WebP",	L"*.webp" },
+	{ L"WebP lossless",	L"*.webp" },
 	// RAW
 };
 
+// Edits applied by batch export (batch.cpp), saved as JSON. The crop is relative to the image size.
+struct Edit_Preset {
+	f32 hue;
+	f32 saturation;
+	f32 contrast;
+	f32 brightness;
+	f32 gamma;
+	bool srgb;
+	bool do_blur;
+	u32 blur_samples;
+	u32 blur_lod;
+	f32 blur_scale;
+	v4 rgba_flags;
+	v2 crop_a;
+	v2 crop_b;
+};
+
+// How decoded pixels are stored. Sources with more than 8 bits per channel keep them: integer ones
+// as RGBA16, float ones (already converted from linear to sRGB encoding, values above 1 kept) as
+// RGBA32F. See pixel_format_size.
+enum Pixel_Format {
+	Pixel_Rgba8,
+	Pixel_Rgba16,
+	Pixel_Rgba32f,
+};
+
+// Decoded pixels handed to the histogram job once they are uploaded. Freed with the last
+// shared_pixels_release.
+struct Shared_Pixels {
+	u8 *data;
+	i32 w;
+	i32 h;
+	Pixel_Format format;
+	volatile LONG refs;
+};
+
 struct Image
 {
 	int w;
 	int h;
 	int n;
 	unsigned char *data;
+	Pixel_Format format; // of 'data'
 	int orientation = 0;
 	bool has_histo;
 	easyexif::EXIFInfo exif_info;
@@ -321,6 +381,26 @@ struct Shader_Program {
 	size_t				constants_buffer_size;
 };
 
+// Result of the separable blur for the image on screen, see update_blur_cache
+struct Blur_Cache {
+	ID3D11Texture2D 			*temp; // horizontal pass, half float, source width x mip 'lod' height
+	ID3D11RenderTargetView 		*temp_rtv;
+	ID3D11ShaderResourceView 	*temp_srv;
+	Texture 					result;
+	ID3D11RenderTargetView 		*result_rtv;
+	i32 w, h, temp_h;
+	DXGI_FORMAT result_format; // 8-bit, or half float for deeper sources
+
+	// inputs the result was computed from
+	bool valid;
+	ID3D11Texture2D 			*source;
+	i32 source_version;
+	u32 samples;
+	u32 lod;
+	f32 scale;
+	bool nearest;
+};
+
 struct Graphics
 {
 	ID3D11Device1 				*device;
@@ -343,6 +423,22 @@ struct Graphics
 	Shader_Program 				bg_program;
 	Shader_Program 				crop_program;
 	Shader_Program 				lines_program;
+	Shader_Program 				blur_program;
+
+	Blur_Cache					blur_cache;
+
+	ID3D11Texture1D 			*color_curve; // baked adjustments, see update_color_cache
+	ID3D11ShaderResourceView	*color_curve_srv;
+	Shader_Constants_Main		color_cache_key;
+	f32							color_matrix[3][4];
+	f32							curve_scale;
+	bool						color_cache_valid;
+
+	ID3D11Texture3D 			*color_lut; // edits composed with the grading LUT
+	ID3D11ShaderResourceView	*color_lut_srv;
+	Shader_Constants_Main		color_lut_key;
+	u32							color_lut_version;
+	bool						color_lut_valid;
 
 	ID3D11Buffer				*lines_vertex_buffer;
 
@@ -460,6 +556,55 @@ struct UI_Theme {
 	UI_Color4 neg_btn_2;
 };
 
+struct Gif_Anim;
+
+struct Anim_Clock {
+	f64 next_due;           // time (seconds, QPC based) at which the next frame is due
+	bool running;
+	char file_name[1024];
+	int frames;
+	f64 nominal_fps;
+
+	// playback statistics since the file was loaded
+	f64 play_time;          // seconds spent playing, pauses excluded
+	f64 last_update;
+	u64 frames_shown;
+	u64 frames_skipped;     // frames that were due but never presented because we were behind
+	u64 frames_late;        // presented more than ANIM_LATE_TOLERANCE after they were due
+	u64 stalls;             // playback fell too far behind and was resynchronized
+	f64 lateness_sum;
+	f64 lateness_sq_sum;
+	f64 lateness_max;
+};
+
+// Grading LUT loaded from a .cube file, applied after the edits. See cube_lut_parse.
+struct Grading_LUT {
+	f32 *data;              // size^3 RGB triplets, red varies fastest
+	i32 size;
+	v3 domain_min;
+	v3 domain_max;
+	char name[256];
+	u32 version;            // bumped on every load or clear
+};
+
+struct Batch_Job {
+	dynarray<wchar_t *> inputs;
+	dynarray<wchar_t *> outputs;	// one per input, see batch_assign_outputs; null when refused
+	wchar_t output_folder[1024];
+	Encoder_Format format;
+	i32 quality;				// JPEG and lossy WebP
+	bool color_manage;			// convert images with an embedded ICC profile to sRGB
+	Edit_Preset preset;
+	Grading_LUT lut;			// own copy, the viewer's may change while the job runs
+	volatile LONG next;			// next input to claim
+	volatile LONG done;
+	volatile LONG failed;
+	volatile bool cancel;
+	volatile bool finished;
+	HANDLE wake;				// signaled after every file, may be null
+	bool verbose;				// print every file to stdout
+};
+
 struct Global
 {
     Graphics graphics;
@@ -507,7 +652,6 @@ struct Global
 	UI_Font* ui_font;
 	UI_Block* tooltip_block;
 	bool ui_want_capture_mouse;
-	Dynarray<u32> check_mouse_hashes;
 	i32 shapes_texture_id;
 	bool ui_mouse_hit_test;
 	u32 mouse_dn_hash;
@@ -531,7 +675,15 @@ struct Global
 	int anim_index;
 	bool anim_play;
     unsigned char *anim_buffer;
+	Gif_Anim *anim_gif; // GIFs are stored indexed instead of in anim_buffer, see gif_anim.cpp
     int *anim_frame_delays;
+	Anim_Rect *anim_dirty_rects;
+	int anim_uploaded_index;
+	Anim_Clock anim_clock;
+	Grading_LUT grading_lut;
+	Batch_Job *batch;           // running or finished batch export started from the UI
+	Encoder_Format batch_format = Format_Png;
+	i32 export_quality = 90;    // JPEG and lossy WebP, for saving and batch export
 	Texture anim_texture;
     int anim_frames;
     bool anim_loaded;
@@ -553,6 +705,7 @@ struct Global
     bool settings_autoplayGIFs;
     bool settings_sort = true;
     bool settings_exif = true;
+    bool settings_color_management = true;
     bool settings_hide_status_fullscreen = false;
     bool settings_hide_status_with_gui = false;
     bool settings_start_in_fullscreen = false;
@@ -560,8 +713,12 @@ struct Global
     bool settings_dont_resize = false;
     bool settings_calculate_histograms = false;
     bool settings_preview_thumbs = true;
+    bool settings_anim_stats = false;
+    bool settings_ui_stats = false;
 	int32_t settings_selected_theme = UI_Theme_Cactus_Green;
 
+	FILE *ui_stats_file = nullptr; // ui_stats.jsonl, open while settings_ui_stats is on, see dump_ui_stats
+
 	bool mouse_dragging = false;
 
 	bool crop_mode = false;
@@ -585,8 +742,31 @@ struct Global
 
 	u64 histo_max;
 	u64 histo_max_edit;
+	volatile LONG histo_generation; // bumped per histogram request, older jobs drop their results
 	UI_Block* histo_block;
 
+	// Histogram after the edits (hue, saturation, ...), computed from a downsampled copy of the
+	// image in the background, see request_adjusted_histogram
+	bool histo_show_adjusted = false;
+	bool has_histo_adjusted;
+	u64 histo_adj_r[256];
+	u64 histo_adj_g[256];
+	u64 histo_adj_b[256];
+	u64 histo_adj_t[256];
+	u64 histo_adj_max;
+	f32 histo_clipped_low;  // share of channel values crushed to 0
+	f32 histo_clipped_high; // share of channel values blown out to 255
+	u8* histo_proxy;
+	i32 histo_proxy_w;
+	i32 histo_proxy_h;
+	f32 histo_proxy_scale;  // full image pixels per proxy pixel
+	u32 histo_proxy_id;     // bumped whenever the proxy is replaced
+	HANDLE histo_adjust_event;
+	Shader_Constants_Main histo_adjust_constants; // latest requested parameters
+	u32 histo_adjust_proxy_id;
+	u32 histo_adjust_lut_version;
+	LONG histo_adjust_request;
+
     bool nearest_filtering = false;
     bool pixel_grid = false;
 };
@@ -14,6 +14,7 @@ struct Animated_Image {
 	uint32_t num_frames;
 	void* raw_mem;
 	int* durations;
+	Anim_Rect* dirty_rects; // canvas region that differs from the previous frame
 };
 
 
@@ -26,10 +27,13 @@ static int webp_anim_allocate_frames(Animated_Image* const image, uint32_t num_f
 	Decoded_Frame* const frames =
 	(Decoded_Frame*)malloc(num_frames * sizeof(*frames));
 	int *durations = (int*)malloc(num_frames * sizeof(int));
+	Anim_Rect *dirty_rects = (Anim_Rect*)malloc(num_frames * sizeof(Anim_Rect));
 
-	if (mem == NULL || frames == NULL) {
+	if (mem == NULL || frames == NULL || durations == NULL || dirty_rects == NULL) {
 		free(mem);
 		free(frames);
+		free(durations);
+		free(dirty_rects);
 		return 0;
 	}
 	free(image->raw_mem);
@@ -41,6 +45,7 @@ static int webp_anim_allocate_frames(Animated_Image* const image, uint32_t num_f
 	}
 	image->raw_mem = mem;
 	image->durations = durations;
+	image->dirty_rects = dirty_rects;
 	return 1;
 }
 
@@ -51,7 +56,10 @@ static int webp_anim_read_file(const WebPData* const webp_data, Animated_Image*
 	int dump_ok = 1;
 	uint32_t frame_index = 0;
 	int prev_frame_timestamp = 0;
+	Anim_Rect prev_rect = {0};
+	WebPMuxAnimDispose prev_dispose = WEBP_MUX_DISPOSE_NONE;
 	WebPAnimDecoder* dec;
+	const WebPDemuxer* demux;
 	WebPAnimInfo anim_info;
 
 	memset(image, 0, sizeof(*image));
@@ -76,6 +84,8 @@ static int webp_anim_read_file(const WebPData* const webp_data, Animated_Image*
 	// Allocate frames.
 	if (!webp_anim_allocate_frames(image, anim_info.frame_count)) return 0;
 
+	demux = WebPAnimDecoderGetDemuxer(dec);
+
 	// Decode frames.
 	while (WebPAnimDecoderHasMoreFrames(dec)) {
 		Decoded_Frame* curr_frame;
@@ -94,6 +104,31 @@ static int webp_anim_read_file(const WebPData* const webp_data, Animated_Image*
 		image->durations[frame_index] = curr_frame->duration;
 		memcpy(curr_rgba, frame_rgba,
 		       image->canvas_width * kNumChannels * image->canvas_height);
+
+		// The frame only draws inside its own rectangle, plus whatever the previous frame
+		// cleared when disposing to background.
+		WebPIterator iter;
+		Anim_Rect rect = { 0, 0, (i32)image->canvas_width, (i32)image->canvas_height };
+		WebPMuxAnimDispose dispose = WEBP_MUX_DISPOSE_NONE;
+		if (WebPDemuxGetFrame(demux, frame_index + 1, &iter)) {
+			rect = { iter.x_offset, iter.y_offset, iter.width, iter.height };
+			dispose = iter.dispose_method;
+			WebPDemuxReleaseIterator(&iter);
+		}
+		Anim_Rect dirty = rect;
+		if (frame_index == 0) {
+			dirty = { 0, 0, (i32)image->canvas_width, (i32)image->canvas_height };
+		} else if (prev_dispose == WEBP_MUX_DISPOSE_BACKGROUND) {
+			i32 x1 = max(rect.x + rect.w, prev_rect.x + prev_rect.w);
+			i32 y1 = max(rect.y + rect.h, prev_rect.y + prev_rect.h);
+			dirty.x = min(rect.x, prev_rect.x);
+			dirty.y = min(rect.y, prev_rect.y);
+			dirty.w = x1 - dirty.x;
+			dirty.h = y1 - dirty.y;
+		}
+		image->dirty_rects[frame_index] = dirty;
+		prev_rect = rect;
+		prev_dispose = dispose;
 		++frame_index;
 		prev_frame_timestamp = timestamp;
 	}
@@ -0,0 +1,167 @@
+// UI benchmark: builds synthetic frames of a growing number of blocks headless, with the software
+// backend, and prints where the time goes (bench_ui_main, bin\tests.exe --bench-ui). Every frame
+// scrolls the list a little so that none of them is reused and the whole layout, vertex build and
+// sort run each time. The layout time per block should stay flat as the block count grows, popups
+// included, each of which is a root of its own.
+
+#define BENCH_UI_W 1920
+#define BENCH_UI_H 1080
+
+struct Bench_UI_Times {
+	f64 layout_ms;
+	f64 build_ms;
+	f64 sort_ms;
+	f64 raster_ms; // the software backend drawing the vertices
+	i64 vertices;
+};
+
+static UI_Block *bench_ui_block(UI_Context *ctx, UI_Size w, UI_Size h, u32 color) {
+	UI_Block *block = UI_push_block(ctx);
+	block->style.size[axis_x] = w;
+	block->style.size[axis_y] = h;
+	block->style.color[c_background] = UI_color4_sld_u32(color);
+	block->flags |= UI_Block_Flags_draw_background;
+	return block;
+}
+
+static UI_Block *bench_ui_text(UI_Context *ctx, UI_Font *font, const char *text) {
+	UI_Block *block = UI_push_block(ctx);
+	block->style.size[axis_x] = { UI_Size_t::text_content, 0, 1 };
+	block->style.size[axis_y] = { UI_Size_t::text_content, 0, 1 };
+	block->style.font = font;
+	block->style.font_size = 13;
+	block->style.color[c_text] = UI_color4_sld_u32(0xE0E0E0FF);
+	UI_block_set_string(ctx, block, text);
+	block->flags |= UI_Block_Flags_draw_text;
+	return block;
+}
+
+// A scrolled list of rows of about 'count' blocks in all, the kind the file browser and the metadata
+// panel make, and a popup per hundred blocks. Rows hold an icon, a label when there's a font and a
+// value cell clipped to the row, widths come from the parent and heights from the children. Returns
+// how long UI_render took.
+static f64 bench_ui_frame(UI_Context *ctx, UI_Font *font, int count, int frame) {
+	UI_begin_frame(ctx, 16);
+	ctx->viewport = v2(BENCH_UI_W, BENCH_UI_H); // there is no window to take the size from
+	int popups = count / 100;
+	int list_count = count - popups * 10;
+	auto buffer = UI_get_current_frame_buffer(ctx);
+
+	UI_Block *list = UI_push_block(ctx, 0);
+	list->style.position[axis_x] = { UI_Position_t::absolute, 0 };
+	list->style.position[axis_y] = { UI_Position_t::absolute, -(f32)(frame % 64) };
+	list->style.size[axis_x] = { UI_Size_t::pixels, BENCH_UI_W, 1 };
+	list->style.size[axis_y] = { UI_Size_t::sum_of_children, 0, 1 };
+	list->style.layout.axis = axis_y;
+	list->style.layout.spacing = v2(0, 2);
+	UI_push_parent(ctx, list);
+	for (int row_index = 0; buffer->count < list_count; row_index++) {
+		UI_Block *row = bench_ui_block(ctx, { UI_Size_t::percent_of_parent, 1, 1 }, { UI_Size_t::sum_of_children, 0, 1 },
+		                               row_index % 2 ? 0x2A2A30FF : 0x24242AFF);
+		row->style.layout.axis = axis_x;
+		row->style.layout.padding = v2(4, 2);
+		row->style.layout.spacing = v2(6, 0);
+		UI_push_parent(ctx, row);
+		{
+			UI_Block *icon = bench_ui_block(ctx, { UI_Size_t::pixels, 16, 1 }, { UI_Size_t::pixels, 16, 1 }, 0x4080C0FF);
+			icon->style.roundness = v4(3);
+			if (font)
+				bench_ui_text(ctx, font, UI_tprintf(ctx, "Item %d", row_index));
+			UI_Block *value = bench_ui_block(ctx, { UI_Size_t::pixels, 160, 1 }, { UI_Size_t::pixels, 16, 1 }, 0x3A3A44FF);
+			value->style.color[c_border] = UI_color4_sld_u32(0x60606CFF);
+			value->style.border_size = 1;
+			value->style.clip_block = row;
+		}
+		UI_pop_parent(ctx);
+	}
+	UI_pop_parent(ctx);
+
+	for (int i = 0; i < popups; i++) {
+		UI_Block *popup = UI_push_block(ctx, 0);
+		popup->style.position[axis_x] = { UI_Position_t::absolute, (f32)(i * 173 % (BENCH_UI_W - 200)) };
+		popup->style.position[axis_y] = { UI_Position_t::absolute, (f32)(i * 97 % (BENCH_UI_H - 200)) };
+		popup->style.size[axis_x] = { UI_Size_t::sum_of_children, 0, 1 };
+		popup->style.size[axis_y] = { UI_Size_t::sum_of_children, 0, 1 };
+		popup->style.color[c_background] = UI_color4_sld_u32(0x1E1E24F0);
+		popup->style.roundness = v4(6);
+		popup->style.layout.axis = axis_y;
+		popup->style.layout.padding = v2(6, 6);
+		popup->depth_level = 100;
+		popup->flags |= UI_Block_Flags_draw_background;
+		UI_push_parent(ctx, popup);
+		for (int j = 0; j < 9; j++) {
+			UI_Block *item = font ? bench_ui_text(ctx, font, UI_tprintf(ctx, "Popup %d entry %d", i, j))
+			                      : bench_ui_block(ctx, { UI_Size_t::pixels, 140, 1 }, { UI_Size_t::pixels, 14, 1 }, 0x50505AFF);
+			item->style.clip_block = popup;
+		}
+		UI_pop_parent(ctx);
+	}
+
+	UI_end_frame(ctx);
+	UI_software_clear(ctx, v4(0.1f, 0.1f, 0.1f, 1));
+	f64 render_start = get_time();
+	UI_render(ctx);
+	UI_assert(!ctx->frame_reused);
+	return (get_time() - render_start) * 1000;
+}
+
+static Bench_UI_Times bench_ui_run(UI_Context *ctx, UI_Font *font, int count, int frames) {
+	Bench_UI_Times times = {};
+	bench_ui_frame(ctx, font, count, 0); // rasterizes the glyphs and grows the block storage
+	for (int frame = 1; frame <= frames; frame++) {
+		f64 render_ms = bench_ui_frame(ctx, font, count, frame);
+		times.layout_ms += ctx->debug.last_layout_ms;
+		times.build_ms += ctx->debug.last_build_ms - ctx->debug.last_sort_ms;
+		times.sort_ms += ctx->debug.last_sort_ms;
+		times.raster_ms += render_ms - ctx->debug.last_build_ms;
+		times.vertices += ctx->debug.last_vertex_count;
+	}
+	times.layout_ms /= frames;
+	times.build_ms /= frames;
+	times.sort_ms /= frames;
+	times.raster_ms /= frames;
+	times.vertices /= frames;
+	return times;
+}
+
+static int bench_ui_main(int argc, wchar_t **argv) {
+	int frames = 100;
+	bool text = true;
+	for (int i = 0; i < argc; i++) {
+		if (wcscmp(argv[i], L"--frames") == 0 && i + 1 < argc) {
+			frames = _wtoi(argv[++i]);
+		} else if (wcscmp(argv[i], L"--no-text") == 0) {
+			text = false;
+		} else {
+			fprintf(stderr, "usage: tests --bench-ui [--frames 100] [--no-text]\n");
+			return 2;
+		}
+	}
+	frames = max(frames, 1);
+
+	UI_Context *ctx = UI_init_context();
+	UI_software_init(ctx, BENCH_UI_W, BENCH_UI_H, parallel_for);
+	WW = BENCH_UI_W; // UI_build_vertices drops blocks outside the window
+	WH = BENCH_UI_H;
+	UI_Font *font = nullptr;
+	if (text) {
+		int sizes[] = { 13 };
+		char system_font[512] = {};
+		if (get_font_file_from_system(system_font, 512, "Segoe UI (TrueType)") ||
+		    get_font_file_from_system(system_font, 512, "Arial (TrueType)"))
+			font = UI_load_font_file(ctx, system_font, sizes, array_size(sizes));
+		if (!font) fprintf(stderr, "No system font found, the frames have no text.\n");
+	}
+
+	// the software backend stands in for the GPU, its time is only there to put the rest in proportion
+	printf("%d frames each, averages in ms%s\n", frames, font ? "" : ", without text");
+	printf("%8s %9s %8s %8s %8s %9s %13s\n", "blocks", "vertices", "layout", "build", "sort", "raster", "layout us/blk");
+	int counts[] = { 1000, 2000, 5000, 10000, 20000 };
+	for (int i = 0; i < array_size(counts); i++) {
+		Bench_UI_Times times = bench_ui_run(ctx, font, counts[i], frames);
+		int blocks = ctx->debug.last_block_count;
+		printf("%8d %9lld %8.3f %8.3f %8.3f %9.3f %13.3f\n", blocks, times.vertices, times.layout_ms,
+		       times.build_ms, times.sort_ms, times.raster_ms, times.layout_ms * 1000 / blocks);
+	}
+	return 0;
+}
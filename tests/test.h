@@ -0,0 +1,56 @@
+#pragma once
+// A test is a function that checks things with CHECK; a failed check is printed with its location and
+// fails the test, the test itself keeps going. tests.cpp lists the tests and runs them.
+
+typedef void Test_Func();
+
+struct Test {
+	const char *name;
+	Test_Func *func;
+};
+
+static int test_failed_checks;
+
+static bool test_check(bool ok, const char *expression, const char *file, int line) {
+	if (!ok) {
+		printf("  %s(%d): CHECK(%s) failed\n", file, line, expression);
+		test_failed_checks++;
+	}
+	return ok;
+}
+
+// Evaluates to the condition, so a test can stop where going on makes no sense: if (!CHECK(p)) return;
+#define CHECK(x) test_check((x) ? true : false, #x, __FILE__, __LINE__)
+
+// Largest difference of any channel of two w*h RGBA8 images with the given row pitches.
+static int test_max_difference(const u8 *a, size_t a_pitch, const u8 *b, size_t b_pitch, i32 w, i32 h) {
+	int result = 0;
+	for (i32 y = 0; y < h; y++) {
+		const u8 *ra = a + y * a_pitch;
+		const u8 *rb = b + y * b_pitch;
+		for (i32 i = 0; i < w * 4; i++)
+			result = max(result, abs((int)ra[i] - (int)rb[i]));
+	}
+	return result;
+}
+
+// A w*h RGBA8 image whose every pixel differs from its neighbors and every row from the others.
+static u8 *test_pattern(i32 w, i32 h) {
+	u8 *pixels = (u8 *)malloc((size_t)w * h * 4);
+	for (i32 y = 0; y < h; y++) {
+		for (i32 x = 0; x < w; x++) {
+			u8 *p = pixels + ((size_t)y * w + x) * 4;
+			p[0] = (u8)(x * 3 + y);
+			p[1] = (u8)(y * 5);
+			p[2] = (u8)(x ^ y);
+			p[3] = 255;
+		}
+	}
+	return pixels;
+}
+
+// The constants an unedited w*h image is exported with.
+static Shader_Constants_Main test_neutral_constants(i32 w, i32 h) {
+	Edit_Preset preset = edit_preset_neutral();
+	return edit_preset_constants(&preset, w, h);
+}
@@ -0,0 +1,42 @@
+// batch.cpp's output names: no input is written over, by itself or by another input's output, and no
+// two inputs share an output. Only the paths are compared, none of the files has to exist.
+
+static Batch_Job *test_batch_job(const wchar_t **inputs, int count) {
+	Edit_Preset preset = edit_preset_neutral();
+	Batch_Job *job = batch_create(&preset, L"C:\\photos", Format_Png, 90, nullptr);
+	for (int i = 0; i < count; i++)
+		job->inputs.push_back(_wcsdup(inputs[i]));
+	batch_assign_outputs(job);
+	return job;
+}
+
+static bool test_batch_output(Batch_Job *job, int index, const wchar_t *expected) {
+	const wchar_t *output = job->outputs[index];
+	if (!expected) return CHECK(output == nullptr);
+	bool same = CHECK(output != nullptr && wcscmp(output, expected) == 0);
+	if (!same) printf("  %ls: expected %ls, got %ls\n", job->inputs[index], expected, output ? output : L"nothing");
+	return same;
+}
+
+static void test_batch_output_names() {
+	const wchar_t *inputs[] = {
+		L"C:\\photos\\a.png",		// the output would be the input itself
+		L"C:\\photos\\a.jpg",		// a.png is an input
+		L"C:\\other\\a.jpg",		// and a (2).png the output of the one before
+		L"C:\\other\\b.tif",
+		L"C:\\Photos\\.\\C.PNG",	// itself again, spelled differently
+		L"C:\\photos\\c (2).png",	// an input that looks like a numbered output
+		L"C:\\other\\c.webp",
+	};
+	Batch_Job *job = test_batch_job(inputs, array_size(inputs));
+	if (CHECK(job->outputs.Count == array_size(inputs))) {
+		test_batch_output(job, 0, nullptr);
+		test_batch_output(job, 1, L"C:\\photos\\a (2).png");
+		test_batch_output(job, 2, L"C:\\photos\\a (3).png");
+		test_batch_output(job, 3, L"C:\\photos\\b.png");
+		test_batch_output(job, 4, nullptr);
+		test_batch_output(job, 5, nullptr);
+		test_batch_output(job, 6, L"C:\\photos\\c (3).png");
+	}
+	batch_free(job);
+}
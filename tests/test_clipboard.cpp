@@ -0,0 +1,103 @@
+// clipboard.cpp: what copy_image_cpu and copy_image_bgra put on the clipboard, through the memory
+// clipboard.
+
+// The payload must be one CF_DIBV5: a BITMAPV5HEADER for a bottom-up 32 bpp BGRA image, then its pixels.
+static const BITMAPV5HEADER *test_check_dib(Clipboard_Memory_State *state, i32 w, i32 h) {
+	if (!CHECK(state->data != nullptr)) return nullptr;
+	CHECK(state->format == Clipboard_Format_Dib_V5);
+	if (!CHECK(state->size == sizeof(BITMAPV5HEADER) + (size_t)w * h * 4)) return nullptr;
+	const BITMAPV5HEADER *header = (const BITMAPV5HEADER *)state->data;
+	CHECK(header->bV5Size == sizeof(BITMAPV5HEADER));
+	CHECK(header->bV5Width == w);
+	CHECK(header->bV5Height == h); // positive: bottom-up
+	CHECK(header->bV5Planes == 1);
+	CHECK(header->bV5BitCount == 32);
+	CHECK(header->bV5Compression == BI_BITFIELDS);
+	CHECK(header->bV5SizeImage == (DWORD)w * h * 4);
+	CHECK(header->bV5RedMask == 0x00FF0000);
+	CHECK(header->bV5GreenMask == 0x0000FF00);
+	CHECK(header->bV5BlueMask == 0x000000FF);
+	CHECK(header->bV5AlphaMask == 0xFF000000);
+	CHECK(header->bV5CSType == LCS_sRGB);
+	return header;
+}
+
+// Largest channel difference between the DIB's pixels and the w*h region at (x0, y0) of an RGBA image
+// 'image_w' wide, with the DIB's last row being the region's first.
+static int test_dib_difference(const u8 *dib, const u8 *rgba, i32 image_w, i32 x0, i32 y0, i32 w, i32 h) {
+	int result = 0;
+	for (i32 y = 0; y < h; y++) {
+		const u8 *dib_row = dib + (size_t)(h - 1 - y) * w * 4;
+		const u8 *row = rgba + ((size_t)(y0 + y) * image_w + x0) * 4;
+		for (i32 x = 0; x < w; x++) {
+			const u8 *d = dib_row + x * 4;
+			const u8 *s = row + x * 4;
+			result = max(result, abs(d[0] - s[2]));
+			result = max(result, abs(d[1] - s[1]));
+			result = max(result, abs(d[2] - s[0]));
+			result = max(result, abs(d[3] - s[3]));
+		}
+	}
+	return result;
+}
+
+// An unedited image, tall enough for the pipeline to fill the DIB in more than one band.
+static void test_clipboard_copy_image_cpu() {
+	i32 w = 97, h = CLIPBOARD_BAND_ROWS + 45;
+	u8 *image = test_pattern(w, h);
+	Shader_Constants_Main constants = test_neutral_constants(w, h);
+	Clipboard_Memory_State state;
+	Clipboard clipboard = clipboard_memory(&state);
+	CHECK(copy_image_cpu(&clipboard, &constants, image, Pixel_Rgba8, w, h, nullptr));
+	if (test_check_dib(&state, w, h))
+		CHECK(test_dib_difference(state.data + sizeof(BITMAPV5HEADER), image, w, 0, 0, w, h) <= 1);
+	clipboard_memory_free(&state);
+	free(image);
+}
+
+// The crop decides the DIB's size, and which source row ends up at the bottom.
+static void test_clipboard_copy_image_cpu_crop() {
+	i32 w = 120, h = 300;
+	u8 *image = test_pattern(w, h);
+	Shader_Constants_Main constants = test_neutral_constants(w, h);
+	constants.crop_a = v2(10, 20);
+	constants.crop_b = v2(60, 290);
+	Clipboard_Memory_State state;
+	Clipboard clipboard = clipboard_memory(&state);
+	CHECK(copy_image_cpu(&clipboard, &constants, image, Pixel_Rgba8, w, h, nullptr));
+	if (test_check_dib(&state, 50, 270))
+		CHECK(test_dib_difference(state.data + sizeof(BITMAPV5HEADER), image, w, 10, 20, 50, 270) <= 1);
+	clipboard_memory_free(&state);
+	free(image);
+}
+
+// BGRA rows with padding at the end, like a mapped staging texture, are copied as they are.
+static void test_clipboard_copy_image_bgra() {
+	i32 w = 33, h = 17;
+	size_t stride = (size_t)w * 4 + 60;
+	u8 *bgra = (u8 *)malloc(stride * h);
+	for (size_t i = 0; i < stride * h; i++)
+		bgra[i] = (u8)(i * 7 + i / stride);
+	Clipboard_Memory_State state;
+	Clipboard clipboard = clipboard_memory(&state);
+	CHECK(copy_image_bgra(&clipboard, bgra, stride, w, h));
+	if (test_check_dib(&state, w, h)) {
+		const u8 *pixels = state.data + sizeof(BITMAPV5HEADER);
+		bool rows_match = true;
+		for (i32 y = 0; y < h; y++)
+			rows_match &= memcmp(pixels + (size_t)(h - 1 - y) * w * 4, bgra + y * stride, (size_t)w * 4) == 0;
+		CHECK(rows_match);
+	}
+	clipboard_memory_free(&state);
+	free(bgra);
+}
+
+// Nothing to copy, nothing on the clipboard.
+static void test_clipboard_empty_image() {
+	Clipboard_Memory_State state;
+	Clipboard clipboard = clipboard_memory(&state);
+	u8 pixel[4] = {};
+	CHECK(!copy_image_bgra(&clipboard, pixel, 4, 0, 1));
+	CHECK(state.data == nullptr && state.pending == nullptr);
+	clipboard_memory_free(&state);
+}
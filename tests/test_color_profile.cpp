@@ -0,0 +1,158 @@
+// color_profile.cpp on small matrix/TRC profiles put together here: sRGB itself needs no transform,
+// a gamma 2.2 profile with the sRGB primaries maps 8-bit values the way the formulas say, and profiles
+// whose tag table or tags run past the end are refused.
+
+#define TEST_ICC_MAX_TAGS 8
+
+struct Test_Icc {
+	u8 data[2048];
+	u32 size;
+	u32 tag_count;
+};
+
+static void test_icc_put_u32(u8 *p, u32 value) {
+	p[0] = (u8)(value >> 24);
+	p[1] = (u8)(value >> 16);
+	p[2] = (u8)(value >> 8);
+	p[3] = (u8)value;
+}
+
+static void test_icc_put_s15f16(u8 *p, f64 value) {
+	test_icc_put_u32(p, (u32)(i32)floor(value * 65536 + 0.5));
+}
+
+// A header and room for TEST_ICC_MAX_TAGS tag table entries, the tag data goes after those.
+static void test_icc_begin(Test_Icc *icc, const char *color_space) {
+	memset(icc, 0, sizeof(*icc));
+	memcpy(icc->data + 12, "mntr", 4);
+	memcpy(icc->data + 16, color_space, 4);
+	memcpy(icc->data + 20, "XYZ ", 4);
+	memcpy(icc->data + 36, "acsp", 4);
+	icc->size = 132 + TEST_ICC_MAX_TAGS * 12;
+}
+
+static void test_icc_add_tag(Test_Icc *icc, const char *sig, const u8 *tag, u32 tag_size) {
+	u8 *entry = icc->data + 132 + icc->tag_count * 12;
+	memcpy(entry, sig, 4);
+	test_icc_put_u32(entry + 4, icc->size);
+	test_icc_put_u32(entry + 8, tag_size);
+	memcpy(icc->data + icc->size, tag, tag_size);
+	icc->size += (tag_size + 3) & ~3u;
+	icc->tag_count++;
+	test_icc_put_u32(icc->data, icc->size);
+	test_icc_put_u32(icc->data + 128, icc->tag_count);
+}
+
+static void test_icc_add_xyz(Test_Icc *icc, const char *sig, f64 x, f64 y, f64 z) {
+	u8 tag[20] = { 'X', 'Y', 'Z', ' ' };
+	test_icc_put_s15f16(tag + 8, x);
+	test_icc_put_s15f16(tag + 12, y);
+	test_icc_put_s15f16(tag + 16, z);
+	test_icc_add_tag(icc, sig, tag, sizeof(tag));
+}
+
+// The sRGB primaries adapted to D50, as in the sRGB profiles that ship with Windows.
+static void test_icc_add_srgb_colorants(Test_Icc *icc) {
+	test_icc_add_xyz(icc, "rXYZ", 0.4360747, 0.2225045, 0.0139322);
+	test_icc_add_xyz(icc, "gXYZ", 0.3850649, 0.7168786, 0.0971045);
+	test_icc_add_xyz(icc, "bXYZ", 0.1430804, 0.0606169, 0.7141733);
+}
+
+// The same tone curve on all three channels.
+static void test_icc_add_trcs(Test_Icc *icc, const u8 *curve, u32 curve_size) {
+	test_icc_add_tag(icc, "rTRC", curve, curve_size);
+	test_icc_add_tag(icc, "gTRC", curve, curve_size);
+	test_icc_add_tag(icc, "bTRC", curve, curve_size);
+}
+
+static void test_icc_srgb(Test_Icc *icc) {
+	// parametric type 3: (a x + b)^g from d on, c x below
+	u8 para[12 + 5 * 4] = { 'p', 'a', 'r', 'a', 0, 0, 0, 0, 0, 3 };
+	f64 params[5] = { 2.4, 1 / 1.055, 0.055 / 1.055, 1 / 12.92, 0.04045 };
+	for (int k = 0; k < 5; k++) test_icc_put_s15f16(para + 12 + k * 4, params[k]);
+	test_icc_begin(icc, "RGB ");
+	test_icc_add_srgb_colorants(icc);
+	test_icc_add_trcs(icc, para, sizeof(para));
+}
+
+// 'curv' with a single entry is a gamma in u8Fixed8: 563 / 256 = 2.199.
+static void test_icc_gamma22(Test_Icc *icc) {
+	u8 curv[14] = { 'c', 'u', 'r', 'v', 0, 0, 0, 0, 0, 0, 0, 1, 563 >> 8, 563 & 0xFF };
+	test_icc_begin(icc, "RGB ");
+	test_icc_add_srgb_colorants(icc);
+	test_icc_add_trcs(icc, curv, sizeof(curv));
+}
+
+static void test_color_profile_srgb() {
+	Test_Icc icc;
+	test_icc_srgb(&icc);
+	Color_Transform *t = (Color_Transform *)malloc(sizeof(Color_Transform));
+	CHECK(!color_transform_build(icc.data, icc.size, t));
+	free(t);
+}
+
+static void test_color_profile_gamma() {
+	Test_Icc icc;
+	test_icc_gamma22(&icc);
+	Color_Transform *t = (Color_Transform *)malloc(sizeof(Color_Transform));
+	if (CHECK(color_transform_build(icc.data, icc.size, t))) {
+		// every 8-bit value, on each channel, through the curve and out as sRGB
+		u8 pixels[256 * 4];
+		for (int v = 0; v < 256; v++) {
+			u8 px[4] = { (u8)v, (u8)(255 - v), (u8)(v / 2), (u8)v };
+			memcpy(pixels + v * 4, px, 4);
+		}
+		u8 expected[256 * 4];
+		for (int i = 0; i < 256 * 4; i++) {
+			f64 linear = pow(pixels[i] / 255.0, 563 / 256.0);
+			f64 srgb = linear <= 0.0031308 ? linear * 12.92 : 1.055 * pow(linear, 1 / 2.4) - 0.055;
+			expected[i] = i % 4 == 3 ? pixels[i] : (u8)floor(srgb * 255 + 0.5);
+		}
+		color_transform_apply(t, pixels, Pixel_Rgba8, 256, 1);
+		int difference = test_max_difference(pixels, sizeof(pixels), expected, sizeof(expected), 256, 1);
+		if (!CHECK(difference <= 1)) printf("  largest difference %d\n", difference);
+	}
+	free(t);
+}
+
+// Cut short, a profile must be refused without reading past the end: every copy is allocated at its
+// exact size.
+static bool test_color_profile_builds(const u8 *data, u32 size) {
+	u8 *copy = (u8 *)malloc(size);
+	memcpy(copy, data, size);
+	Color_Transform *t = (Color_Transform *)malloc(sizeof(Color_Transform));
+	bool built = color_transform_build(copy, size, t);
+	free(t);
+	free(copy);
+	return built;
+}
+
+static void test_color_profile_truncated() {
+	Test_Icc icc;
+	test_icc_gamma22(&icc);
+	CHECK(test_color_profile_builds(icc.data, icc.size));
+
+	// the tag table counts more entries than fit
+	for (u32 entries = 0; entries < 3; entries++) {
+		Test_Icc table = icc;
+		u32 size = 132 + entries * 12;
+		test_icc_put_u32(table.data, size);
+		CHECK(!test_color_profile_builds(table.data, size));
+		test_icc_put_u32(table.data + 128, 0xFFFFFFFF);
+		CHECK(!test_color_profile_builds(table.data, size));
+	}
+
+	// the profile ends inside the last tag, and with the size in the header left as it was
+	u32 cut = icc.size - 4;
+	Test_Icc tags = icc;
+	test_icc_put_u32(tags.data, cut);
+	CHECK(!test_color_profile_builds(tags.data, cut));
+	CHECK(!test_color_profile_builds(icc.data, cut));
+
+	// a tag that points past the end
+	Test_Icc offset = icc;
+	test_icc_put_u32(offset.data + 132 + 4, icc.size + 16);
+	CHECK(!test_color_profile_builds(offset.data, icc.size));
+
+	CHECK(!test_color_profile_builds(icc.data, 131));
+}
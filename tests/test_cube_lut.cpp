@@ -0,0 +1,96 @@
+// cpu_pipeline.cpp's .cube parser and the tetrahedral lookup of its tables.
+
+// A 2^3 .cube text whose entry for (r, g, b) is 'entry' of them, red varying fastest.
+static void test_cube_text(char *text, size_t text_size, const char *header, void (*entry)(f32 rgb[3])) {
+	size_t length = snprintf(text, text_size, "%s", header);
+	for (int i = 0; i < 8; i++) {
+		f32 rgb[3] = { (f32)(i & 1), (f32)(i >> 1 & 1), (f32)(i >> 2 & 1) };
+		entry(rgb);
+		length += snprintf(text + length, text_size - length, "%g %g %g\n", rgb[0], rgb[1], rgb[2]);
+	}
+}
+
+static void test_cube_identity(f32 rgb[3]) {}
+
+static void test_cube_rotate(f32 rgb[3]) {
+	f32 r = rgb[0];
+	rgb[0] = rgb[2];
+	rgb[2] = rgb[1];
+	rgb[1] = r;
+}
+
+static void test_cube_lut_valid() {
+	char text[1024];
+	test_cube_text(text, sizeof(text),
+		"# made by hand\n"
+		"TITLE \"Two by two\"\n"
+		"DOMAIN_MIN 0 0 0\r\n"
+		"DOMAIN_MAX 1 2 4\r\n"
+		"  LUT_3D_SIZE 2\n\n", test_cube_rotate);
+	Grading_LUT lut = {};
+	char error[128] = "";
+	if (!CHECK(cube_lut_parse(text, &lut, error, sizeof(error)))) {
+		printf("  %s\n", error);
+		return;
+	}
+	CHECK(lut.size == 2);
+	CHECK(strcmp(lut.name, "Two by two") == 0);
+	CHECK(lut.domain_min.x == 0 && lut.domain_min.y == 0 && lut.domain_min.z == 0);
+	CHECK(lut.domain_max.x == 1 && lut.domain_max.y == 2 && lut.domain_max.z == 4);
+	// entry 1 is red 1, green 0, blue 0, rotated to (0, 1, 0)
+	CHECK(lut.data[3] == 0 && lut.data[4] == 1 && lut.data[5] == 0);
+	free(lut.data);
+}
+
+// A table that doesn't parse leaves the LUT that was loaded before as it was.
+static void test_cube_lut_rejected(const char *text, const char *expected_error) {
+	f32 previous[3] = { 1, 2, 3 };
+	Grading_LUT lut = {};
+	lut.data = previous;
+	lut.size = 7;
+	char error[128] = "";
+	CHECK(!cube_lut_parse(text, &lut, error, sizeof(error)));
+	if (!CHECK(strcmp(error, expected_error) == 0))
+		printf("  got \"%s\", expected \"%s\"\n", error, expected_error);
+	CHECK(lut.data == previous && lut.size == 7);
+}
+
+static void test_cube_lut_invalid() {
+	char text[1024];
+	test_cube_text(text, sizeof(text), "LUT_3D_SIZE 2\n", test_cube_identity);
+	size_t length = strlen(text);
+
+	snprintf(text + length, sizeof(text) - length, "1 1 1\n");
+	test_cube_lut_rejected(text, "More than 8 table entries.");
+	text[length - strlen("1 1 1\n")] = 0;
+	test_cube_lut_rejected(text, "Expected 8 table entries, found 7.");
+
+	test_cube_lut_rejected("LUT_3D_SIZE 2\n0 0 0\n1 x 0\n", "Invalid table entry 2.");
+	test_cube_lut_rejected("LUT_3D_SIZE 2\n0 0\n1 0 0\n", "Invalid table entry 1.");
+	test_cube_lut_rejected("LUT_1D_SIZE 1024\n0 0 0\n", "1D LUTs are not supported.");
+	test_cube_lut_rejected("LUT_3D_SIZE 1\n0 0 0\n", "Unsupported LUT_3D_SIZE.");
+	test_cube_lut_rejected("0 0 0\n", "LUT_3D_SIZE missing before the table.");
+	test_cube_lut_rejected("TITLE \"empty\"\n", "No LUT_3D_SIZE found.");
+}
+
+// Tetrahedral interpolation is exact for a table that is linear in its input: the identity returns the
+// input and the rotated table the input rotated, anywhere inside a cell.
+static void test_cube_lut_sample() {
+	char text[1024];
+	f32 out[3];
+	Grading_LUT lut = {};
+	char error[128];
+	test_cube_text(text, sizeof(text), "LUT_3D_SIZE 2\n", test_cube_identity);
+	if (CHECK(cube_lut_parse(text, &lut, error, sizeof(error)))) {
+		cpu_lut_sample(lut.data, lut.size, 3, 0.25f, 0.5f, 0.8f, out);
+		CHECK(fabsf(out[0] - 0.25f) < 1e-6f && fabsf(out[1] - 0.5f) < 1e-6f && fabsf(out[2] - 0.8f) < 1e-6f);
+		cpu_lut_sample(lut.data, lut.size, 3, -1.0f, 2.0f, 0.5f, out); // clamped to the cube
+		CHECK(fabsf(out[0]) < 1e-6f && fabsf(out[1] - 1) < 1e-6f && fabsf(out[2] - 0.5f) < 1e-6f);
+	}
+	test_cube_text(text, sizeof(text), "LUT_3D_SIZE 2\n", test_cube_rotate);
+	if (CHECK(cube_lut_parse(text, &lut, error, sizeof(error)))) {
+		cpu_lut_sample(lut.data, lut.size, 3, 0.1f, 0.6f, 0.3f, out);
+		CHECK(fabsf(out[0] - 0.3f) < 1e-6f && fabsf(out[1] - 0.1f) < 1e-6f && fabsf(out[2] - 0.6f) < 1e-6f);
+	}
+	free(lut.data);
+}
@@ -0,0 +1,110 @@
+// encoders.cpp's PNG and JPEG writers, which cut the image into bands: sizes from a single pixel to
+// several bands, odd widths and heights one row past a band. PNGs are decoded with stb_image and
+// compared pixel for pixel, JPEGs byte for byte with stb_image_write's encoder they are built from.
+
+struct Test_Encoder_Output {
+	u8 *data;
+	size_t size;
+	size_t capacity;
+};
+
+static bool test_encoder_write(void *user, const void *data, size_t size) {
+	Test_Encoder_Output *output = (Test_Encoder_Output *)user;
+	if (output->size + size > output->capacity) {
+		output->capacity = max(output->capacity * 2, output->size + size);
+		output->data = (u8 *)realloc(output->data, output->capacity);
+	}
+	memcpy(output->data + output->size, data, size);
+	output->size += size;
+	return true;
+}
+
+static void test_stb_write(void *user, void *data, int size) {
+	test_encoder_write(user, data, size);
+}
+
+// The source rows of a tightly packed image.
+struct Test_Encoder_Image {
+	const u8 *pixels;
+	size_t stride;
+};
+
+static bool test_encoder_rows(void *user, i32 y, i32 rows, u8 *dst, size_t stride) {
+	Test_Encoder_Image *image = (Test_Encoder_Image *)user;
+	for (i32 i = 0; i < rows; i++)
+		memcpy(dst + i * stride, image->pixels + (size_t)(y + i) * image->stride, image->stride);
+	return true;
+}
+
+// The test pattern with a changing alpha, and for RGBA16 with low bytes that differ from the high
+// ones, so that a byte swapped the wrong way shows.
+static u8 *test_encoder_pattern(Pixel_Format format, i32 w, i32 h) {
+	u8 *pattern = test_pattern(w, h);
+	for (size_t i = 0; i < (size_t)w * h; i++)
+		pattern[i * 4 + 3] = (u8)(i * 7);
+	if (format == Pixel_Rgba8) return pattern;
+	size_t count = (size_t)w * h * 4;
+	u16 *result = (u16 *)malloc(count * 2);
+	for (size_t i = 0; i < count; i++)
+		result[i] = (u16)(pattern[i] << 8 | (u8)(i * 13 + pattern[i]));
+	free(pattern);
+	return (u8 *)result;
+}
+
+static bool test_encode(Encoder_Format encoder_format, Pixel_Format format, const u8 *pixels, i32 w, i32 h, i32 quality,
+                        Test_Encoder_Output *output) {
+	Test_Encoder_Image image = { pixels, (size_t)w * pixel_format_size(format) };
+	Encoder_Source source = { test_encoder_rows, &image, format, w, h };
+	*output = {};
+	return encode_image(encoder_format, &source, quality, test_encoder_write, output);
+}
+
+static void test_png_roundtrip(Pixel_Format format, i32 w, i32 h) {
+	u8 *pixels = test_encoder_pattern(format, w, h);
+	Test_Encoder_Output png;
+	if (CHECK(test_encode(Format_Png, format, pixels, w, h, 90, &png))) {
+		int decoded_w = 0, decoded_h = 0, n;
+		void *decoded = format == Pixel_Rgba16
+			? (void *)stbi_load_16_from_memory(png.data, (int)png.size, &decoded_w, &decoded_h, &n, 4)
+			: (void *)stbi_load_from_memory(png.data, (int)png.size, &decoded_w, &decoded_h, &n, 4);
+		if (CHECK(decoded != nullptr) && CHECK(decoded_w == w && decoded_h == h)) {
+			if (!CHECK(memcmp(decoded, pixels, (size_t)w * h * pixel_format_size(format)) == 0))
+				printf("  %dx%d %s differs\n", w, h, format == Pixel_Rgba16 ? "RGBA16" : "RGBA8");
+		}
+		stbi_image_free(decoded);
+	}
+	free(png.data);
+	free(pixels);
+}
+
+// Bands are PNG_BAND_BYTES of filtered rows, so 4097 pixels wide makes bands of 63 rows in RGBA8
+// and 31 in RGBA16: 64 rows are two bands, 513 rows 9 and 17, more than one batch on most machines.
+static void test_encoders_png() {
+	i32 sizes[][2] = { { 1, 1 }, { 1, 257 }, { 37, 1 }, { 101, 513 }, { 4097, 64 }, { 4097, 513 } };
+	for (int i = 0; i < array_size(sizes); i++) {
+		test_png_roundtrip(Pixel_Rgba8, sizes[i][0], sizes[i][1]);
+		test_png_roundtrip(Pixel_Rgba16, sizes[i][0], sizes[i][1]);
+	}
+}
+
+// Bands of JPEG_BAND_ROWS rows; quality 90 subsamples the chroma, 91 doesn't.
+static void test_encoders_jpeg() {
+	i32 sizes[][2] = { { 1, 1 }, { 7, 257 }, { 33, 513 }, { 100, 255 }, { 17, 16 } };
+	i32 qualities[] = { 90, 91 };
+	for (int i = 0; i < array_size(sizes); i++) {
+		i32 w = sizes[i][0], h = sizes[i][1];
+		u8 *pixels = test_encoder_pattern(Pixel_Rgba8, w, h);
+		for (int q = 0; q < array_size(qualities); q++) {
+			Test_Encoder_Output jpeg, reference = {};
+			bool encoded = CHECK(test_encode(Format_Jpeg, Pixel_Rgba8, pixels, w, h, qualities[q], &jpeg));
+			if (encoded && CHECK(stbi_write_jpg_to_func(test_stb_write, &reference, w, h, 4, pixels, qualities[q]))) {
+				bool same = jpeg.size == reference.size && memcmp(jpeg.data, reference.data, jpeg.size) == 0;
+				if (!CHECK(same))
+					printf("  %dx%d at quality %d differs from stb\n", w, h, qualities[q]);
+			}
+			free(jpeg.data);
+			free(reference.data);
+		}
+		free(pixels);
+	}
+}
@@ -0,0 +1,146 @@
+// ui_core.cpp's glyph atlas: packing, growing and eviction, with glyphs made up of a solid color each
+// instead of rasterized ones so that no font is needed.
+
+static UI_Context *test_glyph_context() {
+	UI_Context *ctx = (UI_Context *)calloc(1, sizeof(UI_Context));
+	ctx->frame_id = 100000;
+	return ctx;
+}
+
+static UI_Font test_glyph_font(int size) {
+	UI_Font font = {};
+	font.glyphs.init_null();
+	UI_glyph_atlas_reset(&font, size, size);
+	return font;
+}
+
+static void test_glyph_font_free(UI_Font *font) {
+	free(font->pixels);
+	free(font->packer_nodes);
+	font->glyphs.clear();
+}
+
+static u32 test_glyph_color(int index) {
+	return 0xFF000000 | (u32)(index + 1) * 2654435761u >> 8;
+}
+
+// Packs a w*h glyph the way UI_glyph_rasterize does and fills it with its color. False if it doesn't fit.
+static bool test_add_glyph(UI_Font *font, int w, int h, u64 last_used) {
+	int x, y;
+	if (!UI_glyph_atlas_pack(font, w + 1, h + 1, &x, &y)) return false;
+	UI_Glyph glyph = {};
+	glyph.codepoint = font->glyphs.count;
+	glyph.packed = true;
+	glyph.last_used = last_used;
+	glyph.info.x0 = x;
+	glyph.info.y0 = y;
+	glyph.info.x1 = x + w;
+	glyph.info.y1 = y + h;
+	u32 color = test_glyph_color(font->glyphs.count);
+	for (int row = y; row < y + h; row++)
+		for (int column = x; column < x + w; column++)
+			((u32 *)font->pixels)[(size_t)row * font->w + column] = color;
+	font->glyphs.push_back(glyph);
+	return true;
+}
+
+// Every packed glyph lies inside the atlas, overlaps no other and still has its own color.
+static bool test_glyphs_intact(UI_Font *font) {
+	bool ok = true;
+	for (int i = 0; i < font->glyphs.count; i++) {
+		UI_Font_Glyph_Info *a = &font->glyphs[i].info;
+		if (!font->glyphs[i].packed) continue;
+		ok &= CHECK(a->x0 >= 0 && a->y0 >= 0 && a->x1 <= font->w && a->y1 <= font->h);
+		for (int j = i + 1; j < font->glyphs.count; j++) {
+			UI_Font_Glyph_Info *b = &font->glyphs[j].info;
+			if (!font->glyphs[j].packed) continue;
+			ok &= CHECK(a->x1 <= b->x0 || b->x1 <= a->x0 || a->y1 <= b->y0 || b->y1 <= a->y0);
+		}
+		u32 color = test_glyph_color(i);
+		bool same = true;
+		for (int y = a->y0; y < a->y1; y++)
+			for (int x = a->x0; x < a->x1; x++)
+				same &= ((u32 *)font->pixels)[(size_t)y * font->w + x] == color;
+		ok &= CHECK(same);
+		if (!ok) break;
+	}
+	return ok;
+}
+
+// Glyphs of all kinds of sizes fill the smallest atlas without overlapping.
+static void test_glyph_atlas_pack() {
+	UI_Font font = test_glyph_font(UI_GLYPH_ATLAS_MIN);
+	int added = 0;
+	for (int i = 0; i < 2000; i++)
+		added += test_add_glyph(&font, 3 + i * 7 % 29, 5 + i * 11 % 23, 0);
+	CHECK(added > 100);
+	CHECK(added < 2000); // some didn't fit, the atlas isn't supposed to grow by itself here
+	test_glyphs_intact(&font);
+	test_glyph_font_free(&font);
+}
+
+// A full atlas doubles up to UI_GLYPH_ATLAS_MAX, the glyphs stay where they are.
+static void test_glyph_atlas_grow() {
+	UI_Font font = test_glyph_font(UI_GLYPH_ATLAS_MIN);
+	int size = UI_GLYPH_ATLAS_MIN;
+	for (;;) {
+		while (test_add_glyph(&font, 31, 31, 0)) {}
+		if (!test_glyphs_intact(&font)) break;
+		bool grown = UI_glyph_atlas_grow(&font);
+		if (size == UI_GLYPH_ATLAS_MAX) {
+			CHECK(!grown);
+			CHECK(font.w == UI_GLYPH_ATLAS_MAX && font.h == UI_GLYPH_ATLAS_MAX);
+			break;
+		}
+		if (!CHECK(grown)) break;
+		size *= 2;
+		CHECK(font.w == size && font.h == size);
+		CHECK(font.resized);
+		test_glyphs_intact(&font);
+	}
+	CHECK(font.glyphs.count == (UI_GLYPH_ATLAS_MAX / 32) * (UI_GLYPH_ATLAS_MAX / 32));
+	test_glyph_font_free(&font);
+}
+
+// Eviction keeps the glyphs of the current frame and then the most recently used ones, until they
+// cover half the atlas, and moves them along with their pixels.
+static void test_glyph_atlas_evict() {
+	UI_Context *ctx = test_glyph_context();
+	UI_Font font = test_glyph_font(UI_GLYPH_ATLAS_MAX);
+	// every glyph last used in a different frame, in no particular order, and every 16th in this one
+	for (int i = 0; test_add_glyph(&font, 40, 40, i % 16 == 0 ? ctx->frame_id : (u64)(i * 7919 % 10007)); i++) {}
+	int count = font.glyphs.count;
+	int x, y;
+	CHECK(!UI_glyph_atlas_pack(&font, 41, 41, &x, &y));
+
+	u32 resets = ctx->glyph_atlas_resets;
+	UI_glyph_atlas_evict(ctx, &font);
+	CHECK(ctx->glyph_atlas_resets == resets + 1);
+	CHECK(font.w == UI_GLYPH_ATLAS_MAX);
+	CHECK(font.glyphs.count == count);
+	test_glyphs_intact(&font);
+
+	int kept = 0;
+	u64 oldest_kept = UINT64_MAX, newest_evicted = 0;
+	for (int i = 0; i < count; i++) {
+		UI_Glyph *glyph = &font.glyphs[i];
+		if (glyph->last_used == ctx->frame_id) {
+			CHECK(glyph->packed);
+		} else if (glyph->packed) {
+			oldest_kept = min(oldest_kept, glyph->last_used);
+		} else {
+			newest_evicted = max(newest_evicted, glyph->last_used);
+		}
+		kept += glyph->packed;
+	}
+	CHECK(newest_evicted < oldest_kept);
+	CHECK(kept < count);
+	CHECK(kept * 41 * 41 <= UI_GLYPH_ATLAS_MAX * UI_GLYPH_ATLAS_MAX / 2);
+	CHECK(kept * 41 * 41 > UI_GLYPH_ATLAS_MAX * UI_GLYPH_ATLAS_MAX / 2 - 41 * 41);
+
+	// the room made is usable
+	CHECK(test_add_glyph(&font, 40, 40, ctx->frame_id));
+	test_glyphs_intact(&font);
+	test_glyph_font_free(&font);
+	free(ctx);
+}
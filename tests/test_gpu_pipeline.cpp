@@ -0,0 +1,110 @@
+// cpu_pipeline.cpp against the GPU: every case renders the main image with render_image_offscreen,
+// which is what save_image exports animations with, and with the CPU pipeline from the same
+// constants, and compares the two. Needs a D3D11 device; on machines without a GPU WARP stands in.
+
+static bool test_gpu_device() {
+	if (!G->graphics.device) return CHECK(SUCCEEDED(init_d3d11_device()));
+	return true;
+}
+
+// The RGBA8 test pattern in 'format'.
+static u8 *test_pattern_as(Pixel_Format format, i32 w, i32 h) {
+	u8 *pattern = test_pattern(w, h);
+	if (format == Pixel_Rgba8) return pattern;
+	size_t count = (size_t)w * h * 4;
+	u8 *result = (u8 *)malloc(count * pixel_format_size(format));
+	for (size_t i = 0; i < count; i++) {
+		if (format == Pixel_Rgba16)
+			((u16 *)result)[i] = (u16)(pattern[i] * 257);
+		else
+			((f32 *)result)[i] = pattern[i] / 255.0f;
+	}
+	free(pattern);
+	return result;
+}
+
+// Renders a w*h image of 'format' edited with 'preset' and turned 'orientation' quarter turns on
+// both sides and checks that no channel differs by more than 'tolerance'.
+static void test_gpu_matches_cpu(const Edit_Preset *preset, Pixel_Format format, i32 orientation, int tolerance) {
+	if (!test_gpu_device()) return;
+	i32 w = 131, h = 77;
+	u8 *src = test_pattern_as(format, w, h);
+	Image *image = &G->graphics.main_image;
+	image->w = w;
+	image->h = h;
+	image->format = format;
+	image->orientation = orientation;
+	image->texture = create_texture(src, w, h, false, format);
+	G->graphics.blur_cache.valid = false; // keyed by the texture, which the previous case may have reused
+	edit_preset_apply(preset);
+
+	Offscreen_Render render;
+	if (CHECK(SUCCEEDED(render_image_offscreen(&render)))) {
+		Shader_Constants_Main constants = set_main_shader_constants();
+		constants.render_mode = RENDER_MODE_ENCODER;
+		size_t stride = (size_t)render.w * 4;
+		u8 *cpu = (u8 *)malloc(stride * render.h);
+		if (CHECK(cpu_render_encoder(&constants, src, format, w, h, cpu, render.w, render.h, stride, true, &G->grading_lut))) {
+			int difference = test_max_difference(render.data, render.pitch, cpu, stride, render.w, render.h);
+			if (!CHECK(difference <= tolerance))
+				printf("  largest difference %d\n", difference);
+		}
+		free(cpu);
+		release_offscreen_render(&render);
+	}
+
+	image->texture.srv->Release();
+	image->texture.d3d_texture->Release();
+	image->texture = {};
+	free(src);
+}
+
+static void test_gpu_pipeline_neutral() {
+	Edit_Preset preset = edit_preset_neutral();
+	test_gpu_matches_cpu(&preset, Pixel_Rgba8, 0, 1);
+}
+
+static void test_gpu_pipeline_color() {
+	Edit_Preset preset = edit_preset_neutral();
+	preset.hue = 0.3f;
+	preset.saturation = 1.4f;
+	preset.contrast = 1.2f;
+	preset.brightness = 0.1f;
+	preset.gamma = 0.8f;
+	test_gpu_matches_cpu(&preset, Pixel_Rgba8, 0, 2);
+	preset.srgb = true;
+	test_gpu_matches_cpu(&preset, Pixel_Rgba8, 0, 2);
+}
+
+static void test_gpu_pipeline_channels() {
+	Edit_Preset preset = edit_preset_neutral();
+	preset.rgba_flags = v4(1, 0, 1, 0);
+	test_gpu_matches_cpu(&preset, Pixel_Rgba8, 0, 1);
+	preset.rgba_flags = v4(0, 1, 0, 1);
+	test_gpu_matches_cpu(&preset, Pixel_Rgba8, 0, 1);
+}
+
+static void test_gpu_pipeline_crop_rotation() {
+	Edit_Preset preset = edit_preset_neutral();
+	preset.crop_a = v2(0.1f, 0.2f);
+	preset.crop_b = v2(0.7f, 0.9f);
+	for (i32 orientation = 0; orientation < 4; orientation++)
+		test_gpu_matches_cpu(&preset, Pixel_Rgba8, orientation, 1);
+}
+
+// The GPU blurs mips made by GenerateMips, the CPU its own box filtered ones, so a little more slack.
+static void test_gpu_pipeline_blur() {
+	Edit_Preset preset = edit_preset_neutral();
+	preset.do_blur = true;
+	preset.blur_scale = 0.01f;
+	test_gpu_matches_cpu(&preset, Pixel_Rgba8, 0, 3);
+	preset.blur_lod = 2;
+	test_gpu_matches_cpu(&preset, Pixel_Rgba8, 0, 3);
+}
+
+static void test_gpu_pipeline_formats() {
+	Edit_Preset preset = edit_preset_neutral();
+	preset.contrast = 1.3f;
+	test_gpu_matches_cpu(&preset, Pixel_Rgba16, 0, 2);
+	test_gpu_matches_cpu(&preset, Pixel_Rgba32f, 1, 2);
+}
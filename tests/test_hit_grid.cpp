@@ -0,0 +1,96 @@
+// ui_core.cpp's hit grid against the linear scans it replaced: overlapping blocks of all sizes that
+// straddle cell borders and the edges of the viewport, at a few depths with many ties.
+
+#define TEST_HIT_W 500 // not a whole number of cells
+#define TEST_HIT_H 300
+
+static u32 test_hit_random(u32 *state) {
+	*state = *state * 1664525u + 1013904223u;
+	return *state >> 8;
+}
+
+// The old UI_hit_test: the deepest hit_test block under 'point', the first pushed among equals, none
+// at depth 0.
+static UI_Block *test_hit_scan(UI_Context *ctx, v2 point) {
+	auto buffer = UI_get_current_frame_buffer(ctx);
+	UI_Block *foremost = nullptr;
+	u32 max_depth = 0;
+	for (int i = 0; i < buffer->count; i++) {
+		UI_Block *block = &buffer->data[i];
+		if (block->hash == 0 || !(block->flags & UI_Block_Flags_hit_test)) continue;
+		if (!UI_point_in_rect(block->position, block->position + block->size, point)) continue;
+		if (block->depth_level > max_depth) {
+			max_depth = block->depth_level;
+			foremost = block;
+		}
+	}
+	return foremost;
+}
+
+// What UI_blocks_at_point has to return, in push order.
+static int test_blocks_scan(UI_Context *ctx, v2 point, u32 flags, UI_Block **result, int max_count) {
+	auto buffer = UI_get_current_frame_buffer(ctx);
+	int count = 0;
+	for (int i = 0; i < buffer->count; i++) {
+		UI_Block *block = &buffer->data[i];
+		if (block->hash == 0 || !(block->flags & flags)) continue;
+		if (!UI_point_in_rect(block->position, block->position + block->size, point)) continue;
+		if (count < max_count) result[count] = block;
+		count++;
+	}
+	return count;
+}
+
+// Compares what the grid and the scans find at 'point', false and a message when they differ.
+static bool test_hit_point(UI_Context *ctx, v2 point, int *hits) {
+	UI_Block *expected = test_hit_scan(ctx, point);
+	*hits += expected != nullptr;
+	bool same = CHECK(UI_hit_test(ctx, point, UI_CURRENT) == expected);
+	u32 flag_sets[] = { UI_Block_Flags_hit_test, UI_Block_Flags_capture_mouse, UI_Block_Flags_hit_test | UI_Block_Flags_capture_mouse };
+	for (int f = 0; f < array_size(flag_sets); f++) {
+		UI_Block *grid_blocks[32], *scan_blocks[32];
+		int grid_count = UI_blocks_at_point(ctx, point, UI_CURRENT, flag_sets[f], grid_blocks, array_size(grid_blocks));
+		int scan_count = test_blocks_scan(ctx, point, flag_sets[f], scan_blocks, array_size(scan_blocks));
+		size_t compared = min(scan_count, (int)array_size(scan_blocks)) * sizeof(UI_Block *);
+		same &= CHECK(grid_count == scan_count) && CHECK(memcmp(grid_blocks, scan_blocks, compared) == 0);
+	}
+	if (!same) printf("  at %g, %g\n", point.x, point.y);
+	return same;
+}
+
+static void test_hit_grid() {
+	UI_Context *ctx = UI_init_context();
+	UI_software_init(ctx, 1, 1);
+	UI_begin_frame(ctx, 16);
+	ctx->viewport = v2(TEST_HIT_W, TEST_HIT_H);
+	u32 state = 12345;
+	for (int i = 0; i < 300; i++) {
+		UI_Block *block = UI_push_block(ctx, 0);
+		f32 x = (f32)(test_hit_random(&state) % (TEST_HIT_W + 200)) - 100;
+		f32 y = (f32)(test_hit_random(&state) % (TEST_HIT_H + 200)) - 100;
+		block->style.position[axis_x] = { UI_Position_t::absolute, x };
+		block->style.position[axis_y] = { UI_Position_t::absolute, y };
+		block->style.size[axis_x] = { UI_Size_t::pixels, (f32)(1 + test_hit_random(&state) % 160), 1 };
+		block->style.size[axis_y] = { UI_Size_t::pixels, (f32)(1 + test_hit_random(&state) % 160), 1 };
+		block->depth_level = test_hit_random(&state) % 4;
+		u32 kind = test_hit_random(&state) % 8;
+		if (kind < 4) block->flags |= UI_Block_Flags_hit_test;
+		if (kind >= 2 && kind < 6) block->flags |= UI_Block_Flags_capture_mouse;
+		block->hash = kind == 1 ? 0 : i + 1; // hit_test, but without a hash it can't be hit
+	}
+	UI_end_frame(ctx);
+
+	// every 5 pixels from outside the viewport on one side to outside on the other, then the corners
+	// of every block, where the closed rects end; stops at the first few mismatches
+	int hits = 0, mismatches = 0;
+	for (int y = -60; y <= TEST_HIT_H + 60 && mismatches < 5; y += 5)
+		for (int x = -60; x <= TEST_HIT_W + 60 && mismatches < 5; x += 5)
+			mismatches += !test_hit_point(ctx, v2(x, y), &hits);
+	auto buffer = UI_get_current_frame_buffer(ctx);
+	for (int i = 0; i < buffer->count && mismatches < 5; i++) {
+		UI_Block *block = &buffer->data[i];
+		mismatches += !test_hit_point(ctx, block->position, &hits);
+		mismatches += !test_hit_point(ctx, block->position + block->size, &hits);
+	}
+	CHECK(hits > 1000); // most of the viewport is covered, the grid has something to find
+}
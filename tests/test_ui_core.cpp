@@ -0,0 +1,203 @@
+// ui_core.cpp's bookkeeping behind the frame: the vertex sort, the hash indexes and the text run cache
+// on a context that has nothing else, and reusing the layout of a frame that didn't change.
+
+static UI_Context *test_ui_core_context() {
+	UI_Context *ctx = (UI_Context *)calloc(1, sizeof(UI_Context));
+	ctx->frame_id = 1;
+	return ctx;
+}
+
+static void test_ui_core_context_free(UI_Context *ctx) {
+	ctx->vertices.clear();
+	ctx->vertices_sorted.clear();
+	ctx->vertex_keys.clear();
+	ctx->vertex_order.clear();
+	ctx->buffers[0].clear();
+	ctx->buffers[1].clear();
+	ctx->previous_blocks_index.clear();
+	ctx->text_runs.clear();
+	ctx->text_runs_index.clear();
+	ctx->text_run_glyphs.clear();
+	ctx->text_run_chars.clear();
+	free(ctx);
+}
+
+// std::stable_sort on descending depth is what UI_sort_vertices has to match: back to front, pushed
+// order among equals. A handful of depths, negative ones too, so that most vertices tie.
+static void test_ui_core_sort_vertices() {
+	UI_Context *ctx = test_ui_core_context();
+	u32 state = 7;
+	int counts[] = { 2, 3, 100, 5000 };
+	for (int c = 0; c < array_size(counts); c++) {
+		ctx->vertices.reset_count();
+		for (int i = 0; i < counts[c]; i++) {
+			UI_Vertex vertex = {};
+			state = state * 1664525u + 1013904223u;
+			vertex.depth = (f32)(state >> 8 & 7) / 8 - 0.25f;
+			vertex.dst_p0 = v2((f32)i, 0); // to tell the vertices apart
+			ctx->vertices.push_back(vertex);
+		}
+		UI_Vertex *expected = (UI_Vertex *)malloc(sizeof(UI_Vertex) * counts[c]);
+		memcpy(expected, ctx->vertices.data, sizeof(UI_Vertex) * counts[c]);
+		std::stable_sort(expected, expected + counts[c], [](const UI_Vertex &a, const UI_Vertex &b) { return a.depth > b.depth; });
+		UI_sort_vertices(ctx);
+		bool same = CHECK(ctx->vertices.count == counts[c]);
+		for (int i = 0; same && i < counts[c]; i++) {
+			same = ctx->vertices[i].dst_p0.x == expected[i].dst_p0.x;
+			if (!CHECK(same)) printf("  %d vertices, first difference at %d\n", counts[c], i);
+		}
+		free(expected);
+	}
+	test_ui_core_context_free(ctx);
+}
+
+// Hashes that all start probing at the last slot of a 16 slot table, so that probing has to wrap.
+static int test_ui_core_colliding_hashes(u32 *hashes, int count) {
+	Dynarray<UI_Hash_Slot> table = {};
+	UI_hash_index_reset(&table, 1);
+	int found = 0;
+	for (u32 hash = 1; found < count; hash++)
+		if (UI_hash_index_lookup(&table, hash) == &table.data[table.count - 1]) hashes[found++] = hash;
+	int slots = table.count;
+	table.clear();
+	return slots;
+}
+
+static void test_ui_core_hash_index() {
+	u32 hashes[6];
+	if (!CHECK(test_ui_core_colliding_hashes(hashes, array_size(hashes)) == 16)) return;
+
+	// five of them in a table for up to eight, each finds its own slot; the sixth finds an empty one
+	Dynarray<UI_Hash_Slot> table = {};
+	UI_hash_index_reset(&table, 8);
+	CHECK(table.count == 16);
+	for (u32 i = 0; i < 5; i++) {
+		UI_Hash_Slot *slot = UI_hash_index_lookup(&table, hashes[i]);
+		if (!CHECK(slot->index == 0)) continue;
+		slot->hash = hashes[i];
+		slot->index = i + 1;
+	}
+	for (u32 i = 0; i < 5; i++) {
+		UI_Hash_Slot *slot = UI_hash_index_lookup(&table, hashes[i]);
+		CHECK(slot->hash == hashes[i] && slot->index == i + 1);
+	}
+	CHECK(UI_hash_index_lookup(&table, hashes[5])->index == 0);
+	table.clear();
+
+	// the previous frame's index keeps the first of the blocks that share a hash
+	UI_Context *ctx = test_ui_core_context();
+	auto previous = UI_get_previous_frame_buffer(ctx);
+	previous->init_reserve(MB(1), 8);
+	u32 block_hashes[] = { hashes[0], hashes[1], hashes[0], 0, hashes[2], hashes[1] };
+	for (int i = 0; i < array_size(block_hashes); i++) {
+		UI_Block block = {};
+		block.hash = block_hashes[i];
+		previous->push_back(block);
+	}
+	UI_index_previous_frame(ctx);
+	CHECK(UI_find_previous_block(ctx, hashes[0]) == &previous->data[0]);
+	CHECK(UI_find_previous_block(ctx, hashes[1]) == &previous->data[1]);
+	CHECK(UI_find_previous_block(ctx, hashes[2]) == &previous->data[4]);
+	CHECK(UI_find_previous_block(ctx, hashes[3]) == nullptr);
+	CHECK(UI_find_block(ctx, 0, UI_PREVIOUS) == nullptr);
+	test_ui_core_context_free(ctx);
+}
+
+// A font of one size whose glyphs for 'a' and 'b' are in the atlas already, so that no face is needed.
+static UI_Font test_ui_core_font(int *sizes, int *line_heights) {
+	UI_Font font = {};
+	font.sizes = sizes;
+	font.true_sizes = line_heights;
+	font.sizes_count = 1;
+	for (u32 c = 'a'; c <= 'b'; c++) {
+		UI_Glyph glyph = {};
+		glyph.codepoint = c;
+		glyph.packed = true;
+		glyph.info.x0 = (c - 'a') * 10;
+		glyph.info.x1 = glyph.info.x0 + 7;
+		glyph.info.y1 = 9;
+		glyph.info.advance_x = 8;
+		font.glyphs.push_back(glyph);
+	}
+	return font;
+}
+
+// A run is cached until the atlas is evicted, which moves the glyphs: then it is laid out again with
+// their new rects.
+static void test_ui_core_text_runs() {
+	UI_Context *ctx = test_ui_core_context();
+	int sizes[] = { 16 }, line_heights[] = { 12 };
+	UI_Font font = test_ui_core_font(sizes, line_heights);
+	char text[] = "ab";
+	UI_Text_Run *run = UI_find_text_run(ctx, &font, 16, text);
+	if (CHECK(run != nullptr) && CHECK(run->glyph_count == 2)) {
+		CHECK(ctx->text_run_glyphs[run->glyphs + 1].src_p0.x == 10);
+		CHECK(run->advance == 16 && run->extent.y == 12);
+		CHECK(UI_find_text_run(ctx, &font, 16, text) == run);
+		CHECK(ctx->text_runs.count == 1);
+	}
+
+	// as UI_glyph_atlas_evict leaves them: the same glyphs somewhere else
+	font.glyphs[0].info.x0 += 100;
+	font.glyphs[0].info.x1 += 100;
+	font.glyphs[1].info.y0 += 50;
+	font.glyphs[1].info.y1 += 50;
+	ctx->glyph_atlas_resets++;
+	run = UI_find_text_run(ctx, &font, 16, text);
+	if (CHECK(run != nullptr) && CHECK(run->glyph_count == 2)) {
+		UI_Text_Glyph *glyphs = &ctx->text_run_glyphs[run->glyphs];
+		CHECK(glyphs[0].src_p0.x == 100 && glyphs[0].src_p0.y == 0);
+		CHECK(glyphs[1].src_p0.x == 10 && glyphs[1].src_p0.y == 50);
+		CHECK(run->atlas_resets == ctx->glyph_atlas_resets);
+		CHECK(ctx->text_runs.count == 1);
+	}
+	font.glyphs.clear();
+	font.glyphs_index.clear();
+	test_ui_core_context_free(ctx);
+}
+
+// A column of three blocks in a panel, the first 'first_h' pixels high. Returns the last one.
+static UI_Block *test_ui_core_column_frame(UI_Context *ctx, f32 first_h) {
+	UI_begin_frame(ctx, 16);
+	ctx->viewport = v2(200, 200);
+	UI_Block *panel = UI_push_block(ctx, 0);
+	panel->style.position[axis_x] = { UI_Position_t::absolute, 10 };
+	panel->style.position[axis_y] = { UI_Position_t::absolute, 10 };
+	panel->style.size[axis_x] = { UI_Size_t::pixels, 100, 1 };
+	panel->style.size[axis_y] = { UI_Size_t::pixels, 180, 1 };
+	panel->style.layout.axis = axis_y;
+	panel->style.layout.padding = v2(4, 4);
+	panel->style.layout.spacing = v2(0, 6);
+	UI_push_parent(ctx, panel);
+	UI_Block *block = nullptr;
+	for (int i = 0; i < 3; i++) {
+		block = UI_push_block(ctx);
+		block->style.size[axis_x] = { UI_Size_t::pixels, 80, 1 };
+		block->style.size[axis_y] = { UI_Size_t::pixels, i == 0 ? first_h : 20, 1 };
+	}
+	UI_pop_parent(ctx);
+	UI_end_frame(ctx);
+	return block;
+}
+
+// The same frame again takes over the layout, a block that changed size makes the next one move.
+static void test_ui_core_reuse_layout() {
+	UI_Context *ctx = UI_init_context();
+	UI_software_init(ctx, 1, 1);
+	v2 first = test_ui_core_column_frame(ctx, 20)->position;
+	CHECK(!ctx->frame_reused);
+	CHECK(first.x == 14 && first.y == 14 + 2 * (20 + 6));
+
+	UI_Block *last = test_ui_core_column_frame(ctx, 20);
+	CHECK(ctx->frame_reused);
+	CHECK(last->position.x == first.x && last->position.y == first.y);
+	CHECK(last->size.x == 80 && last->size.y == 20);
+
+	last = test_ui_core_column_frame(ctx, 40);
+	CHECK(!ctx->frame_reused);
+	CHECK(last->position.x == first.x && last->position.y == first.y + 20);
+
+	last = test_ui_core_column_frame(ctx, 40);
+	CHECK(ctx->frame_reused);
+	CHECK(last->position.y == first.y + 20);
+}
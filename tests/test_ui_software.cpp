@@ -0,0 +1,163 @@
+// ui_software.cpp: UI frames built with ui_core and drawn headless by the software backend, compared
+// with reference images in tests/data. The frames have no text, glyphs would depend on the FreeType
+// build. A frame that doesn't match is written to bin\ under the reference's name; when the change
+// is intended, that image becomes the new reference.
+
+#define TEST_UI_W 256
+#define TEST_UI_H 192
+
+static UI_Context *test_ui;
+
+// One software context for all the tests, every frame starts from a cleared framebuffer.
+static UI_Context *test_ui_context() {
+	if (!test_ui) {
+		test_ui = UI_init_context();
+		UI_software_init(test_ui, TEST_UI_W, TEST_UI_H);
+	}
+	return test_ui;
+}
+
+static UI_Block *test_ui_block(UI_Context *ctx, f32 w, f32 h, UI_Color4 color) {
+	UI_Block *block = UI_push_block(ctx);
+	block->style.size[axis_x] = { UI_Size_t::pixels, w, 1 };
+	block->style.size[axis_y] = { UI_Size_t::pixels, h, 1 };
+	block->style.color[c_background] = color;
+	block->flags |= UI_Block_Flags_draw_background;
+	return block;
+}
+
+// Gradients, corners, borders, softness, translucency, sRGB, a rotated texture and clipping: most of
+// what the pixel shader does, in one frame.
+static void test_ui_frame(UI_Context *ctx, i32 texture) {
+	UI_begin_frame(ctx, 16);
+	ctx->viewport = v2(TEST_UI_W, TEST_UI_H); // there is no window to take the size from
+
+	UI_Block *panel = UI_push_block(ctx, 0);
+	panel->style.position[axis_x] = { UI_Position_t::absolute, 8 };
+	panel->style.position[axis_y] = { UI_Position_t::absolute, 8 };
+	panel->style.size[axis_x] = { UI_Size_t::pixels, 240, 1 };
+	panel->style.size[axis_y] = { UI_Size_t::pixels, 176, 1 };
+	panel->style.color[c_background] = UI_color4_vrt(0x3C4A5AFF, 0x1E1E24FF);
+	panel->style.color[c_border] = UI_color4_sld_u32(0x80C0FFFF);
+	panel->style.border_size = 2;
+	panel->style.roundness = v4(12);
+	panel->style.layout.axis = axis_y;
+	panel->style.layout.padding = v2(8, 8);
+	panel->style.layout.spacing = v2(0, 6);
+	panel->flags |= UI_Block_Flags_draw_background | UI_Block_Flags_draw_border;
+	UI_push_parent(ctx, panel);
+	{
+		UI_Block *bar = test_ui_block(ctx, 200, 24, UI_color4_hrz(0xE04030FF, 0x30C060FF));
+		bar->style.roundness = v4(20, 0, 6, 0);
+		bar->style.softness = 0;
+
+		UI_Block *soft = test_ui_block(ctx, 120, 24, UI_color4_sld_u32(0xFFFFFF80));
+		soft->style.softness = 4;
+		soft->style.roundness = v4(-1); // pill
+
+		UI_Block *srgb = test_ui_block(ctx, 200, 16, UI_color4_hrz(0x000000FF, 0xFFFFFFFF));
+		srgb->flags |= UI_Block_Flags_render_srgb;
+
+		UI_Block *image = test_ui_block(ctx, 48, 48, UI_color4_sld_u32(0xFFFFFFFF));
+		image->flags |= UI_Block_Flags_draw_image;
+		image->style.texture_handle = texture;
+		image->style.texture_uv = v2(0, 0);
+		image->style.texture_src_size = v2(16, 16);
+		image->style.texture_rotation = 0.5f;
+		image->style.softness = 0;
+
+		// wider than the panel, cut off at its edge
+		UI_Block *clipped = test_ui_block(ctx, 300, 20, UI_color4_sld_u32(0xFFA000C0));
+		clipped->style.clip_block = panel;
+		clipped->style.softness = 0;
+	}
+	UI_pop_parent(ctx);
+
+	UI_end_frame(ctx);
+	UI_software_clear(ctx, v4(0.1f, 0.1f, 0.1f, 1));
+	UI_render(ctx);
+}
+
+// The framebuffer against tests/data/<name>.png. A little slack per channel, for math libraries
+// that round sinf and powf differently.
+static void test_ui_check_frame(UI_Context *ctx, const char *name) {
+	UI_Software_Context *sw_ctx = (UI_Software_Context *)ctx->backend_context;
+	char path[256];
+	snprintf(path, sizeof(path), "tests/data/%s.png", name);
+	int w = 0, h = 0, n;
+	u8 *reference = stbi_load(path, &w, &h, &n, 4);
+	bool same = CHECK(reference != nullptr) && CHECK(w == sw_ctx->w && h == sw_ctx->h);
+	if (same) {
+		int difference = test_max_difference(sw_ctx->framebuffer, (size_t)w * 4, reference, (size_t)w * 4, w, h);
+		same = CHECK(difference <= 2);
+		if (!same) printf("  largest difference %d\n", difference);
+	}
+	if (!same) {
+		snprintf(path, sizeof(path), "bin/%s.png", name);
+		stbi_write_png(path, sw_ctx->w, sw_ctx->h, 4, sw_ctx->framebuffer, sw_ctx->w * 4);
+		printf("  frame written to %s\n", path);
+	}
+	stbi_image_free(reference);
+}
+
+static void test_ui_software_frame() {
+	UI_Context *ctx = test_ui_context();
+	int ww = WW, wh = WH;
+	WW = TEST_UI_W; // UI_build_vertices drops blocks outside the window
+	WH = TEST_UI_H;
+
+	u8 pixels[16 * 16 * 4];
+	for (int i = 0; i < 16 * 16; i++) {
+		bool odd = ((i % 16) / 4 + (i / 16) / 4) % 2;
+		u8 color[4] = { 240, 240, 240, 255 };
+		if (odd) { color[0] = 32; color[1] = 128; color[2] = 224; }
+		memcpy(pixels + i * 4, color, 4);
+	}
+	i32 texture = UI_create_texture(ctx, pixels, 16, 16);
+	if (CHECK(texture >= 0)) {
+		test_ui_frame(ctx, texture);
+		test_ui_check_frame(ctx, "ui_software_frame");
+		// a frame built the same again reuses the layout and vertices, and has to look the same
+		test_ui_frame(ctx, texture);
+		CHECK(ctx->frame_reused);
+		test_ui_check_frame(ctx, "ui_software_frame");
+	}
+	WW = ww;
+	WH = wh;
+}
+
+// Updating a texture bound to the caller's memory must leave that memory alone.
+static void test_ui_software_bound_texture() {
+	UI_Context *ctx = test_ui_context();
+	UI_Software_Context *sw_ctx = (UI_Software_Context *)ctx->backend_context;
+	i32 w = 8, h = 6;
+	u8 *bound = test_pattern(w, h);
+	u8 *original = test_pattern(w, h);
+	u8 *update = (u8 *)calloc((size_t)w * h * 4, 1);
+	memset(update, 0xAB, (size_t)w * h * 4);
+	UI_Software_Texture *texture = &sw_ctx->textures[3];
+
+	UI_software_bind_texture(ctx, 3, bound, w, h, w * 4);
+	UI_software_update_texture(ctx, 3, bound, w * 4, 0, 0, w, h);
+	CHECK(texture->pixels == bound && !texture->owned);
+
+	UI_software_update_texture(ctx, 3, update, w * 4, 2, 1, 3, 4);
+	CHECK(memcmp(bound, original, (size_t)w * h * 4) == 0);
+	if (CHECK(texture->owned && texture->pixels != bound && texture->pitch == w * 4)) {
+		for (int y = 0; y < h; y++) {
+			for (int x = 0; x < w; x++) {
+				bool updated = x >= 2 && x < 5 && y >= 1 && y < 5;
+				const u8 *expected = (updated ? update : original) + ((size_t)y * w + x) * 4;
+				CHECK(memcmp(texture->pixels + (size_t)y * texture->pitch + x * 4, expected, 4) == 0);
+			}
+		}
+	}
+
+	// an owned texture is what later updates and the next bind replace
+	UI_software_bind_texture(ctx, 3, bound, w, h, w * 4);
+	CHECK(texture->pixels == bound && !texture->owned);
+	texture->pixels = nullptr;
+	free(bound);
+	free(original);
+	free(update);
+}
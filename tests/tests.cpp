@@ -0,0 +1,84 @@
+// Test runner. Like main.cpp it builds the whole application as one translation unit, so the tests
+// reach everything main.cpp does, and adds the tests on top; `b.bat tests` builds and runs it as
+// bin\tests.exe. Without arguments every test runs, otherwise the ones whose names start with an
+// argument. The exit code is the number of failed tests. `bin\tests.exe --bench-ui` runs the UI
+// benchmark in bench_ui.cpp instead.
+#include "../src/main.h"
+#include "../src/source.cpp"
+#include <algorithm> // std::stable_sort, what UI_sort_vertices is checked against
+
+#include "test.h"
+#include "bench_ui.cpp"
+#include "test_batch.cpp"
+#include "test_clipboard.cpp"
+#include "test_color_profile.cpp"
+#include "test_cube_lut.cpp"
+#include "test_encoders.cpp"
+#include "test_gpu_pipeline.cpp"
+#include "test_glyph_atlas.cpp"
+#include "test_hit_grid.cpp"
+#include "test_ui_core.cpp"
+#include "test_ui_software.cpp"
+
+static Test tests[] = {
+	{ "batch_output_names",				test_batch_output_names },
+	{ "clipboard_copy_image_cpu",		test_clipboard_copy_image_cpu },
+	{ "clipboard_copy_image_cpu_crop",	test_clipboard_copy_image_cpu_crop },
+	{ "clipboard_copy_image_bgra",		test_clipboard_copy_image_bgra },
+	{ "clipboard_empty_image",			test_clipboard_empty_image },
+	{ "color_profile_srgb",				test_color_profile_srgb },
+	{ "color_profile_gamma",				test_color_profile_gamma },
+	{ "color_profile_truncated",		test_color_profile_truncated },
+	{ "cube_lut_valid",					test_cube_lut_valid },
+	{ "cube_lut_invalid",				test_cube_lut_invalid },
+	{ "cube_lut_sample",				test_cube_lut_sample },
+	{ "encoders_png",					test_encoders_png },
+	{ "encoders_jpeg",					test_encoders_jpeg },
+	{ "gpu_pipeline_neutral",			test_gpu_pipeline_neutral },
+	{ "gpu_pipeline_color",				test_gpu_pipeline_color },
+	{ "gpu_pipeline_channels",			test_gpu_pipeline_channels },
+	{ "gpu_pipeline_crop_rotation",		test_gpu_pipeline_crop_rotation },
+	{ "gpu_pipeline_blur",				test_gpu_pipeline_blur },
+	{ "gpu_pipeline_formats",			test_gpu_pipeline_formats },
+	{ "glyph_atlas_pack",				test_glyph_atlas_pack },
+	{ "glyph_atlas_grow",				test_glyph_atlas_grow },
+	{ "glyph_atlas_evict",				test_glyph_atlas_evict },
+	{ "hit_grid",						test_hit_grid },
+	{ "ui_core_sort_vertices",			test_ui_core_sort_vertices },
+	{ "ui_core_hash_index",				test_ui_core_hash_index },
+	{ "ui_core_text_runs",				test_ui_core_text_runs },
+	{ "ui_core_reuse_layout",			test_ui_core_reuse_layout },
+	{ "ui_software_frame",				test_ui_software_frame },
+	{ "ui_software_bound_texture",		test_ui_software_bound_texture },
+};
+
+static bool test_selected(const Test *test, int argc, wchar_t **argv) {
+	if (argc <= 1) return true;
+	wchar_t name[128];
+	swprintf(name, array_size(name), L"%hs", test->name);
+	for (int i = 1; i < argc; i++)
+		if (wcsncmp(name, argv[i], wcslen(argv[i])) == 0) return true;
+	return false;
+}
+
+int wmain(int argc, wchar_t **argv) {
+	if (argc > 1 && wcscmp(argv[1], L"--bench-ui") == 0)
+		return bench_ui_main(argc - 2, argv + 2);
+	int failed = 0, ran = 0;
+	for (int i = 0; i < array_size(tests); i++) {
+		if (!test_selected(&tests[i], argc, argv)) continue;
+		printf("%s\n", tests[i].name);
+		int failed_checks = test_failed_checks;
+		f64 start = get_time();
+		tests[i].func();
+		ran++;
+		if (test_failed_checks != failed_checks) {
+			printf("  FAILED\n");
+			failed++;
+		} else {
+			printf("  ok (%.1f ms)\n", (get_time() - start) * 1000);
+		}
+	}
+	printf("%d of %d tests passed\n", ran - failed, ran);
+	return failed;
+}